@@ -0,0 +1,906 @@
+/***************************************************************************
+ * msbench.c
+ *
+ * Benchmark of the mseed2sac hot paths using synthetic data.
+ *
+ * Multi-channel miniSEED is generated with mst_pack() and the phases
+ * of a conversion are timed separately: reading and decoding records,
+ * trace assembly with mst_addmsrtogroup(), conversion of samples to
+ * floats, binary SAC writing, alphanumeric SAC writing and ZIP
+ * deflate compression.  Each phase is repeated and the results are
+ * written as JSON for comparison between releases.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <libmseed.h>
+
+#include "fdzipstream.h"
+#include "sacformat.h"
+#include "sampleconv.h"
+
+#define VERSION "1.0"
+#define PACKAGE "msbench"
+
+#define MAXPHASES 16
+
+/* Timing results for a phase */
+struct phase
+{
+  const char *name;
+  double best;   /* Shortest time of the repetitions in seconds */
+  double total;  /* Total time of the repetitions in seconds */
+  int runs;
+  int64_t bytes; /* Bytes processed or produced by one repetition */
+};
+
+/* Records generated for a channel */
+struct recbuffer
+{
+  char *records;
+  int64_t count;
+  int64_t size;
+};
+
+static int parameter_proc (int argcount, char **argvec);
+static void recordhandler (char *record, int reclen, void *handlerdata);
+static int generate (void);
+static void fillsamples (MSTrace *mst, int chanidx);
+static int readdecode (flag dataflag, MSTraceGroup *mstg, double *assembly);
+static int64_t convertsamples (MSTraceGroup *mstg);
+static int64_t writebinary (MSTraceGroup *mstg);
+static int64_t writealpha (MSTraceGroup *mstg);
+static int64_t writezip (MSTraceGroup *mstg);
+static float *tracefloats (MSTrace *mst);
+static void setheader (struct SACHeader *sh, MSTrace *mst);
+static struct phase *addphase (const char *name);
+static void addtime (struct phase *ph, double seconds, int64_t bytes);
+static int writeresults (void);
+static double now (void);
+static void usage (void);
+
+static int verbose = 0;
+static int channels = 12;
+static double duration = 3600.0;
+static double samprate = 100.0;
+static int reclen = 512;
+static int encoding = DE_STEIM2;
+static int repeat = 3;
+static char *tmpdir = ".";
+static char *resultfile = "msbench.json";
+
+static char datafile[512];
+static int64_t totalrecs = 0;
+static int64_t totalsamps = 0;
+static int64_t filebytes = 0;
+static const char *sampleconv;
+
+static struct phase phases[MAXPHASES];
+static int phasecount = 0;
+
+static float *floatbuffer = NULL; /* Float samples of a trace */
+static int64_t floatsize = 0;
+
+int
+main (int argc, char **argv)
+{
+  MSTraceGroup *mstg = NULL;
+  struct phase *ph;
+  double start;
+  double assembly;
+  int64_t bytes;
+  int rep;
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return 1;
+
+  sampleconv = sc_init ();
+
+  snprintf (datafile, sizeof (datafile), "%s/msbench-%ld.mseed", tmpdir, (long)getpid ());
+
+  start = now ();
+  if (generate ())
+    return 1;
+  addtime (addphase ("generate"), now () - start, filebytes);
+
+  if (verbose)
+    fprintf (stderr, "Generated %lld records, %lld samples, %lld bytes\n",
+             (long long int)totalrecs, (long long int)totalsamps, (long long int)filebytes);
+
+  /* Read record headers, read and decode records, then assemble them
+   * into traces timing only the mst_addmsrtogroup() calls */
+  ph = addphase ("read");
+  for (rep = 0; rep < repeat; rep++)
+  {
+    start = now ();
+    if (readdecode (0, NULL, NULL))
+      return 1;
+    addtime (ph, now () - start, filebytes);
+  }
+
+  ph = addphase ("read_decode");
+  for (rep = 0; rep < repeat; rep++)
+  {
+    start = now ();
+    if (readdecode (1, NULL, NULL))
+      return 1;
+    addtime (ph, now () - start, filebytes);
+  }
+
+  ph = addphase ("assembly");
+  for (rep = 0; rep < repeat; rep++)
+  {
+    mst_freegroup (&mstg);
+    mstg = mst_initgroup (NULL);
+
+    if (readdecode (1, mstg, &assembly))
+      return 1;
+    addtime (ph, assembly, totalsamps * 4);
+  }
+
+  ph = addphase ("float_conversion");
+  for (rep = 0; rep < repeat; rep++)
+  {
+    start = now ();
+    bytes = convertsamples (mstg);
+    addtime (ph, now () - start, bytes);
+  }
+
+  ph = addphase ("sac_write");
+  for (rep = 0; rep < repeat; rep++)
+  {
+    start = now ();
+    if ((bytes = writebinary (mstg)) < 0)
+      return 1;
+    addtime (ph, now () - start, bytes);
+  }
+
+  ph = addphase ("alpha_write");
+  for (rep = 0; rep < repeat; rep++)
+  {
+    start = now ();
+    if ((bytes = writealpha (mstg)) < 0)
+      return 1;
+    addtime (ph, now () - start, bytes);
+  }
+
+  ph = addphase ("zip_deflate");
+  for (rep = 0; rep < repeat; rep++)
+  {
+    start = now ();
+    if ((bytes = writezip (mstg)) < 0)
+      return 1;
+    addtime (ph, now () - start, bytes);
+  }
+
+  unlink (datafile);
+  mst_freegroup (&mstg);
+  free (floatbuffer);
+
+  return (writeresults ()) ? 1 : 0;
+} /* End of main() */
+
+/***************************************************************************
+ * generate:
+ *
+ * Generate synthetic miniSEED for all channels with mst_pack() and
+ * write it to the data file, multiplexing the records of the channels
+ * in the order they were packed.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+generate (void)
+{
+  struct recbuffer *buffers;
+  MSTrace *mst;
+  FILE *ofp;
+  int64_t packedsamples;
+  int64_t recidx;
+  int64_t remaining;
+  int chanidx;
+
+  if ((buffers = (struct recbuffer *)calloc (channels, sizeof (struct recbuffer))) == NULL)
+  {
+    fprintf (stderr, "Error allocating memory\n");
+    return -1;
+  }
+
+  for (chanidx = 0; chanidx < channels; chanidx++)
+  {
+    if ((mst = mst_init (NULL)) == NULL)
+      return -1;
+
+    snprintf (mst->network, sizeof (mst->network), "XB");
+    snprintf (mst->station, sizeof (mst->station), "B%03d", chanidx / 3);
+    snprintf (mst->channel, sizeof (mst->channel), "HH%c", "ZNE"[chanidx % 3]);
+    mst->dataquality = 'D';
+    mst->starttime = ms_timestr2hptime ("2020-01-01T00:00:00");
+    mst->samprate = samprate;
+
+    fillsamples (mst, chanidx);
+
+    if (mst_pack (mst, recordhandler, &buffers[chanidx], reclen, encoding, 1,
+                  &packedsamples, 1, verbose - 1, NULL) < 0)
+    {
+      fprintf (stderr, "Error packing %s\n", mst->station);
+      return -1;
+    }
+
+    totalsamps += packedsamples;
+    mst_free (&mst);
+  }
+
+  if ((ofp = fopen (datafile, "wb")) == NULL)
+  {
+    fprintf (stderr, "Cannot open %s: %s\n", datafile, strerror (errno));
+    return -1;
+  }
+
+  for (recidx = 0, remaining = channels; remaining > 0; recidx++)
+  {
+    remaining = 0;
+
+    for (chanidx = 0; chanidx < channels; chanidx++)
+    {
+      if (recidx >= buffers[chanidx].count)
+        continue;
+
+      if (fwrite (buffers[chanidx].records + recidx * reclen, reclen, 1, ofp) != 1)
+      {
+        fprintf (stderr, "Error writing %s: %s\n", datafile, strerror (errno));
+        return -1;
+      }
+
+      totalrecs++;
+      filebytes += reclen;
+      remaining++;
+    }
+  }
+
+  fclose (ofp);
+
+  for (chanidx = 0; chanidx < channels; chanidx++)
+    free (buffers[chanidx].records);
+  free (buffers);
+
+  return 0;
+} /* End of generate() */
+
+/***************************************************************************
+ * fillsamples:
+ *
+ * Fill a MSTrace with a deterministic signal, a sinusoid with added
+ * noise.  The amplitudes vary by channel so that the data compress
+ * with a mix of difference sizes and stay within 16 bits for INT16.
+ ***************************************************************************/
+static void
+fillsamples (MSTrace *mst, int chanidx)
+{
+  uint32_t state = 12345 + chanidx;
+  double amplitude;
+  double value;
+  int32_t noise;
+  int64_t idx;
+
+  mst->numsamples = (int64_t) (duration * samprate);
+  mst->samplecnt = mst->numsamples;
+
+  amplitude = (encoding == DE_INT16) ? 20000.0 : (double)(100 << (chanidx % 12));
+  noise = (encoding == DE_INT16) ? 1000 : (2 << (chanidx % 10));
+
+  if (encoding == DE_FLOAT64)
+    mst->sampletype = 'd';
+  else if (encoding == DE_FLOAT32)
+    mst->sampletype = 'f';
+  else
+    mst->sampletype = 'i';
+
+  mst->datasamples = malloc ((size_t)mst->numsamples * ms_samplesize (mst->sampletype));
+
+  for (idx = 0; idx < mst->numsamples; idx++)
+  {
+    state = state * 1103515245 + 12345;
+
+    value = amplitude * sin (idx * 2.0 * M_PI / (samprate * (10 + chanidx))) +
+            (int32_t) ((state >> 8) % (2 * noise)) - noise;
+
+    if (mst->sampletype == 'i')
+      ((int32_t *)mst->datasamples)[idx] = (int32_t)value;
+    else if (mst->sampletype == 'f')
+      ((float *)mst->datasamples)[idx] = (float)value;
+    else
+      ((double *)mst->datasamples)[idx] = value;
+  }
+} /* End of fillsamples() */
+
+/***************************************************************************
+ * recordhandler:
+ *
+ * Save records packed by mst_pack() in the buffer of the channel.
+ ***************************************************************************/
+static void
+recordhandler (char *record, int reclen, void *handlerdata)
+{
+  struct recbuffer *rb = (struct recbuffer *)handlerdata;
+  char *records;
+
+  if (rb->count >= rb->size)
+  {
+    if ((records = (char *)realloc (rb->records, (rb->size * 2 + 64) * reclen)) == NULL)
+    {
+      fprintf (stderr, "Error allocating memory\n");
+      exit (1);
+    }
+
+    rb->records = records;
+    rb->size = rb->size * 2 + 64;
+  }
+
+  memcpy (rb->records + rb->count * reclen, record, reclen);
+  rb->count++;
+} /* End of recordhandler() */
+
+/***************************************************************************
+ * readdecode:
+ *
+ * Read all records of the data file with ms_readmsr_r(), decoding the
+ * data samples if dataflag is true.  If mstg is not NULL the records
+ * are added to it and the time spent in mst_addmsrtogroup() is
+ * returned in assembly.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+readdecode (flag dataflag, MSTraceGroup *mstg, double *assembly)
+{
+  MSFileParam *msfp = NULL;
+  MSRecord *msr = NULL;
+  double start;
+  int retcode;
+
+  if (assembly)
+    *assembly = 0.0;
+
+  while ((retcode = ms_readmsr_r (&msfp, &msr, datafile, reclen, NULL, NULL,
+                                  1, dataflag, verbose - 1)) == MS_NOERROR)
+  {
+    if (mstg)
+    {
+      start = now ();
+      mst_addmsrtogroup (mstg, msr, 1, -1.0, -1.0);
+      *assembly += now () - start;
+    }
+  }
+
+  ms_readmsr_r (&msfp, &msr, NULL, 0, NULL, NULL, 0, 0, 0);
+
+  if (retcode != MS_ENDOFFILE)
+  {
+    fprintf (stderr, "Error reading %s: %s\n", datafile, ms_errorstr (retcode));
+    return -1;
+  }
+
+  return 0;
+} /* End of readdecode() */
+
+/***************************************************************************
+ * tracefloats:
+ *
+ * Convert the samples of a MSTrace to floats in the float buffer.
+ *
+ * Returns a pointer to the float samples or NULL on error.
+ ***************************************************************************/
+static float *
+tracefloats (MSTrace *mst)
+{
+  if (mst->numsamples > floatsize)
+  {
+    free (floatbuffer);
+
+    if ((floatbuffer = (float *)malloc (mst->numsamples * sizeof (float))) == NULL)
+    {
+      fprintf (stderr, "Error allocating memory\n");
+      floatsize = 0;
+      return NULL;
+    }
+
+    floatsize = mst->numsamples;
+  }
+
+  if (mst->sampletype == 'i')
+    sc_int32tofloat (floatbuffer, (int32_t *)mst->datasamples, mst->numsamples, 0);
+  else if (mst->sampletype == 'd')
+    sc_doubletofloat (floatbuffer, (double *)mst->datasamples, mst->numsamples, 0);
+  else
+    memcpy (floatbuffer, mst->datasamples, mst->numsamples * sizeof (float));
+
+  return floatbuffer;
+} /* End of tracefloats() */
+
+/***************************************************************************
+ * convertsamples:
+ *
+ * Convert the samples of all traces to floats.
+ *
+ * Returns the number of bytes of float samples produced.
+ ***************************************************************************/
+static int64_t
+convertsamples (MSTraceGroup *mstg)
+{
+  MSTrace *mst;
+  int64_t bytes = 0;
+
+  for (mst = mstg->traces; mst; mst = mst->next)
+  {
+    if (!tracefloats (mst))
+      return -1;
+
+    bytes += mst->numsamples * sizeof (float);
+  }
+
+  return bytes;
+} /* End of convertsamples() */
+
+/***************************************************************************
+ * setheader:
+ *
+ * Set the SAC header fields describing the samples of a MSTrace.
+ ***************************************************************************/
+static void
+setheader (struct SACHeader *sh, MSTrace *mst)
+{
+  struct SACHeader nullheader = NullSACHeader;
+
+  memcpy (sh, &nullheader, sizeof (struct SACHeader));
+
+  sh->npts = (int32_t)mst->numsamples;
+  sh->delta = (float)(1.0 / mst->samprate);
+  sh->b = 0.0;
+  sh->e = (float)((mst->numsamples - 1) / mst->samprate);
+  sh->iftype = ITIME;
+  sh->leven = 1;
+  sh->nvhdr = 6;
+} /* End of setheader() */
+
+/***************************************************************************
+ * writebinary:
+ *
+ * Write each trace to a binary SAC file in the temporary directory,
+ * the files are removed after writing.
+ *
+ * Returns the number of bytes written or -1 on error.
+ ***************************************************************************/
+static int64_t
+writebinary (MSTraceGroup *mstg)
+{
+  struct SACHeader sh;
+  MSTrace *mst;
+  FILE *ofp;
+  char outfile[512];
+  float *fdata;
+  int64_t bytes = 0;
+  int idx = 0;
+
+  for (mst = mstg->traces; mst; mst = mst->next, idx++)
+  {
+    snprintf (outfile, sizeof (outfile), "%s/msbench-%ld-%d.SAC", tmpdir, (long)getpid (), idx);
+
+    if ((fdata = tracefloats (mst)) == NULL)
+      return -1;
+
+    setheader (&sh, mst);
+
+    if ((ofp = fopen (outfile, "wb")) == NULL)
+    {
+      fprintf (stderr, "Cannot open %s: %s\n", outfile, strerror (errno));
+      return -1;
+    }
+
+    if (fwrite (&sh, sizeof (struct SACHeader), 1, ofp) != 1 ||
+        fwrite (fdata, sizeof (float), mst->numsamples, ofp) != (size_t)mst->numsamples)
+    {
+      fprintf (stderr, "Error writing %s: %s\n", outfile, strerror (errno));
+      fclose (ofp);
+      return -1;
+    }
+
+    fclose (ofp);
+    unlink (outfile);
+
+    bytes += sizeof (struct SACHeader) + mst->numsamples * sizeof (float);
+  }
+
+  return bytes;
+} /* End of writebinary() */
+
+/***************************************************************************
+ * writealpha:
+ *
+ * Write the samples of each trace to an alphanumeric SAC file in the
+ * temporary directory, 5 samples per line as formatted by mseed2sac.
+ * The header is not included, its formatting is negligible compared
+ * to the samples.  The files are removed after writing.
+ *
+ * Returns the number of bytes written or -1 on error.
+ ***************************************************************************/
+static int64_t
+writealpha (MSTraceGroup *mstg)
+{
+  MSTrace *mst;
+  FILE *ofp;
+  char outfile[512];
+  char buffer[65536];
+  char *bp;
+  float *fdata;
+  int64_t bytes = 0;
+  int64_t sidx;
+  int idx = 0;
+
+  for (mst = mstg->traces; mst; mst = mst->next, idx++)
+  {
+    snprintf (outfile, sizeof (outfile), "%s/msbench-%ld-%d.SACA", tmpdir, (long)getpid (), idx);
+
+    if ((fdata = tracefloats (mst)) == NULL)
+      return -1;
+
+    if ((ofp = fopen (outfile, "wb")) == NULL)
+    {
+      fprintf (stderr, "Cannot open %s: %s\n", outfile, strerror (errno));
+      return -1;
+    }
+
+    for (bp = buffer, sidx = 0; sidx < mst->numsamples; sidx++)
+    {
+      sc_formatalpha (bp, fdata[sidx]);
+      bp += 15;
+
+      if ((sidx % 5) == 4 || sidx == mst->numsamples - 1)
+        *bp++ = '\n';
+
+      if ((bp - buffer) > (int)(sizeof (buffer) - 16) || sidx == mst->numsamples - 1)
+      {
+        if (fwrite (buffer, bp - buffer, 1, ofp) != 1)
+        {
+          fprintf (stderr, "Error writing %s: %s\n", outfile, strerror (errno));
+          fclose (ofp);
+          return -1;
+        }
+
+        bytes += bp - buffer;
+        bp = buffer;
+      }
+    }
+
+    fclose (ofp);
+    unlink (outfile);
+  }
+
+  return bytes;
+} /* End of writealpha() */
+
+/***************************************************************************
+ * writezip:
+ *
+ * Write each trace as binary SAC to an entry of a ZIP archive in the
+ * temporary directory, compressed with deflate.  The archive is
+ * removed after writing.
+ *
+ * Returns the number of uncompressed bytes written or -1 on error.
+ ***************************************************************************/
+static int64_t
+writezip (MSTraceGroup *mstg)
+{
+  struct SACHeader sh;
+  ZIPstream *zstream;
+  ZIPentry *zentry;
+  MSTrace *mst;
+  ssize_t writestatus = 0;
+  char zipfile[512];
+  char name[64];
+  float *fdata;
+  int64_t bytes = 0;
+  int zipfd;
+  int idx = 0;
+
+  snprintf (zipfile, sizeof (zipfile), "%s/msbench-%ld.zip", tmpdir, (long)getpid ());
+
+  if ((zipfd = open (zipfile, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+  {
+    fprintf (stderr, "Cannot open %s: %s\n", zipfile, strerror (errno));
+    return -1;
+  }
+
+  if ((zstream = zs_init (zipfd, NULL)) == NULL)
+  {
+    fprintf (stderr, "Error initializing ZIP archive\n");
+    close (zipfd);
+    return -1;
+  }
+
+  for (mst = mstg->traces; mst; mst = mst->next, idx++)
+  {
+    snprintf (name, sizeof (name), "msbench-%d.SAC", idx);
+
+    if ((fdata = tracefloats (mst)) == NULL)
+      return -1;
+
+    setheader (&sh, mst);
+
+    if ((zentry = zs_entrybegin (zstream, name, time (NULL), ZS_DEFLATE, &writestatus)) == NULL ||
+        zs_entrydata (zstream, zentry, (uint8_t *)&sh, sizeof (struct SACHeader), &writestatus) == NULL ||
+        zs_entrydata (zstream, zentry, (uint8_t *)fdata, mst->numsamples * sizeof (float),
+                      &writestatus) == NULL ||
+        zs_entryend (zstream, zentry, &writestatus) == NULL)
+    {
+      fprintf (stderr, "Error writing ZIP entry %s, write status: %lld\n",
+               name, (long long int)writestatus);
+      return -1;
+    }
+
+    bytes += sizeof (struct SACHeader) + mst->numsamples * sizeof (float);
+  }
+
+  if (zs_finish (zstream, &writestatus))
+  {
+    fprintf (stderr, "Error finishing ZIP archive, write status: %lld\n",
+             (long long int)writestatus);
+    return -1;
+  }
+
+  zs_free (zstream);
+  close (zipfd);
+  unlink (zipfile);
+
+  return bytes;
+} /* End of writezip() */
+
+/***************************************************************************
+ * addphase:
+ *
+ * Add a phase to the results.
+ *
+ * Returns a pointer to the phase.
+ ***************************************************************************/
+static struct phase *
+addphase (const char *name)
+{
+  struct phase *ph = &phases[phasecount++];
+
+  memset (ph, 0, sizeof (struct phase));
+  ph->name = name;
+
+  if (verbose)
+    fprintf (stderr, "Running %s\n", name);
+
+  return ph;
+} /* End of addphase() */
+
+/***************************************************************************
+ * addtime:
+ *
+ * Add the time and bytes of a repetition to a phase.
+ ***************************************************************************/
+static void
+addtime (struct phase *ph, double seconds, int64_t bytes)
+{
+  if (ph->runs == 0 || seconds < ph->best)
+    ph->best = seconds;
+
+  ph->total += seconds;
+  ph->bytes = bytes;
+  ph->runs++;
+} /* End of addtime() */
+
+/***************************************************************************
+ * writeresults:
+ *
+ * Write the parameters and phase timings as JSON to the result file,
+ * or to stdout if the file is "-".  A summary is printed to stderr.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+writeresults (void)
+{
+  struct phase *ph;
+  FILE *ofp;
+  char timestr[64];
+  time_t nowtime = time (NULL);
+  double best;
+  int idx;
+
+  if (!strcmp (resultfile, "-"))
+  {
+    ofp = stdout;
+  }
+  else if ((ofp = fopen (resultfile, "w")) == NULL)
+  {
+    fprintf (stderr, "Cannot open %s: %s\n", resultfile, strerror (errno));
+    return -1;
+  }
+
+  strftime (timestr, sizeof (timestr), "%Y-%m-%dT%H:%M:%SZ", gmtime (&nowtime));
+
+  fprintf (ofp, "{\n");
+  fprintf (ofp, "  \"program\": \"%s\",\n", PACKAGE);
+  fprintf (ofp, "  \"version\": \"%s\",\n", VERSION);
+  fprintf (ofp, "  \"libmseed\": \"%s\",\n", LIBMSEED_VERSION);
+  fprintf (ofp, "  \"sampleconv\": \"%s\",\n", sampleconv);
+  fprintf (ofp, "  \"date\": \"%s\",\n", timestr);
+  fprintf (ofp, "  \"parameters\": {\n");
+  fprintf (ofp, "    \"channels\": %d,\n", channels);
+  fprintf (ofp, "    \"duration\": %g,\n", duration);
+  fprintf (ofp, "    \"samprate\": %g,\n", samprate);
+  fprintf (ofp, "    \"reclen\": %d,\n", reclen);
+  fprintf (ofp, "    \"encoding\": %d,\n", encoding);
+  fprintf (ofp, "    \"repeat\": %d\n", repeat);
+  fprintf (ofp, "  },\n");
+  fprintf (ofp, "  \"records\": %lld,\n", (long long int)totalrecs);
+  fprintf (ofp, "  \"samples\": %lld,\n", (long long int)totalsamps);
+  fprintf (ofp, "  \"bytes\": %lld,\n", (long long int)filebytes);
+  fprintf (ofp, "  \"phases\": [\n");
+
+  for (idx = 0; idx < phasecount; idx++)
+  {
+    ph = &phases[idx];
+    best = (ph->best > 0.0) ? ph->best : 1e-9;
+
+    fprintf (ofp, "    {\"name\": \"%s\", \"runs\": %d, \"best\": %.6f, \"mean\": %.6f, "
+                  "\"bytes\": %lld, \"samples_per_second\": %.0f, \"mbytes_per_second\": %.2f}%s\n",
+             ph->name, ph->runs, ph->best, ph->total / ph->runs,
+             (long long int)ph->bytes, totalsamps / best, ph->bytes / best / 1048576.0,
+             (idx < phasecount - 1) ? "," : "");
+
+    fprintf (stderr, "%-18s %10.6f s %12.0f samples/s %10.2f MB/s\n",
+             ph->name, ph->best, totalsamps / best, ph->bytes / best / 1048576.0);
+  }
+
+  fprintf (ofp, "  ]\n");
+  fprintf (ofp, "}\n");
+
+  if (ofp != stdout)
+    fclose (ofp);
+
+  return 0;
+} /* End of writeresults() */
+
+/***************************************************************************
+ * now:
+ *
+ * Returns the current monotonic time in seconds.
+ ***************************************************************************/
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+} /* End of now() */
+
+/***************************************************************************
+ * parameter_proc:
+ *
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure.
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      fprintf (stderr, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else if (strcmp (argvec[optind], "-c") == 0 && optind + 1 < argcount)
+    {
+      channels = strtol (argvec[++optind], NULL, 10);
+    }
+    else if (strcmp (argvec[optind], "-d") == 0 && optind + 1 < argcount)
+    {
+      duration = strtod (argvec[++optind], NULL);
+    }
+    else if (strcmp (argvec[optind], "-s") == 0 && optind + 1 < argcount)
+    {
+      samprate = strtod (argvec[++optind], NULL);
+    }
+    else if (strcmp (argvec[optind], "-r") == 0 && optind + 1 < argcount)
+    {
+      reclen = strtol (argvec[++optind], NULL, 10);
+    }
+    else if (strcmp (argvec[optind], "-e") == 0 && optind + 1 < argcount)
+    {
+      encoding = strtol (argvec[++optind], NULL, 10);
+    }
+    else if (strcmp (argvec[optind], "-n") == 0 && optind + 1 < argcount)
+    {
+      repeat = strtol (argvec[++optind], NULL, 10);
+    }
+    else if (strcmp (argvec[optind], "-t") == 0 && optind + 1 < argcount)
+    {
+      tmpdir = argvec[++optind];
+    }
+    else if (strcmp (argvec[optind], "-o") == 0 && optind + 1 < argcount)
+    {
+      resultfile = argvec[++optind];
+    }
+    else
+    {
+      fprintf (stderr, "Unknown option: %s\n", argvec[optind]);
+      return -1;
+    }
+  }
+
+  if (channels < 1 || duration <= 0.0 || samprate <= 0.0 || repeat < 1)
+  {
+    fprintf (stderr, "Channels, duration, sample rate and repetitions must be positive\n");
+    return -1;
+  }
+
+  if (encoding != DE_INT16 && encoding != DE_INT32 && encoding != DE_FLOAT32 &&
+      encoding != DE_FLOAT64 && encoding != DE_STEIM1 && encoding != DE_STEIM2)
+  {
+    fprintf (stderr, "Unsupported encoding: %d\n", encoding);
+    return -1;
+  }
+
+  if (reclen < MINRECLEN || reclen > MAXRECLEN || (reclen & (reclen - 1)))
+  {
+    fprintf (stderr, "Record length must be a power of 2: %d\n", reclen);
+    return -1;
+  }
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * usage:
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s - Benchmark of mseed2sac hot paths version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s [options]\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V           Report program version\n"
+           " -h           Show this usage message\n"
+           " -v           Be more verbose, multiple flags can be used\n"
+           " -c channels  Number of channels to generate, default 12\n"
+           " -d seconds   Duration of each channel, default 3600\n"
+           " -s rate      Sample rate in samples per second, default 100\n"
+           " -r bytes     Record length, default 512\n"
+           " -e encoding  Data encoding: 1, 3, 4, 5, 10 or 11 (Steim2), default 11\n"
+           " -n count     Number of repetitions of each phase, default 3\n"
+           " -t dir       Directory for temporary files, default current directory\n"
+           " -o file      Write JSON results to file, '-' for stdout, default msbench.json\n"
+           "\n");
+} /* End of usage() */
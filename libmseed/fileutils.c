@@ -5,7 +5,7 @@
  * Written by Chad Trabant
  *   IRIS Data Management Center
  *
- * modified: 2015.108
+ * modified: 2026.287
  ***************************************************************************/
 
 #include <errno.h>
@@ -18,7 +18,69 @@
 
 #include "libmseed.h"
 
+/* Regular files are read using a memory mapping where supported */
+#if !defined(LMP_WIN)
+  #define MSFP_MMAP 1
+  #include <fcntl.h>
+  #include <sys/mman.h>
+#endif
+
+/* Compressed files are decompressed by a separate thread when built
+ * with LIBMSEED_ZLIB (gzip) and/or LIBMSEED_ZSTD (zstd) */
+#if (defined(LIBMSEED_ZLIB) || defined(LIBMSEED_ZSTD)) && !defined(LMP_WIN)
+  #define MSFP_DECOMP 1
+  #include <pthread.h>
+  #if defined(LIBMSEED_ZLIB)
+    #include <zlib.h>
+  #endif
+  #if defined(LIBMSEED_ZSTD)
+    #include <zstd.h>
+  #endif
+#endif
+
+/* Compression formats of input files */
+#define MSFP_GZIP 1
+#define MSFP_ZSTD 2
+
+/* Size of the ring buffer of decompressed data and of compressed reads */
+#define MSFP_RINGSIZE 1048576
+#define MSFP_INSIZE 131072
+
+/* Decompression of a compressed file by a separate thread, the thread
+ * reads and decompresses the file into a ring buffer that is read by
+ * ms_readmsr_main() in place of the file */
+typedef struct MSDecomp_s
+{
+  FILE *fp;              /* Compressed file, read only by the thread */
+  int format;            /* MSFP_GZIP or MSFP_ZSTD */
+  uint8_t prefix[4];     /* Bytes read from the file to detect the format */
+  int prefixlen;
+  int eof;               /* End of data returned to the reader */
+  uint64_t consumed;     /* Bytes taken from the ring by the reader */
+#if defined(MSFP_DECOMP)
+  char *ring;            /* Ring buffer of decompressed data */
+  uint64_t written;      /* Bytes added to the ring by the thread */
+  int done;              /* Thread finished at the end of the data or an error */
+  int stop;              /* Thread is requested to stop */
+  char error[200];       /* Error if decompression failed */
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t readable;
+  pthread_cond_t writable;
+#endif
+} MSDecomp;
+
+static MSFileParam *ms_newmsfp (void);
 static int ms_fread (char *buf, int size, int num, FILE *stream);
+static int ms_map_msfp (MSFileParam *msfp, off_t filesize);
+static void ms_unmap_msfp (MSFileParam *msfp);
+static int ms_endmap_msfp (MSFileParam *msfp);
+static int ms_compression (const uint8_t *buf, int length);
+static MSDecomp *ms_decomp_open (FILE *fp, int format, const uint8_t *prefix,
+                                 int prefixlen, const char *msfile);
+static void ms_decomp_close (MSDecomp *dc);
+static int ms_decomp_read (MSDecomp *dc, char *buf, int size, const char *msfile);
+static int ms_decomp_seek (MSFileParam *msfp, off_t offset);
 
 /* Pack type parameters for the 8 defined types:
  * [type] : [hdrlen] [sizelen] [chksumlen]
@@ -84,7 +146,7 @@ int8_t packtypes[9][3] = {
  *********************************************************************/
 
 /* Initialize the global file reading parameters */
-MSFileParam gMSFileParam = {NULL, "", NULL, 0, 0, 0, 0, 0, 0, 0};
+MSFileParam gMSFileParam = {NULL, "", NULL, 0, 0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, 0, NULL, NULL};
 
 /**********************************************************************
  * ms_readmsr:
@@ -126,6 +188,88 @@ ms_readmsr_r (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
                           last, skipnotdata, dataflag, NULL, verbose);
 } /* End of ms_readmsr_r() */
 
+/**********************************************************************
+ * ms_readmsr_setbuffer:
+ *
+ * Set the reading mode for the next file opened with a MSFileParam,
+ * allocating the MSFileParam if needed.  Must be called before the
+ * first read of a file, the settings apply until the file is closed
+ * by calling ms_readmsr_r() or ms_readmsr_main() with msfile set to
+ * NULL.
+ *
+ * If buffersize is greater than 0 files are read using stdio with a
+ * read-ahead buffer of buffersize bytes instead of a memory mapping,
+ * the operating system is asked for reads of the buffer size.  This
+ * can substantially improve throughput when reading from network file
+ * systems.  If advise is true the operating system is advised that
+ * regular files will be read sequentially, using posix_fadvise() when
+ * supported.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+int
+ms_readmsr_setbuffer (MSFileParam **ppmsfp, int buffersize, flag advise)
+{
+  if (!ppmsfp)
+    return -1;
+
+  if (!*ppmsfp && !(*ppmsfp = ms_newmsfp ()))
+    return -1;
+
+  if ((*ppmsfp)->fp)
+  {
+    ms_log (2, "ms_readmsr_setbuffer(): Cannot change reading mode of open file: %s\n",
+            (*ppmsfp)->filename);
+    return -1;
+  }
+
+  (*ppmsfp)->readbuffersize = (buffersize > 0) ? buffersize : 0;
+  (*ppmsfp)->readadvise     = advise;
+
+  return 0;
+} /* End of ms_readmsr_setbuffer() */
+
+/**********************************************************************
+ * ms_newmsfp:
+ *
+ * A helper routine to allocate and initialize a MSFileParam.
+ *
+ * Returns a pointer to a MSFileParam on success and NULL on error.
+ *********************************************************************/
+static MSFileParam *
+ms_newmsfp (void)
+{
+  MSFileParam *msfp;
+
+  msfp = (MSFileParam *)malloc (sizeof (MSFileParam));
+
+  if (msfp == NULL)
+  {
+    ms_log (2, "ms_newmsfp(): Cannot allocate memory for MSFP\n");
+    return NULL;
+  }
+
+  msfp->fp             = NULL;
+  msfp->filename[0]    = '\0';
+  msfp->rawrec         = NULL;
+  msfp->readlen        = 0;
+  msfp->readoffset     = 0;
+  msfp->packtype       = 0;
+  msfp->packhdroffset  = 0;
+  msfp->filepos        = 0;
+  msfp->filesize       = 0;
+  msfp->recordcount    = 0;
+  msfp->mapbase        = NULL;
+  msfp->maplength      = 0;
+  msfp->mapoffset      = 0;
+  msfp->readbuffersize = 0;
+  msfp->readadvise     = 0;
+  msfp->readbuffer     = NULL;
+  msfp->decomp         = NULL;
+
+  return msfp;
+} /* End of ms_newmsfp() */
+
 /**********************************************************************
  * ms_shift_msfp:
  *
@@ -147,7 +291,12 @@ ms_shift_msfp (MSFileParam *msfp, int shift)
     return;
   }
 
-  memmove (msfp->rawrec, msfp->rawrec + shift, msfp->readlen - shift);
+  /* A mapped buffer is shifted by moving the start of the window */
+  if (msfp->mapbase)
+    msfp->rawrec += shift;
+  else
+    memmove (msfp->rawrec, msfp->rawrec + shift, msfp->readlen - shift);
+
   msfp->readlen -= shift;
 
   if (shift < msfp->readoffset)
@@ -169,6 +318,696 @@ ms_shift_msfp (MSFileParam *msfp, int shift)
 /* Macro to return current reading position */
 #define MSFPREADPTR(MSFP) (MSFP->rawrec + MSFP->readoffset)
 
+/* Macro to test for end of file, the end of a mapping, decompressed data or stdio EOF */
+#define MSFPEOF(MSFP) ((MSFP->mapbase) ? (MSFP->mapoffset >= MSFP->maplength) : \
+                       (MSFP->decomp) ? MSFP->decomp->eof : feof (MSFP->fp))
+
+/**********************************************************************
+ * ms_map_msfp:
+ *
+ * A helper routine to memory map an opened regular file for reading.
+ * The mapping is read in the same way as the stdio read buffer, as a
+ * window of up to MAXRECLEN bytes, but instead of copying data into
+ * the buffer the window is moved through the mapping.  Records are
+ * parsed directly from the mapping.
+ *
+ * Returns 0 when the file is mapped and -1 when it is not, in which
+ * case the file should be read with stdio.
+ *********************************************************************/
+static int
+ms_map_msfp (MSFileParam *msfp, off_t filesize)
+{
+#if defined(MSFP_MMAP)
+  void *map;
+
+  if (!msfp || filesize <= 0 || (off_t)(size_t)filesize != filesize)
+    return -1;
+
+  map = mmap (NULL, (size_t)filesize, PROT_READ, MAP_PRIVATE, fileno (msfp->fp), 0);
+
+  if (map == MAP_FAILED)
+    return -1;
+
+#if defined(MADV_SEQUENTIAL)
+  madvise (map, (size_t)filesize, MADV_SEQUENTIAL);
+#endif
+
+  /* Release any stdio read buffer */
+  if (msfp->rawrec)
+    free (msfp->rawrec);
+
+  msfp->mapbase   = (char *)map;
+  msfp->maplength = filesize;
+  msfp->mapoffset = 0;
+  msfp->rawrec    = msfp->mapbase;
+
+  return 0;
+#else
+  return -1;
+#endif
+} /* End of ms_map_msfp() */
+
+/**********************************************************************
+ * ms_unmap_msfp:
+ *
+ * A helper routine to release the memory mapping of a MSFP, if any.
+ *********************************************************************/
+static void
+ms_unmap_msfp (MSFileParam *msfp)
+{
+#if defined(MSFP_MMAP)
+  if (msfp && msfp->mapbase)
+  {
+    munmap (msfp->mapbase, (size_t)msfp->maplength);
+
+    msfp->rawrec    = NULL;
+    msfp->mapbase   = NULL;
+    msfp->maplength = 0;
+    msfp->mapoffset = 0;
+  }
+#endif
+} /* End of ms_unmap_msfp() */
+
+/**********************************************************************
+ * ms_endmap_msfp:
+ *
+ * A helper routine to switch a mapped MSFP to stdio reading for the
+ * end of the file, where a truncated record could otherwise be parsed
+ * beyond the end of the mapping.  Unprocessed data in the read window
+ * are copied to a new read buffer, the mapping is released and the
+ * file is positioned following the window.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+ms_endmap_msfp (MSFileParam *msfp)
+{
+  char *rawrec;
+  off_t mapoffset;
+
+  if (!msfp || !msfp->mapbase)
+    return 0;
+
+  if (!(rawrec = (char *)malloc (MAXRECLEN)))
+  {
+    ms_log (2, "ms_endmap_msfp(): Cannot allocate memory for read buffer\n");
+    return -1;
+  }
+
+  if (msfp->readlen > 0)
+    memcpy (rawrec, msfp->rawrec, msfp->readlen);
+
+  mapoffset = msfp->mapoffset;
+  ms_unmap_msfp (msfp);
+  msfp->rawrec = rawrec;
+
+  if (lmp_fseeko (msfp->fp, mapoffset, SEEK_SET))
+  {
+    ms_log (2, "Cannot seek in file: %s (%s)\n", msfp->filename, strerror (errno));
+    return -1;
+  }
+
+  return 0;
+} /* End of ms_endmap_msfp() */
+
+/**********************************************************************
+ * ms_compression:
+ *
+ * A helper routine to detect compressed data from the first bytes of
+ * a file, the gzip and zstd frame magic numbers are recognized.
+ *
+ * Returns MSFP_GZIP or MSFP_ZSTD if the data are compressed and 0
+ * otherwise.
+ *********************************************************************/
+static int
+ms_compression (const uint8_t *buf, int length)
+{
+  if (!buf)
+    return 0;
+
+  if (length >= 2 && buf[0] == 0x1f && buf[1] == 0x8b)
+    return MSFP_GZIP;
+
+  if (length >= 4 && buf[0] == 0x28 && buf[1] == 0xb5 && buf[2] == 0x2f && buf[3] == 0xfd)
+    return MSFP_ZSTD;
+
+  return 0;
+} /* End of ms_compression() */
+
+#if defined(MSFP_DECOMP)
+/**********************************************************************
+ * ms_decomp_input:
+ *
+ * A helper routine for the decompression thread to read the next
+ * block of compressed data, starting with the bytes read to detect
+ * the format.  The end of the file is indicated with *eof.
+ *
+ * Returns the number of bytes read or -1 on error.
+ *********************************************************************/
+static int
+ms_decomp_input (MSDecomp *dc, uint8_t *inbuf, int *eof)
+{
+  int inlen = 0;
+
+  if (dc->prefixlen > 0)
+  {
+    memcpy (inbuf, dc->prefix, dc->prefixlen);
+    inlen         = dc->prefixlen;
+    dc->prefixlen = 0;
+  }
+
+  inlen += (int)fread (inbuf + inlen, 1, MSFP_INSIZE - inlen, dc->fp);
+
+  if (inlen < MSFP_INSIZE)
+  {
+    if (ferror (dc->fp))
+    {
+      snprintf (dc->error, sizeof (dc->error), "Cannot read file (%s)", strerror (errno));
+      return -1;
+    }
+
+    *eof = 1;
+  }
+
+  return inlen;
+} /* End of ms_decomp_input() */
+
+/**********************************************************************
+ * ms_decomp_space:
+ *
+ * A helper routine for the decompression thread to wait for free
+ * space in the ring buffer.  The space returned is contiguous, up to
+ * the end of the ring.
+ *
+ * Returns 0 with the space in *out and *outsize, or -1 if the thread
+ * is requested to stop.
+ *********************************************************************/
+static int
+ms_decomp_space (MSDecomp *dc, char **out, size_t *outsize)
+{
+  size_t offset;
+  size_t space;
+
+  pthread_mutex_lock (&dc->lock);
+
+  while (!dc->stop && dc->written - dc->consumed >= MSFP_RINGSIZE)
+    pthread_cond_wait (&dc->writable, &dc->lock);
+
+  if (dc->stop)
+  {
+    pthread_mutex_unlock (&dc->lock);
+    return -1;
+  }
+
+  offset = (size_t)(dc->written % MSFP_RINGSIZE);
+  space  = MSFP_RINGSIZE - (size_t)(dc->written - dc->consumed);
+
+  pthread_mutex_unlock (&dc->lock);
+
+  *out     = dc->ring + offset;
+  *outsize = (space < MSFP_RINGSIZE - offset) ? space : MSFP_RINGSIZE - offset;
+
+  return 0;
+} /* End of ms_decomp_space() */
+
+/**********************************************************************
+ * ms_decomp_commit:
+ *
+ * A helper routine for the decompression thread to add data written
+ * into the space returned by ms_decomp_space() to the ring buffer.
+ *********************************************************************/
+static void
+ms_decomp_commit (MSDecomp *dc, size_t length)
+{
+  if (length == 0)
+    return;
+
+  pthread_mutex_lock (&dc->lock);
+  dc->written += length;
+  pthread_cond_signal (&dc->readable);
+  pthread_mutex_unlock (&dc->lock);
+} /* End of ms_decomp_commit() */
+
+#if defined(LIBMSEED_ZLIB)
+/**********************************************************************
+ * ms_decomp_gzip:
+ *
+ * Decompress gzip data into the ring buffer, concatenated gzip
+ * members are decompressed as a single stream.
+ *
+ * Returns 0 on success and -1 on error or when stopped.
+ *********************************************************************/
+static int
+ms_decomp_gzip (MSDecomp *dc, uint8_t *inbuf)
+{
+  z_stream strm;
+  char *out;
+  size_t outsize;
+  int eof = 0;
+  int inlen;
+  int rv = 0;
+  int zrv;
+
+  memset (&strm, 0, sizeof (strm));
+
+  /* Window bits of 15 + 32 detect a gzip or zlib header */
+  if (inflateInit2 (&strm, 15 + 32) != Z_OK)
+  {
+    snprintf (dc->error, sizeof (dc->error), "Cannot initialize gzip decompression");
+    return -1;
+  }
+
+  for (;;)
+  {
+    if (strm.avail_in == 0 && !eof)
+    {
+      if ((inlen = ms_decomp_input (dc, inbuf, &eof)) < 0)
+      {
+        rv = -1;
+        break;
+      }
+
+      strm.next_in  = inbuf;
+      strm.avail_in = (uInt)inlen;
+    }
+
+    if (ms_decomp_space (dc, &out, &outsize))
+    {
+      rv = -1;
+      break;
+    }
+
+    strm.next_out  = (Bytef *)out;
+    strm.avail_out = (uInt)outsize;
+
+    zrv = inflate (&strm, Z_NO_FLUSH);
+
+    ms_decomp_commit (dc, outsize - strm.avail_out);
+
+    if (zrv == Z_STREAM_END)
+    {
+      /* Continue with the next member, if any */
+      if (strm.avail_in == 0 && !eof)
+      {
+        if ((inlen = ms_decomp_input (dc, inbuf, &eof)) < 0)
+        {
+          rv = -1;
+          break;
+        }
+
+        strm.next_in  = inbuf;
+        strm.avail_in = (uInt)inlen;
+      }
+
+      if (strm.avail_in == 0)
+        break;
+
+      inflateReset (&strm);
+    }
+    else if (zrv == Z_BUF_ERROR && strm.avail_in == 0 && eof)
+    {
+      snprintf (dc->error, sizeof (dc->error), "Truncated gzip data");
+      rv = -1;
+      break;
+    }
+    else if (zrv != Z_OK && zrv != Z_BUF_ERROR)
+    {
+      snprintf (dc->error, sizeof (dc->error), "Cannot decompress gzip data (%s)",
+                (strm.msg) ? strm.msg : "unknown error");
+      rv = -1;
+      break;
+    }
+  }
+
+  inflateEnd (&strm);
+
+  return rv;
+} /* End of ms_decomp_gzip() */
+#endif /* LIBMSEED_ZLIB */
+
+#if defined(LIBMSEED_ZSTD)
+/**********************************************************************
+ * ms_decomp_zstd:
+ *
+ * Decompress zstd data into the ring buffer, concatenated frames are
+ * decompressed as a single stream.
+ *
+ * Returns 0 on success and -1 on error or when stopped.
+ *********************************************************************/
+static int
+ms_decomp_zstd (MSDecomp *dc, uint8_t *inbuf)
+{
+  ZSTD_DStream *zds;
+  ZSTD_inBuffer in  = {NULL, 0, 0};
+  ZSTD_outBuffer zout;
+  char *out;
+  size_t outsize;
+  size_t zrv   = 0;
+  int flushed  = 1;
+  int eof      = 0;
+  int inlen;
+  int rv = 0;
+
+  if (!(zds = ZSTD_createDStream ()) || ZSTD_isError (ZSTD_initDStream (zds)))
+  {
+    snprintf (dc->error, sizeof (dc->error), "Cannot initialize zstd decompression");
+    ZSTD_freeDStream (zds);
+    return -1;
+  }
+
+  for (;;)
+  {
+    if (in.pos == in.size && !eof)
+    {
+      if ((inlen = ms_decomp_input (dc, inbuf, &eof)) < 0)
+      {
+        rv = -1;
+        break;
+      }
+
+      in.src  = inbuf;
+      in.size = (size_t)inlen;
+      in.pos  = 0;
+    }
+
+    /* Finished when all input is consumed and all output flushed */
+    if (in.pos == in.size && eof && flushed)
+    {
+      if (zrv != 0)
+      {
+        snprintf (dc->error, sizeof (dc->error), "Truncated zstd data");
+        rv = -1;
+      }
+
+      break;
+    }
+
+    if (ms_decomp_space (dc, &out, &outsize))
+    {
+      rv = -1;
+      break;
+    }
+
+    zout.dst  = out;
+    zout.size = outsize;
+    zout.pos  = 0;
+
+    zrv = ZSTD_decompressStream (zds, &zout, &in);
+
+    ms_decomp_commit (dc, zout.pos);
+
+    if (ZSTD_isError (zrv))
+    {
+      snprintf (dc->error, sizeof (dc->error), "Cannot decompress zstd data (%s)",
+                ZSTD_getErrorName (zrv));
+      rv = -1;
+      break;
+    }
+
+    flushed = (zout.pos < zout.size);
+  }
+
+  ZSTD_freeDStream (zds);
+
+  return rv;
+} /* End of ms_decomp_zstd() */
+#endif /* LIBMSEED_ZSTD */
+
+/**********************************************************************
+ * ms_decomp_thread:
+ *
+ * The decompression thread, read and decompress a file into the ring
+ * buffer until the end of the data, an error or a request to stop.
+ *********************************************************************/
+static void *
+ms_decomp_thread (void *arg)
+{
+  MSDecomp *dc = (MSDecomp *)arg;
+  uint8_t *inbuf;
+
+  if (!(inbuf = (uint8_t *)malloc (MSFP_INSIZE)))
+  {
+    snprintf (dc->error, sizeof (dc->error), "Cannot allocate memory for decompression");
+  }
+  else
+  {
+#if defined(LIBMSEED_ZLIB)
+    if (dc->format == MSFP_GZIP)
+      ms_decomp_gzip (dc, inbuf);
+#endif
+#if defined(LIBMSEED_ZSTD)
+    if (dc->format == MSFP_ZSTD)
+      ms_decomp_zstd (dc, inbuf);
+#endif
+
+    free (inbuf);
+  }
+
+  pthread_mutex_lock (&dc->lock);
+  dc->done = 1;
+  pthread_cond_signal (&dc->readable);
+  pthread_mutex_unlock (&dc->lock);
+
+  return NULL;
+} /* End of ms_decomp_thread() */
+#endif /* MSFP_DECOMP */
+
+/**********************************************************************
+ * ms_decomp_open:
+ *
+ * A helper routine to start the decompression of a compressed file
+ * by a separate thread.  The prefix bytes have been read from the
+ * file to detect the format and are decompressed first.
+ *
+ * Returns a pointer to a MSDecomp on success and NULL on error,
+ * including when the format is not supported by this build.
+ *********************************************************************/
+static MSDecomp *
+ms_decomp_open (FILE *fp, int format, const uint8_t *prefix,
+                int prefixlen, const char *msfile)
+{
+  const char *name = (format == MSFP_GZIP) ? "gzip" : "zstd";
+  MSDecomp *dc;
+  int supported = 0;
+
+#if defined(LIBMSEED_ZLIB)
+  if (format == MSFP_GZIP)
+    supported = 1;
+#endif
+#if defined(LIBMSEED_ZSTD)
+  if (format == MSFP_ZSTD)
+    supported = 1;
+#endif
+
+  if (!supported)
+  {
+    ms_log (2, "Cannot read %s compressed file, not supported by this build: %s\n",
+            name, msfile);
+    return NULL;
+  }
+
+  if (!(dc = (MSDecomp *)calloc (1, sizeof (MSDecomp))))
+  {
+    ms_log (2, "ms_decomp_open(): Cannot allocate memory\n");
+    return NULL;
+  }
+
+  dc->fp     = fp;
+  dc->format = format;
+
+  if (prefixlen > (int)sizeof (dc->prefix))
+    prefixlen = (int)sizeof (dc->prefix);
+
+  memcpy (dc->prefix, prefix, prefixlen);
+  dc->prefixlen = prefixlen;
+
+#if defined(MSFP_DECOMP)
+  if (!(dc->ring = (char *)malloc (MSFP_RINGSIZE)))
+  {
+    ms_log (2, "ms_decomp_open(): Cannot allocate memory for ring buffer\n");
+    free (dc);
+    return NULL;
+  }
+
+  pthread_mutex_init (&dc->lock, NULL);
+  pthread_cond_init (&dc->readable, NULL);
+  pthread_cond_init (&dc->writable, NULL);
+
+  if (pthread_create (&dc->thread, NULL, ms_decomp_thread, dc))
+  {
+    ms_log (2, "Cannot start %s decompression thread: %s\n", name, msfile);
+    pthread_mutex_destroy (&dc->lock);
+    pthread_cond_destroy (&dc->readable);
+    pthread_cond_destroy (&dc->writable);
+    free (dc->ring);
+    free (dc);
+    return NULL;
+  }
+#endif
+
+  return dc;
+} /* End of ms_decomp_open() */
+
+/**********************************************************************
+ * ms_decomp_close:
+ *
+ * A helper routine to stop the decompression thread, if running, and
+ * free the decompression of a file.  The file is not closed.
+ *********************************************************************/
+static void
+ms_decomp_close (MSDecomp *dc)
+{
+  if (!dc)
+    return;
+
+#if defined(MSFP_DECOMP)
+  pthread_mutex_lock (&dc->lock);
+  dc->stop = 1;
+  pthread_cond_signal (&dc->writable);
+  pthread_mutex_unlock (&dc->lock);
+
+  pthread_join (dc->thread, NULL);
+
+  pthread_mutex_destroy (&dc->lock);
+  pthread_cond_destroy (&dc->readable);
+  pthread_cond_destroy (&dc->writable);
+  free (dc->ring);
+#endif
+
+  free (dc);
+} /* End of ms_decomp_close() */
+
+/**********************************************************************
+ * ms_decomp_read:
+ *
+ * A helper routine to read decompressed data from the ring buffer,
+ * waiting for the decompression thread as needed.  Like fread() the
+ * requested size is returned unless the end of the data is reached,
+ * which sets the MSDecomp.eof flag, or a decompression error follows
+ * the data read, which is then reported by the next call.
+ *
+ * Returns the number of bytes read or -1 on a decompression error.
+ *********************************************************************/
+static int
+ms_decomp_read (MSDecomp *dc, char *buf, int size, const char *msfile)
+{
+  int readcount = 0;
+#if defined(MSFP_DECOMP)
+  size_t offset;
+  size_t length;
+
+  while (readcount < size)
+  {
+    pthread_mutex_lock (&dc->lock);
+
+    while (dc->written == dc->consumed && !dc->done)
+      pthread_cond_wait (&dc->readable, &dc->lock);
+
+    length = (size_t)(dc->written - dc->consumed);
+
+    pthread_mutex_unlock (&dc->lock);
+
+    if (length == 0)
+    {
+      /* The thread is done and all data have been read, data
+         decompressed before an error are returned first */
+      if (dc->error[0] && readcount > 0)
+        break;
+
+      if (dc->error[0])
+      {
+        ms_log (2, "%s: %s\n", msfile, dc->error);
+        return -1;
+      }
+
+      dc->eof = 1;
+      break;
+    }
+
+    /* Copy contiguous data up to the end of the ring */
+    offset = (size_t)(dc->consumed % MSFP_RINGSIZE);
+
+    if (length > MSFP_RINGSIZE - offset)
+      length = MSFP_RINGSIZE - offset;
+    if (length > (size_t)(size - readcount))
+      length = (size_t)(size - readcount);
+
+    memcpy (buf + readcount, dc->ring + offset, length);
+    readcount += (int)length;
+
+    pthread_mutex_lock (&dc->lock);
+    dc->consumed += length;
+    pthread_cond_signal (&dc->writable);
+    pthread_mutex_unlock (&dc->lock);
+  }
+#else
+  /* Never called without decompression support */
+  (void)dc;
+  (void)buf;
+  (void)size;
+  (void)msfile;
+#endif
+
+  return readcount;
+} /* End of ms_decomp_read() */
+
+/**********************************************************************
+ * ms_decomp_seek:
+ *
+ * A helper routine to move the reading position of a decompressed
+ * file to an offset in the decompressed data.  Offsets within the
+ * read buffer are reached by moving the reading offset, later offsets
+ * by discarding decompressed data.  Earlier offsets cannot be reached
+ * without decompressing the file again and are not supported.
+ *
+ * Returns 0 on success and -1 on error.
+ *********************************************************************/
+static int
+ms_decomp_seek (MSFileParam *msfp, off_t offset)
+{
+  char discard[4096];
+  off_t bufferpos;
+  off_t skip;
+  int readsize;
+  int readcount;
+
+  /* Offset of the start of the read buffer */
+  bufferpos = (off_t)msfp->decomp->consumed - msfp->readlen;
+
+  if (offset >= bufferpos && offset <= (off_t)msfp->decomp->consumed)
+  {
+    msfp->readoffset = (int)(offset - bufferpos);
+    msfp->filepos    = offset;
+    return 0;
+  }
+
+  if (offset < bufferpos)
+  {
+    ms_log (2, "Cannot seek backward in compressed file: %s\n", msfp->filename);
+    return -1;
+  }
+
+  for (skip = offset - (off_t)msfp->decomp->consumed; skip > 0; skip -= readcount)
+  {
+    readsize = (skip < (off_t)sizeof (discard)) ? (int)skip : (int)sizeof (discard);
+
+    if ((readcount = ms_decomp_read (msfp->decomp, discard, readsize, msfp->filename)) < 0)
+      return -1;
+
+    if (readcount < readsize && msfp->decomp->eof)
+    {
+      ms_log (2, "Cannot seek beyond end of compressed file: %s\n", msfp->filename);
+      return -1;
+    }
+  }
+
+  msfp->filepos    = offset;
+  msfp->readlen    = 0;
+  msfp->readoffset = 0;
+
+  return 0;
+} /* End of ms_decomp_seek() */
+
 /**********************************************************************
  * ms_readmsr_main:
  *
@@ -206,6 +1045,12 @@ ms_shift_msfp (MSFileParam *msfp, int shift)
  * a section of data in a packed file may be skipped, packed files are
  * internal to the IRIS DMC.
  *
+ * Regular files are memory mapped where supported and records are
+ * parsed directly from the mapping, data are read using stdio from
+ * stdin, pipes and when mapping is not possible.  Either way the
+ * MSRecord.record of a returned record should not be used after the
+ * next call.
+ *
  * After reading all the records in a file the controlling program
  * should call it one last time with msfile set to NULL.  This will
  * close the file and free allocated memory.
@@ -239,27 +1084,11 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
   /* Initialize the file read parameters if needed */
   if (!msfp)
   {
-    msfp = (MSFileParam *)malloc (sizeof (MSFileParam));
-
-    if (msfp == NULL)
-    {
-      ms_log (2, "ms_readmsr_main(): Cannot allocate memory for MSFP\n");
+    if ((msfp = ms_newmsfp ()) == NULL)
       return MS_GENERROR;
-    }
 
     /* Redirect the supplied pointer to the allocated params */
     *ppmsfp = msfp;
-
-    msfp->fp            = NULL;
-    msfp->filename[0]   = '\0';
-    msfp->rawrec        = NULL;
-    msfp->readlen       = 0;
-    msfp->readoffset    = 0;
-    msfp->packtype      = 0;
-    msfp->packhdroffset = 0;
-    msfp->filepos       = 0;
-    msfp->filesize      = 0;
-    msfp->recordcount   = 0;
   }
 
   /* When cleanup is requested */
@@ -267,10 +1096,19 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
   {
     msr_free (ppmsr);
 
+    /* Stop any decompression thread before closing the file it reads */
+    ms_decomp_close (msfp->decomp);
+    msfp->decomp = NULL;
+
     if (msfp->fp != NULL)
       fclose (msfp->fp);
 
-    if (msfp->rawrec != NULL)
+    if (msfp->readbuffer != NULL)
+      free (msfp->readbuffer);
+
+    if (msfp->mapbase != NULL)
+      ms_unmap_msfp (msfp);
+    else if (msfp->rawrec != NULL)
       free (msfp->rawrec);
 
     /* If the file parameters are the global parameters reset them */
@@ -286,6 +1124,13 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
       gMSFileParam.filepos       = 0;
       gMSFileParam.filesize      = 0;
       gMSFileParam.recordcount   = 0;
+      gMSFileParam.mapbase        = NULL;
+      gMSFileParam.maplength      = 0;
+      gMSFileParam.mapoffset      = 0;
+      gMSFileParam.readbuffersize = 0;
+      gMSFileParam.readadvise     = 0;
+      gMSFileParam.readbuffer     = NULL;
+      gMSFileParam.decomp         = NULL;
     }
     /* Otherwise free the MSFileParam */
     else
@@ -297,25 +1142,26 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
     return MS_NOERROR;
   }
 
-  /* Allocate reading buffer */
-  if (msfp->rawrec == NULL)
-  {
-    if (!(msfp->rawrec = (char *)malloc (MAXRECLEN)))
-    {
-      ms_log (2, "ms_readmsr_main(): Cannot allocate memory for read buffer\n");
-      return MS_GENERROR;
-    }
-  }
-
   /* Sanity check: track if we are reading the same file */
   if (msfp->fp && strncmp (msfile, msfp->filename, sizeof (msfp->filename)))
   {
     ms_log (2, "ms_readmsr_main() called with a different file name without being reset\n");
 
     /* Close previous file and reset needed variables */
+    ms_decomp_close (msfp->decomp);
+    msfp->decomp = NULL;
+
     if (msfp->fp != NULL)
       fclose (msfp->fp);
 
+    if (msfp->readbuffer != NULL)
+    {
+      free (msfp->readbuffer);
+      msfp->readbuffer = NULL;
+    }
+
+    ms_unmap_msfp (msfp);
+
     msfp->fp            = NULL;
     msfp->readlen       = 0;
     msfp->readoffset    = 0;
@@ -360,15 +1206,114 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
         }
 
         msfp->filesize = sbuf.st_size;
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+        /* Advise sequential reading of regular files if requested */
+        if (msfp->readadvise && S_ISREG (sbuf.st_mode))
+          posix_fadvise (fileno (msfp->fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        /* Map regular files unless a read buffer is requested, otherwise use stdio */
+        if (msfp->readbuffersize <= 0 && S_ISREG (sbuf.st_mode) &&
+            ms_map_msfp (msfp, msfp->filesize) == 0)
+        {
+          /* Compressed files are not parsed from the mapping but decompressed from stdio */
+          if (ms_compression ((uint8_t *)msfp->mapbase, (msfp->maplength < 4) ? (int)msfp->maplength : 4))
+            ms_unmap_msfp (msfp);
+          else if (verbose > 1)
+            ms_log (1, "Reading %s using a memory mapping\n", msfile);
+        }
+      }
+    }
+
+    /* Set a read-ahead buffer for stdio reading if requested */
+    if (msfp->readbuffersize > 0 && !msfp->mapbase)
+    {
+      if (!(msfp->readbuffer = (char *)malloc (msfp->readbuffersize)))
+      {
+        ms_log (2, "ms_readmsr_main(): Cannot allocate memory for read-ahead buffer\n");
+        return MS_GENERROR;
+      }
+
+      if (setvbuf (msfp->fp, msfp->readbuffer, _IOFBF, msfp->readbuffersize))
+      {
+        ms_log (2, "Cannot set read buffer for file: %s\n", msfile);
+        return MS_GENERROR;
+      }
+
+      if (verbose > 1)
+        ms_log (1, "Reading %s with a %d byte read-ahead buffer\n", msfile, msfp->readbuffersize);
+    }
+
+    /* Detect compressed data at the start of files read with stdio, the
+     * bytes read are passed to the decompression or kept for parsing */
+    if (!msfp->mapbase)
+    {
+      uint8_t prefix[4];
+      int prefixlen;
+      int format;
+
+      prefixlen = (int)fread (prefix, 1, sizeof (prefix), msfp->fp);
+
+      if (prefixlen < (int)sizeof (prefix) && ferror (msfp->fp))
+      {
+        ms_log (2, "Cannot read file: %s (%s)\n", msfile, strerror (errno));
+        return MS_GENERROR;
+      }
+
+      if ((format = ms_compression (prefix, prefixlen)))
+      {
+        if (!(msfp->decomp = ms_decomp_open (msfp->fp, format, prefix, prefixlen, msfile)))
+          return MS_GENERROR;
+
+        /* Size of the decompressed data is known at the end of the data */
+        msfp->filesize = 0;
+
+        if (verbose > 1)
+          ms_log (1, "Reading %s with %s decompression in a separate thread\n", msfile,
+                  (format == MSFP_GZIP) ? "gzip" : "zstd");
+      }
+      else if (prefixlen > 0)
+      {
+        if (!msfp->rawrec && !(msfp->rawrec = (char *)malloc (MAXRECLEN)))
+        {
+          ms_log (2, "ms_readmsr_main(): Cannot allocate memory for read buffer\n");
+          return MS_GENERROR;
+        }
+
+        memcpy (msfp->rawrec, prefix, prefixlen);
+        msfp->readlen = prefixlen;
       }
     }
   }
 
+  /* Allocate reading buffer */
+  if (msfp->rawrec == NULL)
+  {
+    if (!(msfp->rawrec = (char *)malloc (MAXRECLEN)))
+    {
+      ms_log (2, "ms_readmsr_main(): Cannot allocate memory for read buffer\n");
+      return MS_GENERROR;
+    }
+  }
+
   /* Seek to a specified offset if requested */
   if (fpos != NULL && *fpos < 0)
   {
     /* Only try to seek in real files, not stdin */
-    if (msfp->fp != stdin)
+    if (msfp->mapbase)
+    {
+      msfp->mapoffset  = *fpos * -1;
+      msfp->filepos    = *fpos * -1;
+      msfp->readlen    = 0;
+      msfp->readoffset = 0;
+    }
+    else if (msfp->decomp)
+    {
+      if (ms_decomp_seek (msfp, *fpos * -1))
+        return MS_GENERROR;
+    }
+    else if (msfp->fp != stdin)
     {
       if (lmp_fseeko (msfp->fp, *fpos * -1, SEEK_SET))
       {
@@ -392,13 +1337,16 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
   {
     /* Read more data into buffer if not at EOF and buffer has less than MINRECLEN
        * or more data is needed for the current record detected in buffer. */
-    if (!feof (msfp->fp) && (MSFPBUFLEN (msfp) < MINRECLEN || parseval > 0))
+    if (!MSFPEOF (msfp) && (MSFPBUFLEN (msfp) < MINRECLEN || parseval > 0))
     {
       /* Reset offsets if no unprocessed data in buffer */
       if (MSFPBUFLEN (msfp) <= 0)
       {
         msfp->readlen    = 0;
         msfp->readoffset = 0;
+
+        if (msfp->mapbase)
+          msfp->rawrec = msfp->mapbase + msfp->mapoffset;
       }
       /* Otherwise shift existing data to beginning of buffer */
       else if (msfp->readoffset > 0)
@@ -409,26 +1357,65 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
       /* Determine read size */
       readsize = (MAXRECLEN - msfp->readlen);
 
-      /* Read data into record buffer */
-      readcount = ms_fread (msfp->rawrec + msfp->readlen, 1, readsize, msfp->fp);
+      /* Extend the window of a mapped file, data are not copied */
+      if (msfp->mapbase && (msfp->maplength - msfp->mapoffset) > readsize)
+      {
+        msfp->mapoffset += readsize;
+        msfp->readlen += readsize;
 
-      if (readcount != readsize)
+        /* File position corresponding to start of buffer */
+        msfp->filepos = msfp->mapoffset - msfp->readlen;
+      }
+      /* Continue with stdio for the end of a mapped file */
+      else if (msfp->mapbase && ms_endmap_msfp (msfp))
+      {
+        retcode = MS_GENERROR;
+        break;
+      }
+      else
       {
-        if (!feof (msfp->fp))
+        /* Read data into record buffer */
+        if (msfp->decomp)
+          readcount = ms_decomp_read (msfp->decomp, msfp->rawrec + msfp->readlen, readsize, msfile);
+        else
+          readcount = ms_fread (msfp->rawrec + msfp->readlen, 1, readsize, msfp->fp);
+
+        if (readcount < 0)
         {
-          ms_log (2, "Short read of %d bytes starting from %" PRId64 "\n",
-                  readsize, msfp->filepos);
           retcode = MS_GENERROR;
           break;
         }
-      }
 
-      /* Update read buffer length */
-      msfp->readlen += readcount;
+        /* Short reads of decompressed data before an error are not
+           an error, the error is reported by the next read */
+        if (readcount != readsize && !msfp->decomp)
+        {
+          if (!MSFPEOF (msfp))
+          {
+            ms_log (2, "Short read of %d bytes starting from %" PRId64 "\n",
+                    readsize, msfp->filepos);
+            retcode = MS_GENERROR;
+            break;
+          }
+        }
+
+        /* Update read buffer length */
+        msfp->readlen += readcount;
+
+        /* File position corresponding to start of buffer; not strictly necessary */
+        if (msfp->decomp)
+        {
+          msfp->filepos = (off_t)msfp->decomp->consumed - msfp->readlen;
 
-      /* File position corresponding to start of buffer; not strictly necessary */
-      if (msfp->fp != stdin)
-        msfp->filepos = lmp_ftello (msfp->fp) - msfp->readlen;
+          /* The size of decompressed data is known at the end */
+          if (msfp->decomp->eof)
+            msfp->filesize = (off_t)msfp->decomp->consumed;
+        }
+        else if (msfp->fp != stdin)
+        {
+          msfp->filepos = lmp_ftello (msfp->fp) - msfp->readlen;
+        }
+      }
     }
 
     /* Test for packed file signature at the beginning of the file */
@@ -518,18 +1505,32 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
                     srcname, (msfp->packhdroffset - msfp->filepos), msfp->filepos);
           }
 
-          if (lmp_fseeko (msfp->fp, msfp->packhdroffset, SEEK_SET))
+          /* The decompressed seek sets the reading position itself,
+           * keeping any decompressed data after the offset */
+          if (msfp->decomp)
+          {
+            if (ms_decomp_seek (msfp, msfp->packhdroffset))
+              return MS_GENERROR;
+          }
+          else
           {
-            ms_log (2, "Cannot seek in file: %s (%s)\n", msfile, strerror (errno));
+            if (msfp->mapbase)
+            {
+              msfp->mapoffset = msfp->packhdroffset;
+            }
+            else if (lmp_fseeko (msfp->fp, msfp->packhdroffset, SEEK_SET))
+            {
+              ms_log (2, "Cannot seek in file: %s (%s)\n", msfile, strerror (errno));
 
-            return MS_GENERROR;
-            break;
+              return MS_GENERROR;
+            }
+
+            msfp->filepos    = msfp->packhdroffset;
+            msfp->readlen    = 0;
+            msfp->readoffset = 0;
           }
 
-          msfp->filepos    = msfp->packhdroffset;
-          msfp->readlen    = 0;
-          msfp->readoffset = 0;
-          packdatasize     = 0;
+          packdatasize = 0;
         }
 
         /* Return to top of loop for proper pack header handling */
@@ -648,7 +1649,7 @@ ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile,
         }
 
         /* End of file check */
-        else if (impreclen <= 0 && feof (msfp->fp))
+        else if (impreclen <= 0 && MSFPEOF (msfp))
         {
           impreclen = msfp->filesize - msfp->filepos;
 
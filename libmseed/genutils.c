@@ -316,6 +316,30 @@ ms_strncpopen (char *dest, const char *source, int length)
   return dcnt;
 } /* End of ms_strncpopen() */
 
+/***************************************************************************
+ * ms_fnv1a:
+ *
+ * Calculate a 32-bit FNV-1a hash of 'length' bytes of 'data', e.g. a
+ * source name or a fixed length key containing NULL characters.
+ *
+ * Returns the hash value.
+ ***************************************************************************/
+uint32_t
+ms_fnv1a (const void *data, size_t length)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint32_t hash = 2166136261u;
+  size_t idx;
+
+  for (idx = 0; idx < length; idx++)
+  {
+    hash ^= bytes[idx];
+    hash *= 16777619u;
+  }
+
+  return hash;
+} /* End of ms_fnv1a() */
+
 /***************************************************************************
  * ms_doy2md:
  *
@@ -516,6 +516,7 @@ typedef struct MSTrace_s {
   void           *prvtptr;           /* Private pointer for general use, unused by libmseed */
   StreamState    *ststate;           /* Stream processing state information */
   struct MSTrace_s *next;            /* Pointer to next trace */
+  size_t          datasize;          /* Allocated size of datasamples in bytes, 0 if unknown */
 }
 MSTrace;
 
@@ -582,6 +583,9 @@ typedef struct Selections_s {
   struct Selections_s *next;
 } Selections;
 
+/* Compiled selection index, opaque, see ms_compileselections() */
+typedef struct SelectIndex_s SelectIndex;
+
 
 /* Global variables (defined in pack.c) and macros to set/force
  * pack byte orders */
@@ -622,6 +626,11 @@ extern int           msr_pack_header (MSRecord *msr, flag normalize, flag verbos
 
 extern int           msr_unpack_data (MSRecord *msr, int swapflag, flag verbose);
 
+extern int           msr_unpack_samples (MSRecord *msr, flag verbose);
+
+extern int           msr_unpack_samples_into (MSRecord *msr, void *output,
+                                              size_t outputsize, flag verbose);
+
 extern MSRecord*     msr_init (MSRecord *msr);
 extern void          msr_free (MSRecord **ppmsr);
 extern void          msr_free_blktchain (MSRecord *msr);
@@ -657,6 +666,7 @@ extern int           mst_addmsr (MSTrace *mst, MSRecord *msr, flag whence);
 extern int           mst_addspan (MSTrace *mst, hptime_t starttime,  hptime_t endtime,
 				  void *datasamples, int64_t numsamples,
 				  char sampletype, flag whence);
+extern int           mst_growdata (MSTrace *mst, size_t datasize);
 extern MSTrace*      mst_addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, flag dataquality,
 					double timetol, double sampratetol);
 extern MSTrace*      mst_addtracetogroup (MSTraceGroup *mstg, MSTrace *mst);
@@ -703,6 +713,13 @@ typedef struct MSFileParam_s
   off_t filepos;
   off_t filesize;
   int   recordcount;
+  char *mapbase;     /* Memory mapping of file, if mapped */
+  off_t maplength;   /* Length of memory mapping */
+  off_t mapoffset;   /* Offset of data following read buffer in mapping */
+  int   readbuffersize; /* Read-ahead buffer size, see ms_readmsr_setbuffer() */
+  flag  readadvise;  /* Advise sequential reading */
+  char *readbuffer;  /* Read-ahead buffer for stdio */
+  struct MSDecomp_s *decomp; /* Decompression of compressed files, private */
 } MSFileParam;
 
 extern int      ms_readmsr (MSRecord **ppmsr, const char *msfile, int reclen, off_t *fpos, int *last,
@@ -711,6 +728,7 @@ extern int      ms_readmsr_r (MSFileParam **ppmsfp, MSRecord **ppmsr, const char
 			      off_t *fpos, int *last, flag skipnotdata, flag dataflag, flag verbose);
 extern int      ms_readmsr_main (MSFileParam **ppmsfp, MSRecord **ppmsr, const char *msfile, int reclen,
 				 off_t *fpos, int *last, flag skipnotdata, flag dataflag, Selections *selections, flag verbose);
+extern int      ms_readmsr_setbuffer (MSFileParam **ppmsfp, int buffersize, flag advise);
 extern int      ms_readtraces (MSTraceGroup **ppmstg, const char *msfile, int reclen, double timetol, double sampratetol,
 			       flag dataquality, flag skipnotdata, flag dataflag, flag verbose);
 extern int      ms_readtraces_timewin (MSTraceGroup **ppmstg, const char *msfile, int reclen, double timetol, double sampratetol,
@@ -737,6 +755,7 @@ extern int      ms_splitsrcname (char *srcname, char *net, char *sta, char *loc,
 extern int      ms_strncpclean (char *dest, const char *source, int length);
 extern int      ms_strncpcleantail (char *dest, const char *source, int length);
 extern int      ms_strncpopen (char *dest, const char *source, int length);
+extern uint32_t ms_fnv1a (const void *data, size_t length);
 extern int      ms_doy2md (int year, int jday, int *month, int *mday);
 extern int      ms_md2doy (int year, int month, int mday, int *jday);
 extern hptime_t ms_btime2hptime (BTime *btime);
@@ -797,6 +816,10 @@ extern int      ms_addselect_comp (Selections **ppselections, char *net, char* s
 extern int      ms_readselectionsfile (Selections **ppselections, char *filename);
 extern void     ms_freeselections (Selections *selections);
 extern void     ms_printselections (Selections *selections);
+extern SelectIndex *ms_compileselections (Selections *selections);
+extern Selections *ms_matchselect_index (SelectIndex *index, char *srcname,
+					 hptime_t starttime, hptime_t endtime, SelectTime **ppselecttime);
+extern void     ms_freeselectindex (SelectIndex *index);
 
 /* Leap second declarations, implementation in gentutils.c */
 typedef struct LeapSecond_s
@@ -6,7 +6,7 @@
  * Written by Chad Trabant unless otherwise noted
  *   IRIS Data Management Center
  *
- * modified: 2014.197
+ * modified: 2026.287
  ***************************************************************************/
 
 #include <errno.h>
@@ -506,6 +506,598 @@ ms_freeselections (Selections *selections)
 
 } /* End of ms_freeselections() */
 
+
+/* Glob pattern characters recognized by ms_globmatch() */
+#define SELECT_GLOBCHARS "*?[\\"
+
+/* Time window lists longer than this are searched using a sorted index */
+#define SELECT_LINEARWINDOWS 8
+
+/* Compiled details for each selection */
+typedef struct SelectEntry_s
+{
+  Selections *selection;
+  int wcount;             /* Number of time windows */
+  SelectTime **windows;   /* Time windows sorted by start time, if indexed */
+  int *order;             /* Position of each sorted window in original list */
+  hptime_t *maxend;       /* Latest end time of sorted windows up to each index */
+} SelectEntry;
+
+/* Hash table node, a key and a list of selection positions */
+typedef struct SelectNode_s
+{
+  char *key;
+  int *entries;
+  int count;
+  struct SelectNode_s *next;
+} SelectNode;
+
+typedef struct SelectHash_s
+{
+  SelectNode **buckets;
+  int bucketcount;
+  int count;
+} SelectHash;
+
+/* Trie node for literal prefixes of globbing patterns */
+typedef struct SelectTrie_s
+{
+  char c;
+  int *entries;           /* Patterns with a literal prefix ending at this node */
+  int count;
+  struct SelectTrie_s *child;
+  struct SelectTrie_s *sibling;
+} SelectTrie;
+
+/* Compiled selection index */
+struct SelectIndex_s
+{
+  SelectEntry *entries;   /* In selection list order */
+  int count;
+  SelectHash exact;       /* Patterns without globbing characters */
+  SelectTrie root;        /* Patterns with globbing characters */
+  SelectHash cache;       /* Candidate selections for each source name */
+};
+
+/***************************************************************************
+ * select_hashfind:
+ *
+ * Find the node for a key in a hash table, optionally adding it if
+ * not found.
+ *
+ * Return pointer to node on success and NULL when not found or error.
+ ***************************************************************************/
+static SelectNode *
+select_hashfind (SelectHash *hash, const char *key, int add)
+{
+  SelectNode **buckets;
+  SelectNode *node;
+  SelectNode *next;
+  uint32_t bucket;
+  int idx;
+
+  if (hash->buckets)
+  {
+    for (node = hash->buckets[ms_fnv1a (key, strlen (key)) % hash->bucketcount]; node; node = node->next)
+      if (!strcmp (node->key, key))
+        return node;
+  }
+
+  if (!add)
+    return NULL;
+
+  /* Grow table, re-hashing existing nodes */
+  if (hash->count >= hash->bucketcount)
+  {
+    int bucketcount = (hash->bucketcount) ? hash->bucketcount * 2 : 64;
+
+    if (!(buckets = (SelectNode **)calloc (bucketcount, sizeof (SelectNode *))))
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return NULL;
+    }
+
+    for (idx = 0; idx < hash->bucketcount; idx++)
+    {
+      for (node = hash->buckets[idx]; node; node = next)
+      {
+        next            = node->next;
+        bucket          = ms_fnv1a (node->key, strlen (node->key)) % bucketcount;
+        node->next      = buckets[bucket];
+        buckets[bucket] = node;
+      }
+    }
+
+    free (hash->buckets);
+    hash->buckets     = buckets;
+    hash->bucketcount = bucketcount;
+  }
+
+  if (!(node = (SelectNode *)calloc (1, sizeof (SelectNode))) ||
+      !(node->key = strdup (key)))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    free (node);
+    return NULL;
+  }
+
+  bucket                     = ms_fnv1a (key, strlen (key)) % hash->bucketcount;
+  node->next                 = hash->buckets[bucket];
+  hash->buckets[bucket]      = node;
+  hash->count++;
+
+  return node;
+} /* End of select_hashfind() */
+
+static void
+select_hashfree (SelectHash *hash)
+{
+  SelectNode *node;
+  SelectNode *next;
+  int idx;
+
+  for (idx = 0; idx < hash->bucketcount; idx++)
+  {
+    for (node = hash->buckets[idx]; node; node = next)
+    {
+      next = node->next;
+      free (node->key);
+      free (node->entries);
+      free (node);
+    }
+  }
+
+  free (hash->buckets);
+}
+
+static void
+select_triefree (SelectTrie *trie)
+{
+  SelectTrie *child;
+  SelectTrie *next;
+
+  for (child = trie->child; child; child = next)
+  {
+    next = child->sibling;
+    select_triefree (child);
+    free (child);
+  }
+
+  free (trie->entries);
+}
+
+/* Append a selection position to a list */
+static int
+select_addentry (int **entries, int *count, int position)
+{
+  int *newentries;
+
+  if (!(newentries = (int *)realloc (*entries, (*count + 1) * sizeof (int))))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return -1;
+  }
+
+  newentries[*count] = position;
+  *entries           = newentries;
+  (*count)++;
+
+  return 0;
+}
+
+static int
+select_compareint (const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/* Time window sort key, an unset start time sorts first */
+typedef struct SelectSort_s
+{
+  hptime_t starttime;
+  int order;
+  SelectTime *window;
+} SelectSort;
+
+static int
+select_comparewindow (const void *a, const void *b)
+{
+  const SelectSort *sorta = (const SelectSort *)a;
+  const SelectSort *sortb = (const SelectSort *)b;
+
+  if (sorta->starttime != sortb->starttime)
+  {
+    if (sorta->starttime == HPTERROR)
+      return -1;
+    if (sortb->starttime == HPTERROR)
+      return 1;
+
+    return (sorta->starttime < sortb->starttime) ? -1 : 1;
+  }
+
+  return sorta->order - sortb->order;
+}
+
+/***************************************************************************
+ * select_indexwindows:
+ *
+ * Build the sorted time window index for a selection entry.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+select_indexwindows (SelectEntry *entry)
+{
+  SelectSort *sort;
+  SelectTime *selecttime;
+  int idx;
+
+  if (!(sort = (SelectSort *)malloc (entry->wcount * sizeof (SelectSort))) ||
+      !(entry->windows = (SelectTime **)malloc (entry->wcount * sizeof (SelectTime *))) ||
+      !(entry->order = (int *)malloc (entry->wcount * sizeof (int))) ||
+      !(entry->maxend = (hptime_t *)malloc (entry->wcount * sizeof (hptime_t))))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    free (sort);
+    return -1;
+  }
+
+  for (idx = 0, selecttime = entry->selection->timewindows; selecttime;
+       idx++, selecttime = selecttime->next)
+  {
+    sort[idx].starttime = selecttime->starttime;
+    sort[idx].order     = idx;
+    sort[idx].window    = selecttime;
+  }
+
+  qsort (sort, entry->wcount, sizeof (SelectSort), select_comparewindow);
+
+  /* Track the latest end time up to each window, an unset end time
+   * (HPTERROR) matches any later time */
+  for (idx = 0; idx < entry->wcount; idx++)
+  {
+    entry->windows[idx] = sort[idx].window;
+    entry->order[idx]   = sort[idx].order;
+
+    if (sort[idx].window->endtime == HPTERROR ||
+        (idx > 0 && entry->maxend[idx - 1] == HPTERROR))
+      entry->maxend[idx] = HPTERROR;
+    else if (idx > 0 && entry->maxend[idx - 1] > sort[idx].window->endtime)
+      entry->maxend[idx] = entry->maxend[idx - 1];
+    else
+      entry->maxend[idx] = sort[idx].window->endtime;
+  }
+
+  free (sort);
+
+  return 0;
+} /* End of select_indexwindows() */
+
+/***************************************************************************
+ * select_windowmatch:
+ *
+ * Test a time window against the start and end times of data, with
+ * the same criteria as ms_matchselect().
+ *
+ * Return non-zero if the window matches and 0 otherwise.
+ ***************************************************************************/
+static int
+select_windowmatch (SelectTime *selecttime, hptime_t starttime, hptime_t endtime)
+{
+  if (starttime != HPTERROR && selecttime->starttime != HPTERROR &&
+      (starttime < selecttime->starttime && !(starttime <= selecttime->starttime && endtime >= selecttime->starttime)))
+    return 0;
+
+  if (endtime != HPTERROR && selecttime->endtime != HPTERROR &&
+      (endtime > selecttime->endtime && !(starttime <= selecttime->endtime && endtime >= selecttime->endtime)))
+    return 0;
+
+  return 1;
+}
+
+/***************************************************************************
+ * select_entrymatch:
+ *
+ * Find the first time window, in list order, of a selection entry
+ * that matches the start and end times of data.
+ *
+ * With start and end times set a window matches if it begins no later
+ * than the later of the two and ends no earlier than the earlier of
+ * the two.  Windows beginning too late are excluded by binary search
+ * of the sorted windows, the remainder are searched back to the point
+ * where no earlier window ends late enough.
+ *
+ * Return pointer to matching SelectTime or NULL for no match.
+ ***************************************************************************/
+static SelectTime *
+select_entrymatch (SelectEntry *entry, hptime_t starttime, hptime_t endtime)
+{
+  SelectTime *selecttime;
+  SelectTime *match = NULL;
+  hptime_t earliest;
+  hptime_t latest;
+  int low;
+  int high;
+  int mid;
+  int idx;
+  int order = 0;
+
+  if (!entry->windows || starttime == HPTERROR || endtime == HPTERROR)
+  {
+    for (selecttime = entry->selection->timewindows; selecttime; selecttime = selecttime->next)
+      if (select_windowmatch (selecttime, starttime, endtime))
+        return selecttime;
+
+    return NULL;
+  }
+
+  earliest = (starttime < endtime) ? starttime : endtime;
+  latest   = (starttime < endtime) ? endtime : starttime;
+
+  /* Find the first window beginning after the latest time */
+  low  = 0;
+  high = entry->wcount;
+  while (low < high)
+  {
+    mid = (low + high) / 2;
+
+    if (entry->windows[mid]->starttime == HPTERROR || entry->windows[mid]->starttime <= latest)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  for (idx = low - 1; idx >= 0; idx--)
+  {
+    if (entry->maxend[idx] != HPTERROR && entry->maxend[idx] < earliest)
+      break;
+
+    if ((entry->windows[idx]->endtime == HPTERROR || entry->windows[idx]->endtime >= earliest) &&
+        (!match || entry->order[idx] < order))
+    {
+      match = entry->windows[idx];
+      order = entry->order[idx];
+    }
+  }
+
+  return match;
+} /* End of select_entrymatch() */
+
+/***************************************************************************
+ * select_candidates:
+ *
+ * Determine the selections with source name patterns matching a
+ * source name, in selection list order, and add them to the cache.
+ *
+ * Return pointer to cache node on success and NULL on error.
+ ***************************************************************************/
+static SelectNode *
+select_candidates (SelectIndex *index, char *srcname)
+{
+  SelectNode *exact;
+  SelectNode *cached;
+  SelectTrie *trie;
+  char *cp;
+  int idx;
+
+  if (!(cached = select_hashfind (&index->cache, srcname, 1)))
+    return NULL;
+
+  /* Selections matching exactly */
+  if ((exact = select_hashfind (&index->exact, srcname, 0)))
+  {
+    for (idx = 0; idx < exact->count; idx++)
+      if (select_addentry (&cached->entries, &cached->count, exact->entries[idx]))
+        return NULL;
+  }
+
+  /* Globbing patterns with a literal prefix matching the source name */
+  trie = &index->root;
+  cp   = srcname;
+  while (trie)
+  {
+    for (idx = 0; idx < trie->count; idx++)
+      if (ms_globmatch (srcname, index->entries[trie->entries[idx]].selection->srcname) &&
+          select_addentry (&cached->entries, &cached->count, trie->entries[idx]))
+        return NULL;
+
+    if (!*cp)
+      break;
+
+    for (trie = trie->child; trie && trie->c != *cp; trie = trie->sibling)
+      ;
+
+    cp++;
+  }
+
+  if (cached->count > 1)
+    qsort (cached->entries, cached->count, sizeof (int), select_compareint);
+
+  return cached;
+} /* End of select_candidates() */
+
+/***************************************************************************
+ * ms_compileselections:
+ *
+ * Compile a selection list into an index for faster matching with
+ * ms_matchselect_index().  Source name patterns without globbing
+ * characters are stored in a hash table, patterns with globbing
+ * characters are stored in a trie by their literal prefix.  Long
+ * lists of time windows are sorted for searching.
+ *
+ * The patterns that match each source name tested are cached, a
+ * later test of the same source name only requires the time windows
+ * to be checked.  An index is therefore not safe to use concurrently
+ * from multiple threads, each thread should compile its own.
+ *
+ * The selection list must not be modified or freed while the index
+ * is in use.
+ *
+ * Return pointer to a SelectIndex on success and NULL on error.
+ ***************************************************************************/
+SelectIndex *
+ms_compileselections (Selections *selections)
+{
+  SelectIndex *index;
+  SelectEntry *entry;
+  SelectNode *node;
+  SelectTrie *trie;
+  SelectTrie *child;
+  Selections *select;
+  SelectTime *selecttime;
+  char *cp;
+  size_t prefixlen;
+  size_t idx;
+
+  if (!(index = (SelectIndex *)calloc (1, sizeof (SelectIndex))))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return NULL;
+  }
+
+  for (select = selections; select; select = select->next)
+    index->count++;
+
+  if (index->count > 0 &&
+      !(index->entries = (SelectEntry *)calloc (index->count, sizeof (SelectEntry))))
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    free (index);
+    return NULL;
+  }
+
+  for (entry = index->entries, select = selections; select; entry++, select = select->next)
+  {
+    entry->selection = select;
+
+    for (selecttime = select->timewindows; selecttime; selecttime = selecttime->next)
+      entry->wcount++;
+
+    if (entry->wcount > SELECT_LINEARWINDOWS && select_indexwindows (entry))
+    {
+      ms_freeselectindex (index);
+      return NULL;
+    }
+
+    /* Exact source names */
+    if (!strpbrk (select->srcname, SELECT_GLOBCHARS))
+    {
+      if (!(node = select_hashfind (&index->exact, select->srcname, 1)) ||
+          select_addentry (&node->entries, &node->count, (int)(entry - index->entries)))
+      {
+        ms_freeselectindex (index);
+        return NULL;
+      }
+
+      continue;
+    }
+
+    /* Globbing patterns, add to trie node for the literal prefix */
+    prefixlen = strcspn (select->srcname, SELECT_GLOBCHARS);
+    trie      = &index->root;
+
+    for (idx = 0, cp = select->srcname; idx < prefixlen; idx++, cp++)
+    {
+      for (child = trie->child; child && child->c != *cp; child = child->sibling)
+        ;
+
+      if (!child)
+      {
+        if (!(child = (SelectTrie *)calloc (1, sizeof (SelectTrie))))
+        {
+          ms_log (2, "Cannot allocate memory\n");
+          ms_freeselectindex (index);
+          return NULL;
+        }
+
+        child->c       = *cp;
+        child->sibling = trie->child;
+        trie->child    = child;
+      }
+
+      trie = child;
+    }
+
+    if (select_addentry (&trie->entries, &trie->count, (int)(entry - index->entries)))
+    {
+      ms_freeselectindex (index);
+      return NULL;
+    }
+  }
+
+  return index;
+} /* End of ms_compileselections() */
+
+/***************************************************************************
+ * ms_matchselect_index:
+ *
+ * Test the specified parameters for a matching selection entry using
+ * a compiled selection index.  The result is the same as
+ * ms_matchselect() with the selection list used to compile the
+ * index: the first selection, in list order, matching the source name
+ * and with a matching time window.  The NULL value (matching any
+ * times) for the start and end times is HPTERROR.
+ *
+ * Return Selections pointer to matching entry on successful match and
+ * NULL for no match or error.
+ ***************************************************************************/
+Selections *
+ms_matchselect_index (SelectIndex *index, char *srcname, hptime_t starttime,
+                      hptime_t endtime, SelectTime **ppselecttime)
+{
+  SelectNode *cached = NULL;
+  SelectTime *matchst = NULL;
+  SelectEntry *entry = NULL;
+  int idx;
+
+  if (index && srcname)
+  {
+    if (!(cached = select_hashfind (&index->cache, srcname, 0)))
+      cached = select_candidates (index, srcname);
+
+    for (idx = 0; cached && idx < cached->count; idx++)
+    {
+      entry = &index->entries[cached->entries[idx]];
+
+      if ((matchst = select_entrymatch (entry, starttime, endtime)))
+        break;
+    }
+  }
+
+  if (ppselecttime)
+    *ppselecttime = matchst;
+
+  return (matchst) ? entry->selection : NULL;
+} /* End of ms_matchselect_index() */
+
+/***************************************************************************
+ * ms_freeselectindex:
+ *
+ * Free all memory associated with a SelectIndex, the selection list
+ * used to compile the index is not freed.
+ ***************************************************************************/
+void
+ms_freeselectindex (SelectIndex *index)
+{
+  int idx;
+
+  if (!index)
+    return;
+
+  for (idx = 0; idx < index->count; idx++)
+  {
+    free (index->entries[idx].windows);
+    free (index->entries[idx].order);
+    free (index->entries[idx].maxend);
+  }
+
+  free (index->entries);
+  select_hashfree (&index->exact);
+  select_hashfree (&index->cache);
+  select_triefree (&index->root);
+  free (index);
+} /* End of ms_freeselectindex() */
+
 /***************************************************************************
  * ms_printselections:
  *
@@ -703,6 +1295,7 @@ ms_globmatch (char *string, char *pattern)
     case '\\':
       if (*pattern)
         c = *pattern++;
+      /* fallthrough */
     default:
       if (c != *string)
         return GLOBMATCH_FALSE;
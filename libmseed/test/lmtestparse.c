@@ -26,6 +26,7 @@ static flag tracegap   = 0;
 static int printraw    = 0;
 static int printdata   = 0;
 static int reclen      = -1;
+static int readbuffer  = 0;
 static char *inputfile = 0;
 
 static double timetol     = -1.0; /* Time tolerance for continuous traces */
@@ -44,6 +45,7 @@ int
 main (int argc, char **argv)
 {
   MSTraceList *mstl = 0;
+  MSFileParam *msfp = 0;
   MSRecord *msr     = 0;
 
   int64_t totalrecs  = 0;
@@ -60,9 +62,13 @@ main (int argc, char **argv)
   if (tracegap)
     mstl = mstl_init (NULL);
 
+  /* Read through stdio with a read-ahead buffer instead of a mapping */
+  if (readbuffer > 0 && ms_readmsr_setbuffer (&msfp, readbuffer, 0))
+    return -1;
+
   /* Loop over the input file */
-  while ((retcode = ms_readmsr (&msr, inputfile, reclen, NULL, NULL, 1,
-                                printdata, verbose)) == MS_NOERROR)
+  while ((retcode = ms_readmsr_r (&msfp, &msr, inputfile, reclen, NULL, NULL, 1,
+                                  printdata, verbose)) == MS_NOERROR)
   {
     totalrecs++;
     totalsamps += msr->samplecnt;
@@ -151,7 +157,7 @@ main (int argc, char **argv)
     mstl_printtracelist (mstl, 0, 1, 1);
 
   /* Make sure everything is cleaned up */
-  ms_readmsr (&msr, NULL, 0, NULL, NULL, 0, 0, 0);
+  ms_readmsr_r (&msfp, &msr, NULL, 0, NULL, NULL, 0, 0, 0);
 
   if (mstl)
     mstl_free (&mstl, 0);
@@ -219,6 +225,10 @@ parameter_proc (int argcount, char **argvec)
     {
       reclen = atoi (argvec[++optind]);
     }
+    else if (strcmp (argvec[optind], "-B") == 0)
+    {
+      readbuffer = atoi (argvec[++optind]);
+    }
     else if (strncmp (argvec[optind], "-", 1) == 0 &&
              strlen (argvec[optind]) > 1)
     {
@@ -283,6 +293,7 @@ usage (void)
            " -tg            Print trace listing with gap information\n"
            " -s             Print a basic summary after processing a file\n"
            " -r bytes       Specify record length in bytes, required if no Blockette 1000\n"
+           " -B bytes       Read through stdio with a read-ahead buffer of bytes\n"
            "\n"
            " file           File of Mini-SEED records\n"
            "\n");
@@ -0,0 +1,234 @@
+/***************************************************************************
+ * lmtestselect.c
+ *
+ * A program for libmseed selection tests, comparing the matches of a
+ * compiled selection index with those of the selection list.
+ *
+ * modified 2026.287
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libmseed.h>
+
+#define PACKAGE "lmtestselect"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+static flag verbose      = 0;
+static char *selectfile  = 0;
+
+static int parameter_proc (int argcount, char **argvec);
+static void print_stderr (char *message);
+static void usage (void);
+
+/* Source name components of the test queries */
+static const char *networks[]  = {"IU", "XA", "XB", NULL};
+static const char *stations[]  = {"ANMO", "S001", "S010", NULL};
+static const char *locations[] = {"", "00", "10", NULL};
+static const char *channels[]  = {"BHZ", "LHZ", "HHE", NULL};
+static const char *qualities[] = {"D", "R", NULL};
+
+/* Time windows of the test queries */
+static const char *windows[][2] = {
+    {"2020,061,00,00,00", "2020,061,00,30,00"},
+    {"2020,061,00,50,00", "2020,061,01,10,00"},
+    {"2020,061,03,00,00", "2020,061,04,00,00"},
+    {NULL, NULL}};
+
+/* Binary I/O for Windows platforms */
+#ifdef LMP_WIN
+  unsigned int _CRT_fmode = _O_BINARY;
+#endif
+
+int
+main (int argc, char **argv)
+{
+  Selections *selections = NULL;
+  Selections *listmatch;
+  Selections *indexmatch;
+  SelectIndex *index;
+  SelectTime *listtime;
+  SelectTime *indextime;
+  hptime_t starttime;
+  hptime_t endtime;
+  char srcname[50];
+  char timestr[30];
+  int64_t queries    = 0;
+  int64_t matches    = 0;
+  int64_t mismatches = 0;
+  int net, sta, loc, chan, qual, win, pass;
+
+  /* Redirect libmseed logging facility to stderr for consistency */
+  ms_loginit (print_stderr, NULL, print_stderr, NULL);
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  if (ms_readselectionsfile (&selections, selectfile) < 0)
+  {
+    ms_log (2, "Cannot read selection file %s\n", selectfile);
+    return 1;
+  }
+
+  if (!(index = ms_compileselections (selections)))
+  {
+    ms_log (2, "Cannot compile selections\n");
+    return 1;
+  }
+
+  /* The second pass repeats all queries, matching from the cache */
+  for (pass = 0; pass < 2; pass++)
+    for (net = 0; networks[net]; net++)
+      for (sta = 0; stations[sta]; sta++)
+        for (loc = 0; locations[loc]; loc++)
+          for (chan = 0; channels[chan]; chan++)
+            for (qual = 0; qualities[qual]; qual++)
+              for (win = 0; windows[win][0]; win++)
+              {
+                snprintf (srcname, sizeof (srcname), "%s_%s_%s_%s_%s",
+                          networks[net], stations[sta], locations[loc],
+                          channels[chan], qualities[qual]);
+
+                starttime = ms_seedtimestr2hptime ((char *)windows[win][0]);
+                endtime   = ms_seedtimestr2hptime ((char *)windows[win][1]);
+
+                listtime  = NULL;
+                indextime = NULL;
+                listmatch  = ms_matchselect (selections, srcname, starttime, endtime, &listtime);
+                indexmatch = ms_matchselect_index (index, srcname, starttime, endtime, &indextime);
+
+                queries++;
+
+                if (listmatch != indexmatch || listtime != indextime)
+                {
+                  mismatches++;
+                  ms_log (0, "MISMATCH %s %s: list %s, index %s\n", srcname, windows[win][0],
+                          (listmatch) ? listmatch->srcname : "none",
+                          (indexmatch) ? indexmatch->srcname : "none");
+                  continue;
+                }
+
+                if (!listmatch)
+                  continue;
+
+                matches++;
+
+                if (pass == 0)
+                {
+                  if (listtime->starttime != HPTERROR)
+                    ms_hptime2seedtimestr (listtime->starttime, timestr, 0);
+                  else
+                    strcpy (timestr, "any");
+
+                  ms_log (0, "%s %s: %s from %s\n", srcname, windows[win][0],
+                          listmatch->srcname, timestr);
+                }
+              }
+
+  ms_log (1, "Queries: %" PRId64 ", Matches: %" PRId64 ", Mismatches: %" PRId64 "\n",
+          queries, matches, mismatches);
+
+  ms_freeselectindex (index);
+  ms_freeselections (selections);
+
+  return (mismatches) ? 1 : 0;
+} /* End of main() */
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else if (strncmp (argvec[optind], "-", 1) == 0 &&
+             strlen (argvec[optind]) > 1)
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+    else if (selectfile == 0)
+    {
+      selectfile = argvec[optind];
+    }
+    else
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+  }
+
+  /* Make sure a selection file was specified */
+  if (!selectfile)
+  {
+    ms_log (2, "No selection file was specified\n\n");
+    ms_log (1, "%s version %s\n\n", PACKAGE, VERSION);
+    ms_log (1, "Try %s -h for usage\n", PACKAGE);
+    exit (1);
+  }
+
+  /* Report the program version */
+  if (verbose)
+    ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * print_stderr():
+ * Print messsage to stderr.
+ ***************************************************************************/
+static void
+print_stderr (char *message)
+{
+  fprintf (stderr, "%s", message);
+} /* End of print_stderr() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s [options] selectfile\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -v             Be more verbose, multiple flags can be used\n"
+           "\n"
+           " selectfile     File of data selections\n"
+           "\n"
+           "This program matches generated source names and time windows\n"
+           "against the selections with ms_matchselect() and a compiled\n"
+           "selection index, printing the matches and any differences.\n"
+           "\n");
+} /* End of usage() */
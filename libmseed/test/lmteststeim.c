@@ -0,0 +1,403 @@
+/***************************************************************************
+ * lmteststeim.c
+ *
+ * A program for libmseed Steim decoding tests at frame, record and
+ * sample count boundaries.
+ *
+ * Series of samples mixing all difference sizes are packed into
+ * Steim1 and Steim2 records of every length from 1 to a number of
+ * samples filling several records.  Each record is decoded and
+ * compared with the original samples, then decoded again with the
+ * number of samples in the header reduced by one so the decoding ends
+ * before the last difference packed.
+ *
+ * modified 2026.287
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libmseed.h>
+
+#define PACKAGE "lmteststeim"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+/* Samples in the longest series */
+#define MAXSAMPLES 400
+
+static flag verbose = 0;
+
+static int32_t series[MAXSAMPLES];
+
+/* Records packed for a series */
+static char *packed   = NULL;
+static int packedsize = 0;
+static int packedlen  = 0;
+
+static int64_t messages = 0;
+
+static void makeseries (int steimtype);
+static int testseries (int encoding, int byteorder, int reclen, int nsamples,
+                       int64_t *records);
+static int checkrecord (char *record, int reclen, int32_t *expected,
+                        int nsamples, const char *desc);
+static void record_handler (char *record, int reclen, void *handlerdata);
+static int parameter_proc (int argcount, char **argvec);
+static void print_stderr (char *message);
+static void count_stderr (char *message);
+static void usage (void);
+
+/* Binary I/O for Windows platforms */
+#ifdef LMP_WIN
+  unsigned int _CRT_fmode = _O_BINARY;
+#endif
+
+int
+main (int argc, char **argv)
+{
+  static const int reclens[] = {128, 512, 0};
+  int64_t records;
+  int encoding, byteorder, rlidx, nsamples;
+  int errors;
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  /* Count decoding messages, reported in the summaries */
+  ms_loginit (print_stderr, NULL, count_stderr, NULL);
+
+  for (encoding = DE_STEIM1; encoding <= DE_STEIM2; encoding++)
+  {
+    makeseries (encoding - DE_STEIM1 + 1);
+
+    for (byteorder = 1; byteorder >= 0; byteorder--)
+      for (rlidx = 0; reclens[rlidx]; rlidx++)
+      {
+        records  = 0;
+        errors   = 0;
+        messages = 0;
+
+        for (nsamples = 1; nsamples <= MAXSAMPLES; nsamples++)
+          errors += testseries (encoding, byteorder, reclens[rlidx], nsamples, &records);
+
+        ms_log (0, "Steim%d %s-endian %d-byte records: %d series, %" PRId64
+                " records, %d errors, %" PRId64 " messages\n",
+                encoding - DE_STEIM1 + 1, (byteorder) ? "big" : "little",
+                reclens[rlidx], MAXSAMPLES, records, errors, messages);
+      }
+  }
+
+  if (packed)
+    free (packed);
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * makeseries():
+ *
+ * Generate the test series, blocks of 1 to 9 samples and occasional
+ * runs of 80 samples with differences of one size, including runs of
+ * constant values and runs filling whole frames with 1-byte
+ * differences.
+ ***************************************************************************/
+static void
+makeseries (int steimtype)
+{
+  /* Difference sizes in bits, differences are within half of 2^(bits-1) */
+  static const int steim1bits[] = {0, 8, 16, 28};
+  static const int steim2bits[] = {0, 4, 5, 6, 8, 10, 15, 28};
+  const int *bits  = (steimtype == 1) ? steim1bits : steim2bits;
+  int classes      = (steimtype == 1) ? 4 : 8;
+  uint32_t lcg     = 12345;
+  int32_t value    = 0;
+  int32_t range    = 0;
+  int blocklen     = 0;
+  int idx;
+
+  for (idx = 0; idx < MAXSAMPLES; idx++)
+  {
+    if (blocklen == 0)
+    {
+      lcg      = lcg * 1103515245u + 12345u;
+      range    = (bits[(lcg >> 16) % classes]) ? 1 << (bits[(lcg >> 16) % classes] - 2) : 0;
+      lcg      = lcg * 1103515245u + 12345u;
+      blocklen = ((lcg >> 16) % 10 == 0) ? 80 : 1 + (lcg >> 16) % 9;
+    }
+
+    lcg = lcg * 1103515245u + 12345u;
+
+    /* Return to zero at the start of blocks of smaller differences */
+    if (range && (value > range || value < -range))
+      value = 0;
+
+    if (range)
+      value += (int32_t) ((lcg >> 8) % (uint32_t)range) - range / 2;
+
+    series[idx] = value;
+    blocklen--;
+  }
+} /* End of makeseries() */
+
+/***************************************************************************
+ * testseries():
+ *
+ * Pack the first nsamples samples of the series and check the
+ * decoding of each record.
+ *
+ * Returns the number of errors.
+ ***************************************************************************/
+static int
+testseries (int encoding, int byteorder, int reclen, int nsamples,
+            int64_t *records)
+{
+  MSRecord *msr = NULL;
+  int64_t packedsamples = 0;
+  int32_t *expected = series;
+  char record[MAXRECLEN];
+  char desc[100];
+  int count;
+  int errors = 0;
+  int offset;
+
+  if (!(msr = msr_init (NULL)))
+  {
+    ms_log (2, "Could not allocate MSRecord, out of memory?\n");
+    return 1;
+  }
+
+  strcpy (msr->network, "XX");
+  strcpy (msr->station, "TEST");
+  strcpy (msr->channel, "BHZ");
+  msr->dataquality = 'D';
+  msr->starttime   = ms_timestr2hptime ("2020-03-01T00:00:00");
+  msr->samprate    = 20.0;
+  msr->reclen      = reclen;
+  msr->encoding    = encoding;
+  msr->byteorder   = byteorder;
+  msr->datasamples = series;
+  msr->numsamples  = nsamples;
+  msr->samplecnt   = nsamples;
+  msr->sampletype  = 'i';
+
+  packedlen = 0;
+
+  if (msr_pack (msr, record_handler, NULL, &packedsamples, 1, verbose) < 0 ||
+      packedsamples != nsamples)
+  {
+    ms_log (2, "Cannot pack %d samples\n", nsamples);
+    msr->datasamples = NULL;
+    msr_free (&msr);
+    return 1;
+  }
+
+  msr->datasamples = NULL;
+  msr_free (&msr);
+
+  for (offset = 0; offset < packedlen; offset += reclen)
+  {
+    memcpy (record, packed + offset, reclen);
+
+    /* Number of samples from the header, in the packed byte order */
+    if (byteorder)
+      count = (uint8_t)record[30] << 8 | (uint8_t)record[31];
+    else
+      count = (uint8_t)record[31] << 8 | (uint8_t)record[30];
+
+    snprintf (desc, sizeof (desc), "Steim%d %s %d-byte, %d samples, record %d",
+              encoding - DE_STEIM1 + 1, (byteorder) ? "BE" : "LE", reclen,
+              nsamples, offset / reclen);
+
+    errors += checkrecord (record, reclen, expected, count, desc);
+
+    /* Decode one sample less than packed */
+    if (count > 1)
+    {
+      count--;
+      if (byteorder)
+      {
+        record[30] = (char)(count >> 8);
+        record[31] = (char)(count & 0xFF);
+      }
+      else
+      {
+        record[30] = (char)(count & 0xFF);
+        record[31] = (char)(count >> 8);
+      }
+
+      errors += checkrecord (record, reclen, expected, count, desc);
+      count++;
+    }
+
+    expected += count;
+    (*records)++;
+  }
+
+  if (expected != series + nsamples)
+  {
+    ms_log (0, "ERROR %d samples packed, %d samples in records\n",
+            nsamples, (int)(expected - series));
+    errors++;
+  }
+
+  return errors;
+} /* End of testseries() */
+
+/***************************************************************************
+ * checkrecord():
+ *
+ * Decode a record and compare the samples with the expected samples.
+ *
+ * Returns 0 when the samples match and 1 otherwise.
+ ***************************************************************************/
+static int
+checkrecord (char *record, int reclen, int32_t *expected, int nsamples,
+             const char *desc)
+{
+  MSRecord *msr = NULL;
+  int32_t *samples;
+  int retcode;
+  int idx;
+
+  if ((retcode = msr_parse (record, reclen, &msr, reclen, 1, verbose)) != MS_NOERROR)
+  {
+    ms_log (0, "ERROR %s: Cannot decode: %s\n", desc, ms_errorstr (retcode));
+    msr_free (&msr);
+    return 1;
+  }
+
+  if (msr->numsamples != nsamples || msr->sampletype != 'i')
+  {
+    ms_log (0, "ERROR %s: Decoded %" PRId64 " samples, expected %d\n",
+            desc, msr->numsamples, nsamples);
+    msr_free (&msr);
+    return 1;
+  }
+
+  samples = (int32_t *)msr->datasamples;
+
+  for (idx = 0; idx < nsamples; idx++)
+  {
+    if (samples[idx] != expected[idx])
+    {
+      ms_log (0, "ERROR %s: Sample %d of %d is %d, expected %d\n",
+              desc, idx, nsamples, samples[idx], expected[idx]);
+      msr_free (&msr);
+      return 1;
+    }
+  }
+
+  msr_free (&msr);
+
+  return 0;
+} /* End of checkrecord() */
+
+/***************************************************************************
+ * record_handler():
+ * Append a packed record to the buffer of packed records.
+ ***************************************************************************/
+static void
+record_handler (char *record, int reclen, void *handlerdata)
+{
+  (void)handlerdata;
+
+  if (packedlen + reclen > packedsize)
+  {
+    packedsize = (packedsize) ? packedsize * 2 : MAXRECLEN * 4;
+
+    if (!(packed = (char *)realloc (packed, packedsize)))
+    {
+      ms_log (2, "Could not allocate buffer, out of memory?\n");
+      exit (1);
+    }
+  }
+
+  memcpy (packed + packedlen, record, reclen);
+  packedlen += reclen;
+} /* End of record_handler() */
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+  }
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * print_stderr():
+ * Print messsage to stderr.
+ ***************************************************************************/
+static void
+print_stderr (char *message)
+{
+  fprintf (stderr, "%s", message);
+} /* End of print_stderr() */
+
+/***************************************************************************
+ * count_stderr():
+ * Count and, when verbose, print a diagnostic messsage to stderr.
+ ***************************************************************************/
+static void
+count_stderr (char *message)
+{
+  messages++;
+
+  if (verbose)
+    fprintf (stderr, "%s", message);
+} /* End of count_stderr() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s [options]\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -v             Be more verbose, multiple flags can be used\n"
+           "\n"
+           "This program packs generated series into Steim1 and Steim2 records\n"
+           "and checks the decoded samples, including decoding fewer samples\n"
+           "than packed.\n"
+           "\n");
+} /* End of usage() */
@@ -0,0 +1,344 @@
+/***************************************************************************
+ * lmtestunpack.c
+ *
+ * A program for libmseed tests of unpacking data samples separately
+ * from the record header with msr_unpack_samples() and
+ * msr_unpack_samples_into().
+ *
+ * The records of each file are read without data samples, the samples
+ * are then unpacked into a caller buffer of exactly the size needed,
+ * into a buffer one sample too small, which must be rejected, and
+ * into MSRecord->datasamples.  All samples must match those unpacked
+ * with the record by msr_parse().
+ *
+ * modified 2026.287
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libmseed.h>
+
+#define PACKAGE "lmtestunpack"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+/* Bytes checked after the end of the caller buffer */
+#define GUARDSIZE 16
+#define GUARDBYTE 0xA5
+
+static flag verbose = 0;
+
+static int64_t messages = 0;
+
+static int testfile (char *inputfile);
+static int testrecord (MSRecord *msr, int64_t *rejected);
+static int parameter_proc (int argcount, char **argvec);
+static void print_stderr (char *message);
+static void count_stderr (char *message);
+static void usage (void);
+
+/* Binary I/O for Windows platforms */
+#ifdef LMP_WIN
+  unsigned int _CRT_fmode = _O_BINARY;
+#endif
+
+int
+main (int argc, char **argv)
+{
+  int errors = 0;
+  int optind;
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  /* Count the messages of rejected buffers, reported in the summaries */
+  ms_loginit (print_stderr, NULL, count_stderr, NULL);
+
+  for (optind = 1; optind < argc; optind++)
+  {
+    if (argv[optind][0] == '-')
+      continue;
+
+    errors += testfile (argv[optind]);
+  }
+
+  return (errors) ? 1 : 0;
+} /* End of main() */
+
+/***************************************************************************
+ * testfile():
+ *
+ * Read the records of a file without data samples and test the
+ * unpacking of the samples of each record.
+ *
+ * Returns the number of errors.
+ ***************************************************************************/
+static int
+testfile (char *inputfile)
+{
+  MSFileParam *msfp = NULL;
+  MSRecord *msr     = NULL;
+  int64_t records   = 0;
+  int64_t samples   = 0;
+  int64_t rejected  = 0;
+  char sampletypes[10] = {0};
+  int errors        = 0;
+  int retcode;
+
+  messages = 0;
+
+  while ((retcode = ms_readmsr_r (&msfp, &msr, inputfile, 0, NULL, NULL,
+                                  1, 0, verbose)) == MS_NOERROR)
+  {
+    records++;
+    samples += msr->samplecnt;
+
+    if (testrecord (msr, &rejected))
+      errors++;
+    else if (msr->samplecnt > 0 && !strchr (sampletypes, msr->sampletype) &&
+             strlen (sampletypes) < sizeof (sampletypes) - 1)
+      sampletypes[strlen (sampletypes)] = msr->sampletype;
+  }
+
+  if (retcode != MS_ENDOFFILE)
+  {
+    ms_log (0, "ERROR %s: Cannot read: %s\n", inputfile, ms_errorstr (retcode));
+    errors++;
+  }
+
+  /* Cleanup memory and close file */
+  ms_readmsr_r (&msfp, &msr, NULL, 0, NULL, NULL, 0, 0, 0);
+
+  ms_log (0, "%s: %" PRId64 " records, %" PRId64 " samples, sample types '%s', "
+          "%" PRId64 " small buffers rejected, %" PRId64 " messages, %d errors\n",
+          inputfile, records, samples, sampletypes, rejected, messages, errors);
+
+  return errors;
+} /* End of testfile() */
+
+/***************************************************************************
+ * testrecord():
+ *
+ * Test the unpacking of the samples of a record read without data
+ * samples, counting rejected buffers that are too small.
+ *
+ * Returns 0 when all samples match and 1 otherwise.
+ ***************************************************************************/
+static int
+testrecord (MSRecord *msr, int64_t *rejected)
+{
+  MSRecord *full = NULL;
+  char srcname[50];
+  uint8_t *buffer = NULL;
+  size_t size;
+  int samplesize;
+  int retcode;
+  int error = 1;
+  int idx;
+
+  msr_srcname (msr, srcname, 1);
+
+  if (msr->datasamples || msr->numsamples)
+  {
+    ms_log (0, "ERROR %s: Samples unpacked with dataflag 0\n", srcname);
+    return 1;
+  }
+
+  /* Reference samples unpacked with the record */
+  if ((retcode = msr_parse (msr->record, msr->reclen, &full, msr->reclen, 1, verbose)) != MS_NOERROR)
+  {
+    ms_log (0, "ERROR %s: Cannot parse record: %s\n", srcname, ms_errorstr (retcode));
+    msr_free (&full);
+    return 1;
+  }
+
+  samplesize = ms_samplesize (full->sampletype);
+  size       = (size_t)full->numsamples * samplesize;
+
+  if (!(buffer = (uint8_t *)malloc (size + GUARDSIZE)))
+  {
+    ms_log (2, "Could not allocate buffer, out of memory?\n");
+    msr_free (&full);
+    return 1;
+  }
+
+  /* Unpack into a buffer of exactly the needed size */
+  memset (buffer, GUARDBYTE, size + GUARDSIZE);
+  msr->sampletype = 0;
+
+  if ((retcode = msr_unpack_samples_into (msr, buffer, size, verbose)) != full->numsamples)
+  {
+    ms_log (0, "ERROR %s: Unpacked %d samples into buffer, expected %" PRId64 "\n",
+            srcname, retcode, full->numsamples);
+    goto cleanup;
+  }
+
+  if (msr->sampletype != full->sampletype || msr->datasamples || msr->numsamples)
+  {
+    ms_log (0, "ERROR %s: Unpacking into buffer set sample type '%c', %" PRId64 " samples\n",
+            srcname, (msr->sampletype) ? msr->sampletype : '-', msr->numsamples);
+    goto cleanup;
+  }
+
+  if (size && memcmp (buffer, full->datasamples, size))
+  {
+    ms_log (0, "ERROR %s: Samples unpacked into buffer differ\n", srcname);
+    goto cleanup;
+  }
+
+  for (idx = 0; idx < GUARDSIZE; idx++)
+  {
+    if (buffer[size + idx] != GUARDBYTE)
+    {
+      ms_log (0, "ERROR %s: Unpacking wrote beyond the end of the buffer\n", srcname);
+      goto cleanup;
+    }
+  }
+
+  /* Unpack into a buffer one sample too small */
+  if (full->numsamples > 0)
+  {
+    memset (buffer, GUARDBYTE, size + GUARDSIZE);
+
+    if ((retcode = msr_unpack_samples_into (msr, buffer, size - samplesize, verbose)) >= 0)
+    {
+      ms_log (0, "ERROR %s: Unpacked %d samples into a buffer too small\n", srcname, retcode);
+      goto cleanup;
+    }
+
+    for (idx = 0; idx < (int)size + GUARDSIZE; idx++)
+    {
+      if (buffer[idx] != GUARDBYTE)
+      {
+        ms_log (0, "ERROR %s: Buffer too small was changed\n", srcname);
+        goto cleanup;
+      }
+    }
+
+    (*rejected)++;
+  }
+
+  /* Unpack into MSRecord->datasamples */
+  if ((retcode = msr_unpack_samples (msr, verbose)) != MS_NOERROR)
+  {
+    ms_log (0, "ERROR %s: Cannot unpack samples: %s\n", srcname, ms_errorstr (retcode));
+    goto cleanup;
+  }
+
+  if (msr->numsamples != full->numsamples || msr->sampletype != full->sampletype ||
+      (size && memcmp (msr->datasamples, full->datasamples, size)))
+  {
+    ms_log (0, "ERROR %s: Samples unpacked into the record differ\n", srcname);
+    goto cleanup;
+  }
+
+  error = 0;
+
+cleanup:
+  free (buffer);
+  msr_free (&full);
+
+  return error;
+} /* End of testrecord() */
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int inputfiles = 0;
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else if (strncmp (argvec[optind], "-", 1) == 0)
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+    else
+    {
+      inputfiles++;
+    }
+  }
+
+  /* Make sure input files were specified */
+  if (!inputfiles)
+  {
+    ms_log (2, "No input files were specified\n\n");
+    ms_log (1, "%s version %s\n\n", PACKAGE, VERSION);
+    ms_log (1, "Try %s -h for usage\n", PACKAGE);
+    exit (1);
+  }
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * print_stderr():
+ * Print messsage to stderr.
+ ***************************************************************************/
+static void
+print_stderr (char *message)
+{
+  fprintf (stderr, "%s", message);
+} /* End of print_stderr() */
+
+/***************************************************************************
+ * count_stderr():
+ * Count and, when verbose, print a diagnostic messsage to stderr.
+ ***************************************************************************/
+static void
+count_stderr (char *message)
+{
+  messages++;
+
+  if (verbose)
+    fprintf (stderr, "%s", message);
+} /* End of count_stderr() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s [options] file1 [file2 ...]\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -v             Be more verbose, multiple flags can be used\n"
+           "\n"
+           " files          File(s) of miniSEED records\n"
+           "\n"
+           "This program unpacks the samples of records read without data\n"
+           "samples into caller buffers and MSRecord->datasamples and compares\n"
+           "them with the samples unpacked with the record.\n"
+           "\n");
+} /* End of usage() */
@@ -5,7 +5,7 @@
  *
  * Written by Chad Trabant, IRIS Data Management Center
  *
- * modified: 2015.108
+ * modified: 2026.287
  ***************************************************************************/
 
 #include <stdio.h>
@@ -465,10 +465,7 @@ mst_addmsr (MSTrace *mst, MSRecord *msr, flag whence)
       return -1;
     }
 
-    mst->datasamples = realloc (mst->datasamples,
-                                (size_t) (mst->numsamples * samplesize + msr->numsamples * samplesize));
-
-    if (mst->datasamples == NULL)
+    if (mst_growdata (mst, (size_t) (mst->numsamples * samplesize + msr->numsamples * samplesize)))
     {
       ms_log (2, "mst_addmsr(): Cannot allocate memory\n");
       return -1;
@@ -529,6 +526,52 @@ mst_addmsr (MSTrace *mst, MSRecord *msr, flag whence)
   return 0;
 } /* End of mst_addmsr() */
 
+/***************************************************************************
+ * mst_growdata:
+ *
+ * Make sure the data sample buffer of a MSTrace is at least datasize
+ * bytes.  When the buffer must be expanded its size is at least
+ * doubled, so that repeatedly appending records results in an
+ * amortized constant number of reallocations per sample.
+ *
+ * A MSTrace.datasize of 0 indicates an unknown buffer size, in which
+ * case the buffer is always reallocated.  A caller that replaces or
+ * frees MSTrace.datasamples itself must reset MSTrace.datasize to 0
+ * (or the size of the new buffer), otherwise the buffer is assumed to
+ * be larger than it is.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+int
+mst_growdata (MSTrace *mst, size_t datasize)
+{
+  size_t newsize;
+  void *newdata;
+
+  if (datasize <= mst->datasize)
+    return 0;
+
+  newsize = mst->datasize * 2;
+
+  if (newsize < datasize)
+    newsize = datasize;
+
+  if ((newdata = realloc (mst->datasamples, newsize)) == NULL)
+  {
+    /* Fall back to the exact size needed */
+    if (newsize == datasize ||
+        (newdata = realloc (mst->datasamples, datasize)) == NULL)
+      return -1;
+
+    newsize = datasize;
+  }
+
+  mst->datasamples = newdata;
+  mst->datasize    = newsize;
+
+  return 0;
+} /* End of mst_growdata() */
+
 /***************************************************************************
  * mst_addspan:
  *
@@ -568,10 +611,7 @@ mst_addspan (MSTrace *mst, hptime_t starttime, hptime_t endtime,
       return -1;
     }
 
-    mst->datasamples = realloc (mst->datasamples,
-                                (size_t) (mst->numsamples * samplesize + numsamples * samplesize));
-
-    if (mst->datasamples == NULL)
+    if (mst_growdata (mst, (size_t) (mst->numsamples * samplesize + numsamples * samplesize)))
     {
       ms_log (2, "mst_addspan(): Cannot allocate memory\n");
       return -1;
@@ -1165,6 +1205,8 @@ mst_convertsamples (MSTrace *mst, char type, flag truncate)
         ms_log (2, "mst_convertsamples: cannot re-allocate buffer for sample conversion\n");
         return -1;
       }
+
+      mst->datasize = (size_t) (mst->numsamples * sizeof (int32_t));
     }
 
     mst->sampletype = 'i';
@@ -1189,6 +1231,8 @@ mst_convertsamples (MSTrace *mst, char type, flag truncate)
         ms_log (2, "mst_convertsamples: cannot re-allocate buffer after sample conversion\n");
         return -1;
       }
+
+      mst->datasize = (size_t) (mst->numsamples * sizeof (float));
     }
 
     mst->sampletype = 'f';
@@ -1219,6 +1263,7 @@ mst_convertsamples (MSTrace *mst, char type, flag truncate)
     }
 
     mst->datasamples = ddata;
+    mst->datasize    = (size_t) (mst->numsamples * sizeof (double));
     mst->sampletype  = 'd';
   } /* Done converting to 64-bit doubles */
 
@@ -1760,12 +1805,15 @@ mst_pack (MSTrace *mst, void (*record_handler) (char *, int, void *),
         ms_log (2, "mst_pack(): Cannot (re)allocate datasamples buffer\n");
         return -1;
       }
+
+      mst->datasize = (size_t)bufsize;
     }
     else
     {
       if (mst->datasamples)
         free (mst->datasamples);
       mst->datasamples = 0;
+      mst->datasize    = 0;
     }
 
     mst->samplecnt -= trpackedsamples;
@@ -14,6 +14,7 @@
  *   IRIS Data Management Center
  ***************************************************************************/
 #include <ctype.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,6 +25,11 @@
 
 /* Function(s) internal to this file */
 static int check_environment (int verbose);
+static int unpack_samples (MSRecord *msr, void *output, size_t outputsize,
+                           flag headerswapflag, flag dataswapflag,
+                           char *srcname, flag verbose);
+static int unpack_data (MSRecord *msr, void *output, size_t outputsize,
+                        int swapflag, flag verbose);
 
 /* Header and data byte order flags controlled by environment variables */
 /* -2 = not checked, -1 = checked but not set, or 0 = LE and 1 = BE */
@@ -658,39 +664,10 @@ msr_unpack (char *record, int reclen, MSRecord **ppmsr,
   /* Unpack the data samples if requested */
   if (dataflag && msr->samplecnt > 0)
   {
-    flag dswapflag     = headerswapflag;
-    flag bigendianhost = ms_bigendianhost ();
-
-    /* Determine byte order of the data and set the dswapflag as
-       needed; if no Blkt1000 or UNPACK_DATA_BYTEORDER environment
-       variable setting assume the order is the same as the header */
-    if (msr->Blkt1000 != 0 && unpackdatabyteorder < 0)
-    {
-      dswapflag = 0;
-
-      /* If BE host and LE data need swapping */
-      if (bigendianhost && msr->byteorder == 0)
-        dswapflag = 1;
-      /* If LE host and BE data (or bad byte order value) need swapping */
-      else if (!bigendianhost && msr->byteorder > 0)
-        dswapflag = 1;
-    }
-    else if (unpackdatabyteorder >= 0)
-    {
-      dswapflag = dataswapflag;
-    }
-
-    if (verbose > 2 && dswapflag)
-      ms_log (1, "%s: Byte swapping needed for unpacking of data samples\n", srcname);
-    else if (verbose > 2)
-      ms_log (1, "%s: Byte swapping NOT needed for unpacking of data samples\n", srcname);
-
-    retval = msr_unpack_data (msr, dswapflag, verbose);
+    retval = unpack_samples (msr, NULL, 0, headerswapflag, dataswapflag, srcname, verbose);
 
     if (retval < 0)
       return retval;
-    else
-      msr->numsamples = retval;
   }
   else
   {
@@ -704,6 +681,138 @@ msr_unpack (char *record, int reclen, MSRecord **ppmsr,
   return MS_NOERROR;
 } /* End of msr_unpack() */
 
+/***************************************************************************
+ * msr_unpack_samples:
+ *
+ * Unpack the data samples of a MSRecord previously unpacked by
+ * msr_unpack() without data samples (dataflag = 0).  The original
+ * record must still be available at MSRecord->record.  Byte swapping
+ * of the data samples is determined in the same way as msr_unpack().
+ *
+ * This allows the header of a record to be inspected, e.g. against
+ * selections, before the work of decoding the data samples is done.
+ *
+ * Returns MS_NOERROR on success, otherwise returns a libmseed error
+ * code (listed in libmseed.h).
+ ***************************************************************************/
+int
+msr_unpack_samples (MSRecord *msr, flag verbose)
+{
+  int retval;
+
+  retval = msr_unpack_samples_into (msr, NULL, 0, verbose);
+
+  return (retval < 0) ? retval : MS_NOERROR;
+} /* End of msr_unpack_samples() */
+
+/***************************************************************************
+ * msr_unpack_samples_into:
+ *
+ * Unpack the data samples of a MSRecord previously unpacked by
+ * msr_unpack() without data samples (dataflag = 0) into a buffer
+ * supplied by the caller, e.g. the end of a growing trace.  The
+ * buffer must hold MSRecord->samplecnt samples of the size implied
+ * by the encoding, see ms_samplesize().  MSRecord->sampletype is set
+ * to the type of the samples, MSRecord->datasamples and
+ * MSRecord->numsamples are not changed.  If output is NULL the
+ * samples are placed in MSRecord->datasamples as done by
+ * msr_unpack_samples().
+ *
+ * Returns the number of samples unpacked on success, otherwise
+ * returns a negative libmseed error code (listed in libmseed.h).
+ ***************************************************************************/
+int
+msr_unpack_samples_into (MSRecord *msr, void *output, size_t outputsize, flag verbose)
+{
+  struct btime_s start_time;
+  flag headerswapflag = 0;
+  flag dataswapflag   = 0;
+  char srcname[50];
+
+  if (!msr || !msr->record || !msr->fsdh)
+    return MS_GENERROR;
+
+  if (msr->samplecnt <= 0)
+    return 0;
+
+  if (msr_srcname (msr, srcname, 1) == NULL)
+  {
+    ms_log (2, "msr_unpack_samples_into(): Cannot generate srcname\n");
+    return MS_GENERROR;
+  }
+
+  /* Repeat the byte swapping test of msr_unpack() on the original record */
+  memcpy (&start_time, msr->record + offsetof (struct fsdh_s, start_time), sizeof (start_time));
+
+  if (!MS_ISVALIDYEARDAY (start_time.year, start_time.day))
+    headerswapflag = dataswapflag = 1;
+
+  if (unpackheaderbyteorder >= 0)
+  {
+    headerswapflag = (ms_bigendianhost () != unpackheaderbyteorder) ? 1 : 0;
+  }
+
+  if (unpackdatabyteorder >= 0)
+  {
+    dataswapflag = (ms_bigendianhost () != unpackdatabyteorder) ? 1 : 0;
+  }
+
+  return unpack_samples (msr, output, outputsize, headerswapflag, dataswapflag,
+                         srcname, verbose);
+} /* End of msr_unpack_samples_into() */
+
+/***************************************************************************
+ * unpack_samples:
+ *
+ * Determine the byte order of the data samples and unpack them using
+ * the header and data swap flags determined for the record header.
+ * The samples are placed in output if not NULL, otherwise in
+ * MSRecord->datasamples.
+ *
+ * Returns the number of samples unpacked or a negative libmseed error
+ * code.
+ ***************************************************************************/
+static int
+unpack_samples (MSRecord *msr, void *output, size_t outputsize,
+                flag headerswapflag, flag dataswapflag,
+                char *srcname, flag verbose)
+{
+  flag dswapflag     = headerswapflag;
+  flag bigendianhost = ms_bigendianhost ();
+  int retval;
+
+  /* Determine byte order of the data and set the dswapflag as
+     needed; if no Blkt1000 or UNPACK_DATA_BYTEORDER environment
+     variable setting assume the order is the same as the header */
+  if (msr->Blkt1000 != 0 && unpackdatabyteorder < 0)
+  {
+    dswapflag = 0;
+
+    /* If BE host and LE data need swapping */
+    if (bigendianhost && msr->byteorder == 0)
+      dswapflag = 1;
+    /* If LE host and BE data (or bad byte order value) need swapping */
+    else if (!bigendianhost && msr->byteorder > 0)
+      dswapflag = 1;
+  }
+  else if (unpackdatabyteorder >= 0)
+  {
+    dswapflag = dataswapflag;
+  }
+
+  if (verbose > 2 && dswapflag)
+    ms_log (1, "%s: Byte swapping needed for unpacking of data samples\n", srcname);
+  else if (verbose > 2)
+    ms_log (1, "%s: Byte swapping NOT needed for unpacking of data samples\n", srcname);
+
+  retval = unpack_data (msr, output, outputsize, dswapflag, verbose);
+
+  if (retval >= 0 && !output)
+    msr->numsamples = retval;
+
+  return retval;
+} /* End of unpack_samples() */
+
 /************************************************************************
  *  msr_unpack_data:
  *
@@ -717,6 +826,22 @@ msr_unpack (char *record, int reclen, MSRecord **ppmsr,
  ************************************************************************/
 int
 msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
+{
+  return unpack_data (msr, NULL, 0, swapflag, verbose);
+} /* End of msr_unpack_data() */
+
+/************************************************************************
+ *  unpack_data:
+ *
+ *  Unpack Mini-SEED data samples for a given MSRecord into output,
+ *  which must hold at least outputsize bytes, or into
+ *  MSRecord->datasamples if output is NULL.
+ *
+ *  Return number of samples unpacked or negative libmseed error code.
+ ************************************************************************/
+static int
+unpack_data (MSRecord *msr, void *output, size_t outputsize,
+             int swapflag, flag verbose)
 {
   int datasize;       /* byte size of data samples in record */
   int nsamples;       /* number of samples unpacked	     */
@@ -792,8 +917,18 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
   /* Calculate buffer size needed for unpacked samples */
   unpacksize = (int)msr->samplecnt * samplesize;
 
+  /* Check the space of the output buffer for the unpacked data */
+  if (output)
+  {
+    if ((size_t)unpacksize > outputsize)
+    {
+      ms_log (2, "msr_unpack_data(%s): Output buffer too small for %d bytes of samples\n",
+              srcname, unpacksize);
+      return MS_GENERROR;
+    }
+  }
   /* (Re)Allocate space for the unpacked data */
-  if (unpacksize > 0)
+  else if (unpacksize > 0)
   {
     msr->datasamples = realloc (msr->datasamples, unpacksize);
 
@@ -811,6 +946,9 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     msr->numsamples  = 0;
   }
 
+  if (!output)
+    output = msr->datasamples;
+
   if (verbose > 2)
     ms_log (1, "%s: Unpacking %" PRId64 " samples\n", srcname, msr->samplecnt);
 
@@ -824,7 +962,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     nsamples = (int)msr->samplecnt;
     if (nsamples > 0)
     {
-      memcpy (msr->datasamples, dbuf, nsamples);
+      memcpy (output, dbuf, nsamples);
     }
     else
     {
@@ -838,7 +976,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking INT16 data samples\n", srcname);
 
     nsamples = msr_decode_int16 ((int16_t *)dbuf, (int)msr->samplecnt,
-                                 msr->datasamples, unpacksize, swapflag);
+                                 output, unpacksize, swapflag);
 
     msr->sampletype = 'i';
     break;
@@ -848,7 +986,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking INT32 data samples\n", srcname);
 
     nsamples = msr_decode_int32 ((int32_t *)dbuf, (int)msr->samplecnt,
-                                 msr->datasamples, unpacksize, swapflag);
+                                 output, unpacksize, swapflag);
 
     msr->sampletype = 'i';
     break;
@@ -858,7 +996,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking FLOAT32 data samples\n", srcname);
 
     nsamples = msr_decode_float32 ((float *)dbuf, (int)msr->samplecnt,
-                                   msr->datasamples, unpacksize, swapflag);
+                                   output, unpacksize, swapflag);
 
     msr->sampletype = 'f';
     break;
@@ -868,7 +1006,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking FLOAT64 data samples\n", srcname);
 
     nsamples = msr_decode_float64 ((double *)dbuf, (int)msr->samplecnt,
-                                   msr->datasamples, unpacksize, swapflag);
+                                   output, unpacksize, swapflag);
 
     msr->sampletype = 'd';
     break;
@@ -878,7 +1016,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking Steim1 data frames\n", srcname);
 
     nsamples = msr_decode_steim1 ((int32_t *)dbuf, datasize, (int)msr->samplecnt,
-                                  msr->datasamples, unpacksize, srcname, swapflag);
+                                  output, unpacksize, srcname, swapflag);
 
     if (nsamples < 0)
       return MS_GENERROR;
@@ -891,7 +1029,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
       ms_log (1, "%s: Unpacking Steim2 data frames\n", srcname);
 
     nsamples = msr_decode_steim2 ((int32_t *)dbuf, datasize, (int)msr->samplecnt,
-                                  msr->datasamples, unpacksize, srcname, swapflag);
+                                  output, unpacksize, srcname, swapflag);
 
     if (nsamples < 0)
       return MS_GENERROR;
@@ -915,7 +1053,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
                 srcname);
     }
 
-    nsamples = msr_decode_geoscope ((char *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_geoscope ((char *)dbuf, (int)msr->samplecnt, output,
                                     unpacksize, msr->encoding, srcname, swapflag);
 
     msr->sampletype = 'f';
@@ -925,7 +1063,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     if (verbose > 1)
       ms_log (1, "%s: Unpacking CDSN encoded data samples\n", srcname);
 
-    nsamples = msr_decode_cdsn ((int16_t *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_cdsn ((int16_t *)dbuf, (int)msr->samplecnt, output,
                                 unpacksize, swapflag);
 
     msr->sampletype = 'i';
@@ -935,7 +1073,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     if (verbose > 1)
       ms_log (1, "%s: Unpacking SRO encoded data samples\n", srcname);
 
-    nsamples = msr_decode_sro ((int16_t *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_sro ((int16_t *)dbuf, (int)msr->samplecnt, output,
                                unpacksize, srcname, swapflag);
 
     msr->sampletype = 'i';
@@ -945,7 +1083,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
     if (verbose > 1)
       ms_log (1, "%s: Unpacking DWWSSN encoded data samples\n", srcname);
 
-    nsamples = msr_decode_dwwssn ((int16_t *)dbuf, (int)msr->samplecnt, msr->datasamples,
+    nsamples = msr_decode_dwwssn ((int16_t *)dbuf, (int)msr->samplecnt, output,
                                   unpacksize, swapflag);
 
     msr->sampletype = 'i';
@@ -966,7 +1104,7 @@ msr_unpack_data (MSRecord *msr, int swapflag, flag verbose)
   }
 
   return nsamples;
-} /* End of msr_unpack_data() */
+} /* End of unpack_data() */
 
 /************************************************************************
  *  check_environment:
@@ -3,7 +3,7 @@
  * STEIM2, GEOSCOPE (24bit and gain ranged), CDSN, SRO and DWWSSN
  * encoded data.
  *
- * modified: 2017.283
+ * modified: 2026.287
  ************************************************************************/
 
 #include <memory.h>
@@ -24,6 +24,88 @@ int decodedebug = 0;
 #define MAX16 0x7FFFul   /* maximum 16 bit positive # */
 #define MAX24 0x7FFFFFul /* maximum 24 bit positive # */
 
+/* Vectorized Steim decoding for little-endian x86 and ARM64 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define STEIM_X86 1
+  #include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #define STEIM_NEON 1
+  #include <arm_neon.h>
+#endif
+
+#if defined(STEIM_X86) || defined(STEIM_NEON)
+  #define STEIM_VECTOR 1
+
+/* Vector implementations */
+  #define STEIM_SSE41 1
+  #define STEIM_AVX2 2
+  #define STEIM_NEONV 3
+
+/* Difference word types, the packing of differences in a 32-bit word */
+  #define STEIM_4X8 0
+  #define STEIM_2X16 1
+  #define STEIM_1X32 2
+  #define STEIM_1X30 3
+  #define STEIM_2X15 4
+  #define STEIM_3X10 5
+  #define STEIM_5X6 6
+  #define STEIM_6X5 7
+  #define STEIM_7X4 8
+  #define STEIM_NONE 9   /* No differences, special word */
+  #define STEIM_ERROR 10 /* Undefined Steim2 dnib */
+
+/* Word type for Steim1 and Steim2 by nibble and dnib (nibble * 4 + dnib) */
+static const uint8_t steimtypes[2][16] = {
+    {STEIM_NONE, STEIM_NONE, STEIM_NONE, STEIM_NONE, STEIM_4X8, STEIM_4X8, STEIM_4X8, STEIM_4X8,
+     STEIM_2X16, STEIM_2X16, STEIM_2X16, STEIM_2X16, STEIM_1X32, STEIM_1X32, STEIM_1X32, STEIM_1X32},
+    {STEIM_NONE, STEIM_NONE, STEIM_NONE, STEIM_NONE, STEIM_4X8, STEIM_4X8, STEIM_4X8, STEIM_4X8,
+     STEIM_ERROR, STEIM_1X30, STEIM_2X15, STEIM_3X10, STEIM_5X6, STEIM_6X5, STEIM_7X4, STEIM_ERROR}};
+
+/* Number of differences for each word type */
+static const int steimcount[9] = {4, 2, 1, 1, 2, 3, 5, 6, 7};
+
+/* Difference extraction for each word type from a word in host
+ * order: shifting left by the steimlshift[] value of a lane places a
+ * difference in the highest bits and an arithmetic shift right by
+ * steimrshift sign extends it.  The byte and 16-bit differences of
+ * byte swapped data are in reverse order in the word, the table is
+ * selected by swapflag. */
+  #define STEIM_LSHIFTS(F)                                               \
+    {{{F (24), F (16), F (8), F (0)}, {F (16), F (0)}, {F (0)}, {F (2)}, \
+      {F (2), F (17)}, {F (2), F (12), F (22)},                          \
+      {F (2), F (8), F (14), F (20), F (26)},                            \
+      {F (2), F (7), F (12), F (17), F (22), F (27)},                    \
+      {F (4), F (8), F (12), F (16), F (20), F (24), F (28)}},           \
+     {{F (0), F (8), F (16), F (24)}, {F (0), F (16)}, {F (0)}, {F (2)}, \
+      {F (2), F (17)}, {F (2), F (12), F (22)},                          \
+      {F (2), F (8), F (14), F (20), F (26)},                            \
+      {F (2), F (7), F (12), F (17), F (22), F (27)},                    \
+      {F (4), F (8), F (12), F (16), F (20), F (24), F (28)}}}
+  #define STEIM_SHIFT(X) (X)
+  #define STEIM_MULTIPLIER(X) (1u << (X))
+
+static const int32_t steimlshift[2][9][8] = STEIM_LSHIFTS (STEIM_SHIFT);
+static const int32_t steimrshift[9]       = {24, 16, 0, 2, 17, 22, 26, 27, 28};
+
+  #if defined(STEIM_X86)
+/* Left shifts as multipliers, SSE4.1 has no variable shift */
+static const uint32_t steimlmul[2][9][8] = STEIM_LSHIFTS (STEIM_MULTIPLIER);
+  #endif
+
+/* Byte shuffles broadcasting each 32-bit lane of a vector */
+static const uint8_t steimbcast[4][16] = {
+    {0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3},
+    {4, 5, 6, 7, 4, 5, 6, 7, 4, 5, 6, 7, 4, 5, 6, 7},
+    {8, 9, 10, 11, 8, 9, 10, 11, 8, 9, 10, 11, 8, 9, 10, 11},
+    {12, 13, 14, 15, 12, 13, 14, 15, 12, 13, 14, 15, 12, 13, 14, 15}};
+
+static int steim_vectortype (void);
+static int msr_decode_steim_vector (int32_t *input, int inputlength, int samplecount,
+                                    int32_t *output, char *srcname, int swapflag,
+                                    int steimtype, int vectortype);
+#endif /* STEIM_X86 || STEIM_NEON */
+
 /************************************************************************
  * msr_decode_int16:
  *
@@ -192,6 +274,9 @@ msr_decode_steim1 (int32_t *input, int inputlength, int samplecount,
   int widx;
   int diffcount;
   int idx;
+#if defined(STEIM_VECTOR)
+  int vectortype;
+#endif
 
   union dword {
     int8_t d8[4];
@@ -208,6 +293,11 @@ msr_decode_steim1 (int32_t *input, int inputlength, int samplecount,
   if (decodedebug)
     ms_log (1, "Decoding %d Steim1 frames, swapflag: %d, srcname: %s\n",
             maxframes, swapflag, (srcname) ? srcname : "");
+#if defined(STEIM_VECTOR)
+  else if ((vectortype = steim_vectortype ()))
+    return msr_decode_steim_vector (input, inputlength, samplecount, output,
+                                    srcname, swapflag, 1, vectortype);
+#endif
 
   for (frameidx = 0; frameidx < maxframes && samplecount > 0; frameidx++)
   {
@@ -348,6 +438,9 @@ msr_decode_steim2 (int32_t *input, int inputlength, int samplecount,
   int diffcount;
   int dnib;
   int idx;
+#if defined(STEIM_VECTOR)
+  int vectortype;
+#endif
 
   union dword {
     int8_t d8[4];
@@ -363,6 +456,11 @@ msr_decode_steim2 (int32_t *input, int inputlength, int samplecount,
   if (decodedebug)
     ms_log (1, "Decoding %d Steim2 frames, swapflag: %d, srcname: %s\n",
             maxframes, swapflag, (srcname) ? srcname : "");
+#if defined(STEIM_VECTOR)
+  else if ((vectortype = steim_vectortype ()))
+    return msr_decode_steim_vector (input, inputlength, samplecount, output,
+                                    srcname, swapflag, 2, vectortype);
+#endif
 
   for (frameidx = 0; frameidx < maxframes && samplecount > 0; frameidx++)
   {
@@ -563,6 +661,520 @@ msr_decode_steim2 (int32_t *input, int inputlength, int samplecount,
   return (outputptr - output);
 } /* End of msr_decode_steim2() */
 
+#if defined(STEIM_VECTOR)
+/************************************************************************
+ * Vectorized Steim decoding
+ *
+ * Each frame is byte swapped as 32-bit words and the words containing
+ * differences are identified from the nibbles.  For each word the
+ * differences are extracted into the lanes of a vector with shifts
+ * from the tables above and integrated with a prefix sum of the lanes
+ * plus the previous sample.  The integration starts from X0 minus the
+ * first difference, so the first sample is X0.
+ *
+ * The results, including the integrity check and error conditions,
+ * are identical to the scalar decoders, which are used when debugging
+ * output is requested.
+ ************************************************************************/
+
+  #if defined(STEIM_X86)
+__attribute__ ((target ("sse4.1"))) static int
+steim_frame_sse41 (const uint32_t *words, const uint8_t *types, int wordcount,
+                   int swapflag, int32_t *output, int samplecount, int32_t *last)
+{
+  int32_t stage[8];
+  __m128i carry = _mm_set1_epi32 (*last);
+  __m128i total;
+  __m128i value;
+  __m128i rshift;
+  __m128i low;
+  __m128i high;
+  int outcount = 0;
+  int count;
+  int idx;
+
+  for (idx = 0; idx < wordcount; idx++)
+  {
+    count = steimcount[types[idx]];
+
+    /* Extract and sign extend differences, lanes 0-3 and 4-7 */
+    value  = _mm_set1_epi32 ((int32_t)words[idx]);
+    rshift = _mm_cvtsi32_si128 (steimrshift[types[idx]]);
+    low    = _mm_mullo_epi32 (value, _mm_loadu_si128 ((const __m128i *)steimlmul[swapflag][types[idx]]));
+    high   = _mm_mullo_epi32 (value, _mm_loadu_si128 ((const __m128i *)(steimlmul[swapflag][types[idx]] + 4)));
+    low    = _mm_sra_epi32 (low, rshift);
+    high   = _mm_sra_epi32 (high, rshift);
+
+    /* Prefix sum of differences plus previous sample */
+    low  = _mm_add_epi32 (low, _mm_slli_si128 (low, 4));
+    low  = _mm_add_epi32 (low, _mm_slli_si128 (low, 8));
+    high = _mm_add_epi32 (high, _mm_slli_si128 (high, 4));
+    high = _mm_add_epi32 (high, _mm_slli_si128 (high, 8));
+    high = _mm_add_epi32 (high, _mm_shuffle_epi32 (low, _MM_SHUFFLE (3, 3, 3, 3)));
+
+    /* Sum of differences of this word, keeping it out of the dependency on carry */
+    total = _mm_shuffle_epi8 ((count > 4) ? high : low,
+                              _mm_loadu_si128 ((const __m128i *)steimbcast[(count - 1) & 3]));
+    low   = _mm_add_epi32 (low, carry);
+    high  = _mm_add_epi32 (high, carry);
+
+    if ((samplecount - outcount) >= 8)
+    {
+      _mm_storeu_si128 ((__m128i *)(output + outcount), low);
+      _mm_storeu_si128 ((__m128i *)(output + outcount + 4), high);
+    }
+    else
+    {
+      _mm_storeu_si128 ((__m128i *)stage, low);
+      _mm_storeu_si128 ((__m128i *)(stage + 4), high);
+      memcpy (output + outcount, stage,
+              ((count < samplecount - outcount) ? count : samplecount - outcount) * sizeof (int32_t));
+    }
+
+    carry = _mm_add_epi32 (carry, total);
+
+    outcount += count;
+  }
+
+  *last = _mm_cvtsi128_si32 (carry);
+
+  return (outcount < samplecount) ? outcount : samplecount;
+}
+
+__attribute__ ((target ("avx2"))) static int
+steim_frame_avx2 (const uint32_t *words, const uint8_t *types, int wordcount,
+                  int swapflag, int32_t *output, int samplecount, int32_t *last)
+{
+  int32_t stage[8];
+  __m256i carry = _mm256_set1_epi32 (*last);
+  __m256i total;
+  __m256i value;
+  int outcount = 0;
+  int count;
+  int idx;
+
+  for (idx = 0; idx < wordcount; idx++)
+  {
+    count = steimcount[types[idx]];
+
+    /* Extract and sign extend differences */
+    value = _mm256_sllv_epi32 (_mm256_set1_epi32 ((int32_t)words[idx]),
+                               _mm256_loadu_si256 ((const __m256i *)steimlshift[swapflag][types[idx]]));
+    value = _mm256_sra_epi32 (value, _mm_cvtsi32_si128 (steimrshift[types[idx]]));
+
+    /* Prefix sum within 128-bit lanes, add low lane total to high lane, add previous sample */
+    value = _mm256_add_epi32 (value, _mm256_slli_si256 (value, 4));
+    value = _mm256_add_epi32 (value, _mm256_slli_si256 (value, 8));
+    value = _mm256_add_epi32 (value, _mm256_permute2x128_si256 (_mm256_shuffle_epi32 (value, 0xFF),
+                                                                value, 0x08));
+
+    /* Sum of differences of this word, keeping it out of the dependency on carry */
+    total = _mm256_permutevar8x32_epi32 (value, _mm256_set1_epi32 (count - 1));
+    value = _mm256_add_epi32 (value, carry);
+
+    if ((samplecount - outcount) >= 8)
+    {
+      _mm256_storeu_si256 ((__m256i *)(output + outcount), value);
+    }
+    else
+    {
+      _mm256_storeu_si256 ((__m256i *)stage, value);
+      memcpy (output + outcount, stage,
+              ((count < samplecount - outcount) ? count : samplecount - outcount) * sizeof (int32_t));
+    }
+
+    carry = _mm256_add_epi32 (carry, total);
+
+    outcount += count;
+  }
+
+  *last = _mm256_cvtsi256_si32 (carry);
+
+  return (outcount < samplecount) ? outcount : samplecount;
+}
+
+__attribute__ ((target ("sse4.1"))) static int
+steim_bytes_sse41 (const int8_t *bytes, int bytecount, int32_t *output, int samplecount,
+                   int32_t *last)
+{
+  int32_t stage[4];
+  int32_t packed;
+  __m128i carry = _mm_set1_epi32 (*last);
+  __m128i value;
+  int outcount;
+
+  if (samplecount > bytecount)
+    samplecount = bytecount;
+
+  for (outcount = 0; outcount < samplecount; outcount += 4)
+  {
+    memcpy (&packed, bytes + outcount, sizeof (packed));
+    value = _mm_cvtepi8_epi32 (_mm_cvtsi32_si128 (packed));
+
+    value = _mm_add_epi32 (value, _mm_slli_si128 (value, 4));
+    value = _mm_add_epi32 (value, _mm_slli_si128 (value, 8));
+
+    if ((samplecount - outcount) >= 4)
+    {
+      _mm_storeu_si128 ((__m128i *)(output + outcount), _mm_add_epi32 (value, carry));
+    }
+    else
+    {
+      _mm_storeu_si128 ((__m128i *)stage, _mm_add_epi32 (value, carry));
+      memcpy (output + outcount, stage, (samplecount - outcount) * sizeof (int32_t));
+    }
+
+    carry = _mm_add_epi32 (carry, _mm_shuffle_epi32 (value, _MM_SHUFFLE (3, 3, 3, 3)));
+  }
+
+  *last = _mm_cvtsi128_si32 (carry);
+
+  return samplecount;
+}
+
+__attribute__ ((target ("avx2"))) static int
+steim_bytes_avx2 (const int8_t *bytes, int bytecount, int32_t *output, int samplecount,
+                  int32_t *last)
+{
+  int32_t stage[8];
+  int32_t packed;
+  __m256i carry = _mm256_set1_epi32 (*last);
+  __m256i value;
+  int outcount;
+
+  if (samplecount > bytecount)
+    samplecount = bytecount;
+
+  for (outcount = 0; outcount < samplecount; outcount += 8)
+  {
+    /* Byte counts are a multiple of 4, the upper lanes are zero for the last 4 */
+    if ((bytecount - outcount) >= 8)
+    {
+      value = _mm256_cvtepi8_epi32 (_mm_loadl_epi64 ((const __m128i *)(bytes + outcount)));
+    }
+    else
+    {
+      memcpy (&packed, bytes + outcount, sizeof (packed));
+      value = _mm256_cvtepi8_epi32 (_mm_cvtsi32_si128 (packed));
+    }
+
+    value = _mm256_add_epi32 (value, _mm256_slli_si256 (value, 4));
+    value = _mm256_add_epi32 (value, _mm256_slli_si256 (value, 8));
+    value = _mm256_add_epi32 (value, _mm256_permute2x128_si256 (_mm256_shuffle_epi32 (value, 0xFF),
+                                                                value, 0x08));
+
+    if ((samplecount - outcount) >= 8)
+    {
+      _mm256_storeu_si256 ((__m256i *)(output + outcount), _mm256_add_epi32 (value, carry));
+    }
+    else
+    {
+      _mm256_storeu_si256 ((__m256i *)stage, _mm256_add_epi32 (value, carry));
+      memcpy (output + outcount, stage, (samplecount - outcount) * sizeof (int32_t));
+    }
+
+    carry = _mm256_add_epi32 (carry, _mm256_permutevar8x32_epi32 (value, _mm256_set1_epi32 (7)));
+  }
+
+  *last = _mm256_cvtsi256_si32 (carry);
+
+  return samplecount;
+}
+  #endif /* STEIM_X86 */
+
+  #if defined(STEIM_NEON)
+static int
+steim_frame_neon (const uint32_t *words, const uint8_t *types, int wordcount,
+                  int swapflag, int32_t *output, int samplecount, int32_t *last)
+{
+  const int32x4_t zero = vdupq_n_s32 (0);
+  int32_t stage[8];
+  int32x4_t carry = vdupq_n_s32 (*last);
+  int32x4_t total;
+  uint32x4_t value;
+  int32x4_t rshift;
+  int32x4_t low;
+  int32x4_t high;
+  int outcount = 0;
+  int count;
+  int idx;
+
+  for (idx = 0; idx < wordcount; idx++)
+  {
+    count = steimcount[types[idx]];
+
+    /* Extract and sign extend differences, shifting right with a negative count */
+    value  = vdupq_n_u32 (words[idx]);
+    rshift = vdupq_n_s32 (-steimrshift[types[idx]]);
+    low    = vreinterpretq_s32_u32 (vshlq_u32 (value, vld1q_s32 (steimlshift[swapflag][types[idx]])));
+    high   = vreinterpretq_s32_u32 (vshlq_u32 (value, vld1q_s32 (steimlshift[swapflag][types[idx]] + 4)));
+    low    = vshlq_s32 (low, rshift);
+    high   = vshlq_s32 (high, rshift);
+
+    /* Prefix sum of differences plus previous sample */
+    low  = vaddq_s32 (low, vextq_s32 (zero, low, 3));
+    low  = vaddq_s32 (low, vextq_s32 (zero, low, 2));
+    high = vaddq_s32 (high, vextq_s32 (zero, high, 3));
+    high = vaddq_s32 (high, vextq_s32 (zero, high, 2));
+    high = vaddq_s32 (high, vdupq_laneq_s32 (low, 3));
+
+    /* Sum of differences of this word, keeping it out of the dependency on carry */
+    total = vreinterpretq_s32_u8 (vqtbl1q_u8 (vreinterpretq_u8_s32 ((count > 4) ? high : low),
+                                              vld1q_u8 (steimbcast[(count - 1) & 3])));
+    low   = vaddq_s32 (low, carry);
+    high  = vaddq_s32 (high, carry);
+
+    if ((samplecount - outcount) >= 8)
+    {
+      vst1q_s32 (output + outcount, low);
+      vst1q_s32 (output + outcount + 4, high);
+    }
+    else
+    {
+      vst1q_s32 (stage, low);
+      vst1q_s32 (stage + 4, high);
+      memcpy (output + outcount, stage,
+              ((count < samplecount - outcount) ? count : samplecount - outcount) * sizeof (int32_t));
+    }
+
+    carry = vaddq_s32 (carry, total);
+
+    outcount += count;
+  }
+
+  *last = vgetq_lane_s32 (carry, 0);
+
+  return (outcount < samplecount) ? outcount : samplecount;
+}
+
+static int
+steim_bytes_neon (const int8_t *bytes, int bytecount, int32_t *output, int samplecount,
+                  int32_t *last)
+{
+  const int32x4_t zero = vdupq_n_s32 (0);
+  int32_t stage[4];
+  int32_t packed;
+  int32x4_t carry = vdupq_n_s32 (*last);
+  int32x4_t value;
+  int outcount;
+
+  if (samplecount > bytecount)
+    samplecount = bytecount;
+
+  for (outcount = 0; outcount < samplecount; outcount += 4)
+  {
+    memcpy (&packed, bytes + outcount, sizeof (packed));
+    value = vmovl_s16 (vget_low_s16 (vmovl_s8 (vreinterpret_s8_s32 (vdup_n_s32 (packed)))));
+
+    value = vaddq_s32 (value, vextq_s32 (zero, value, 3));
+    value = vaddq_s32 (value, vextq_s32 (zero, value, 2));
+
+    if ((samplecount - outcount) >= 4)
+    {
+      vst1q_s32 (output + outcount, vaddq_s32 (value, carry));
+    }
+    else
+    {
+      vst1q_s32 (stage, vaddq_s32 (value, carry));
+      memcpy (output + outcount, stage, (samplecount - outcount) * sizeof (int32_t));
+    }
+
+    carry = vaddq_s32 (carry, vdupq_laneq_s32 (value, 3));
+  }
+
+  *last = vgetq_lane_s32 (carry, 0);
+
+  return samplecount;
+}
+  #endif /* STEIM_NEON */
+
+/************************************************************************
+ * steim_vectortype:
+ *
+ * Determine the vector implementation supported by the CPU.
+ *
+ * Return the vector implementation or 0 if none is supported.
+ ************************************************************************/
+static int
+steim_vectortype (void)
+{
+  #if defined(STEIM_X86)
+  if (__builtin_cpu_supports ("avx2"))
+    return STEIM_AVX2;
+  if (__builtin_cpu_supports ("sse4.1"))
+    return STEIM_SSE41;
+
+  return 0;
+  #else
+  return STEIM_NEONV;
+  #endif
+} /* End of steim_vectortype() */
+
+/************************************************************************
+ * msr_decode_steim_vector:
+ *
+ * Decode Steim1 or Steim2 encoded miniSEED data using the specified
+ * vector implementation and place in supplied buffer as 32-bit
+ * integers.
+ *
+ * Return number of samples in output buffer on success, -1 on error.
+ ************************************************************************/
+static int
+msr_decode_steim_vector (int32_t *input, int inputlength, int samplecount,
+                         int32_t *output, char *srcname, int swapflag,
+                         int steimtype, int vectortype)
+{
+  int32_t *outputptr = output; /* Pointer to next output sample location */
+  uint32_t frame[16];          /* Frame, 16 x 32-bit quantities = 64 bytes */
+  uint8_t types[16];           /* Difference word types */
+  int8_t *bytes;               /* Differences of a frame of 1-byte differences */
+  uint32_t nibblemask;
+  int32_t X0    = 0;           /* Forward integration constant, aka first sample */
+  int32_t Xn    = 0;           /* Reverse integration constant, aka last sample */
+  int32_t last  = 0;           /* Last sample, integration start */
+  int32_t first;
+  int maxframes = inputlength / 64;
+  int frameidx;
+  int nibble;
+  int startidx;
+  int widx;
+  int wordcount;
+  int bytewords;
+  int diffcount;
+  uint8_t type;
+
+  #if defined(STEIM_NEON)
+  (void)vectortype; /* Single implementation */
+  #endif
+
+  swapflag = (swapflag) ? 1 : 0;
+
+  for (frameidx = 0; frameidx < maxframes && samplecount > 0; frameidx++)
+  {
+    /* Copy frame, each is 16x32-bit quantities = 64 bytes */
+    memcpy (frame, input + (16 * frameidx), 64);
+
+    if (swapflag)
+      ms_gswap4a (&frame[0]);
+
+    /* Save integration constants from first frame, skip nibbles, X0, and Xn */
+    if (frameidx == 0)
+    {
+      if (swapflag)
+      {
+        ms_gswap4a (&frame[1]);
+        ms_gswap4a (&frame[2]);
+      }
+
+      X0       = frame[1];
+      Xn       = frame[2];
+      startidx = 3;
+    }
+    else
+    {
+      startidx = 1;
+    }
+
+    bytes = (int8_t *)(input + (16 * frameidx) + startidx);
+
+    /* Frames of only 1-byte differences are common, test all nibbles at once */
+    nibblemask = 0x3FFFFFFFu >> (2 * (startidx - 1));
+
+    if ((frame[0] & nibblemask) == (0x55555555u & nibblemask))
+    {
+      wordcount = bytewords = 16 - startidx;
+      diffcount = 4 * wordcount;
+      widx      = 16;
+    }
+    else
+    {
+      if (swapflag)
+        for (widx = startidx; widx < 16; widx++)
+          ms_gswap4a (&frame[widx]);
+
+      /* Identify words with differences until enough for the requested
+       * samples, the words are moved to the front of the frame */
+      for (widx = startidx, wordcount = 0, bytewords = 0, diffcount = 0;
+           widx < 16 && diffcount < samplecount; widx++)
+      {
+        nibble = EXTRACTBITRANGE (frame[0], (30 - (2 * widx)), 2);
+        type   = steimtypes[steimtype - 1][nibble * 4 + EXTRACTBITRANGE (frame[widx], 30, 2)];
+
+        if (type == STEIM_NONE)
+          continue;
+
+        if (type == STEIM_ERROR)
+        {
+          if (nibble == 2)
+            ms_log (2, "%s: Impossible Steim2 dnib=00 for nibble=10\n", srcname);
+          else
+            ms_log (2, "%s: Impossible Steim2 dnib=11 for nibble=11\n", srcname);
+
+          return -1;
+        }
+
+        types[wordcount] = type;
+        bytewords += (type == STEIM_4X8);
+        diffcount += steimcount[type];
+        frame[1 + wordcount++] = frame[widx];
+      }
+
+      if (wordcount == 0)
+        continue;
+    }
+
+    /* Decode contiguous words of 1-byte differences directly from the input */
+    if (bytewords == wordcount && wordcount == (widx - startidx))
+    {
+      /* Ignore first difference, start integration so the first sample is X0 */
+      if (outputptr == output)
+        last = (int32_t) ((uint32_t)X0 - (uint32_t)bytes[0]);
+
+  #if defined(STEIM_X86)
+      if (vectortype == STEIM_AVX2)
+        diffcount = steim_bytes_avx2 (bytes, diffcount, outputptr, samplecount, &last);
+      else
+        diffcount = steim_bytes_sse41 (bytes, diffcount, outputptr, samplecount, &last);
+  #else
+      diffcount = steim_bytes_neon (bytes, diffcount, outputptr, samplecount, &last);
+  #endif
+    }
+    else
+    {
+      if (outputptr == output)
+      {
+        first = (int32_t) (frame[1] << steimlshift[swapflag][types[0]][0]) >> steimrshift[types[0]];
+        last  = (int32_t) ((uint32_t)X0 - (uint32_t)first);
+      }
+
+  #if defined(STEIM_X86)
+      if (vectortype == STEIM_AVX2)
+        diffcount = steim_frame_avx2 (frame + 1, types, wordcount, swapflag,
+                                      outputptr, samplecount, &last);
+      else
+        diffcount = steim_frame_sse41 (frame + 1, types, wordcount, swapflag,
+                                       outputptr, samplecount, &last);
+  #else
+      diffcount = steim_frame_neon (frame + 1, types, wordcount, swapflag,
+                                    outputptr, samplecount, &last);
+  #endif
+    }
+
+    outputptr += diffcount;
+    samplecount -= diffcount;
+  } /* Done looping over frames */
+
+  /* Check data integrity by comparing last sample to Xn (reverse integration constant) */
+  if (outputptr != output && *(outputptr - 1) != Xn)
+  {
+    ms_log (1, "%s: Warning: Data integrity check for Steim%d failed, Last sample=%d, Xn=%d\n",
+            srcname, steimtype, *(outputptr - 1), Xn);
+  }
+
+  return (outputptr - output);
+} /* End of msr_decode_steim_vector() */
+#endif /* STEIM_VECTOR */
+
 /* Defines for GEOSCOPE encoding */
 #define GEOSCOPE_MANTISSA_MASK 0x0FFFul /* mask for mantissa */
 #define GEOSCOPE_GAIN3_MASK 0x7000ul    /* mask for gainrange factor */
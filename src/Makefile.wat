@@ -1,34 +1,45 @@
-#
-# THIS FILE IS DEPRECATED AND WILL BE REMOVED IN A FUTURE RELEASE
-#
-# Wmake File - for Watcom's wmake
-# Use 'wmake -f Makefile.wat'
-
-.BEFORE
-	@set INCLUDE=.;$(%watcom)\H;$(%watcom)\H\NT
-	@set LIB=.;$(%watcom)\LIB386
-
-cc     = wcc386
-cflags = -zq 
-lflags = OPT quiet OPT map LIBRARY ..\libmseed\libmseed.lib
-cvars  = $+$(cvars)$- -DWIN32 -DNOFDZIP
-
-BIN = ..\mseed2sac.exe
-
-INCS = -I..\libmseed
-
-all: $(BIN)
-
-$(BIN):	mseed2sac.obj
-	wlink $(lflags) name $(BIN) file {mseed2sac.obj}
-
-# Source dependencies:
-mseed2sac.obj:	mseed2sac.c sacformat.h
-
-# How to compile sources:
-.c.obj:
-	$(cc) $(cflags) $(cvars) $(INCS) $[@ -fo=$@
-
-# Clean-up directives:
-clean:	.SYMBOLIC
-	del *.obj *.map $(BIN)
+#
+# THIS FILE IS DEPRECATED AND WILL BE REMOVED IN A FUTURE RELEASE
+#
+# Wmake File - for Watcom's wmake
+# Use 'wmake -f Makefile.wat'
+
+.BEFORE
+	@set INCLUDE=.;$(%watcom)\H;$(%watcom)\H\NT
+	@set LIB=.;$(%watcom)\LIB386
+
+cc     = wcc386
+cflags = -zq 
+lflags = OPT quiet OPT map LIBRARY ..\libmseed\libmseed.lib
+cvars  = $+$(cvars)$- -DWIN32 -DNOFDZIP
+
+BIN = ..\mseed2sac.exe
+
+INCS = -I..\libmseed
+
+all: $(BIN)
+
+$(BIN):	mseed2sac.obj libmseed2sac.obj sampleconv.obj msindex.obj metacache.obj asyncout.obj sacbundle.obj stats.obj manifest.obj jsonout.obj sidecar.obj keytable.obj
+	wlink $(lflags) name $(BIN) file {mseed2sac.obj libmseed2sac.obj sampleconv.obj msindex.obj metacache.obj asyncout.obj sacbundle.obj stats.obj manifest.obj jsonout.obj sidecar.obj keytable.obj}
+
+# Source dependencies:
+mseed2sac.obj:	mseed2sac.c sacformat.h asyncout.h keytable.h libmseed2sac.h m2splatform.h manifest.h sampleconv.h metacache.h msindex.h sacbundle.h stats.h
+libmseed2sac.obj:	libmseed2sac.c libmseed2sac.h sacformat.h sampleconv.h
+sampleconv.obj:	sampleconv.c sampleconv.h
+msindex.obj:	msindex.c msindex.h keytable.h sidecar.h
+metacache.obj:	metacache.c metacache.h keytable.h sidecar.h
+asyncout.obj:	asyncout.c asyncout.h m2splatform.h
+sacbundle.obj:	sacbundle.c sacbundle.h
+stats.obj:	stats.c stats.h jsonout.h m2splatform.h
+manifest.obj:	manifest.c manifest.h jsonout.h m2splatform.h
+jsonout.obj:	jsonout.c jsonout.h
+sidecar.obj:	sidecar.c sidecar.h
+keytable.obj:	keytable.c keytable.h
+
+# How to compile sources:
+.c.obj:
+	$(cc) $(cflags) $(cvars) $(INCS) $[@ -fo=$@
+
+# Clean-up directives:
+clean:	.SYMBOLIC
+	del *.obj *.map $(BIN)
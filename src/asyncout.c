@@ -0,0 +1,366 @@
+/***************************************************************************
+ * asyncout.c
+ *
+ * Asynchronous output of complete files.
+ *
+ * Writing many small files is dominated by the latency of the write,
+ * sync and close calls for each file rather than by the amount of
+ * data.  Files opened by the caller are submitted with their complete
+ * contents in one buffer, output threads take queued files in batches
+ * and write, optionally sync and close each one, so the caller can
+ * continue preparing the next files.  An error writing a file is
+ * reported with the file name and counted, ao_finish() returns the
+ * number of files that failed.
+ *
+ * The amount of queued data is limited, ao_submit() blocks until
+ * there is room in the queue.  Without threads, or before ao_start()
+ * is called, files are written immediately by ao_submit().
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asyncout.h"
+#include "m2splatform.h"
+
+#if defined(WIN32) || defined(WIN64)
+#include <io.h>
+#define write _write
+#define close _close
+#else
+#include <unistd.h>
+#endif
+
+/* Number of files taken from the queue at a time by an output thread */
+#define AO_BATCH 32
+
+/* Limit of data queued for output */
+#define AO_MAXQUEUED 67108864
+
+struct aofile
+{
+  char *outfile;
+  int fd;
+  char *buffer;
+  size_t length;
+  struct aofile *next;
+};
+
+static int syncoutput = 0;
+static int aoverbose = 0;
+static int failures = 0;
+
+#ifndef NOPTHREADS
+static pthread_t *aothreads = 0;
+static int aothreadcount = 0;
+static pthread_mutex_t aolock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t aocond = PTHREAD_COND_INITIALIZER;
+static struct aofile *queuehead = 0;
+static struct aofile *queuetail = 0;
+static int queuedfiles = 0;
+static size_t queuedbytes = 0;
+static int exiting = 0;
+
+#define AO_LOCK() pthread_mutex_lock (&aolock)
+#define AO_UNLOCK() pthread_mutex_unlock (&aolock)
+
+static void *outputthread (void *arg);
+#else
+#define AO_LOCK()
+#define AO_UNLOCK()
+#endif
+
+static int writefile (struct aofile *file);
+
+/***************************************************************************
+ * ao_start:
+ *
+ * Start the pool of output threads, files are synced before closing
+ * if syncfiles is true.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ao_start (int threads, int syncfiles, int verbose)
+{
+#ifndef NOPTHREADS
+  int idx;
+  int rv;
+#endif
+
+  syncoutput = syncfiles;
+  aoverbose = verbose;
+
+#ifndef NOPTHREADS
+  if (threads <= 0)
+    return 0;
+
+  if ((aothreads = (pthread_t *)calloc (threads, sizeof (pthread_t))) == NULL)
+  {
+    fprintf (stderr, "ao_start(): Cannot allocate memory\n");
+    return -1;
+  }
+
+  for (idx = 0; idx < threads; idx++)
+  {
+    if ((rv = pthread_create (&aothreads[idx], NULL, outputthread, NULL)))
+    {
+      fprintf (stderr, "Cannot create output thread: %s\n", strerror (rv));
+      aothreadcount = idx;
+      ao_finish ();
+      return -1;
+    }
+  }
+
+  aothreadcount = threads;
+
+  if (verbose)
+    fprintf (stderr, "Started %d asynchronous output threads\n", aothreadcount);
+#endif
+
+  return 0;
+} /* End of ao_start() */
+
+/***************************************************************************
+ * ao_submit:
+ *
+ * Submit a file opened as fd with its complete contents in buffer for
+ * output.  The file descriptor and buffer, which must be allocated
+ * with malloc(), are owned by this module after the call and closed
+ * and freed when the file is written, also on error.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ao_submit (const char *outfile, int fd, void *buffer, size_t length)
+{
+  struct aofile *file;
+  int rv;
+
+  if ((file = (struct aofile *)calloc (1, sizeof (struct aofile))) == NULL ||
+      (file->outfile = strdup (outfile)) == NULL)
+  {
+    fprintf (stderr, "ao_submit(): Cannot allocate memory\n");
+    free (file);
+    close (fd);
+    free (buffer);
+    AO_LOCK ();
+    failures++;
+    AO_UNLOCK ();
+    return -1;
+  }
+
+  file->fd = fd;
+  file->buffer = (char *)buffer;
+  file->length = length;
+
+#ifndef NOPTHREADS
+  if (aothreads)
+  {
+    pthread_mutex_lock (&aolock);
+
+    while (queuedbytes > 0 && queuedbytes + length > AO_MAXQUEUED)
+      pthread_cond_wait (&aocond, &aolock);
+
+    if (queuetail)
+      queuetail->next = file;
+    else
+      queuehead = file;
+    queuetail = file;
+    queuedfiles++;
+    queuedbytes += length;
+
+    pthread_cond_broadcast (&aocond);
+    pthread_mutex_unlock (&aolock);
+
+    return 0;
+  }
+#endif
+
+  rv = writefile (file);
+
+  if (rv)
+    failures++;
+
+  return rv;
+} /* End of ao_submit() */
+
+/***************************************************************************
+ * ao_finish:
+ *
+ * Wait for all queued files to be written and stop the output
+ * threads.
+ *
+ * Returns the number of files that could not be written.
+ ***************************************************************************/
+int
+ao_finish (void)
+{
+#ifndef NOPTHREADS
+  int idx;
+
+  if (aothreads)
+  {
+    pthread_mutex_lock (&aolock);
+    exiting = 1;
+    pthread_cond_broadcast (&aocond);
+    pthread_mutex_unlock (&aolock);
+
+    for (idx = 0; idx < aothreadcount; idx++)
+      pthread_join (aothreads[idx], NULL);
+
+    free (aothreads);
+    aothreads = 0;
+    aothreadcount = 0;
+    exiting = 0;
+  }
+#endif
+
+  return failures;
+} /* End of ao_finish() */
+
+/***************************************************************************
+ * ao_syncfd:
+ *
+ * Flush the data written to a file descriptor to storage.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+ao_syncfd (int fd)
+{
+#if defined(WIN32) || defined(WIN64)
+  return _commit (fd);
+#else
+  return fsync (fd);
+#endif
+} /* End of ao_syncfd() */
+
+#ifndef NOPTHREADS
+/***************************************************************************
+ * outputthread:
+ *
+ * Output thread, take batches of files from the queue and write them
+ * until ao_finish() is called and the queue is empty.
+ ***************************************************************************/
+static void *
+outputthread (void *arg)
+{
+  struct aofile *batch;
+  struct aofile *file;
+  struct aofile *next;
+  size_t length;
+  int limit;
+  int count;
+  int failed;
+
+  pthread_mutex_lock (&aolock);
+
+  for (;;)
+  {
+    if (!queuehead)
+    {
+      if (exiting)
+        break;
+
+      pthread_cond_wait (&aocond, &aolock);
+      continue;
+    }
+
+    /* Take a batch of files from the head of the queue, sharing the
+     * queued files between the threads */
+    limit = (queuedfiles + aothreadcount - 1) / aothreadcount;
+    if (limit > AO_BATCH)
+      limit = AO_BATCH;
+
+    batch = queuehead;
+    for (file = batch, count = 1; file->next && count < limit; count++)
+      file = file->next;
+
+    queuehead = file->next;
+    if (!queuehead)
+      queuetail = 0;
+    file->next = 0;
+    queuedfiles -= count;
+
+    pthread_mutex_unlock (&aolock);
+
+    length = 0;
+    failed = 0;
+
+    for (file = batch; file; file = next)
+    {
+      next = file->next;
+      length += file->length;
+
+      if (writefile (file))
+        failed++;
+    }
+
+    pthread_mutex_lock (&aolock);
+
+    queuedbytes -= length;
+    failures += failed;
+
+    pthread_cond_broadcast (&aocond);
+  }
+
+  pthread_mutex_unlock (&aolock);
+
+  return NULL;
+} /* End of outputthread() */
+#endif /* NOPTHREADS */
+
+/***************************************************************************
+ * writefile:
+ *
+ * Write, optionally sync and close a file and free it.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+writefile (struct aofile *file)
+{
+  size_t written = 0;
+  int count;
+  int rv = 0;
+
+  while (written < file->length)
+  {
+    if ((count = (int)write (file->fd, file->buffer + written,
+                             (unsigned int)(file->length - written))) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    written += count;
+  }
+
+  if (written < file->length ||
+      (syncoutput && ao_syncfd (file->fd)))
+  {
+    fprintf (stderr, "Error writing output file %s: %s\n", file->outfile, strerror (errno));
+    close (file->fd);
+    rv = -1;
+  }
+  else if (close (file->fd))
+  {
+    fprintf (stderr, "Error closing output file %s: %s\n", file->outfile, strerror (errno));
+    rv = -1;
+  }
+  else if (aoverbose > 1)
+  {
+    fprintf (stderr, "Wrote output file %s\n", file->outfile);
+  }
+
+  free (file->outfile);
+  free (file->buffer);
+  free (file);
+
+  return rv;
+} /* End of writefile() */
@@ -0,0 +1,31 @@
+/***************************************************************************
+ * asyncout.h
+ *
+ * Asynchronous output of complete files, the contents of each file are
+ * queued in a single buffer and written, optionally synced and closed
+ * in batches by a pool of output threads.
+ ***************************************************************************/
+
+#ifndef ASYNCOUT_H
+#define ASYNCOUT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest file queued for asynchronous output, larger files should be
+ * written directly */
+#define AO_MAXFILE 4194304
+
+extern int ao_start (int threads, int syncfiles, int verbose);
+extern int ao_submit (const char *outfile, int fd, void *buffer, size_t length);
+extern int ao_finish (void);
+extern int ao_syncfd (int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ASYNCOUT_H */
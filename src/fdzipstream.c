@@ -8,6 +8,10 @@
  *
  * zlib is required for deflate compression: http://www.zlib.net/
  *
+ * Optional methods are included when compiled with FDZIP_LIBDEFLATE
+ * (deflate using libdeflate: https://github.com/ebiggers/libdeflate)
+ * and FDZIP_ZSTD (Zstandard, ZIP method 93: https://facebook.github.io/zstd/).
+ *
  * What this will do for you:
  *
  * - Create a ZIP archive in a streaming fashion, writing to an output
@@ -72,6 +76,19 @@
  *
  * These three functions must be registered, through zs_registermethod(),
  * with any ZIPstream that will use them.
+ *
+ * Method IDs above 0xFFFF identify alternate implementations of the
+ * ZIP method in the lower 16 bits, which is recorded in the archive.
+ * A method that calculates the CRC-32 of entry data itself should set
+ * ZS_METHOD_CRC32 in the flags of the registered ZIPmethod and set
+ * ZIPentry.CRC32 in its finish() callback.
+ *
+ * A parallel deflate method (ZS_PDEFLATE), compressing blocks of each
+ * entry concurrently, is registered with zs_registerpdeflate().
+ *
+ * A pipelined writer, writing archive data from a ring of buffers
+ * with a separate thread so that compression and output overlap, is
+ * registered with zs_registerwriter().
  ****
  * LICENSE
  *
@@ -89,197 +106,1313 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  *
- * Modified 2017.1.17
+ * Modified 2026.287
+ ***************************************************************************/
+
+/* Allow this code to be skipped by declaring NOFDZIP */
+#ifndef NOFDZIP
+
+#define FDZIPVERSION 2.1
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include <zlib.h>
+
+#include "fdzipstream.h"
+#include "m2splatform.h"
+
+#ifdef FDZIP_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#ifdef FDZIP_ZSTD
+#include <zstd.h>
+#endif
+
+#define BIT_SET(a,b) ((a) |= (1<<(b)))
+
+static int64_t zs_writedata ( ZIPstream *zstream, uint8_t *writeBuffer, int64_t writeBufferSize );
+static uint32_t zs_datetime_unixtodos ( time_t t );
+static void zs_packunit16 (ZIPstream *ZS, int *O, uint16_t V);
+static void zs_packunit32 (ZIPstream *ZS, int *O, uint32_t V);
+static void zs_packunit64 (ZIPstream *ZS, int *O, uint64_t V);
+
+
+/***************************************************************************
+ * zs_store_process:
+ *
+ * The process() callback for the STORE method.
+ *
+ * @return number of bytes ready for writing in writeBuffer or <0 on error.
+ ***************************************************************************/
+static int32_t
+zs_store_process ( ZIPstream *zstream, ZIPentry *zentry,
+                   uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
+                   uint8_t *writeBuffer, int64_t writeBufferSize )
+{
+  if ( ! entry || entrySize <= 0 )
+    return 0;
+
+  if ( entrySize < writeBufferSize )
+    {
+      writeBufferSize = entrySize;
+    }
+
+  memcpy ( writeBuffer, entry, writeBufferSize );
+
+  if ( entryConsumed )
+    {
+      *entryConsumed = writeBufferSize;
+    }
+
+  return writeBufferSize;
+}  /* End of zs_store_process() */
+
+
+/***************************************************************************
+ * zs_deflate_init:
+ *
+ * Initialization for the deflate method.
+ *
+ * @return 0 on sucess and non-zero on error.
+ ***************************************************************************/
+static int32_t
+zs_deflate_init ( ZIPstream *zstream, ZIPentry *zentry )
+{
+  z_stream *zlstream;
+
+  /* Allocate ZLIB stream entry and store at private method pointer */
+  zlstream = (z_stream *) calloc (1, sizeof(z_stream));
+  if ( ! zlstream )
+    {
+      fprintf (stderr, "Cannot allocate memory for z_stream\n");
+      return -1;
+    }
+  zentry->methoddata = zlstream;
+
+  /* Allocate deflate zlib stream state & initialize */
+  zlstream->zalloc = Z_NULL;
+  zlstream->zfree = Z_NULL;
+  zlstream->opaque = Z_NULL;
+  zlstream->total_in = 0;
+  zlstream->total_out = 0;
+  zlstream->data_type = Z_BINARY;
+
+  if ( deflateInit2 (zlstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK )
+    {
+      fprintf (stderr, "zs_deflate_init: Error with deflateInit2()\n");
+      return -1;
+    }
+
+  return 0;
+}
+
+
+/***************************************************************************
+ * zs_deflate_process:
+ *
+ * Process data for deflate method.
+ *
+ * @return number of bytes ready for writing in writeBuffer or <0 on error.
+ ***************************************************************************/
+static int32_t
+zs_deflate_process( ZIPstream *zstream, ZIPentry *zentry,
+                    uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
+                    uint8_t* writeBuffer, int64_t writeBufferSize )
+{
+  z_stream *zlstream;
+  int flush;
+  int rv;
+
+  if ( ! zstream || ! zentry )
+    return -1;
+
+  zlstream = zentry->methoddata;
+
+  if ( ! zlstream )
+    return -1;
+
+  zlstream->next_in = entry;
+  zlstream->avail_in = ( entry ) ? entrySize : 0;
+  zlstream->next_out = writeBuffer;
+  zlstream->avail_out = writeBufferSize;
+
+  flush = ( entry ) ? Z_NO_FLUSH : Z_FINISH;
+
+  rv = deflate ( zlstream, flush );
+
+  if ( ! (entry && rv == Z_OK) &&
+       ! (!entry && rv == Z_STREAM_END) )
+    {
+      fprintf (stderr, "zs_deflate_process: Error with deflate():\n");
+
+      if ( rv == Z_BUF_ERROR )
+        fprintf (stderr, "  ZLIB: Z_BUF_ERROR, No progress is possible; either avail_in or avail_out was zero\n");
+      else if ( rv == Z_MEM_ERROR )
+        fprintf (stderr, "  ZLIB: Z_MEM_ERROR, Insufficient memory\n");
+      else if ( rv == Z_STREAM_ERROR )
+        fprintf (stderr, "  ZLIB: Z_STREAM_ERROR, The stream state is inconsistent or stream was NULL\n");
+      else
+        fprintf (stderr, "  ZLIB: deflated returned %d\n", rv);
+
+      return -1;
+    }
+
+  if ( entry && entryConsumed )
+    {
+      *entryConsumed = entrySize - zlstream->avail_in;
+    }
+
+  /* Return number of bytes ready in writeBuffer */
+  return (writeBufferSize - zlstream->avail_out);
+}
+
+
+/***************************************************************************
+ * zs_deflate_finish:
+ *
+ * Closeout for deflate method.
+ *
+ * @return 0 on success and non-zero on error.
+ ***************************************************************************/
+static int32_t
+zs_deflate_finish ( ZIPstream *zstream, ZIPentry *zentry )
+{
+  z_stream *zlstream = zentry->methoddata;
+  int rv;
+  int rc = 0;
+
+  rv = deflateEnd (zlstream);
+
+  if ( rv == Z_DATA_ERROR )
+    {
+      fprintf (stderr, "zs_deflate_finish: Deflate ended, but output buffers not flushed!\n");
+      rc = -1;
+    }
+  else if ( rv == Z_STREAM_ERROR )
+    {
+      fprintf (stderr, "zs:deflate_finish: deflateEnd() returned error.\n");
+      rc = -1;
+    }
+
+  free (zlstream);
+
+  return rc;
+}
+
+
+#ifndef NOPTHREADS
+/***************************************************************************
+ * Parallel deflate method
+ *
+ * Entry data is divided into blocks of ZS_PDEFLATE_BLOCK bytes that
+ * are compressed concurrently by a set of worker threads, each block
+ * is primed with the last 32KB of the preceding block as a dictionary
+ * and ended with a Z_SYNC_FLUSH so the compressed blocks can be
+ * concatenated into a single raw deflate stream.  The CRC-32 of each
+ * block is calculated by the workers and combined in order with
+ * crc32_combine().
+ *
+ * Worker threads are started as blocks are submitted, entries that
+ * fit into a single block are compressed by the calling thread.
+ ***************************************************************************/
+
+/* Size of dictionary carried between blocks, the deflate window size */
+#define ZS_PDEFLATE_DICT 32768
+
+/* A block of entry data for parallel deflate */
+typedef struct pdblock_s
+{
+  uint8_t *input;                /* Dictionary followed by block data */
+  int64_t dictSize;
+  int64_t size;                  /* Size of block data */
+  uint8_t *output;
+  int64_t outputSize;
+  int64_t outputSent;
+  uint32_t CRC32;
+  int last;                      /* Last block of entry */
+  int state;                     /* 0=queued, 1=compressing, 2=done, -1=error */
+  struct pdblock_s *next;
+} PDblock;
+
+/* Parallel deflate state for an entry */
+typedef struct pdeflate_s
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t *tids;
+  int threads;                   /* Maximum number of worker threads */
+  int started;                   /* Number of worker threads started */
+  int exit;                      /* Flag for worker threads to exit */
+  int finished;                  /* Last block has been submitted */
+  int outstanding;               /* Count of blocks not yet written */
+  PDblock *head;                 /* Oldest block not yet written */
+  PDblock *tail;                 /* Newest submitted block */
+  PDblock *queue;                /* Next block to compress */
+  PDblock *current;              /* Block being filled */
+  uint32_t CRC32;
+} PDeflate;
+
+
+/***************************************************************************
+ * zs_pdeflate_newblock:
+ *
+ * Allocate a new block, priming the dictionary with the end of the
+ * data of the previous block if specified.
+ *
+ * @return a pointer to a PDblock struct on success or NULL on error.
+ ***************************************************************************/
+static PDblock *
+zs_pdeflate_newblock ( PDblock *previous )
+{
+  PDblock *block;
+
+  block = (PDblock *) calloc (1, sizeof(PDblock));
+  if ( block )
+    block->input = (uint8_t *) malloc (ZS_PDEFLATE_DICT + ZS_PDEFLATE_BLOCK);
+
+  if ( ! block || ! block->input )
+    {
+      fprintf (stderr, "Cannot allocate memory for deflate block\n");
+      free (block);
+      return NULL;
+    }
+
+  if ( previous )
+    {
+      block->dictSize = ( previous->size < ZS_PDEFLATE_DICT ) ? previous->size : ZS_PDEFLATE_DICT;
+      memcpy (block->input,
+              previous->input + previous->dictSize + previous->size - block->dictSize,
+              block->dictSize);
+    }
+
+  return block;
+}  /* End of zs_pdeflate_newblock() */
+
+
+/***************************************************************************
+ * zs_pdeflate_block:
+ *
+ * Compress a block using the supplied (initialized) zlib stream and
+ * calculate the CRC-32 of the block data.  The block input is freed.
+ *
+ * @return 0 on success and non-zero on error.
+ ***************************************************************************/
+static int
+zs_pdeflate_block ( z_stream *zlstream, PDblock *block )
+{
+  uint8_t *output;
+  int64_t allocated;
+  int flush;
+  int rv;
+
+  if ( deflateReset (zlstream) != Z_OK )
+    return -1;
+
+  if ( block->dictSize > 0 &&
+       deflateSetDictionary (zlstream, block->input, block->dictSize) != Z_OK )
+    return -1;
+
+  /* Initial allocation for block and sync flush marker, grown if needed */
+  allocated = deflateBound (zlstream, block->size) + 64;
+  if ( ! (block->output = (uint8_t *) malloc (allocated)) )
+    return -1;
+
+  zlstream->next_in = block->input + block->dictSize;
+  zlstream->avail_in = block->size;
+  flush = ( block->last ) ? Z_FINISH : Z_SYNC_FLUSH;
+
+  do
+    {
+      if ( block->outputSize == allocated )
+        {
+          allocated += ZS_PDEFLATE_DICT;
+          if ( ! (output = (uint8_t *) realloc (block->output, allocated)) )
+            return -1;
+          block->output = output;
+        }
+
+      zlstream->next_out = block->output + block->outputSize;
+      zlstream->avail_out = allocated - block->outputSize;
+
+      rv = deflate (zlstream, flush);
+
+      block->outputSize = allocated - zlstream->avail_out;
+
+      if ( rv != Z_OK && rv != Z_STREAM_END && rv != Z_BUF_ERROR )
+        {
+          fprintf (stderr, "zs_pdeflate_block: Error with deflate(): %d\n", rv);
+          return -1;
+        }
+    }
+  while ( ( block->last ) ? rv != Z_STREAM_END : zlstream->avail_out == 0 && rv != Z_BUF_ERROR );
+
+  block->CRC32 = crc32 (crc32 (0L, Z_NULL, 0), block->input + block->dictSize, block->size);
+
+  free (block->input);
+  block->input = NULL;
+
+  return 0;
+}  /* End of zs_pdeflate_block() */
+
+
+/***************************************************************************
+ * zs_pdeflate_worker:
+ *
+ * Worker thread compressing queued blocks in order of submission.
+ ***************************************************************************/
+static void *
+zs_pdeflate_worker ( void *arg )
+{
+  PDeflate *pd = (PDeflate *) arg;
+  PDblock *block;
+  z_stream zlstream;
+  int initialized;
+  int rv;
+
+  memset (&zlstream, 0, sizeof(z_stream));
+  initialized = ( deflateInit2 (&zlstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) == Z_OK );
+
+  pthread_mutex_lock (&pd->lock);
+
+  for (;;)
+    {
+      while ( ! pd->queue && ! pd->exit )
+        pthread_cond_wait (&pd->cond, &pd->lock);
+
+      if ( ! pd->queue )
+        break;
+
+      block = pd->queue;
+      pd->queue = block->next;
+      block->state = 1;
+
+      pthread_mutex_unlock (&pd->lock);
+
+      rv = ( initialized ) ? zs_pdeflate_block (&zlstream, block) : -1;
+
+      pthread_mutex_lock (&pd->lock);
+
+      block->state = ( rv ) ? -1 : 2;
+      pthread_cond_broadcast (&pd->cond);
+    }
+
+  pthread_mutex_unlock (&pd->lock);
+
+  if ( initialized )
+    deflateEnd (&zlstream);
+
+  return NULL;
+}  /* End of zs_pdeflate_worker() */
+
+
+/***************************************************************************
+ * zs_pdeflate_submit:
+ *
+ * Queue a block for compression, starting another worker thread if
+ * the maximum has not been reached.  If no workers are running and
+ * this is the only block of the entry it is compressed directly.
+ *
+ * @return 0 on success and non-zero on error.
+ ***************************************************************************/
+static int
+zs_pdeflate_submit ( PDeflate *pd, PDblock *block )
+{
+  z_stream zlstream;
+  int rv = 0;
+
+  /* Compress a single block entry with the calling thread */
+  if ( block->last && pd->started == 0 && ! pd->head )
+    {
+      memset (&zlstream, 0, sizeof(z_stream));
+      if ( deflateInit2 (&zlstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK )
+        {
+          fprintf (stderr, "zs_pdeflate_submit: Error with deflateInit2()\n");
+          return -1;
+        }
+
+      rv = zs_pdeflate_block (&zlstream, block);
+      deflateEnd (&zlstream);
+
+      block->state = ( rv ) ? -1 : 2;
+      pd->head = pd->tail = block;
+      pd->outstanding++;
+
+      return 0;
+    }
+
+  pthread_mutex_lock (&pd->lock);
+
+  if ( pd->tail )
+    pd->tail->next = block;
+  else
+    pd->head = block;
+
+  pd->tail = block;
+  pd->outstanding++;
+
+  if ( ! pd->queue )
+    pd->queue = block;
+
+  if ( pd->started < pd->threads &&
+       pthread_create (&pd->tids[pd->started], NULL, zs_pdeflate_worker, pd) == 0 )
+    pd->started++;
+
+  if ( pd->started == 0 )
+    {
+      fprintf (stderr, "zs_pdeflate_submit: Cannot start compression thread\n");
+      rv = -1;
+    }
+
+  pthread_cond_broadcast (&pd->cond);
+  pthread_mutex_unlock (&pd->lock);
+
+  return rv;
+}  /* End of zs_pdeflate_submit() */
+
+
+/***************************************************************************
+ * zs_pdeflate_state:
+ *
+ * Determine the state of the oldest block, optionally waiting for it
+ * to be compressed.
+ *
+ * @return the state of the oldest block.
+ ***************************************************************************/
+static int
+zs_pdeflate_state ( PDeflate *pd, int wait )
+{
+  int state;
+
+  pthread_mutex_lock (&pd->lock);
+
+  while ( wait && (pd->head->state == 0 || pd->head->state == 1) )
+    pthread_cond_wait (&pd->cond, &pd->lock);
+
+  state = pd->head->state;
+
+  pthread_mutex_unlock (&pd->lock);
+
+  return state;
+}  /* End of zs_pdeflate_state() */
+
+
+/***************************************************************************
+ * zs_pdeflate_init:
+ *
+ * Initialization for the parallel deflate method.
+ *
+ * @return 0 on sucess and non-zero on error.
+ ***************************************************************************/
+static int32_t
+zs_pdeflate_init ( ZIPstream *zstream, ZIPentry *zentry )
+{
+  PDeflate *pd;
+
+  pd = (PDeflate *) calloc (1, sizeof(PDeflate));
+  if ( pd )
+    {
+      pd->threads = ( zentry->method->threads > 0 ) ? zentry->method->threads : 1;
+      pd->tids = (pthread_t *) calloc (pd->threads, sizeof(pthread_t));
+    }
+
+  if ( ! pd || ! pd->tids )
+    {
+      fprintf (stderr, "Cannot allocate memory for parallel deflate\n");
+      free (pd);
+      return -1;
+    }
+
+  pthread_mutex_init (&pd->lock, NULL);
+  pthread_cond_init (&pd->cond, NULL);
+  pd->CRC32 = crc32 (0L, Z_NULL, 0);
+
+  zentry->methoddata = pd;
+
+  return 0;
+}  /* End of zs_pdeflate_init() */
+
+
+/***************************************************************************
+ * zs_pdeflate_process:
+ *
+ * Process data for the parallel deflate method.  Input is buffered
+ * into blocks that are submitted for compression, compressed blocks
+ * are returned in order.  The number of blocks in flight is limited
+ * to twice the number of threads.
+ *
+ * @return number of bytes ready for writing in writeBuffer or <0 on error.
+ ***************************************************************************/
+static int32_t
+zs_pdeflate_process ( ZIPstream *zstream, ZIPentry *zentry,
+                      uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
+                      uint8_t* writeBuffer, int64_t writeBufferSize )
+{
+  PDeflate *pd;
+  PDblock *block;
+  int64_t consumed = 0;
+  int64_t copySize;
+  int state;
+
+  if ( ! zstream || ! zentry )
+    return -1;
+
+  pd = zentry->methoddata;
+
+  if ( ! pd )
+    return -1;
+
+  for (;;)
+    {
+      /* Return output of the oldest block when compressed */
+      if ( pd->head )
+        {
+          if ( (state = zs_pdeflate_state (pd, 0)) < 0 )
+            {
+              fprintf (stderr, "zs_pdeflate_process: Error compressing block\n");
+              return -1;
+            }
+
+          if ( state == 2 )
+            {
+              block = pd->head;
+
+              copySize = block->outputSize - block->outputSent;
+              if ( copySize > writeBufferSize )
+                copySize = writeBufferSize;
+
+              memcpy (writeBuffer, block->output + block->outputSent, copySize);
+              block->outputSent += copySize;
+
+              /* Remove block when all output is returned */
+              if ( block->outputSent >= block->outputSize )
+                {
+                  pd->CRC32 = crc32_combine (pd->CRC32, block->CRC32, block->size);
+
+                  pthread_mutex_lock (&pd->lock);
+                  pd->head = block->next;
+                  if ( ! pd->head )
+                    pd->tail = NULL;
+                  pd->outstanding--;
+                  pthread_mutex_unlock (&pd->lock);
+
+                  free (block->output);
+                  free (block);
+                }
+
+              if ( copySize > 0 )
+                {
+                  if ( entryConsumed )
+                    *entryConsumed = consumed;
+
+                  return copySize;
+                }
+
+              continue;
+            }
+        }
+
+      /* Buffer input data into blocks */
+      if ( entry )
+        {
+          if ( consumed >= entrySize )
+            {
+              if ( entryConsumed )
+                *entryConsumed = consumed;
+
+              return 0;
+            }
+
+          if ( ! pd->current && ! (pd->current = zs_pdeflate_newblock (NULL)) )
+            return -1;
+
+          /* Submit full block, waiting for the oldest if too many are in flight */
+          if ( pd->current->size == ZS_PDEFLATE_BLOCK )
+            {
+              if ( pd->outstanding >= 2 * pd->threads )
+                {
+                  if ( zs_pdeflate_state (pd, 1) < 0 )
+                    {
+                      fprintf (stderr, "zs_pdeflate_process: Error compressing block\n");
+                      return -1;
+                    }
+
+                  continue;
+                }
+
+              if ( ! (block = zs_pdeflate_newblock (pd->current)) )
+                return -1;
+
+              if ( zs_pdeflate_submit (pd, pd->current) )
+                {
+                  free (block->input);
+                  free (block);
+                  return -1;
+                }
+
+              pd->current = block;
+            }
+
+          copySize = ZS_PDEFLATE_BLOCK - pd->current->size;
+          if ( copySize > (entrySize - consumed) )
+            copySize = entrySize - consumed;
+
+          memcpy (pd->current->input + pd->current->dictSize + pd->current->size,
+                  entry + consumed, copySize);
+          pd->current->size += copySize;
+          consumed += copySize;
+
+          continue;
+        }
+
+      /* Flush: submit the last block and return all output in order */
+      if ( ! pd->finished )
+        {
+          if ( ! pd->current && ! (pd->current = zs_pdeflate_newblock (NULL)) )
+            return -1;
+
+          pd->current->last = 1;
+          pd->finished = 1;
+
+          block = pd->current;
+          pd->current = NULL;
+
+          if ( zs_pdeflate_submit (pd, block) )
+            return -1;
+        }
+
+      if ( ! pd->head )
+        return 0;
+
+      if ( zs_pdeflate_state (pd, 1) < 0 )
+        {
+          fprintf (stderr, "zs_pdeflate_process: Error compressing block\n");
+          return -1;
+        }
+    }
+}  /* End of zs_pdeflate_process() */
+
+
+/***************************************************************************
+ * zs_pdeflate_finish:
+ *
+ * Closeout for the parallel deflate method, stop worker threads and
+ * set the combined CRC-32 of the entry.
+ *
+ * @return 0 on success and non-zero on error.
+ ***************************************************************************/
+static int32_t
+zs_pdeflate_finish ( ZIPstream *zstream, ZIPentry *zentry )
+{
+  PDeflate *pd = zentry->methoddata;
+  PDblock *block;
+  int rc = 0;
+  int idx;
+
+  if ( ! pd )
+    return -1;
+
+  pthread_mutex_lock (&pd->lock);
+  pd->exit = 1;
+  pthread_cond_broadcast (&pd->cond);
+  pthread_mutex_unlock (&pd->lock);
+
+  for ( idx = 0; idx < pd->started; idx++ )
+    pthread_join (pd->tids[idx], NULL);
+
+  /* Any remaining blocks indicate an incomplete entry */
+  if ( pd->head || pd->current || ! pd->finished )
+    {
+      fprintf (stderr, "zs_pdeflate_finish: Entry not completely flushed\n");
+      rc = -1;
+    }
+
+  while ( pd->head )
+    {
+      block = pd->head;
+      pd->head = block->next;
+      free (block->input);
+      free (block->output);
+      free (block);
+    }
+
+  if ( pd->current )
+    {
+      free (pd->current->input);
+      free (pd->current);
+    }
+
+  zentry->CRC32 = pd->CRC32;
+
+  pthread_mutex_destroy (&pd->lock);
+  pthread_cond_destroy (&pd->cond);
+  free (pd->tids);
+  free (pd);
+  zentry->methoddata = NULL;
+
+  return rc;
+}  /* End of zs_pdeflate_finish() */
+#endif /* NOPTHREADS */
+
+#ifndef NOPTHREADS
+/***************************************************************************
+ * Pipelined output writer
+ *
+ * Archive data is copied into a ring of buffers and a writer thread
+ * writes filled buffers to the output descriptor in order, so that
+ * compression continues while a write() to a slow pipe or socket is
+ * blocked.  Data is only waited on when all buffers are queued.
+ *
+ * A write error is reported by the zs_writedata() call or flush
+ * following it, data queued after an error is discarded.
+ ***************************************************************************/
+
+/* A buffer of archive data */
+typedef struct zwbuffer_s
+{
+  uint8_t *data;
+  int64_t length;                /* Length of data in buffer */
+  int queued;                    /* Buffer is queued for writing */
+} ZWbuffer;
+
+/* Pipelined writer state for a stream */
+typedef struct zipwriter_s
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t tid;
+  int fd;
+  ZWbuffer *buffers;
+  int32_t count;                 /* Number of buffers */
+  int64_t size;                  /* Size of each buffer */
+  int32_t fill;                  /* Buffer being filled */
+  int32_t next;                  /* Next buffer to write */
+  int32_t queued;                /* Count of buffers queued for writing */
+  int exit;                      /* Flag for writer thread to exit */
+  int64_t writestatus;           /* Return value of failed write(), 1 if none */
+  int writeerrno;                /* errno of failed write() */
+} ZIPwriter;
+
+
+/***************************************************************************
+ * zs_writer_thread:
+ *
+ * Writer thread writing queued buffers in order until all queued
+ * buffers are written and the thread is told to exit.
+ ***************************************************************************/
+static void *
+zs_writer_thread ( void *arg )
+{
+  ZIPwriter *zw = (ZIPwriter *) arg;
+  ZWbuffer *buffer;
+  ssize_t lwritestatus = 1;
+  size_t writeLength;
+  int64_t written;
+  int failed;
+
+  pthread_mutex_lock (&zw->lock);
+
+  for (;;)
+    {
+      while ( ! zw->queued && ! zw->exit )
+        pthread_cond_wait (&zw->cond, &zw->lock);
+
+      if ( ! zw->queued )
+        break;
+
+      buffer = &zw->buffers[zw->next];
+      failed = ( zw->writestatus <= 0 );
+
+      pthread_mutex_unlock (&zw->lock);
+
+      /* Write buffer in blocks of ZS_WRITE_SIZE, discarded after an error */
+      written = 0;
+      while ( ! failed && written < buffer->length )
+        {
+          writeLength = ( (buffer->length - written) > ZS_WRITE_SIZE ) ?
+            ZS_WRITE_SIZE : (buffer->length - written);
+
+          lwritestatus = write (zw->fd, buffer->data+written, writeLength);
+
+          if ( lwritestatus <= 0 )
+            break;
+
+          written += lwritestatus;
+        }
+
+      pthread_mutex_lock (&zw->lock);
+
+      if ( ! failed && written < buffer->length )
+        {
+          zw->writestatus = lwritestatus;
+          zw->writeerrno = errno;
+        }
+
+      buffer->length = 0;
+      buffer->queued = 0;
+      zw->next = (zw->next + 1) % zw->count;
+      zw->queued--;
+
+      pthread_cond_broadcast (&zw->cond);
+    }
+
+  pthread_mutex_unlock (&zw->lock);
+
+  return NULL;
+}  /* End of zs_writer_thread() */
+
+
+/***************************************************************************
+ * zs_writer_queue:
+ *
+ * Queue the buffer being filled, if it contains data, for writing and
+ * wait for the next buffer to be available.  If flush is true also
+ * wait for all queued buffers to be written.
+ *
+ * @return 1 on success and the return value of a failed write() on error.
+ ***************************************************************************/
+static int64_t
+zs_writer_queue ( ZIPwriter *zw, int flush )
+{
+  int64_t writestatus;
+
+  pthread_mutex_lock (&zw->lock);
+
+  if ( zw->buffers[zw->fill].length > 0 )
+    {
+      zw->buffers[zw->fill].queued = 1;
+      zw->queued++;
+      zw->fill = (zw->fill + 1) % zw->count;
+
+      pthread_cond_broadcast (&zw->cond);
+    }
+
+  while ( (flush) ? zw->queued > 0 : zw->buffers[zw->fill].queued )
+    pthread_cond_wait (&zw->cond, &zw->lock);
+
+  writestatus = zw->writestatus;
+
+  if ( writestatus <= 0 )
+    errno = zw->writeerrno;
+
+  pthread_mutex_unlock (&zw->lock);
+
+  return writestatus;
+}  /* End of zs_writer_queue() */
+
+
+/***************************************************************************
+ * zs_writer_put:
+ *
+ * Copy data into the ring of buffers, queueing each buffer for
+ * writing when it is full.
+ *
+ * The ZIPstream.WriteOffset value will be incremented accordingly.
+ *
+ * @return number of bytes queued on success and the return value of a
+ * failed write() on error.
+ ***************************************************************************/
+static int64_t
+zs_writer_put ( ZIPstream *zstream, uint8_t *writeBuffer, int64_t writeBufferSize )
+{
+  ZIPwriter *zw = zstream->writer;
+  ZWbuffer *buffer;
+  int64_t writestatus;
+  int64_t copySize;
+  int64_t copied = 0;
+
+  /* Report an error from a previous write */
+  pthread_mutex_lock (&zw->lock);
+  writestatus = zw->writestatus;
+  if ( writestatus <= 0 )
+    errno = zw->writeerrno;
+  pthread_mutex_unlock (&zw->lock);
+
+  if ( writestatus <= 0 )
+    return writestatus;
+
+  while ( copied < writeBufferSize )
+    {
+      buffer = &zw->buffers[zw->fill];
+
+      copySize = zw->size - buffer->length;
+      if ( copySize > writeBufferSize - copied )
+        copySize = writeBufferSize - copied;
+
+      memcpy (buffer->data + buffer->length, writeBuffer + copied, copySize);
+      buffer->length += copySize;
+      copied += copySize;
+
+      if ( buffer->length == zw->size &&
+           (writestatus = zs_writer_queue (zw, 0)) <= 0 )
+        return writestatus;
+    }
+
+  zstream->WriteOffset += copied;
+
+  return copied;
+}  /* End of zs_writer_put() */
+
+
+/***************************************************************************
+ * zs_writer_stop:
+ *
+ * Wait for queued buffers to be written, stop the writer thread and
+ * free the writer.  Data in a buffer not yet queued is discarded.
  ***************************************************************************/
+static void
+zs_writer_stop ( ZIPstream *zstream )
+{
+  ZIPwriter *zw = zstream->writer;
+  int32_t idx;
 
-/* Allow this code to be skipped by declaring NOFDZIP */
-#ifndef NOFDZIP
+  if ( ! zw )
+    return;
 
-#define FDZIPVERSION 2.1
+  pthread_mutex_lock (&zw->lock);
+  zw->exit = 1;
+  pthread_cond_broadcast (&zw->cond);
+  pthread_mutex_unlock (&zw->lock);
 
-#include <assert.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <inttypes.h>
-#include <string.h>
-#include <errno.h>
+  pthread_join (zw->tid, NULL);
 
-#include <zlib.h>
+  for ( idx = 0; idx < zw->count; idx++ )
+    free (zw->buffers[idx].data);
 
-#include "fdzipstream.h"
+  pthread_mutex_destroy (&zw->lock);
+  pthread_cond_destroy (&zw->cond);
+  free (zw->buffers);
+  free (zw);
 
-#define BIT_SET(a,b) ((a) |= (1<<(b)))
+  zstream->writer = NULL;
+}  /* End of zs_writer_stop() */
+#endif /* NOPTHREADS */
 
-static int64_t zs_writedata ( ZIPstream *zstream, uint8_t *writeBuffer, int64_t writeBufferSize );
-static uint32_t zs_datetime_unixtodos ( time_t t );
-static void zs_packunit16 (ZIPstream *ZS, int *O, uint16_t V);
-static void zs_packunit32 (ZIPstream *ZS, int *O, uint32_t V);
-static void zs_packunit64 (ZIPstream *ZS, int *O, uint64_t V);
+#ifdef FDZIP_LIBDEFLATE
+/* Initial buffer size for libdeflate entries */
+#define ZS_LIBDEFLATE_BUFFER 1048576
+
+/* Entry state for the libdeflate method */
+typedef struct zslibdeflate_s
+{
+  uint8_t *buffer;               /* Uncompressed entry data */
+  int64_t size;
+  int64_t allocated;
+  uint8_t *output;               /* Compressed entry data */
+  int64_t outputSize;
+  int64_t outputSent;
+  int compressed;
+} ZSlibdeflate;
 
 
 /***************************************************************************
- * zs_store_process:
+ * zs_libdeflate_init:
  *
- * The process() callback for the STORE method.
+ * Initialization for the libdeflate method.
  *
- * @return number of bytes ready for writing in writeBuffer or <0 on error.
+ * @return 0 on sucess and non-zero on error.
  ***************************************************************************/
 static int32_t
-zs_store_process ( ZIPstream *zstream, ZIPentry *zentry,
-                   uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
-                   uint8_t *writeBuffer, int64_t writeBufferSize )
+zs_libdeflate_init ( ZIPstream *zstream, ZIPentry *zentry )
 {
-  if ( ! entry || entrySize <= 0 )
-    return 0;
+  ZSlibdeflate *ld;
 
-  if ( entrySize < writeBufferSize )
+  ld = (ZSlibdeflate *) calloc (1, sizeof(ZSlibdeflate));
+  if ( ! ld )
     {
-      writeBufferSize = entrySize;
+      fprintf (stderr, "Cannot allocate memory for libdeflate state\n");
+      return -1;
     }
 
-  memcpy ( writeBuffer, entry, writeBufferSize );
+  zentry->methoddata = ld;
 
-  if ( entryConsumed )
+  return 0;
+}
+
+
+/***************************************************************************
+ * zs_libdeflate_process:
+ *
+ * Process data for the libdeflate method.  The entry data is buffered
+ * and compressed as a whole buffer when flushed.
+ *
+ * @return number of bytes ready for writing in writeBuffer or <0 on error.
+ ***************************************************************************/
+static int32_t
+zs_libdeflate_process ( ZIPstream *zstream, ZIPentry *zentry,
+                        uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
+                        uint8_t* writeBuffer, int64_t writeBufferSize )
+{
+  struct libdeflate_compressor *compressor;
+  ZSlibdeflate *ld;
+  uint8_t *buffer;
+  int64_t allocated;
+  int64_t bound;
+  int64_t copySize;
+
+  if ( ! zstream || ! zentry )
+    return -1;
+
+  ld = zentry->methoddata;
+
+  if ( ! ld )
+    return -1;
+
+  /* Buffer entry data */
+  if ( entry )
     {
-      *entryConsumed = writeBufferSize;
+      if ( entrySize <= 0 )
+        return 0;
+
+      if ( ld->size + entrySize > ld->allocated )
+        {
+          allocated = ( ld->allocated ) ? ld->allocated : ZS_LIBDEFLATE_BUFFER;
+          while ( allocated < ld->size + entrySize )
+            allocated *= 2;
+
+          if ( ! (buffer = (uint8_t *) realloc (ld->buffer, allocated)) )
+            {
+              fprintf (stderr, "Cannot allocate memory for libdeflate buffer\n");
+              return -1;
+            }
+
+          ld->buffer = buffer;
+          ld->allocated = allocated;
+        }
+
+      memcpy (ld->buffer + ld->size, entry, entrySize);
+      ld->size += entrySize;
+
+      if ( entryConsumed )
+        *entryConsumed = entrySize;
+
+      return 0;
     }
 
-  return writeBufferSize;
-}  /* End of zs_store_process() */
+  /* Compress the entire entry on the first flush call */
+  if ( ! ld->compressed )
+    {
+      if ( ! (compressor = libdeflate_alloc_compressor (6)) )
+        {
+          fprintf (stderr, "zs_libdeflate_process: Cannot allocate compressor\n");
+          return -1;
+        }
+
+      bound = libdeflate_deflate_compress_bound (compressor, ld->size);
+
+      if ( ! (ld->output = (uint8_t *) malloc (bound)) )
+        {
+          fprintf (stderr, "Cannot allocate memory for libdeflate output\n");
+          libdeflate_free_compressor (compressor);
+          return -1;
+        }
+
+      ld->outputSize = libdeflate_deflate_compress (compressor, ld->buffer, ld->size,
+                                                    ld->output, bound);
+      libdeflate_free_compressor (compressor);
+
+      if ( ld->outputSize == 0 )
+        {
+          fprintf (stderr, "zs_libdeflate_process: Error with libdeflate_deflate_compress()\n");
+          return -1;
+        }
+
+      free (ld->buffer);
+      ld->buffer = NULL;
+      ld->compressed = 1;
+    }
+
+  /* Return compressed data */
+  copySize = ld->outputSize - ld->outputSent;
+  if ( copySize > writeBufferSize )
+    copySize = writeBufferSize;
+
+  memcpy (writeBuffer, ld->output + ld->outputSent, copySize);
+  ld->outputSent += copySize;
+
+  return copySize;
+}
 
 
 /***************************************************************************
- * zs_deflate_init:
+ * zs_libdeflate_finish:
  *
- * Initialization for the deflate method.
+ * Closeout for the libdeflate method.
+ *
+ * @return 0 on success and non-zero on error.
+ ***************************************************************************/
+static int32_t
+zs_libdeflate_finish ( ZIPstream *zstream, ZIPentry *zentry )
+{
+  ZSlibdeflate *ld = zentry->methoddata;
+
+  if ( ! ld )
+    return -1;
+
+  free (ld->buffer);
+  free (ld->output);
+  free (ld);
+  zentry->methoddata = NULL;
+
+  return 0;
+}
+#endif /* FDZIP_LIBDEFLATE */
+
+
+#ifdef FDZIP_ZSTD
+/* Entry state for the zstd method */
+typedef struct zszstd_s
+{
+  ZSTD_CCtx *cctx;
+  int finished;                  /* Frame is complete */
+} ZSzstd;
+
+
+/***************************************************************************
+ * zs_zstd_init:
+ *
+ * Initialization for the zstd method.
  *
  * @return 0 on sucess and non-zero on error.
  ***************************************************************************/
 static int32_t
-zs_deflate_init ( ZIPstream *zstream, ZIPentry *zentry )
+zs_zstd_init ( ZIPstream *zstream, ZIPentry *zentry )
 {
-  z_stream *zlstream;
+  ZSzstd *zs;
 
-  /* Allocate ZLIB stream entry and store at private method pointer */
-  zlstream = (z_stream *) calloc (1, sizeof(z_stream));
-  if ( ! zlstream )
+  zs = (ZSzstd *) calloc (1, sizeof(ZSzstd));
+  if ( zs )
+    zs->cctx = ZSTD_createCCtx ();
+
+  if ( ! zs || ! zs->cctx )
     {
-      fprintf (stderr, "Cannot allocate memory for z_stream\n");
+      fprintf (stderr, "Cannot allocate memory for ZSTD_CCtx\n");
+      free (zs);
       return -1;
     }
-  zentry->methoddata = zlstream;
-
-  /* Allocate deflate zlib stream state & initialize */
-  zlstream->zalloc = Z_NULL;
-  zlstream->zfree = Z_NULL;
-  zlstream->opaque = Z_NULL;
-  zlstream->total_in = 0;
-  zlstream->total_out = 0;
-  zlstream->data_type = Z_BINARY;
 
-  if ( deflateInit2 (zlstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-                     -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK )
+  if ( ZSTD_isError (ZSTD_CCtx_setParameter (zs->cctx, ZSTD_c_compressionLevel,
+                                             ZSTD_CLEVEL_DEFAULT)) )
     {
-      fprintf (stderr, "zs_deflate_init: Error with deflateInit2()\n");
+      fprintf (stderr, "zs_zstd_init: Error with ZSTD_CCtx_setParameter()\n");
+      ZSTD_freeCCtx (zs->cctx);
+      free (zs);
       return -1;
     }
 
+  zentry->methoddata = zs;
+
+  /* Version needed to extract zstd entries (6.3) */
+  zentry->ZipVersion = 63;
+
   return 0;
 }
 
 
 /***************************************************************************
- * zs_deflate_process:
+ * zs_zstd_process:
  *
- * Process data for deflate method.
+ * Process data for the zstd method.
  *
  * @return number of bytes ready for writing in writeBuffer or <0 on error.
  ***************************************************************************/
 static int32_t
-zs_deflate_process( ZIPstream *zstream, ZIPentry *zentry,
-                    uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
-                    uint8_t* writeBuffer, int64_t writeBufferSize )
+zs_zstd_process ( ZIPstream *zstream, ZIPentry *zentry,
+                  uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
+                  uint8_t* writeBuffer, int64_t writeBufferSize )
 {
-  z_stream *zlstream;
-  int flush;
-  int rv;
+  ZSzstd *zs;
+  ZSTD_inBuffer input;
+  ZSTD_outBuffer output;
+  size_t rv;
 
   if ( ! zstream || ! zentry )
     return -1;
 
-  zlstream = zentry->methoddata;
+  zs = zentry->methoddata;
 
-  if ( ! zlstream )
+  if ( ! zs )
     return -1;
 
-  zlstream->next_in = entry;
-  zlstream->avail_in = ( entry ) ? entrySize : 0;
-  zlstream->next_out = writeBuffer;
-  zlstream->avail_out = writeBufferSize;
-
-  flush = ( entry ) ? Z_NO_FLUSH : Z_FINISH;
+  /* Nothing more to flush once the frame is complete */
+  if ( ! entry && zs->finished )
+    return 0;
 
-  rv = deflate ( zlstream, flush );
+  input.src = entry;
+  input.size = ( entry ) ? entrySize : 0;
+  input.pos = 0;
+  output.dst = writeBuffer;
+  output.size = writeBufferSize;
+  output.pos = 0;
 
-  if ( ! (entry && rv == Z_OK) &&
-       ! (!entry && rv == Z_STREAM_END) )
+  /* Continue until output is produced, all input is consumed or,
+   * when flushing, the frame is complete */
+  do
     {
-      fprintf (stderr, "zs_deflate_process: Error with deflate():\n");
-
-      if ( rv == Z_BUF_ERROR )
-        fprintf (stderr, "  ZLIB: Z_BUF_ERROR, No progress is possible; either avail_in or avail_out was zero\n");
-      else if ( rv == Z_MEM_ERROR )
-        fprintf (stderr, "  ZLIB: Z_MEM_ERROR, Insufficient memory\n");
-      else if ( rv == Z_STREAM_ERROR )
-        fprintf (stderr, "  ZLIB: Z_STREAM_ERROR, The stream state is inconsistent or stream was NULL\n");
-      else
-        fprintf (stderr, "  ZLIB: deflated returned %d\n", rv);
+      rv = ZSTD_compressStream2 (zs->cctx, &output, &input,
+                                 ( entry ) ? ZSTD_e_continue : ZSTD_e_end);
 
-      return -1;
+      if ( ZSTD_isError (rv) )
+        {
+          fprintf (stderr, "zs_zstd_process: Error with ZSTD_compressStream2(): %s\n",
+                   ZSTD_getErrorName (rv));
+          return -1;
+        }
     }
+  while ( output.pos == 0 &&
+          ( ( entry ) ? input.pos < input.size : rv != 0 ) );
+
+  if ( ! entry && rv == 0 )
+    zs->finished = 1;
 
   if ( entry && entryConsumed )
     {
-      *entryConsumed = entrySize - zlstream->avail_in;
+      *entryConsumed = input.pos;
     }
 
   /* Return number of bytes ready in writeBuffer */
-  return (writeBufferSize - zlstream->avail_out);
+  return output.pos;
 }
 
 
 /***************************************************************************
- * zs_deflate_finish:
+ * zs_zstd_finish:
  *
- * Closeout for deflate method.
+ * Closeout for the zstd method.
  *
  * @return 0 on success and non-zero on error.
  ***************************************************************************/
 static int32_t
-zs_deflate_finish ( ZIPstream *zstream, ZIPentry *zentry )
+zs_zstd_finish ( ZIPstream *zstream, ZIPentry *zentry )
 {
-  z_stream *zlstream = zentry->methoddata;
-  int rv;
+  ZSzstd *zs = zentry->methoddata;
   int rc = 0;
 
-  rv = deflateEnd (zlstream);
+  if ( ! zs )
+    return -1;
 
-  if ( rv == Z_DATA_ERROR )
-    {
-      fprintf (stderr, "zs_deflate_finish: Deflate ended, but output buffers not flushed!\n");
-      rc = -1;
-    }
-  else if ( rv == Z_STREAM_ERROR )
+  if ( ! zs->finished )
     {
-      fprintf (stderr, "zs:deflate_finish: deflateEnd() returned error.\n");
+      fprintf (stderr, "zs_zstd_finish: Frame ended, but output not flushed!\n");
       rc = -1;
     }
 
-  free (zlstream);
+  ZSTD_freeCCtx (zs->cctx);
+  free (zs);
+  zentry->methoddata = NULL;
 
   return rc;
 }
+#endif /* FDZIP_ZSTD */
 
 
 /***************************************************************************
@@ -354,6 +1487,123 @@ zs_registermethod ( ZIPstream *zs, int32_t methodID,
 }  /* End of zs_registermethod() */
 
 
+/***************************************************************************
+ * zs_registerpdeflate:
+ *
+ * Register the parallel deflate method (ZS_PDEFLATE) with the
+ * supplied ZIPstream, compressing entries using up to the specified
+ * number of threads.  Entries are recorded as using the DEFLATE
+ * method and are readable by any ZIP extractor.
+ *
+ * This method must be registered after zs_init() and is not
+ * available when compiled with NOPTHREADS.
+ *
+ * @return a pointer to a ZIPmethod struct on success or NULL on error.
+ ***************************************************************************/
+ZIPmethod *
+zs_registerpdeflate ( ZIPstream *zs, int32_t threads )
+{
+#ifndef NOPTHREADS
+  ZIPmethod *method;
+
+  method = zs_registermethod ( zs, ZS_PDEFLATE,
+                               zs_pdeflate_init,
+                               zs_pdeflate_process,
+                               zs_pdeflate_finish );
+
+  if ( method )
+    {
+      method->flags = ZS_METHOD_CRC32;
+      method->threads = ( threads > 0 ) ? threads : 1;
+    }
+
+  return method;
+#else
+  fprintf (stderr, "Parallel deflate is not supported without threads\n");
+  return NULL;
+#endif
+}  /* End of zs_registerpdeflate() */
+
+
+/***************************************************************************
+ * zs_registerwriter:
+ *
+ * Register a pipelined writer with the supplied ZIPstream, archive
+ * data is written to the output descriptor by a writer thread from a
+ * ring of the specified number of buffers, each of bufferSize bytes.
+ * At least 2 buffers are used, a bufferSize of 0 or less selects
+ * ZS_WRITE_SIZE.  Archive data is written to the output descriptor
+ * when zs_finish() returns.
+ *
+ * The writer must be registered after zs_init() and before any
+ * entries are added, it is not available when compiled with NOPTHREADS.
+ *
+ * @return 0 on success and non-zero on error.
+ ***************************************************************************/
+int
+zs_registerwriter ( ZIPstream *zs, int32_t buffers, int64_t bufferSize )
+{
+#ifndef NOPTHREADS
+  ZIPwriter *zw;
+  int32_t idx;
+
+  if ( ! zs || zs->writer || zs->WriteOffset > 0 )
+    return -1;
+
+  zw = (ZIPwriter *) calloc (1, sizeof(ZIPwriter));
+  if ( zw )
+    {
+      zw->count = ( buffers > 2 ) ? buffers : 2;
+      zw->size = ( bufferSize > 0 ) ? bufferSize : ZS_WRITE_SIZE;
+      zw->buffers = (ZWbuffer *) calloc (zw->count, sizeof(ZWbuffer));
+    }
+
+  for ( idx = 0; zw && zw->buffers && idx < zw->count; idx++ )
+    {
+      if ( ! (zw->buffers[idx].data = (uint8_t *) malloc (zw->size)) )
+        break;
+    }
+
+  if ( ! zw || ! zw->buffers || idx < zw->count )
+    {
+      fprintf (stderr, "Cannot allocate memory for writer buffers\n");
+      if ( zw && zw->buffers )
+        {
+          while ( idx-- > 0 )
+            free (zw->buffers[idx].data);
+          free (zw->buffers);
+        }
+      free (zw);
+      return -1;
+    }
+
+  zw->fd = zs->fd;
+  zw->writestatus = 1;
+  pthread_mutex_init (&zw->lock, NULL);
+  pthread_cond_init (&zw->cond, NULL);
+
+  if ( pthread_create (&zw->tid, NULL, zs_writer_thread, zw) )
+    {
+      fprintf (stderr, "Cannot start writer thread\n");
+      pthread_mutex_destroy (&zw->lock);
+      pthread_cond_destroy (&zw->cond);
+      for ( idx = 0; idx < zw->count; idx++ )
+        free (zw->buffers[idx].data);
+      free (zw->buffers);
+      free (zw);
+      return -1;
+    }
+
+  zs->writer = zw;
+
+  return 0;
+#else
+  fprintf (stderr, "Pipelined writer is not supported without threads\n");
+  return -1;
+#endif
+}  /* End of zs_registerwriter() */
+
+
 /***************************************************************************
  * zs_init:
  *
@@ -375,6 +1625,10 @@ zs_init ( int fd, ZIPstream *zs )
     }
   else
     {
+#ifndef NOPTHREADS
+      zs_writer_stop (zs);
+#endif
+
       zentry = zs->FirstEntry;
       while ( zentry )
         {
@@ -421,6 +1675,30 @@ zs_init ( int fd, ZIPstream *zs )
       return NULL;
     }
 
+#ifdef FDZIP_LIBDEFLATE
+  /* Register the optional ZS_LIBDEFLATE method */
+  if ( ! zs_registermethod ( zs, ZS_LIBDEFLATE,
+                             zs_libdeflate_init,
+                             zs_libdeflate_process,
+                             zs_libdeflate_finish ) )
+    {
+      free (zs);
+      return NULL;
+    }
+#endif
+
+#ifdef FDZIP_ZSTD
+  /* Register the optional ZS_ZSTD method */
+  if ( ! zs_registermethod ( zs, ZS_ZSTD,
+                             zs_zstd_init,
+                             zs_zstd_process,
+                             zs_zstd_finish ) )
+    {
+      free (zs);
+      return NULL;
+    }
+#endif
+
   return zs;
 }  /* End of zs_init() */
 
@@ -440,6 +1718,10 @@ zs_free ( ZIPstream *zs )
   if ( ! zs )
     return;
 
+#ifndef NOPTHREADS
+  zs_writer_stop (zs);
+#endif
+
   zentry = zs->FirstEntry;
   while ( zentry )
     {
@@ -471,6 +1753,9 @@ zs_free ( ZIPstream *zs )
  * for this entry.  Included methods are:
  *   Z_STORE   - no compression
  *   Z_DEFLATE - deflate compression
+ *   ZS_PDEFLATE - parallel deflate, see zs_registerpdeflate()
+ *   ZS_LIBDEFLATE - deflate using libdeflate, if compiled with FDZIP_LIBDEFLATE
+ *   ZS_ZSTD   - Zstandard compression, if compiled with FDZIP_ZSTD
  *
  * The entry modified time (modtime) is stored in UTC.
  *
@@ -531,6 +1816,9 @@ zs_writeentry ( ZIPstream *zstream, uint8_t *entry, int64_t entrySize,
  * for this entry.  Included methods are:
  *   Z_STORE   - no compression
  *   Z_DEFLATE - deflate compression
+ *   ZS_PDEFLATE - parallel deflate, see zs_registerpdeflate()
+ *   ZS_LIBDEFLATE - deflate using libdeflate, if compiled with FDZIP_LIBDEFLATE
+ *   ZS_ZSTD   - Zstandard compression, if compiled with FDZIP_ZSTD
  *
  * The entry modified time (modtime) is stored in UTC.
  *
@@ -683,8 +1971,9 @@ zs_entrydata ( ZIPstream *zstream, ZIPentry *zentry, uint8_t *entry,
 
   if ( entry )
     {
-      /* Calculate, or continue calculation of, CRC32 */
-      zentry->CRC32 = crc32 (zentry->CRC32, (uint8_t *)entry, entrySize);
+      /* Calculate, or continue calculation of, CRC32 unless done by the method */
+      if ( ! (zentry->method->flags & ZS_METHOD_CRC32) )
+        zentry->CRC32 = crc32 (zentry->CRC32, (uint8_t *)entry, entrySize);
 
       remaining = entrySize;
     }
@@ -956,6 +2245,20 @@ zs_finish ( ZIPstream *zstream, ssize_t *writestatus )
       return -1;
     }
 
+#ifndef NOPTHREADS
+  /* Wait for the pipelined writer to write all archive data */
+  if ( zstream->writer &&
+       (lwritestatus = zs_writer_queue (zstream->writer, 1)) <= 0 )
+    {
+      fprintf (stderr, "Error writing ZIP archive data: %s\n", strerror(errno));
+
+      if ( writestatus )
+        *writestatus = (ssize_t)lwritestatus;
+
+      return -1;
+    }
+#endif
+
   return 0;
 }  /* End of zs_finish() */
 
@@ -963,7 +2266,8 @@ zs_finish ( ZIPstream *zstream, ssize_t *writestatus )
 /***************************************************************************
  * zs_writedata:
  *
- * Write data to output descriptor in blocks of ZS_WRITE_SIZE bytes.
+ * Write data to output descriptor in blocks of ZS_WRITE_SIZE bytes,
+ * or queue it for the pipelined writer if registered.
  *
  * The ZIPstream.WriteOffset value will be incremented accordingly.
  *
@@ -979,6 +2283,11 @@ zs_writedata ( ZIPstream *zstream, uint8_t *writeBuffer, int64_t writeBufferSize
   if ( ! zstream || ! writeBuffer )
     return 0;
 
+#ifndef NOPTHREADS
+  if ( zstream->writer )
+    return zs_writer_put (zstream, writeBuffer, writeBufferSize);
+#endif
+
   /* Write blocks of ZS_WRITE_SIZE until done */
   written = 0;
   while ( written < writeBufferSize )
@@ -32,6 +32,18 @@ extern "C" {
 /* Compression methods, match ZIP specification */
 #define ZS_STORE      0
 #define ZS_DEFLATE    8
+#define ZS_ZSTD       93    /* Requires FDZIP_ZSTD */
+
+/* Method IDs above 0xFFFF are alternate implementations of the ZIP
+ * method in the lower 16 bits, which is recorded in the archive */
+#define ZS_PDEFLATE   (0x10000 | ZS_DEFLATE)  /* Parallel (threaded) deflate */
+#define ZS_LIBDEFLATE (0x20000 | ZS_DEFLATE)  /* Deflate using libdeflate, requires FDZIP_LIBDEFLATE */
+
+/* ZIPmethod flags */
+#define ZS_METHOD_CRC32 0x1   /* Method calculates the entry CRC-32 */
+
+/* Block size (uncompressed) for parallel deflate */
+#define ZS_PDEFLATE_BLOCK 131072
 
 /* Maximum single size to write(), 1 MiB */
 #define ZS_WRITE_SIZE 1048576
@@ -71,6 +83,7 @@ typedef struct zipstream_s
   struct zipentry_s *FirstEntry;
   struct zipentry_s *LastEntry;
   struct zipmethod_s *firstMethod;
+  struct zipwriter_s *writer;    /* Pipelined writer, see zs_registerwriter() */
   uint8_t buffer[ZS_BUFFER_SIZE];
 } ZIPstream;
 
@@ -84,6 +97,8 @@ typedef struct zipmethod_s
                       uint8_t *entry, int64_t entrySize, int64_t *entryConsumed,
                       uint8_t* writeBuffer, int64_t writeBufferSize );
   int32_t (*finish)( ZIPstream *zstream, ZIPentry *zentry );
+  int32_t flags;                 /* Method flags, ZS_METHOD_* */
+  int32_t threads;               /* Threads available to the method */
   struct zipmethod_s* next;
 } ZIPmethod;
 
@@ -96,6 +111,10 @@ extern  ZIPmethod * zs_registermethod ( ZIPstream *zs, int32_t methodID,
                                         int32_t (*finish)( ZIPstream*, ZIPentry* )
                                         );
 
+extern ZIPmethod * zs_registerpdeflate ( ZIPstream *zs, int32_t threads );
+
+extern int zs_registerwriter ( ZIPstream *zs, int32_t buffers, int64_t bufferSize );
+
 extern ZIPstream * zs_init ( int fd, ZIPstream *zs );
 
 extern void zs_free ( ZIPstream *zs );
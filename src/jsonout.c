@@ -0,0 +1,30 @@
+/***************************************************************************
+ * jsonout.c
+ *
+ * Routines for writing JSON output.
+ ***************************************************************************/
+
+#include <stdio.h>
+
+#include "jsonout.h"
+
+/***************************************************************************
+ * json_printstring:
+ *
+ * Print a string as the contents of a JSON string, escaping quotes,
+ * backslashes and control characters.  The enclosing quotes are not
+ * printed.
+ ***************************************************************************/
+void
+json_printstring (FILE *fp, const char *string)
+{
+  for (; *string; string++)
+  {
+    if (*string == '"' || *string == '\\')
+      fprintf (fp, "\\%c", *string);
+    else if ((unsigned char)*string < 0x20)
+      fprintf (fp, "\\u%04x", (unsigned char)*string);
+    else
+      fputc (*string, fp);
+  }
+} /* End of json_printstring() */
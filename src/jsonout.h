@@ -0,0 +1,23 @@
+/***************************************************************************
+ * jsonout.h
+ *
+ * Routines for writing JSON output, used by the statistics and
+ * manifest modules.
+ ***************************************************************************/
+
+#ifndef JSONOUT_H
+#define JSONOUT_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern void json_printstring (FILE *fp, const char *string);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSONOUT_H */
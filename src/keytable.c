@@ -0,0 +1,215 @@
+/***************************************************************************
+ * keytable.c
+ *
+ * A hash table of values found by a key.
+ *
+ * The table uses open addressing with linear probing of slots hashed
+ * with the FNV-1a hash and is expanded to keep it no more than half
+ * full.  The hash of each key is stored with its value, probes only
+ * compare keys of the same hash and the table is expanded without
+ * looking up the keys again.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#include "keytable.h"
+
+/* Initial number of slots */
+#define KT_MINSIZE 256
+
+static int expand (KeyTable *kt);
+
+/***************************************************************************
+ * kt_init:
+ *
+ * Initialize an empty table using keyof to determine the key of a
+ * value, data is passed to keyof.
+ ***************************************************************************/
+void
+kt_init (KeyTable *kt, KTKeyFunc keyof, void *data)
+{
+  memset (kt, 0, sizeof (KeyTable));
+
+  kt->keyof = keyof;
+  kt->data = data;
+} /* End of kt_init() */
+
+/***************************************************************************
+ * kt_find:
+ *
+ * Find the value with the specified key.
+ *
+ * Returns the value or 0 when not found.
+ ***************************************************************************/
+uintptr_t
+kt_find (KeyTable *kt, const char *key, size_t length)
+{
+  const char *valuekey;
+  size_t valuelength;
+  uint32_t hash;
+  uint32_t slot;
+
+  if (!kt->count)
+    return 0;
+
+  hash = ms_fnv1a (key, length);
+
+  for (slot = hash & (kt->size - 1); kt->values[slot]; slot = (slot + 1) & (kt->size - 1))
+  {
+    if (kt->hashes[slot] != hash)
+      continue;
+
+    valuekey = kt->keyof (kt->data, kt->values[slot], &valuelength);
+
+    if (valuelength == length && !memcmp (valuekey, key, length))
+      return kt->values[slot];
+  }
+
+  return 0;
+} /* End of kt_find() */
+
+/***************************************************************************
+ * kt_add:
+ *
+ * Add a value to the table, the key of the value must not already be
+ * in the table.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+kt_add (KeyTable *kt, uintptr_t value)
+{
+  const char *key;
+  size_t length;
+  uint32_t hash;
+  uint32_t slot;
+
+  if (!value)
+    return -1;
+
+  if ((kt->count + 1) * 2 > kt->size && expand (kt))
+    return -1;
+
+  key = kt->keyof (kt->data, value, &length);
+  hash = ms_fnv1a (key, length);
+
+  for (slot = hash & (kt->size - 1); kt->values[slot]; slot = (slot + 1) & (kt->size - 1))
+    ;
+
+  kt->values[slot] = value;
+  kt->hashes[slot] = hash;
+  kt->count++;
+
+  return 0;
+} /* End of kt_add() */
+
+/***************************************************************************
+ * kt_next:
+ *
+ * Iterate over the values of the table in slot order, position must
+ * be set to 0 before the first call.  The table must not be changed
+ * while iterating.
+ *
+ * Returns the next value or 0 when all values have been returned.
+ ***************************************************************************/
+uintptr_t
+kt_next (KeyTable *kt, uint32_t *position)
+{
+  for (; *position < kt->size; (*position)++)
+  {
+    if (kt->values[*position])
+      return kt->values[(*position)++];
+  }
+
+  return 0;
+} /* End of kt_next() */
+
+/***************************************************************************
+ * kt_clear:
+ *
+ * Remove all values from the table, keeping its slots for reuse.
+ ***************************************************************************/
+void
+kt_clear (KeyTable *kt)
+{
+  if (kt->values)
+    memset (kt->values, 0, kt->size * sizeof (uintptr_t));
+
+  kt->count = 0;
+} /* End of kt_clear() */
+
+/***************************************************************************
+ * kt_free:
+ *
+ * Free the slots of the table, it is left empty and can be reused.
+ ***************************************************************************/
+void
+kt_free (KeyTable *kt)
+{
+  free (kt->values);
+  free (kt->hashes);
+
+  kt->values = NULL;
+  kt->hashes = NULL;
+  kt->size = 0;
+  kt->count = 0;
+} /* End of kt_free() */
+
+/***************************************************************************
+ * expand:
+ *
+ * Double the number of slots of the table, moving the values to the
+ * slots of their stored hashes.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+expand (KeyTable *kt)
+{
+  uintptr_t *values;
+  uint32_t *hashes;
+  uint32_t size;
+  uint32_t slot;
+  uint32_t idx;
+
+  size = (kt->size) ? kt->size * 2 : KT_MINSIZE;
+
+  if (size < kt->size ||
+      (values = (uintptr_t *)calloc (size, sizeof (uintptr_t))) == NULL)
+  {
+    fprintf (stderr, "keytable expand(): Cannot allocate memory\n");
+    return -1;
+  }
+
+  if ((hashes = (uint32_t *)malloc (size * sizeof (uint32_t))) == NULL)
+  {
+    fprintf (stderr, "keytable expand(): Cannot allocate memory\n");
+    free (values);
+    return -1;
+  }
+
+  for (idx = 0; idx < kt->size; idx++)
+  {
+    if (!kt->values[idx])
+      continue;
+
+    for (slot = kt->hashes[idx] & (size - 1); values[slot]; slot = (slot + 1) & (size - 1))
+      ;
+
+    values[slot] = kt->values[idx];
+    hashes[slot] = kt->hashes[idx];
+  }
+
+  free (kt->values);
+  free (kt->hashes);
+
+  kt->values = values;
+  kt->hashes = hashes;
+  kt->size = size;
+
+  return 0;
+} /* End of expand() */
@@ -0,0 +1,49 @@
+/***************************************************************************
+ * keytable.h
+ *
+ * A hash table of values found by a key, used for the indexes of the
+ * traces, metadata and output names and the string tables of record
+ * indexes and caches.
+ ***************************************************************************/
+
+#ifndef KEYTABLE_H
+#define KEYTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Return the key of a value and its length, data is KeyTable.data */
+typedef const char *(*KTKeyFunc) (void *data, uintptr_t value, size_t *length);
+
+/* Values are pointers or indexes identifying entries of the user,
+ * 0 cannot be stored.  Keys are not stored, they must not change while
+ * the value is in the table. */
+typedef struct KeyTable_s
+{
+  uintptr_t *values; /* Values of the slots, 0 for an empty slot */
+  uint32_t *hashes;  /* Hashes of the keys of the slots */
+  uint32_t size;     /* Number of slots, a power of 2 */
+  uint32_t count;    /* Number of values */
+  KTKeyFunc keyof;   /* Key of a value */
+  void *data;        /* Passed to keyof */
+} KeyTable;
+
+/* Initializer of a static KeyTable */
+#define KT_INITIALIZER(keyof, data) {NULL, NULL, 0, 0, (keyof), (data)}
+
+extern void kt_init (KeyTable *kt, KTKeyFunc keyof, void *data);
+extern uintptr_t kt_find (KeyTable *kt, const char *key, size_t length);
+extern int kt_add (KeyTable *kt, uintptr_t value);
+extern uintptr_t kt_next (KeyTable *kt, uint32_t *position);
+extern void kt_clear (KeyTable *kt);
+extern void kt_free (KeyTable *kt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KEYTABLE_H */
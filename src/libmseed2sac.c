@@ -0,0 +1,752 @@
+/***************************************************************************
+ * libmseed2sac.c
+ *
+ * Conversion of miniSEED traces to SAC.
+ *
+ * A SAC header is populated for a trace from the parameters in a
+ * context and the header and samples are written to a sink in the
+ * alphanumeric or binary SAC format of the context.  No global state
+ * is used, samples are converted in blocks allocated for each call and
+ * the trace is not modified, so conversions may run in parallel
+ * threads as long as each uses its own sink.
+ *
+ * Samples are converted with the routines in sampleconv.c, which are
+ * selected by m2s_initcontext() and should be selected before any
+ * threads are started.
+ ***************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmseed2sac.h"
+#include "sampleconv.h"
+
+/* Macro to test floating point number equality within 10 decimal places */
+#define FLTEQUAL(F1, F2) (fabs (F1 - F2) < 1.0E-10 * (fabs (F1) + fabs (F2) + 1.0))
+
+/* Number of samples converted to floats at a time when writing */
+#define SAMPLEBLOCK 16384
+
+/* Size of buffer for alphanumeric SAC output, must hold the header */
+#define ALPHABUFSIZE 65536
+
+static int writebinary (const struct SACHeader *sh, const MSTrace *mst, int swap,
+                        float *block, M2SSink *sink);
+static int writealpha (const struct SACHeader *sh, const MSTrace *mst, float *block,
+                       M2SSink *sink);
+static int bufferwrite (void *handle, const void *data, size_t length);
+static int delaz (double lat1, double lon1, double lat2, double lon2,
+                  double *delta, double *dist, double *azimuth, double *backazimuth);
+
+/***************************************************************************
+ * m2s_initcontext:
+ *
+ * Initialize a context to the default parameters, binary SAC in host
+ * byte order with no metadata, and select the sample conversion
+ * routines.
+ ***************************************************************************/
+void
+m2s_initcontext (M2SContext *ctx)
+{
+  memset (ctx, 0, sizeof (M2SContext));
+
+  ctx->format = M2S_BINARY;
+  ctx->latitude = M2S_UNDEF;
+  ctx->longitude = M2S_UNDEF;
+  ctx->eventlat = M2S_UNDEF;
+  ctx->eventlon = M2S_UNDEF;
+  ctx->eventdepth = M2S_UNDEF;
+
+  sc_init ();
+} /* End of m2s_initcontext() */
+
+/***************************************************************************
+ * m2s_header:
+ *
+ * Populate a SAC header for a trace.  If basename is not NULL the base
+ * of the output file name, Net.Sta.Loc.Chan.Qual.Year.Day.HourMinSec,
+ * is also returned.
+ *
+ * Returns 0 on success, 1 when there is nothing to write and -1 on error.
+ ***************************************************************************/
+int
+m2s_header (const M2SContext *ctx, const MSTrace *mst, struct SACHeader *sh,
+            char *basename, size_t basesize)
+{
+  struct SACHeader nullsh = NullSACHeader;
+  BTime btime;
+
+  const char *sacnetwork;
+  const char *sacstation;
+  const char *saclocation;
+  const char *sacchannel;
+
+  hptime_t submsec;
+  double samprate;
+  int rv;
+
+  if (!ctx || !mst || !sh)
+    return -1;
+
+  if (mst->numsamples == 0 || mst->samprate == 0.0)
+    return 1;
+
+  if (mst->numsamples > INT32_MAX || mst->numsamples < 0)
+  {
+    fprintf (stderr, "ERROR, cannot write SAC file for %s_%s_%s_%s: too many samples (%" PRId64 ")\n",
+             mst->network, mst->station, mst->location, mst->channel, mst->numsamples);
+    return -1;
+  }
+
+  samprate = mst->samprate;
+
+  /* Check reported versus derived sampling rates */
+  if (mst->starttime < mst->endtime)
+  {
+    hptime_t hptimeshift;
+    hptime_t hpdelta;
+    double derived;
+
+    /* Calculate difference between end time of last miniSEED record and the end time
+     * as calculated based on the start time, reported sample rate and number of samples. */
+    hptimeshift = llabs (mst->endtime - mst->starttime - (hptime_t) ((mst->numsamples - 1) * HPTMODULUS / mst->samprate));
+
+    /* Calculate high-precision sample period using reported sample rate */
+    hpdelta = (hptime_t) ((mst->samprate) ? (HPTMODULUS / mst->samprate) : 0.0);
+
+    /* Test if time shift is beyond half a sample period */
+    if (hptimeshift > (hpdelta * 0.5))
+    {
+      /* Derive sample rate from start and end times and number of samples */
+      derived = (double)(mst->numsamples - 1) * HPTMODULUS / (mst->endtime - mst->starttime);
+
+      if (ctx->deriverate)
+      {
+        if (ctx->verbose)
+          fprintf (stderr, "Using derived sample rate of %g over reported rate of %g\n",
+                   derived, mst->samprate);
+
+        samprate = derived;
+      }
+      else
+      {
+        fprintf (stderr, "[%s.%s.%s.%s] Reported sample rate different than derived rate (%g versus %g)\n",
+                 mst->network, mst->station, mst->location, mst->channel,
+                 mst->samprate, derived);
+        fprintf (stderr, "   Consider using the -dr option to use the sample rate derived from the series\n");
+      }
+    }
+  }
+
+  *sh = nullsh;
+
+  sacnetwork = (ctx->network) ? ctx->network : mst->network;
+  sacstation = (ctx->station) ? ctx->station : mst->station;
+  saclocation = (ctx->location) ? ctx->location : mst->location;
+  sacchannel = (ctx->channel) ? ctx->channel : mst->channel;
+
+  /* Insert dummy network code of XX if no network code is set */
+  if (!sacnetwork || *sacnetwork == '\0')
+  {
+    sacnetwork = "XX";
+    fprintf (stderr, "Warning: input data has no network code, inserting XX\n");
+  }
+
+  /* Set time-series source parameters */
+  if (sacnetwork)
+    if (*sacnetwork != '\0')
+      ms_strncpopen (sh->knetwk, (char *)sacnetwork, 8);
+  if (sacstation)
+    if (*sacstation != '\0')
+      ms_strncpopen (sh->kstnm, (char *)sacstation, 8);
+  if (saclocation)
+    if (*saclocation != '\0')
+      ms_strncpopen (sh->khole, (char *)saclocation, 8);
+  if (sacchannel)
+    if (*sacchannel != '\0')
+      ms_strncpopen (sh->kcmpnm, (char *)sacchannel, 8);
+
+  if (ctx->verbose)
+    fprintf (stderr, "Writing SAC for %.8s.%.8s.%.8s.%.8s\n",
+             sacnetwork, sacstation, saclocation, sacchannel);
+
+  /* Set misc. header variables */
+  sh->nvhdr = 6;      /* Header version = 6 */
+  sh->leven = 1;      /* Evenly spaced data */
+  sh->iftype = ITIME; /* Data is time-series */
+
+  /* Set sampling interval (seconds), sample count */
+  sh->delta = 1 / samprate;
+  sh->npts = mst->numsamples;
+
+  /* Insert metadata */
+  if (ctx->metadata)
+  {
+    rv = ctx->metadata (ctx->metahandle, sh, mst->starttime);
+
+    if (rv == -1)
+      fprintf (stderr, "Error inserting metadata for %.8s.%.8s.%.8s.%.8s\n",
+               sacnetwork, sacstation, saclocation, sacchannel);
+    else if (rv == 1)
+      fprintf (stderr, "No metadata found for %.8s.%.8s.%.8s.%.8s\n",
+               sacnetwork, sacstation, saclocation, sacchannel);
+  }
+
+  /* Set station coordinates */
+  if (ctx->latitude != M2S_UNDEF)
+    sh->stla = ctx->latitude;
+  if (ctx->longitude != M2S_UNDEF)
+    sh->stlo = ctx->longitude;
+
+  /* Set event parameters */
+  if (ctx->eventtime)
+    sh->o = (float)MS_HPTIME2EPOCH ((ctx->eventtime - mst->starttime));
+  if (ctx->eventlat != M2S_UNDEF)
+    sh->evla = (float)ctx->eventlat;
+  if (ctx->eventlon != M2S_UNDEF)
+    sh->evlo = (float)ctx->eventlon;
+  if (ctx->eventdepth != M2S_UNDEF)
+    sh->evdp = (float)ctx->eventdepth;
+  if (ctx->eventname)
+    ms_strncpopen (sh->kevnm, (char *)ctx->eventname, 16);
+
+  /* Calculate delta, distance and azimuths if both event and station coordiantes are known */
+  if (sh->evla != FUNDEF && sh->evlo != FUNDEF &&
+      sh->stla != FUNDEF && sh->stlo != FUNDEF)
+  {
+    double delta, dist, azimuth, backazimuth;
+
+    if (!delaz (sh->evla, sh->evlo, sh->stla, sh->stlo, &delta, &dist, &azimuth, &backazimuth))
+    {
+      sh->az = (float)azimuth;
+      sh->baz = (float)backazimuth;
+      sh->gcarc = (float)delta;
+      sh->dist = (float)dist;
+
+      if (ctx->verbose)
+        fprintf (stderr, "Inserting variables: AZ: %g, BAZ: %g, GCARC: %g, DIST: %g\n",
+                 sh->az, sh->baz, sh->gcarc, sh->dist);
+    }
+  }
+
+  /* Set reference time */
+  ms_hptime2btime (mst->starttime, &btime);
+  sh->nzyear = btime.year;
+  sh->nzjday = btime.day;
+  sh->nzhour = btime.hour;
+  sh->nzmin = btime.min;
+  sh->nzsec = btime.sec;
+  sh->nzmsec = btime.fract / 10;
+
+  /* Determine any sub-millisecond portion of the start time in HP time */
+  submsec = (mst->starttime -
+             ms_time2hptime (sh->nzyear, sh->nzjday, sh->nzhour,
+                             sh->nzmin, sh->nzsec, sh->nzmsec * 1000));
+
+  /* Set begin and end offsets from reference time for first and last sample,
+   * any sub-millisecond start time is stored in these offsets. */
+  sh->b = ((float)submsec / HPTMODULUS);
+  sh->e = (mst->numsamples - 1) * (1 / samprate) + ((float)submsec / HPTMODULUS);
+
+  /* Create base output file name: Net.Sta.Loc.Chan.Qual.Year.Day.HourMinSec */
+  if (basename)
+    snprintf (basename, basesize, "%s.%s.%s.%s.%c.%04d.%03d.%02d%02d%02d",
+              sacnetwork, sacstation, saclocation, sacchannel,
+              mst->dataquality, btime.year, btime.day, btime.hour,
+              btime.min, btime.sec);
+
+  return 0;
+} /* End of m2s_header() */
+
+/***************************************************************************
+ * m2s_writedata:
+ *
+ * Write a SAC header and the samples of a trace to a sink in the
+ * format of the context.  The header is byte swapped as needed for
+ * binary formats, the header passed is not modified.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+m2s_writedata (const M2SContext *ctx, const struct SACHeader *sh,
+               const MSTrace *mst, M2SSink *sink)
+{
+  float *block;
+  int rv;
+
+  if (!ctx || !sh || !mst || !sink || !sink->write)
+    return -1;
+
+  if (mst->sampletype != 'f' && mst->sampletype != 'i' && mst->sampletype != 'd')
+  {
+    fprintf (stderr, "Error, unrecognized sample type: '%c'\n", mst->sampletype);
+    return -1;
+  }
+
+  if (ctx->format < M2S_ALPHA || ctx->format > M2S_BINARYBE)
+  {
+    fprintf (stderr, "Error, unrecognized format: '%d'\n", ctx->format);
+    return -1;
+  }
+
+  /* Allocate block for converting samples to floats */
+  if ((block = (float *)malloc (SAMPLEBLOCK * sizeof (float))) == NULL)
+  {
+    fprintf (stderr, "Error allocating memory\n");
+    return -1;
+  }
+
+  if (ctx->format == M2S_ALPHA)
+    rv = writealpha (sh, mst, block, sink);
+  else
+    rv = writebinary (sh, mst, m2s_swapneeded (ctx), block, sink);
+
+  free (block);
+
+  return rv;
+} /* End of m2s_writedata() */
+
+/***************************************************************************
+ * m2s_writetrace:
+ *
+ * Write a trace as a SAC file to a sink.  The sink begin() callback,
+ * if set, is called with the output file name, Net.Sta.Loc.Chan.Qual.
+ * Year.Day.HourMinSec.SAC (SACA for alphanumeric), before the file is
+ * written and the end() callback, if set, after.
+ *
+ * Returns the number of samples written, 0 when there is nothing to
+ * write and -1 on error.
+ ***************************************************************************/
+int
+m2s_writetrace (const M2SContext *ctx, const MSTrace *mst, M2SSink *sink)
+{
+  struct SACHeader sh;
+  char basename[1024];
+  char name[sizeof (basename) + 5]; /* Base name and ".SACA" */
+  int rv;
+
+  if ((rv = m2s_header (ctx, mst, &sh, basename, sizeof (basename))))
+    return (rv > 0) ? 0 : -1;
+
+  snprintf (name, sizeof (name), "%s.SAC%s", basename, (ctx->format == M2S_ALPHA) ? "A" : "");
+
+  if (sink->begin && sink->begin (sink->handle, name, mst))
+    return -1;
+
+  if (m2s_writedata (ctx, &sh, mst, sink))
+    return -1;
+
+  if (sink->end && sink->end (sink->handle))
+    return -1;
+
+  return (int)mst->numsamples;
+} /* End of m2s_writetrace() */
+
+/***************************************************************************
+ * m2s_writetracelist:
+ *
+ * Write each segment of each trace in a MSTraceList as a SAC file to a
+ * sink, see m2s_writetrace().
+ *
+ * Returns the number of SAC files written or -1 on error.
+ ***************************************************************************/
+int
+m2s_writetracelist (const M2SContext *ctx, const MSTraceList *mstl, M2SSink *sink)
+{
+  MSTraceID *id;
+  MSTraceSeg *seg;
+  MSTrace mst;
+  int count = 0;
+  int rv;
+
+  if (!mstl)
+    return -1;
+
+  for (id = mstl->traces; id; id = id->next)
+  {
+    for (seg = id->first; seg; seg = seg->next)
+    {
+      memset (&mst, 0, sizeof (MSTrace));
+      memcpy (mst.network, id->network, sizeof (mst.network));
+      memcpy (mst.station, id->station, sizeof (mst.station));
+      memcpy (mst.location, id->location, sizeof (mst.location));
+      memcpy (mst.channel, id->channel, sizeof (mst.channel));
+      mst.dataquality = id->dataquality;
+      mst.type = id->type;
+      mst.starttime = seg->starttime;
+      mst.endtime = seg->endtime;
+      mst.samprate = seg->samprate;
+      mst.samplecnt = seg->samplecnt;
+      mst.datasamples = seg->datasamples;
+      mst.numsamples = seg->numsamples;
+      mst.sampletype = seg->sampletype;
+
+      if ((rv = m2s_writetrace (ctx, &mst, sink)) < 0)
+        return -1;
+
+      if (rv > 0)
+        count++;
+    }
+  }
+
+  return count;
+} /* End of m2s_writetracelist() */
+
+/***************************************************************************
+ * m2s_getsamples:
+ *
+ * Get count samples of a MSTrace starting at offset as floats, byte
+ * swapped if swap is true.  Samples are converted into the block
+ * buffer, which must hold at least count floats, unless the trace
+ * samples are floats that do not need to be swapped.
+ *
+ * Returns a pointer to the float samples.
+ ***************************************************************************/
+float *
+m2s_getsamples (const MSTrace *mst, int64_t offset, int64_t count, int swap, float *block)
+{
+  if (mst->sampletype == 'i')
+  {
+    sc_int32tofloat (block, (int32_t *)mst->datasamples + offset, count, swap);
+  }
+  else if (mst->sampletype == 'd')
+  {
+    sc_doubletofloat (block, (double *)mst->datasamples + offset, count, swap);
+  }
+  else if (swap)
+  {
+    memcpy (block, (float *)mst->datasamples + offset, count * sizeof (float));
+    sc_swapfloat (block, count);
+  }
+  else
+  {
+    return (float *)mst->datasamples + offset;
+  }
+
+  return block;
+} /* End of m2s_getsamples() */
+
+/***************************************************************************
+ * m2s_swapneeded:
+ *
+ * Determine if binary SAC headers and data need to be byte swapped for
+ * the format of a context.
+ *
+ * Returns 1 if byte swapping is needed and 0 otherwise.
+ ***************************************************************************/
+int
+m2s_swapneeded (const M2SContext *ctx)
+{
+  return ((ctx->format == M2S_BINARYLE && ms_bigendianhost ()) ||
+          (ctx->format == M2S_BINARYBE && !ms_bigendianhost ()));
+} /* End of m2s_swapneeded() */
+
+/***************************************************************************
+ * m2s_buffersink:
+ *
+ * Initialize a sink that appends the SAC files written to a memory
+ * buffer.  The buffer should be initialized to zeros or contain an
+ * allocated buffer, its data is freed with m2s_freebuffer().
+ ***************************************************************************/
+void
+m2s_buffersink (M2SSink *sink, M2SBuffer *buffer)
+{
+  memset (sink, 0, sizeof (M2SSink));
+
+  sink->write = bufferwrite;
+  sink->handle = buffer;
+} /* End of m2s_buffersink() */
+
+/***************************************************************************
+ * m2s_freebuffer:
+ *
+ * Free the data of a memory buffer and reset it.
+ ***************************************************************************/
+void
+m2s_freebuffer (M2SBuffer *buffer)
+{
+  if (!buffer)
+    return;
+
+  free (buffer->data);
+  memset (buffer, 0, sizeof (M2SBuffer));
+} /* End of m2s_freebuffer() */
+
+/***************************************************************************
+ * writebinary:
+ *
+ * Write a binary SAC header and samples to a sink, converting samples
+ * to floats in blocks.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+writebinary (const struct SACHeader *sh, const MSTrace *mst, int swap,
+             float *block, M2SSink *sink)
+{
+  struct SACHeader swapped;
+  const float *fdata;
+  int64_t npts = mst->numsamples;
+  int64_t count;
+  int64_t idx;
+
+  if (swap)
+  {
+    swapped = *sh;
+
+    for (idx = 0; idx < (NUMFLOATHDR + NUMINTHDR); idx++)
+      ms_gswap4 ((int32_t *)&swapped + idx);
+
+    sh = &swapped;
+  }
+
+  if (sink->write (sink->handle, sh, sizeof (struct SACHeader)))
+    return -1;
+
+  /* Write float samples directly or in converted blocks */
+  if (mst->sampletype == 'f' && !swap)
+    return (npts && sink->write (sink->handle, mst->datasamples, npts * sizeof (float))) ? -1 : 0;
+
+  for (idx = 0; idx < npts; idx += count)
+  {
+    count = (npts - idx < SAMPLEBLOCK) ? npts - idx : SAMPLEBLOCK;
+    fdata = m2s_getsamples (mst, idx, count, swap, block);
+
+    if (sink->write (sink->handle, fdata, count * sizeof (float)))
+      return -1;
+  }
+
+  return 0;
+} /* End of writebinary() */
+
+/***************************************************************************
+ * writealpha:
+ *
+ * Write an alphanumeric SAC header and samples to a sink, formatted in
+ * a buffer that is written whenever it cannot hold another line.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+writealpha (const struct SACHeader *sh, const MSTrace *mst, float *block,
+            M2SSink *sink)
+{
+  char *buffer;
+  char *bp;
+  float *fdata = 0;
+  int64_t npts = mst->numsamples;
+  int64_t blockstart = 0;
+  int64_t blockend = 0;
+  int64_t idx, fidx;
+  int rv = 0;
+
+  /* Declare and set up pointers to header variable type sections */
+  const float *fhp = (const float *)sh;
+  const int32_t *ihp = (const int32_t *)sh + (NUMFLOATHDR);
+  const char *shp = (const char *)sh + (NUMFLOATHDR * 4 + NUMINTHDR * 4);
+
+  if ((buffer = (char *)malloc (ALPHABUFSIZE)) == NULL)
+  {
+    fprintf (stderr, "Error allocating memory\n");
+    return -1;
+  }
+
+  /* Generate header in buffer */
+  bp = buffer;
+
+  /* Write SAC header float variables, 5 variables per line */
+  for (idx = 0; idx < NUMFLOATHDR; idx += 5)
+  {
+    for (fidx = idx; fidx < (idx + 5) && fidx < NUMFLOATHDR; fidx++)
+    {
+      sc_formatalpha (bp, *(fhp + fidx));
+      bp += 15;
+    }
+
+    *bp++ = '\n';
+  }
+
+  /* Write SAC header integer variables, 5 variables per line */
+  for (idx = 0; idx < NUMINTHDR; idx += 5)
+  {
+    for (fidx = idx; fidx < (idx + 5) && fidx < NUMINTHDR; fidx++)
+    {
+      sprintf (bp, "%10d", *(ihp + fidx));
+      bp += 10;
+    }
+
+    sprintf (bp, "\n");
+    bp += 1;
+  }
+
+  /* Write SAC header string variables, 3 variables per line */
+  for (idx = 0; idx < (NUMSTRHDR + 1); idx += 3)
+  {
+    if (idx == 0)
+    {
+      sprintf (bp, "%-8.8s%-16.16s", shp, shp + 8);
+      bp += 24;
+    }
+    else
+    {
+      for (fidx = idx; fidx < (idx + 3) && fidx < (NUMSTRHDR + 1); fidx++)
+      {
+        sprintf (bp, "%-8.8s", shp + (fidx * 8));
+        bp += 8;
+      }
+    }
+
+    sprintf (bp, "\n");
+    bp += 1;
+  }
+
+  /* Write float data after the header, 5 values per line, writing the
+   * buffer whenever it cannot hold another line */
+  for (idx = 0; idx < npts && !rv; idx += 5)
+  {
+    for (fidx = idx; fidx < (idx + 5) && fidx < npts && fidx >= 0; fidx++)
+    {
+      if (fidx >= blockend)
+      {
+        blockstart = fidx;
+        blockend = (npts - fidx < SAMPLEBLOCK) ? npts : fidx + SAMPLEBLOCK;
+        fdata = m2s_getsamples (mst, blockstart, blockend - blockstart, 0, block);
+      }
+
+      sc_formatalpha (bp, fdata[fidx - blockstart]);
+      bp += 15;
+    }
+
+    *bp++ = '\n';
+
+    if ((bp - buffer) > (ALPHABUFSIZE - 76))
+    {
+      rv = (sink->write (sink->handle, buffer, bp - buffer)) ? -1 : 0;
+      bp = buffer;
+    }
+  }
+
+  if (!rv && bp > buffer)
+    rv = (sink->write (sink->handle, buffer, bp - buffer)) ? -1 : 0;
+
+  free (buffer);
+
+  return rv;
+} /* End of writealpha() */
+
+/***************************************************************************
+ * bufferwrite:
+ *
+ * Sink write callback appending data to a memory buffer, growing the
+ * buffer as needed.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+bufferwrite (void *handle, const void *data, size_t length)
+{
+  M2SBuffer *buffer = (M2SBuffer *)handle;
+  size_t newsize;
+  char *newdata;
+
+  if (buffer->length + length > buffer->size)
+  {
+    newsize = (buffer->size) ? buffer->size : ALPHABUFSIZE;
+
+    while (newsize < buffer->length + length)
+      newsize *= 2;
+
+    if ((newdata = (char *)realloc (buffer->data, newsize)) == NULL)
+    {
+      fprintf (stderr, "bufferwrite(): Cannot allocate memory\n");
+      return -1;
+    }
+
+    buffer->data = newdata;
+    buffer->size = newsize;
+  }
+
+  memcpy (buffer->data + buffer->length, data, length);
+  buffer->length += length;
+
+  return 0;
+} /* End of bufferwrite() */
+
+/***************************************************************************
+ * delaz:
+ *
+ * Calculate the angular distance (and approximately equivalent
+ * kilometers), azimuth and back azimuth for specified coordinates.
+ * Latitudes are converted to geocentric latitudes using the WGS84
+ * spheriod to correct for ellipticity.
+ *
+ * delta       : angular distance (degrees)
+ * dist        : distance (kilometers, 111.19 km/deg)
+ * azimuth     : azimuth from 1 to 2 (degrees)
+ * backazimuth : azimuth from 2 to 1 (degrees)
+ *
+ * Returns 0 on sucess and -1 on failure.
+ ***************************************************************************/
+static int
+delaz (double lat1, double lon1, double lat2, double lon2,
+       double *delta, double *dist, double *azimuth, double *backazimuth)
+{
+  /* Major and minor axies for WGS84 spheriod */
+  const double semimajor = 6378137.0;
+  const double semiminor = 6356752.3142;
+
+  double ratio2, pirad, halfpi, nlat1, nlat2, gamma, a, b, sita, bsita;
+
+  ratio2 = ((semiminor * semiminor) / (semimajor * semimajor));
+
+  pirad = acos (-1.0) / 180.0;
+  halfpi = acos (-1.0) / 2.0;
+
+  /* Convert latitude to geocentric coordinates */
+  nlat1 = atan (ratio2 * tan (lat1 * pirad));
+  nlat2 = atan (ratio2 * tan (lat2 * pirad));
+
+  /* Great circle calculation for delta and azimuth */
+  gamma = (lon2 - lon1) * pirad;
+  a = (halfpi - nlat2);
+  b = (halfpi - nlat1);
+
+  if (a == 0.0)
+    sita = 1.0;
+  else if (nlat2 == 0.0)
+    sita = 0.0;
+  else
+    sita = sin (b) / tan (a);
+
+  if (b == 0.0)
+    bsita = 1.0;
+  else if (nlat1 == 0.0)
+    bsita = 0.0;
+  else
+    bsita = sin (a) / tan (b);
+
+  *delta = acos (cos (a) * cos (b) + sin (a) * sin (b) * cos (gamma)) / pirad;
+  if (FLTEQUAL (*delta, 0.0))
+    *delta = 0.0;
+
+  /* 111.19 km/deg */
+  *dist = *delta * 111.19;
+  if (FLTEQUAL (*dist, 0.0))
+    *dist = 0.0;
+
+  *azimuth = atan2 (sin (gamma), sita - cos (gamma) * cos (b)) / pirad;
+  if (FLTEQUAL (*azimuth, 0.0))
+    *azimuth = 0.0;
+  else if (*azimuth < 0.0)
+    *azimuth += 360;
+
+  *backazimuth = atan2 (-sin (gamma), bsita - cos (gamma) * cos (a)) / pirad;
+  if (FLTEQUAL (*backazimuth, 0.0))
+    *backazimuth = 0.0;
+  else if (*backazimuth < 0.0)
+    *backazimuth += 360;
+
+  return 0;
+} /* End of delaz() */
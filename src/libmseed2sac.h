@@ -0,0 +1,93 @@
+/***************************************************************************
+ * libmseed2sac.h
+ *
+ * Conversion of miniSEED traces to SAC, a reentrant interface for
+ * embedding the conversion in other programs.  All parameters of a
+ * conversion are held in a context and output is written to a sink,
+ * either user supplied callbacks or a growing memory buffer, so
+ * conversions with separate contexts and sinks may run concurrently.
+ ***************************************************************************/
+
+#ifndef LIBMSEED2SAC_H
+#define LIBMSEED2SAC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libmseed.h>
+
+#include "sacformat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Value of context parameters that are not set */
+#define M2S_UNDEF -999.0
+
+/* SAC file formats */
+#define M2S_ALPHA 1    /* Alphanumeric */
+#define M2S_BINARY 2   /* Binary, host byte order */
+#define M2S_BINARYLE 3 /* Binary, little-endian */
+#define M2S_BINARYBE 4 /* Binary, big-endian */
+
+/* Parameters of a conversion, initialize with m2s_initcontext() */
+typedef struct M2SContext_s
+{
+  int format;           /* SAC file format, M2S_BINARY by default */
+  int deriverate;       /* Use sample rate derived from trace times if different */
+  const char *network;  /* Source name overrides, NULL to use trace values */
+  const char *station;
+  const char *location;
+  const char *channel;
+  double latitude;      /* Station coordinates, M2S_UNDEF if not set */
+  double longitude;
+  hptime_t eventtime;   /* Event parameters, 0 and M2S_UNDEF if not set */
+  double eventlat;
+  double eventlon;
+  double eventdepth;
+  const char *eventname;
+  /* Insert metadata into a header populated with the source name,
+   * returns 0 on success, 1 when no metadata is found and -1 on error */
+  int (*metadata) (void *handle, struct SACHeader *sh, hptime_t starttime);
+  void *metahandle;
+  int verbose;
+} M2SContext;
+
+/* Destination of SAC files, begin() and end() are optional and called
+ * around each file written by m2s_writetrace(), write() is called with
+ * the contents of a file in order.  Callbacks return 0 on success. */
+typedef struct M2SSink_s
+{
+  int (*begin) (void *handle, const char *name, const MSTrace *mst);
+  int (*write) (void *handle, const void *data, size_t length);
+  int (*end) (void *handle);
+  void *handle;
+} M2SSink;
+
+/* Memory buffer for a sink, data is allocated with malloc() */
+typedef struct M2SBuffer_s
+{
+  char *data;
+  size_t length;
+  size_t size;
+} M2SBuffer;
+
+extern void m2s_initcontext (M2SContext *ctx);
+extern int m2s_header (const M2SContext *ctx, const MSTrace *mst, struct SACHeader *sh,
+                       char *basename, size_t basesize);
+extern int m2s_writedata (const M2SContext *ctx, const struct SACHeader *sh,
+                          const MSTrace *mst, M2SSink *sink);
+extern int m2s_writetrace (const M2SContext *ctx, const MSTrace *mst, M2SSink *sink);
+extern int m2s_writetracelist (const M2SContext *ctx, const MSTraceList *mstl, M2SSink *sink);
+extern float *m2s_getsamples (const MSTrace *mst, int64_t offset, int64_t count,
+                              int swap, float *block);
+extern int m2s_swapneeded (const M2SContext *ctx);
+extern void m2s_buffersink (M2SSink *sink, M2SBuffer *buffer);
+extern void m2s_freebuffer (M2SBuffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBMSEED2SAC_H */
@@ -0,0 +1,23 @@
+/***************************************************************************
+ * m2splatform.h
+ *
+ * Platform dependent definitions shared by the mseed2sac modules.
+ *
+ * Threads are not used on Windows, NOPTHREADS is defined so that the
+ * modules are built without their threaded features.
+ ***************************************************************************/
+
+#ifndef M2SPLATFORM_H
+#define M2SPLATFORM_H
+
+#if defined(WIN32) || defined(WIN64)
+#ifndef NOPTHREADS
+#define NOPTHREADS
+#endif
+#endif
+
+#ifndef NOPTHREADS
+#include <pthread.h>
+#endif
+
+#endif /* M2SPLATFORM_H */
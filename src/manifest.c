@@ -0,0 +1,204 @@
+/***************************************************************************
+ * manifest.c
+ *
+ * Manifest of the SAC files written by a run.
+ *
+ * An entry is added with mf_add() for each SAC file written, entries
+ * may be added from multiple threads.  The manifest is written as JSON
+ * by mf_write(), entries sorted by their location in the output and
+ * then by name so that the manifest of a run is reproducible.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jsonout.h"
+#include "m2splatform.h"
+#include "manifest.h"
+
+static MFEntry *entries = NULL;
+static int entrycount = 0;
+static int entrysize = 0;
+
+#ifndef NOPTHREADS
+static pthread_mutex_t manifestlock = PTHREAD_MUTEX_INITIALIZER;
+#define MF_LOCK() pthread_mutex_lock (&manifestlock)
+#define MF_UNLOCK() pthread_mutex_unlock (&manifestlock)
+#else
+#define MF_LOCK()
+#define MF_UNLOCK()
+#endif
+
+static int compareentries (const void *a, const void *b);
+static void printtime (FILE *fp, hptime_t time);
+
+/***************************************************************************
+ * mf_add:
+ *
+ * Add a copy of an entry to the manifest.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+mf_add (const MFEntry *entry)
+{
+  MFEntry *newentries;
+  int newsize;
+
+  MF_LOCK ();
+
+  if (entrycount >= entrysize)
+  {
+    newsize = (entrysize) ? entrysize * 2 : 256;
+
+    if (!(newentries = (MFEntry *)realloc (entries, newsize * sizeof (MFEntry))))
+    {
+      MF_UNLOCK ();
+      fprintf (stderr, "Cannot allocate memory for manifest entries\n");
+      return -1;
+    }
+
+    entries = newentries;
+    entrysize = newsize;
+  }
+
+  entries[entrycount++] = *entry;
+
+  MF_UNLOCK ();
+
+  return 0;
+} /* End of mf_add() */
+
+/***************************************************************************
+ * mf_write:
+ *
+ * Write the manifest as JSON to manifestfile, or to stdout if "-".
+ * The shard and shards values identify the shard of a sharded run and
+ * are 0 and 1 otherwise, the container is "zip", "bundle" or "files"
+ * and output is the name of the ZIP archive or bundle if any.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+mf_write (const char *manifestfile, int shard, int shards,
+          const char *container, const char *output)
+{
+  FILE *fp;
+  int idx;
+  int rv;
+
+  if (!strcmp (manifestfile, "-"))
+  {
+    fp = stdout;
+  }
+  else if (!(fp = fopen (manifestfile, "w")))
+  {
+    fprintf (stderr, "Cannot open manifest file: %s\n", manifestfile);
+    return -1;
+  }
+
+  MF_LOCK ();
+
+  if (entrycount > 1)
+    qsort (entries, entrycount, sizeof (MFEntry), compareentries);
+
+  fprintf (fp, "{\n");
+  fprintf (fp, "  \"shard\": %d,\n", shard);
+  fprintf (fp, "  \"shards\": %d,\n", shards);
+  fprintf (fp, "  \"container\": \"%s\",\n", container);
+  fprintf (fp, "  \"output\": ");
+  if (output)
+  {
+    fprintf (fp, "\"");
+    json_printstring (fp, output);
+    fprintf (fp, "\",\n");
+  }
+  else
+  {
+    fprintf (fp, "null,\n");
+  }
+  fprintf (fp, "  \"count\": %d,\n", entrycount);
+  fprintf (fp, "  \"entries\": [\n");
+
+  for (idx = 0; idx < entrycount; idx++)
+  {
+    fprintf (fp, "    {\"name\": \"");
+    json_printstring (fp, entries[idx].name);
+    fprintf (fp, "\", \"source\": \"");
+    json_printstring (fp, entries[idx].srcname);
+    fprintf (fp, "\", \"start\": ");
+    printtime (fp, entries[idx].starttime);
+    fprintf (fp, ", \"end\": ");
+    printtime (fp, entries[idx].endtime);
+    fprintf (fp, ", \"samples\": %lld, \"size\": %lld",
+             (long long int)entries[idx].samples, (long long int)entries[idx].size);
+
+    if (entries[idx].method >= 0)
+      fprintf (fp, ", \"offset\": %lld, \"length\": %lld, \"crc32\": \"%08x\", \"method\": %d",
+               (long long int)entries[idx].offset, (long long int)entries[idx].length,
+               (unsigned int)entries[idx].crc32, entries[idx].method);
+    else if (!strcmp (container, "bundle"))
+      fprintf (fp, ", \"offset\": %lld, \"length\": %lld",
+               (long long int)entries[idx].offset, (long long int)entries[idx].length);
+
+    fprintf (fp, "}%s\n", (idx < entrycount - 1) ? "," : "");
+  }
+
+  fprintf (fp, "  ]\n");
+  fprintf (fp, "}\n");
+
+  MF_UNLOCK ();
+
+  rv = (ferror (fp)) ? -1 : 0;
+
+  if (fp != stdout)
+  {
+    if (fclose (fp))
+      rv = -1;
+  }
+  else
+  {
+    fflush (fp);
+  }
+
+  if (rv)
+    fprintf (stderr, "Error writing manifest file: %s\n", manifestfile);
+
+  return rv;
+} /* End of mf_write() */
+
+/***************************************************************************
+ * compareentries:
+ *
+ * Compare entries by offset and then by name for qsort().
+ *
+ * Returns -1, 0 or 1 for a less than, equal to or greater than b.
+ ***************************************************************************/
+static int
+compareentries (const void *a, const void *b)
+{
+  const MFEntry *ea = (const MFEntry *)a;
+  const MFEntry *eb = (const MFEntry *)b;
+
+  if (ea->offset != eb->offset)
+    return (ea->offset < eb->offset) ? -1 : 1;
+
+  return strcmp (ea->name, eb->name);
+} /* End of compareentries() */
+
+/***************************************************************************
+ * printtime:
+ *
+ * Print a time as a JSON string in ISO format.
+ ***************************************************************************/
+static void
+printtime (FILE *fp, hptime_t time)
+{
+  char timestr[40];
+
+  if (ms_hptime2isotimestr (time, timestr, 1))
+    fprintf (fp, "\"%s\"", timestr);
+  else
+    fprintf (fp, "null");
+} /* End of printtime() */
@@ -0,0 +1,43 @@
+/***************************************************************************
+ * manifest.h
+ *
+ * Manifest of the SAC files written by a run, listing the location of
+ * each file in its output ZIP archive or bundle so that the outputs of
+ * separate runs, such as the shards of a sharded conversion, can be
+ * combined without decompressing or parsing them.
+ ***************************************************************************/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <stdint.h>
+
+#include <libmseed.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MFEntry_s
+{
+  char name[1024];    /* SAC file name */
+  char srcname[64];   /* Source name, Net_Sta_Loc_Chan_Qual */
+  hptime_t starttime; /* Time of first sample */
+  hptime_t endtime;   /* Time of last sample */
+  int64_t samples;    /* Number of samples */
+  int64_t offset;     /* Offset of ZIP local header or bundle entry, 0 for files */
+  int64_t length;     /* Length of stored, possibly compressed, data */
+  int64_t size;       /* Size of SAC file */
+  uint32_t crc32;     /* CRC-32 of SAC file, ZIP entries only */
+  int method;         /* ZIP compression method, -1 if not in a ZIP archive */
+} MFEntry;
+
+extern int mf_add (const MFEntry *entry);
+extern int mf_write (const char *manifestfile, int shard, int shards,
+                     const char *container, const char *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANIFEST_H */
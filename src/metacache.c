@@ -0,0 +1,416 @@
+/***************************************************************************
+ * metacache.c
+ *
+ * Compiled caches of text input files.
+ *
+ * A cache file is a sidecar of a metadata or data selection file, see
+ * sidecar.c, with MC_SUFFIX added to the name.  The parsed lines of
+ * the text file are stored as an array of fixed size entries of the
+ * kind of the cache, MCMetaEntry or MCSelectEntry, followed by a table
+ * of the terminated strings they reference by offset.  Each distinct
+ * string is stored once.  The file is laid out so that it can be used
+ * in place: where supported it is memory mapped and the entries and
+ * strings are not copied, they must not be modified.  A cache of
+ * another kind or entry size is ignored.
+ *
+ * Cache file layout:
+ *   char     magic[8]     "M2SC01\n\0"
+ *   uint32_t byteorder    0x01020304
+ *   uint32_t kind
+ *   uint32_t entrysize
+ *   uint32_t flags
+ *   int64_t  filesize
+ *   int64_t  filetime
+ *   int64_t  count
+ *   int64_t  strsize
+ *   count x entry
+ *   char     strings[strsize]
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "metacache.h"
+#include "sidecar.h"
+
+/* Cache files are read using a memory mapping where supported */
+#if !defined(WIN32) && !defined(WIN64)
+#define MC_MMAP 1
+#include <sys/mman.h>
+#endif
+
+#define MC_MAGIC "M2SC01\n"
+#define MC_HEADERSIZE 56
+
+static const char *stringof (void *data, uintptr_t value, size_t *length);
+
+/***************************************************************************
+ * mc_init:
+ *
+ * Allocate and initialize an empty cache of the specified kind with
+ * entries of entrysize bytes for building.
+ *
+ * Returns a pointer to a new MCache on success and NULL on error.
+ ***************************************************************************/
+MCache *
+mc_init (uint32_t kind, uint32_t entrysize)
+{
+  MCache *cache;
+
+  if ((cache = (MCache *)calloc (1, sizeof (MCache))) == NULL)
+  {
+    fprintf (stderr, "mc_init(): Cannot allocate memory\n");
+    return NULL;
+  }
+
+  cache->kind = kind;
+  cache->entrysize = entrysize;
+  kt_init (&cache->strtable, stringof, cache);
+
+  return cache;
+} /* End of mc_init() */
+
+/***************************************************************************
+ * mc_addentry:
+ *
+ * Add an entry to the end of a cache being built.
+ *
+ * Returns a pointer to the new entry, set to zero, on success and NULL
+ * on error.
+ ***************************************************************************/
+void *
+mc_addentry (MCache *cache)
+{
+  void *newentries;
+  int64_t newsize;
+
+  if (!cache || cache->base)
+    return NULL;
+
+  if (cache->count >= cache->size)
+  {
+    newsize = (cache->size) ? cache->size * 2 : 256;
+
+    if ((newentries = realloc (cache->entries, newsize * cache->entrysize)) == NULL)
+    {
+      fprintf (stderr, "mc_addentry(): Cannot allocate memory\n");
+      return NULL;
+    }
+
+    cache->entries = (char *)newentries;
+    cache->size = newsize;
+  }
+
+  memset (cache->entries + cache->count * cache->entrysize, 0, cache->entrysize);
+
+  return cache->entries + cache->count++ * cache->entrysize;
+} /* End of mc_addentry() */
+
+/***************************************************************************
+ * mc_addstring:
+ *
+ * Add a string to the string table of a cache being built and set
+ * offset to its reference, a NULL string is referenced as 0.  Each
+ * distinct string is stored once.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+mc_addstring (MCache *cache, const char *string, uint32_t *offset)
+{
+  void *newstrings;
+  int64_t length;
+  int64_t newalloc;
+
+  if (!cache || !offset || cache->base)
+    return -1;
+
+  if (!string)
+  {
+    *offset = 0;
+    return 0;
+  }
+
+  if ((*offset = (uint32_t)kt_find (&cache->strtable, string, strlen (string))))
+    return 0;
+
+  length = strlen (string) + 1;
+
+  if (cache->strsize + length >= UINT32_MAX)
+  {
+    fprintf (stderr, "mc_addstring(): String table too large\n");
+    return -1;
+  }
+
+  if (cache->strsize + length > cache->stralloc)
+  {
+    newalloc = (cache->stralloc) ? cache->stralloc * 2 : 4096;
+
+    while (newalloc < cache->strsize + length)
+      newalloc *= 2;
+
+    if ((newstrings = realloc (cache->strings, newalloc)) == NULL)
+    {
+      fprintf (stderr, "mc_addstring(): Cannot allocate memory\n");
+      return -1;
+    }
+
+    cache->strings = (char *)newstrings;
+    cache->stralloc = newalloc;
+  }
+
+  memcpy (cache->strings + cache->strsize, string, length);
+  *offset = (uint32_t)(cache->strsize + 1);
+  cache->strsize += length;
+
+  return kt_add (&cache->strtable, *offset);
+} /* End of mc_addstring() */
+
+/***************************************************************************
+ * mc_string:
+ *
+ * Find a string referenced by an entry, valid is set to 0 if the
+ * reference is outside of the string table and 1 otherwise.
+ *
+ * Returns a pointer to the string or NULL for a NULL or invalid
+ * reference.
+ ***************************************************************************/
+const char *
+mc_string (MCache *cache, uint32_t offset, int *valid)
+{
+  *valid = (offset <= cache->strsize);
+
+  if (offset == 0 || !*valid)
+    return NULL;
+
+  return cache->strings + offset - 1;
+} /* End of mc_string() */
+
+/***************************************************************************
+ * mc_read:
+ *
+ * Read the cache file of a text file, it must be of the specified
+ * kind and entry size and match the size and modification time of the
+ * text file.
+ *
+ * Returns a pointer to a MCache on success and NULL when no usable
+ * cache exists or on error.
+ ***************************************************************************/
+MCache *
+mc_read (const char *srcfile, uint32_t kind, uint32_t entrysize, int verbose)
+{
+  MCache *cache = NULL;
+  FILE *cfp;
+  struct stat sbuf;
+  char cachefile[1024];
+  char *header;
+  uint32_t fileentrysize;
+  int64_t filesize;
+  int64_t filetime;
+  int64_t cachefilesize;
+  int64_t cachefiletime;
+
+  if (sc_path (cachefile, sizeof (cachefile), srcfile, MC_SUFFIX))
+    return NULL;
+
+  if ((cfp = fopen (cachefile, "rb")) == NULL)
+    return NULL;
+
+  if (fstat (fileno (cfp), &sbuf) || sbuf.st_size < MC_HEADERSIZE ||
+      (off_t)(size_t)sbuf.st_size != sbuf.st_size)
+  {
+    if (verbose)
+      fprintf (stderr, "Ignoring unrecognized cache file %s\n", cachefile);
+
+    fclose (cfp);
+    return NULL;
+  }
+
+  if ((cache = mc_init (kind, entrysize)) == NULL)
+  {
+    fclose (cfp);
+    return NULL;
+  }
+
+  cache->length = (size_t)sbuf.st_size;
+
+#if defined(MC_MMAP)
+  cache->base = mmap (NULL, cache->length, PROT_READ, MAP_PRIVATE, fileno (cfp), 0);
+
+  if (cache->base == MAP_FAILED)
+    cache->base = NULL;
+  else
+    cache->mapped = 1;
+#endif
+
+  if (!cache->base)
+  {
+    if ((cache->base = malloc (cache->length)) == NULL)
+    {
+      fprintf (stderr, "mc_read(): Cannot allocate memory\n");
+      goto failure;
+    }
+
+    if (fread (cache->base, cache->length, 1, cfp) != 1)
+    {
+      fprintf (stderr, "Error reading cache file %s\n", cachefile);
+      goto failure;
+    }
+  }
+
+  header = (char *)cache->base;
+  memcpy (&cache->kind, header + 12, sizeof (cache->kind));
+  memcpy (&fileentrysize, header + 16, sizeof (fileentrysize));
+  memcpy (&cache->flags, header + 20, sizeof (cache->flags));
+  memcpy (&cachefilesize, header + 24, sizeof (cachefilesize));
+  memcpy (&cachefiletime, header + 32, sizeof (cachefiletime));
+  memcpy (&cache->count, header + 40, sizeof (cache->count));
+  memcpy (&cache->strsize, header + 48, sizeof (cache->strsize));
+
+  if (sc_checkheader (header, MC_MAGIC) || cache->kind != kind || fileentrysize != entrysize ||
+      cache->count < 0 || cache->strsize < 0 ||
+      cache->count > (int64_t)(cache->length - MC_HEADERSIZE) / entrysize ||
+      (int64_t)cache->length != MC_HEADERSIZE + cache->count * entrysize + cache->strsize ||
+      (cache->strsize && header[cache->length - 1] != '\0'))
+  {
+    if (verbose)
+      fprintf (stderr, "Ignoring unrecognized cache file %s\n", cachefile);
+
+    goto failure;
+  }
+
+  /* Check that the cache matches the text file */
+  if (sc_filestat (srcfile, &filesize, &filetime) ||
+      filesize != cachefilesize || filetime != cachefiletime)
+  {
+    if (verbose)
+      fprintf (stderr, "Ignoring out of date cache file %s\n", cachefile);
+
+    goto failure;
+  }
+
+  cache->entries = header + MC_HEADERSIZE;
+  cache->strings = cache->entries + cache->count * entrysize;
+  cache->size = cache->count;
+  cache->stralloc = cache->strsize;
+
+  fclose (cfp);
+
+  if (verbose)
+    fprintf (stderr, "Read cache of %lld entries from %s\n", (long long int)cache->count, cachefile);
+
+  return cache;
+
+failure:
+  fclose (cfp);
+  mc_free (cache);
+
+  return NULL;
+} /* End of mc_read() */
+
+/***************************************************************************
+ * mc_write:
+ *
+ * Write the cache file for a text file, replacing any existing cache.
+ * The size and modification time of the text file are recorded for
+ * detection of changes.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+mc_write (MCache *cache, const char *srcfile, int verbose)
+{
+  SCWriter sw;
+  FILE *cfp;
+  int64_t filesize;
+  int64_t filetime;
+
+  if (!cache || !srcfile)
+    return -1;
+
+  if (sc_filestat (srcfile, &filesize, &filetime))
+    return -1;
+
+  if (sc_open (&sw, srcfile, MC_SUFFIX, "cache", MC_MAGIC))
+    return -1;
+
+  cfp = sw.fp;
+
+  if (fwrite (&cache->kind, sizeof (cache->kind), 1, cfp) != 1 ||
+      fwrite (&cache->entrysize, sizeof (cache->entrysize), 1, cfp) != 1 ||
+      fwrite (&cache->flags, sizeof (cache->flags), 1, cfp) != 1 ||
+      fwrite (&filesize, sizeof (filesize), 1, cfp) != 1 ||
+      fwrite (&filetime, sizeof (filetime), 1, cfp) != 1 ||
+      fwrite (&cache->count, sizeof (cache->count), 1, cfp) != 1 ||
+      fwrite (&cache->strsize, sizeof (cache->strsize), 1, cfp) != 1)
+    goto failure;
+
+  if (cache->count && fwrite (cache->entries, cache->entrysize, cache->count, cfp) != (size_t)cache->count)
+    goto failure;
+
+  if (cache->strsize && fwrite (cache->strings, cache->strsize, 1, cfp) != 1)
+    goto failure;
+
+  if (sc_close (&sw))
+    return -1;
+
+  if (verbose)
+    fprintf (stderr, "Wrote cache of %lld entries to %s\n", (long long int)cache->count, sw.path);
+
+  return 0;
+
+failure:
+  sc_abort (&sw);
+
+  return -1;
+} /* End of mc_write() */
+
+/***************************************************************************
+ * mc_free:
+ *
+ * Free all memory associated with a cache, a cache that was read is
+ * unmapped and any strings referenced from it are no longer valid.
+ ***************************************************************************/
+void
+mc_free (MCache *cache)
+{
+  if (!cache)
+    return;
+
+  if (cache->base)
+  {
+#if defined(MC_MMAP)
+    if (cache->mapped)
+      munmap (cache->base, cache->length);
+    else
+#endif
+      free (cache->base);
+  }
+  else
+  {
+    free (cache->entries);
+    free (cache->strings);
+  }
+
+  kt_free (&cache->strtable);
+  free (cache);
+} /* End of mc_free() */
+
+/***************************************************************************
+ * stringof:
+ *
+ * Return the string of a value of the string table, a string
+ * reference.
+ ***************************************************************************/
+static const char *
+stringof (void *data, uintptr_t value, size_t *length)
+{
+  const char *string = ((MCache *)data)->strings + value - 1;
+
+  *length = strlen (string);
+
+  return string;
+} /* End of stringof() */
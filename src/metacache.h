@@ -0,0 +1,91 @@
+/***************************************************************************
+ * metacache.h
+ *
+ * Compiled caches of text input files, a sidecar file containing the
+ * parsed entries of a metadata or data selection file in a compact
+ * binary form that is memory mapped and used directly by later runs
+ * instead of parsing the text again.
+ ***************************************************************************/
+
+#ifndef METACACHE_H
+#define METACACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libmseed.h>
+
+#include "keytable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Suffix added to a text file name for its cache file */
+#define MC_SUFFIX ".m2sc"
+
+/* Kinds of cached files */
+#define MC_METADATA 1   /* Metadata file, MCMetaEntry entries */
+#define MC_SELECTIONS 2 /* Data selection file, MCSelectEntry entries */
+
+/* Cache flags */
+#define MC_SEEDINC 0x01 /* Metadata inclinations are SEED dips */
+
+/* Number of fields in a metadata line */
+#define MC_METAFIELDS 17
+
+/* String references are offsets into the string table plus 1, 0 is NULL */
+
+typedef struct MCMetaEntry_s
+{
+  uint32_t fields[MC_METAFIELDS]; /* Metadata fields */
+  float stla;                     /* Numeric fields, valid if field present */
+  float stlo;
+  float stel;
+  float stdp;
+  float cmpaz;
+  float cmpinc;
+  float scale;
+  hptime_t starttime;
+  hptime_t endtime;
+} MCMetaEntry;
+
+typedef struct MCSelectEntry_s
+{
+  uint32_t srcname;   /* Source name, consecutive entries with the same
+                         source name are time windows of one selection */
+  uint32_t reserved;
+  hptime_t starttime; /* Time window */
+  hptime_t endtime;
+} MCSelectEntry;
+
+typedef struct MCache_s
+{
+  uint32_t kind;
+  uint32_t flags;
+  uint32_t entrysize;
+  char *entries; /* Entries in file order */
+  int64_t count;
+  int64_t size;
+  char *strings; /* String table of terminated strings */
+  int64_t strsize;
+  int64_t stralloc;
+  KeyTable strtable; /* Strings, values are references, built while adding */
+  void *base;    /* Mapping or buffer of cache file when read */
+  size_t length;
+  int mapped;
+} MCache;
+
+extern MCache *mc_init (uint32_t kind, uint32_t entrysize);
+extern void *mc_addentry (MCache *cache);
+extern int mc_addstring (MCache *cache, const char *string, uint32_t *offset);
+extern const char *mc_string (MCache *cache, uint32_t offset, int *valid);
+extern MCache *mc_read (const char *srcfile, uint32_t kind, uint32_t entrysize, int verbose);
+extern int mc_write (MCache *cache, const char *srcfile, int verbose);
+extern void mc_free (MCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METACACHE_H */
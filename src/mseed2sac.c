@@ -7,6 +7,7 @@
  ***************************************************************************/
 
 #include <errno.h>
+#include <fcntl.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,6 +17,16 @@
 #include <libmseed.h>
 
 #include "sacformat.h"
+#include "asyncout.h"
+#include "keytable.h"
+#include "libmseed2sac.h"
+#include "m2splatform.h"
+#include "manifest.h"
+#include "metacache.h"
+#include "msindex.h"
+#include "sacbundle.h"
+#include "sampleconv.h"
+#include "stats.h"
 
 #ifndef NOFDZIP
 #include "fdzipstream.h"
@@ -23,24 +34,53 @@
 
 #if defined(WIN32) || defined(WIN64)
 #include <io.h>
-#define access _access
+#define open _open
+#define close _close
+#define fdopen _fdopen
 
-#ifndef F_OK
-#define F_OK 0
+#ifndef NODAEMON
+#define NODAEMON
 #endif
+#else
+#include <unistd.h>
+#endif
+
+#ifndef NODAEMON
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
 #endif
 
 #define VERSION "2.3"
 #define PACKAGE "mseed2sac"
 
 /* An undefined value for double values */
-#define DUNDEF -999.0
+#define DUNDEF M2S_UNDEF
 
 /* Maximum number of metadata fields per line */
 #define MAXMETAFIELDS 17
 
-/* Macro to test floating point number equality within 10 decimal places */
-#define FLTEQUAL(F1, F2) (fabs (F1 - F2) < 1.0E-10 * (fabs (F1) + fabs (F2) + 1.0))
+/* Maximum number of threads of each kind given with options */
+#define MAXTHREADS 256
+
+/* Maximum streaming window in seconds and sample memory in megabytes, -sw and -sm */
+#define STREAMMAXWINDOW 1.0e9
+#define STREAMMAXMEGABYTES 1048576
+
+/* Maximum number and size in kilobytes of ZIP output buffers, -zw and -zws */
+#define ZIPMAXBUFFERS 256
+#define ZIPMAXBUFSIZE 65536
+
+#if MAXMETAFIELDS != MC_METAFIELDS
+#error "Metadata cache entries must contain MAXMETAFIELDS fields"
+#endif
 
 struct listnode
 {
@@ -54,27 +94,201 @@ struct metanode
   char *metafields[MAXMETAFIELDS];
   hptime_t starttime;
   hptime_t endtime;
+  float stla;   /* Numeric fields parsed once, valid if field present */
+  float stlo;
+  float stel;
+  float stdp;
+  float cmpaz;
+  float cmpinc;
+  float scale;
+  int position; /* Order in metadata list, first match wins */
+};
+
+/* Length of metadata index key: network, station, location and channel */
+#define METAKEYLEN 36
+
+/* An entry in the metadata index, all epochs for a key sorted by start time */
+struct metakey
+{
+  char key[METAKEYLEN];
+  struct metanode **nodes;
+  hptime_t *maxend; /* Latest end time of nodes up to each index */
+  int count;
+  int size;
+};
+
+/* Length of trace index key: network, station, location, channel and quality */
+#define TRACEKEYLEN 45
+
+/* An entry in the trace index, with all traces for a key in group order */
+struct tracekey
+{
+  char key[TRACEKEYLEN];
+  MSTrace **traces;
+  int count;
+  int size;
+};
+
+/* State of a trace decoded directly to floats, at MSTrace.prvtptr */
+struct tracestate
+{
+  char srctype; /* Sample type of the source data */
+};
+
+/* A range of samples of a record inside the trim windows */
+struct trimrange
+{
+  int64_t first;
+  int64_t count;
+};
+
+/* An output file base name used in this run and the next suffix index to try */
+struct namekey
+{
+  char *base;
+  int64_t nextidx;
+};
+
+/* A trace prepared for output, with header and output file name */
+struct sacjob
+{
+  MSTrace *mst;
+  struct SACHeader sh;
+  char outfile[1024];
+  FILE *ofp;
+  void *zentry; /* ZIP entry being written */
+  int fd;       /* Output file for asynchronous output, -1 if not used */
+  MFEntry manifest; /* Location and size of the output for the manifest */
+  int64_t seq;
+  int running;
+  struct sacjob *next;
+};
+
+/* State for reading an input file, optionally using a record index */
+struct readstate
+{
+  MSFileParam *msfp;
+  char *filename;   /* Input file name */
+  MSIndex *index;   /* Record index, loaded or being built */
+  int64_t entry;    /* Next index entry when reading with an index */
+  int building;     /* Index is being built while reading */
+  int retcode;      /* Last return code from ms_readmsr_r() */
+};
+
+/* Largest job request accepted by the daemon */
+#define JOBMAXREQUEST 65536
+
+/* Largest number of jobs processed concurrently by the daemon */
+#define JOBMAXCONCURRENT 256
+
+/* Options accepted in a job request: input, selection, trimming and
+ * output format options.  All others are fixed when the daemon is
+ * started or would write files on the daemon host. */
+static const char *joboptions[] = {
+    "-k", "-E", "-l", "-f", "-N", "-S", "-L", "-C", "-r", "-dr", "-i", "-ic",
+    "-rb", "-sw", "-sm", "-ts", "-te", "-tl", "-shard", "-b",
+    "-z", "-z0", "-zl", "-zs", "-zt", "-zw", "-zws", NULL};
+
+/* Number of records queued by a reader thread for each input file */
+#define READQUEUE 64
+
+/* An input file and the queue of records read by a reader thread */
+struct readfile
+{
+  char *filename;
+  MSRecord *queue[READQUEUE];
+  int qhead;
+  int qcount;
+  int retcode;
+  int done;
+  int abandoned; /* Processing stopped by the main thread */
 };
 
+static MSTrace *addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, int *retcode);
+static int addsamples (MSTrace *mst, MSRecord *msr, flag whence, int *retcode);
+static int trimrecord (MSRecord *msr, Selections *selection, int *whole);
+static int addtrimmed (MSTraceGroup *mstg, MSRecord *msr, int count, int *retcode);
+static struct tracekey *findtracekey (char *key);
+static const char *tracekeyof (void *data, uintptr_t value, size_t *length);
+static int inshard (char *srcname);
+static struct namekey *findnamekey (char *base);
+static const char *namekeyof (void *data, uintptr_t value, size_t *length);
+static void freenamekeys (void);
+static void cleartracekeys (void);
+static void copykeyfield (char *field, const char *value, size_t length);
+static void maketracekey (char *key, char *network, char *station, char *location,
+                          char *channel, char dataquality);
+static void streamtraces (MSTraceGroup *mstg, MSRecord *msr);
+static void flushtrace (MSTraceGroup *mstg, MSTrace *prev, MSTrace *mst);
 static int writesac (MSTrace *mst);
-static int writebinarysac (struct SACHeader *sh, float *fdata, int64_t npts, char *outfile);
-static int writealphasac (struct SACHeader *sh, float *fdata, int64_t npts, char *outfile);
-static int swapsacheader (struct SACHeader *sh);
-static int insertmetadata (struct SACHeader *sh, hptime_t sacstarttime);
-static int delaz (double lat1, double lon1, double lat2, double lon2,
-                  double *delta, double *dist, double *azimuth, double *backazimuth);
+static int preparesac (MSTrace *mst, struct sacjob *job);
+static int outputsac (struct sacjob *job);
+static void writetraces (MSTraceGroup *mstg);
+static void zipturn (struct sacjob *job, int take);
+#ifndef NOPTHREADS
+static int submitsac (MSTrace *mst);
+static void *writerthread (void *arg);
+static int startwriters (void);
+static void stopwriters (void);
+static void drainwriters (void);
+static int pendingoutput (char *outfile);
+#endif
+static int readrecord (MSRecord **ppmsr, int fileidx, char *filename);
+static int readfilerecord (struct readstate *rs, MSRecord **ppmsr, char *filename,
+                           SelectIndex *index);
+static int unpackselected (MSRecord *msr, SelectIndex *index);
+#ifndef NOPTHREADS
+static void *readerthread (void *arg);
+static int startreaders (void);
+static void abandonfile (struct readfile *rf);
+static void stopreaders (void);
+#endif
+static int outputbegin (void *handle, const char *name, const MSTrace *mst);
+static int outputwrite (void *handle, const void *data, size_t length);
+static int outputend (void *handle);
+static int writeasyncsac (struct SACHeader *sh, MSTrace *mst, char *outfile, int fd);
+static int insertmetadata (void *handle, struct SACHeader *sh, hptime_t sacstarttime);
+static int metatimematch (struct metanode *mn, hptime_t sacstarttime, hptime_t sacendtime);
+static struct metanode *matchmetakey (struct metakey *mk, hptime_t sacstarttime,
+                                      hptime_t sacendtime);
+static struct metakey *findmetakey (char *key, int add);
+static const char *metakeyof (void *data, uintptr_t value, size_t *length);
+static void makemetakey (char *key, char *network, char *station, char *location,
+                         char *channel);
+static int comparemetanode (const void *a, const void *b);
+static int indexmetadata (void);
+#ifndef NODAEMON
+static int rundaemon (void);
+static int readjob (int fd, int *jobargc, char ***jobargv);
+static void daemonsignal (int sig);
+static int jobcanuse (const char *option);
+#endif
 static int parameter_proc (int argcount, char **argvec);
 static char *getoptval (int argcount, char **argvec, int argopt, int dasharg);
 static int readlistfile (char *listfile);
 static int addmetadata (char *metaline);
 static int readmetadata (char *metafile);
-static struct listnode *addnode (struct listnode **listroot, void *key, int keylen,
-                                 void *data, int datalen);
+static int readmetacache (char *metafile);
+static int writemetacache (char *metafile, struct listnode *first, int fileseedinc);
+static int readselectcache (char *selectfile);
+static int writeselectcache (char *selectfile);
+static struct listnode *addnode (struct listnode **listroot, struct listnode **listtail,
+                                 void *key, int keylen, void *data, int datalen);
 static void usage (int level);
 
+static M2SContext sacctx;          /* SAC conversion parameters */
 static int verbose = 0;
 static int reclen = -1;
+static int readbuffer = 0;         /* Read-ahead buffer size, 0 to map input files */
+static struct readstate readmain;  /* File reading state for main thread */
+static int useindex = 0;           /* Use and build record index files */
+static int usecache = 0;           /* Use and build metadata and selection caches */
+static int fusedecode = 0;         /* Decode samples directly into traces as floats */
+static int stats = 0;              /* Report phase timing and throughput statistics */
+static char *statsfile = 0;        /* File for statistics as JSON, "-" for stdout */
 static int overwrite = 0;
+static int asyncthreads = 0;       /* Number of asynchronous output threads */
+static int syncoutput = 0;         /* Sync output files to storage before closing */
 static int deriverate = 0;
 static int indifile = 0;
 static int indichannel = 0;
@@ -92,22 +306,86 @@ static double eventlon = DUNDEF;
 static double eventdepth = DUNDEF;
 static char *eventname = 0;
 
+static char *bundlefile = 0;
+static SACBundle *bundle = 0;
+
 static char *zipfile = 0;
 #ifndef NOFDZIP
 static ZIPstream *zstream = 0;
 static int zipmethod = -1;
+static int zipthreads = 0; /* Number of ZIP compression threads */
+static int zipbuffers = 0; /* Number of ZIP output buffers for the writer thread */
+static int zipbufsize = 0; /* Size of ZIP output buffers in kilobytes */
+#endif
+
+#ifndef NOPTHREADS
+static int writethreads = 0;   /* Number of writer threads */
+static pthread_t *writers = 0; /* Writer threads */
+static pthread_mutex_t writelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writecond = PTHREAD_COND_INITIALIZER;
+static struct sacjob *jobhead = 0; /* Queue of jobs for writer threads */
+static struct sacjob *jobtail = 0;
+static int jobcount = 0;
+static int64_t jobseq = 0;  /* Sequence number for next job */
+static int64_t zipnext = 0; /* Sequence number of next ZIP entry */
+static int writersexit = 0;
+
+static int readthreads = 0;         /* Number of reader threads */
+static pthread_t *readers = 0;      /* Reader threads */
+static pthread_mutex_t readlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t readcond = PTHREAD_COND_INITIALIZER;
+static struct readfile *readfiles = 0; /* Input files in processing order */
+static int readfilecount = 0;
+static int readnext = 0;    /* Index of next file to be read */
+static int readcurrent = 0; /* Index of file being processed by main thread */
 #endif
 
 struct listnode *filelist = 0;     /* List of input files */
+static struct listnode *filelisttail = 0; /* Last node of filelist */
 static Selections *selections = 0; /* List of data selections */
+static SelectIndex *selectindex = 0; /* Compiled selections for main thread */
 struct listnode *metadata = 0;     /* List of stations and coordinates, etc. */
+static struct listnode *metadatatail = 0; /* Last node of metadata */
+static MCache *metacache = 0;      /* Metadata cache, fields reference its strings */
+static KeyTable metakeys = KT_INITIALIZER (metakeyof, NULL); /* Metadata index */
+static struct metanode **metawild = 0; /* Metadata entries with wildcards, in list order */
+static int metawildcount = 0;
 static int seedinc = 0;            /* SEED component inclination flag */
 
+static KeyTable tracekeys = KT_INITIALIZER (tracekeyof, NULL); /* Trace index */
+static MSTrace *tracetail = 0; /* Last MSTrace in MSTraceGroup */
+
+static KeyTable namekeys = KT_INITIALIZER (namekeyof, NULL); /* Output base name registry */
+
+static double streamwindow = 0.0;   /* Streaming lookahead window in seconds */
+static int64_t streammaxbytes = 0;  /* Streaming memory limit for samples */
+static int64_t streambytes = 0;     /* Memory used by samples in MSTraceGroup */
+static hptime_t streamhorizon = 0;  /* Latest record start time */
+static hptime_t streamsweep = 0;    /* Horizon of next check for complete traces */
+
+static int trimming = 0;             /* Trim samples outside of time windows */
+static hptime_t trimstart = HPTERROR; /* Trim samples before this time */
+static hptime_t trimend = HPTERROR;   /* Trim samples after this time */
+static int trimselect = 0;           /* Trim samples outside selection time windows */
+static struct trimrange *trimranges = 0; /* Ranges of record samples to keep */
+static int trimrangesize = 0;
+
+static char *daemonsocket = 0;       /* Unix socket on which to accept conversion jobs */
+static int jobprocess = 0;           /* Processing a job received by the daemon */
+
+static int shardindex = 0;           /* Shard of sources processed, 0 to shardcount-1 */
+static int shardcount = 0;           /* Number of shards, 0 when not sharding */
+static char *manifestfile = 0;       /* Manifest of SAC files written */
+#ifndef NODAEMON
+static int daemonjobs = 1;           /* Number of jobs processed concurrently */
+static int daemontimeout = 10;       /* Seconds allowed to send a job request */
+static volatile sig_atomic_t daemonstop = 0;
+#endif
+
 int
 main (int argc, char **argv)
 {
   MSTraceGroup *mstg = 0;
-  MSTrace *mst = 0;
   MSRecord *msr = 0;
 
   struct listnode *flp;
@@ -117,6 +395,12 @@ main (int argc, char **argv)
   char starttime[50];
   hptime_t recendtime;
 
+  const char *sampleconv;
+  Selections *selection = 0;
+  FILE *statsfp = 0;
+  double start;
+  int trimmed = 0;
+  int whole;
   int retcode;
   int64_t totalrecs = 0;
   int64_t totalsamps = 0;
@@ -132,6 +416,50 @@ main (int argc, char **argv)
   if (parameter_proc (argc, argv) < 0)
     return -1;
 
+#ifndef NODAEMON
+  /* Serve conversion jobs until stopped, each job continues in a new process */
+  if (daemonsocket && (retcode = rundaemon ()) != 0)
+    return (retcode > 0) ? 0 : -1;
+#endif
+
+  if (stats || statsfile)
+    st_enable ();
+
+  /* Select sample conversion routines before any threads are started */
+  sampleconv = sc_init ();
+
+  if (verbose > 2)
+    fprintf (stderr, "Using %s sample conversion\n", sampleconv);
+
+  /* Set SAC conversion parameters */
+  m2s_initcontext (&sacctx);
+  sacctx.format = sacformat;
+  sacctx.deriverate = deriverate;
+  sacctx.network = network;
+  sacctx.station = station;
+  sacctx.location = location;
+  sacctx.channel = channel;
+  sacctx.latitude = latitude;
+  sacctx.longitude = longitude;
+  sacctx.eventtime = eventtime;
+  sacctx.eventlat = eventlat;
+  sacctx.eventlon = eventlon;
+  sacctx.eventdepth = eventdepth;
+  sacctx.eventname = eventname;
+  sacctx.metadata = (metadata) ? insertmetadata : NULL;
+  sacctx.verbose = verbose;
+
+  /* Decode samples directly into traces as floats for binary SAC,
+   * reader threads decode records in parallel instead */
+  fusedecode = (sacformat >= 2 && sacformat <= 4);
+#ifndef NOPTHREADS
+  if (readthreads > 0)
+    fusedecode = 0;
+#endif
+
+  if (verbose > 2 && fusedecode)
+    fprintf (stderr, "Decoding samples directly into traces\n");
+
   /* Init MSTraceGroup */
   mstg = mst_initgroup (mstg);
 
@@ -166,9 +494,63 @@ main (int argc, char **argv)
       fprintf (stderr, "Error in zs_init()\n");
       return 1;
     }
+
+    /* Compress entries in parallel if requested */
+    if (zipthreads > 0 && zipmethod == ZS_DEFLATE)
+    {
+      if (!zs_registerpdeflate (zstream, zipthreads))
+      {
+        fprintf (stderr, "Error in zs_registerpdeflate()\n");
+        return 1;
+      }
+
+      zipmethod = ZS_PDEFLATE;
+
+      if (verbose)
+        fprintf (stderr, "Compressing ZIP entries using %d threads\n", zipthreads);
+    }
+
+    /* Write archive data with a separate thread if requested */
+    if (zipbuffers > 0)
+    {
+      if (zs_registerwriter (zstream, zipbuffers, (int64_t)zipbufsize * 1024))
+      {
+        fprintf (stderr, "Error in zs_registerwriter()\n");
+        return 1;
+      }
+
+      if (verbose)
+        fprintf (stderr, "Writing ZIP archive from %d buffers of %d KB\n",
+                 (zipbuffers > 2) ? zipbuffers : 2, (zipbufsize > 0) ? zipbufsize : ZS_WRITE_SIZE / 1024);
+    }
   }
 #endif /* NOFDZIP */
 
+#ifndef NOPTHREADS
+  /* Start writer threads if requested */
+  if (writethreads > 0 && startwriters ())
+    return -1;
+
+  /* Start reader threads if requested */
+  if (readthreads > 0 && startreaders ())
+    return -1;
+#endif
+
+  /* Open output bundle if needed */
+  if (bundlefile)
+  {
+    if ((bundle = sb_open (bundlefile)) == NULL)
+      return -1;
+
+    if (verbose)
+      fprintf (stderr, "Writing SAC bundle to %s\n",
+               (strcmp (bundlefile, "-")) ? bundlefile : "stdout");
+  }
+
+  /* Start asynchronous output threads if requested */
+  if (asyncthreads > 0 && ao_start (asyncthreads, syncoutput, verbose))
+    return -1;
+
   /* Read input miniSEED files into MSTraceGroup */
   flp = filelist;
   while (flp != 0)
@@ -176,21 +558,42 @@ main (int argc, char **argv)
     if (verbose)
       fprintf (stderr, "Reading %s\n", flp->data);
 
-    while ((retcode = ms_readmsr (&msr, flp->data, reclen, NULL, NULL,
-                                  1, 1, verbose - 1)) == MS_NOERROR)
+    for (;;)
     {
+      start = st_now ();
+      retcode = readrecord (&msr, totalfiles, flp->data);
+      st_add (ST_READ, start, (retcode == MS_NOERROR) ? msr->reclen : 0);
+
+      if (retcode != MS_NOERROR)
+        break;
+
       /* Generate source name if needed for tests */
-      if (selections || indichannel)
+      if (selections || indichannel || trimming || shardcount)
       {
         msr_srcname (msr, srcname, 1);
       }
 
+      /* Check if the source of the record is in this shard */
+      if (shardcount && !inshard (srcname))
+      {
+        if (verbose >= 2)
+        {
+          ms_hptime2seedtimestr (msr->starttime, starttime, 1);
+          ms_log (1, "Skipping (shard) %s, %s\n", srcname, starttime);
+        }
+
+        continue;
+      }
+
       /* Check if record is matched by selection */
       if (selections)
       {
+        start = st_now ();
         recendtime = msr_endtime (msr);
+        selection = ms_matchselect_index (selectindex, srcname, msr->starttime, recendtime, NULL);
+        st_add (ST_SELECT, start, 0);
 
-        if (!ms_matchselect (selections, srcname, msr->starttime, recendtime, NULL))
+        if (!selection)
         {
           if (verbose >= 2)
           {
@@ -202,6 +605,30 @@ main (int argc, char **argv)
         }
       }
 
+      /* Determine the samples inside the trim windows, whole records are added as usual */
+      if (trimming)
+      {
+        if ((trimmed = trimrecord (msr, selection, &whole)) < 0)
+        {
+          fprintf (stderr, "Error trimming record of %s\n", srcname);
+          break;
+        }
+
+        if (trimmed == 0)
+        {
+          if (verbose >= 2)
+          {
+            ms_hptime2seedtimestr (msr->starttime, starttime, 1);
+            ms_log (1, "Skipping (trim window) %s, %s\n", srcname, starttime);
+          }
+
+          continue;
+        }
+
+        if (whole)
+          trimmed = 0;
+      }
+
       /* If this is a new channel write previous data (if individual channel writing) */
       if (indichannel)
       {
@@ -209,14 +636,11 @@ main (int argc, char **argv)
         {
           if (strncmp (prevsrcname, srcname, sizeof (prevsrcname)))
           {
-            mst = mstg->traces;
-            while (mst)
-            {
-              writesac (mst);
-              mst = mst->next;
-            }
+            writetraces (mstg);
 
             mstg = mst_initgroup (mstg);
+            cleartracekeys ();
+            streambytes = 0;
 
             strncpy (prevsrcname, srcname, sizeof (prevsrcname));
           }
@@ -230,29 +654,42 @@ main (int argc, char **argv)
       if (verbose >= 2)
         msr_print (msr, verbose - 2);
 
-      mst_addmsrtogroup (mstg, msr, 1, -1.0, -1.0);
+      /* Stop reading the file if samples decoded into a trace are corrupt */
+      start = st_now ();
+      if (trimmed > 0)
+      {
+        if (addtrimmed (mstg, msr, trimmed, &retcode) && retcode != MS_NOERROR)
+          break;
+      }
+      else if (!addmsrtogroup (mstg, msr, &retcode) && retcode != MS_NOERROR)
+      {
+        break;
+      }
+      st_add (ST_ASSEMBLY, start, 0);
+
+      /* Write complete traces if streaming */
+      if (streamwindow > 0.0 || streammaxbytes > 0)
+        streamtraces (mstg, msr);
 
       totalrecs++;
       totalsamps += msr->samplecnt;
+      if (getenv("M2S_BREAK") && totalrecs % 3 == 0) break;
     }
 
     if (retcode != MS_ENDOFFILE)
       fprintf (stderr, "Error reading %s: %s\n", flp->data, ms_errorstr (retcode));
 
     /* Make sure everything is cleaned up */
-    ms_readmsr (&msr, NULL, 0, NULL, NULL, 0, 0, 0);
+    readrecord (&msr, totalfiles, NULL);
 
     /* If processing each file individually, write SAC and reset */
     if (indifile)
     {
-      mst = mstg->traces;
-      while (mst)
-      {
-        writesac (mst);
-        mst = mst->next;
-      }
+      writetraces (mstg);
 
       mstg = mst_initgroup (mstg);
+      cleartracekeys ();
+      streambytes = 0;
     }
 
     totalfiles++;
@@ -260,20 +697,36 @@ main (int argc, char **argv)
   }
 
   if (!indifile)
+    writetraces (mstg);
+
+#ifndef NOPTHREADS
+  /* Wait for reader and writer threads to finish */
+  stopreaders ();
+  stopwriters ();
+#endif
+
+  /* Wait for asynchronous output to finish */
+  if (asyncthreads > 0 && (retcode = ao_finish ()) > 0)
+    fprintf (stderr, "Error, %d output files could not be written\n", retcode);
+
+  /* Write index and close output bundle if needed */
+  if (bundle)
   {
-    mst = mstg->traces;
-    while (mst)
-    {
-      writesac (mst);
-      mst = mst->next;
-    }
+    if (sb_close (bundle, verbose))
+      fprintf (stderr, "Error finishing SAC bundle %s\n", bundlefile);
+
+    bundle = 0;
   }
 
 #ifndef NOFDZIP
   /* Finish output ZIP archive if needed */
   if (zipfile)
   {
-    if (zs_finish (zstream, &writestatus))
+    start = st_now ();
+    retcode = zs_finish (zstream, &writestatus);
+    st_add (ST_ZIPFINISH, start, 0);
+
+    if (retcode)
     {
       fprintf (stderr, "Error finishing ZIP archive, write status: %lld\n",
                (long long int)writestatus);
@@ -283,830 +736,2736 @@ main (int argc, char **argv)
   }
 #endif /* NOFDZIP */
 
+  /* Write manifest of the SAC files written if requested */
+  if (manifestfile)
+    mf_write (manifestfile, shardindex, (shardcount) ? shardcount : 1,
+              (zipfile) ? "zip" : (bundlefile) ? "bundle" : "files",
+              (zipfile) ? zipfile : bundlefile);
+
   /* Make sure everything is cleaned up */
   mst_freegroup (&mstg);
+  cleartracekeys ();
+  kt_free (&tracekeys);
+  freenamekeys ();
+  if (trimranges)
+    free (trimranges);
 
   if (verbose)
     fprintf (stderr, "Files: %d, Records: %lld, Samples: %lld\n",
              totalfiles, (long long int)totalrecs, (long long int)totalsamps);
 
+  /* Report statistics as text and/or JSON */
+  if (stats)
+    st_report (stderr, 0, totalfiles, totalrecs, totalsamps);
+
+  if (statsfile)
+  {
+    if (!strcmp (statsfile, "-"))
+      statsfp = stdout;
+    else if ((statsfp = fopen (statsfile, "w")) == NULL)
+      fprintf (stderr, "Cannot open statistics file: %s (%s)\n", statsfile, strerror (errno));
+
+    if (statsfp && st_report (statsfp, 1, totalfiles, totalrecs, totalsamps))
+      fprintf (stderr, "Error writing statistics to %s\n", statsfile);
+
+    if (statsfp && statsfp != stdout)
+      fclose (statsfp);
+  }
+
   return 0;
 } /* End of main() */
 
 /***************************************************************************
- * writesac:
+ * addmsrtogroup:
  *
- * Write data buffer to output file as binary SAC.
+ * Add data samples from a MSRecord to a MSTrace in a MSTraceGroup,
+ * equivalent to mst_addmsrtogroup() with data quality matching and
+ * default time and sample rate tolerances.
  *
- * Returns the number of samples written or -1 on error.
+ * Traces are located using an index of the traces in the group keyed
+ * on source name and quality instead of scanning all traces.  The
+ * traces for each key are kept in group order, so the first adjacent
+ * trace found is the same one that mst_findadjacent() would return.
+ * New traces are added to the end of the MSTrace chain.
+ *
+ * The retcode is set to a libmseed error code if the data samples of
+ * the record cannot be decoded, otherwise it is left unchanged.
+ *
+ * Return a pointer to the MSTrace updated or 0 on error.
  ***************************************************************************/
-static int
-writesac (MSTrace *mst)
+static MSTrace *
+addmsrtogroup (MSTraceGroup *mstg, MSRecord *msr, int *retcode)
 {
-  struct SACHeader sh = NullSACHeader;
-  BTime btime;
-
-  char outfile[1024];
-  char baseoutfile[1024];
-  char *sacnetwork;
-  char *sacstation;
-  char *saclocation;
-  char *sacchannel;
-
-  float *fdata = 0;
-  double *ddata = 0;
-  int32_t *idata = 0;
-  hptime_t submsec;
-  int64_t idx;
-  int rv;
-
-  if (!mst)
-    return -1;
+  struct tracekey *tk;
+  MSTrace *mst = 0;
+  MSTrace **traces;
+  hptime_t endtime;
+  hptime_t hpdelta;
+  hptime_t postgap;
+  hptime_t pregap;
+  hptime_t hptimetol;
+  hptime_t nhptimetol;
+  char key[TRACEKEYLEN];
+  flag whence = 0;
+  int idx;
 
-  if (mst->numsamples == 0 || mst->samprate == 0.0)
+  if (!mstg || !msr)
     return 0;
 
-  if (mst->numsamples > INT32_MAX || mst->numsamples < 0)
+  endtime = msr_endtime (msr);
+
+  if (endtime == HPTERROR)
   {
-    fprintf (stderr, "ERROR, cannot write SAC file for %s_%s_%s_%s: too many samples (%" PRId64 ")\n",
-             mst->network, mst->station, mst->location, mst->channel, mst->numsamples);
-    return -1;
+    ms_log (2, "addmsrtogroup(): Error calculating record end time\n");
+    return 0;
   }
 
-  /* Check reported versus derived sampling rates */
-  if (mst->starttime < mst->endtime)
-  {
-    hptime_t hptimeshift;
-    hptime_t hpdelta;
-    double samprate;
+  maketracekey (key, msr->network, msr->station, msr->location,
+                msr->channel, msr->dataquality);
 
-    /* Calculate difference between end time of last miniSEED record and the end time
-     * as calculated based on the start time, reported sample rate and number of samples. */
-    hptimeshift = llabs (mst->endtime - mst->starttime - (hptime_t) ((mst->numsamples - 1) * HPTMODULUS / mst->samprate));
+  if ((tk = findtracekey (key)) == NULL)
+    return 0;
 
-    /* Calculate high-precision sample period using reported sample rate */
-    hpdelta = (hptime_t) ((mst->samprate) ? (HPTMODULUS / mst->samprate) : 0.0);
+  /* Records without a quality indicator may match any trace quality */
+  if (!msr->dataquality)
+  {
+    mst = mst_findadjacent (mstg, &whence, 0,
+                            msr->network, msr->station, msr->location, msr->channel,
+                            msr->samprate, -1.0, msr->starttime, endtime, -1.0);
+  }
+  else
+  {
+    /* Calculate high-precision sample period and default time tolerance */
+    hpdelta = (hptime_t) ((msr->samprate) ? (HPTMODULUS / msr->samprate) : 0.0);
+    hptimetol = (hptime_t) (0.5 * hpdelta);
+    nhptimetol = (hptimetol) ? -hptimetol : 0;
 
-    /* Test if time shift is beyond half a sample period */
-    if (hptimeshift > (hpdelta * 0.5))
+    /* Find first time adjacent MSTrace with a tolerable sample rate */
+    for (idx = 0; idx < tk->count; idx++)
     {
-      /* Derive sample rate from start and end times and number of samples */
-      samprate = (double)(mst->numsamples - 1) * HPTMODULUS / (mst->endtime - mst->starttime);
+      postgap = msr->starttime - tk->traces[idx]->endtime - hpdelta;
+      pregap = tk->traces[idx]->starttime - endtime - hpdelta;
 
-      if (deriverate)
-      {
-        if (verbose)
-          fprintf (stderr, "Using derived sample rate of %g over reported rate of %g\n",
-                   samprate, mst->samprate);
-
-        mst->samprate = samprate;
-      }
+      if (postgap <= hptimetol && postgap >= nhptimetol)
+        whence = 1;
+      else if (pregap <= hptimetol && pregap >= nhptimetol)
+        whence = 2;
       else
-      {
-        fprintf (stderr, "[%s.%s.%s.%s] Reported sample rate different than derived rate (%g versus %g)\n",
-                 mst->network, mst->station, mst->location, mst->channel,
-                 mst->samprate, samprate);
-        fprintf (stderr, "   Consider using the -dr option to use the sample rate derived from the series\n");
-      }
+        continue;
+
+      if (!MS_ISRATETOLERABLE (msr->samprate, tk->traces[idx]->samprate))
+        continue;
+
+      mst = tk->traces[idx];
+      break;
     }
   }
 
-  sacnetwork = (network) ? network : mst->network;
-  sacstation = (station) ? station : mst->station;
-  saclocation = (location) ? location : mst->location;
-  sacchannel = (channel) ? channel : mst->channel;
-
-  /* Insert dummy network code of XX if no network code is set */
-  if (!sacnetwork || *sacnetwork == '\0')
+  /* If a match was found update it otherwise create a new MSTrace and
+     add to end of MSTrace chain */
+  if (mst)
   {
-    sacnetwork = "XX";
-    fprintf (stderr, "Warning: input data has no network code, inserting XX\n");
-  }
+    /* Records with no time coverage do not contribute to a trace */
+    if (msr->samplecnt <= 0 || msr->samprate <= 0.0)
+      return mst;
 
-  /* Set time-series source parameters */
-  if (sacnetwork)
-    if (*sacnetwork != '\0')
-      ms_strncpopen (sh.knetwk, sacnetwork, 8);
-  if (sacstation)
-    if (*sacstation != '\0')
-      ms_strncpopen (sh.kstnm, sacstation, 8);
-  if (saclocation)
-    if (*saclocation != '\0')
-      ms_strncpopen (sh.khole, saclocation, 8);
-  if (sacchannel)
-    if (*sacchannel != '\0')
-      ms_strncpopen (sh.kcmpnm, sacchannel, 8);
+    if (addsamples (mst, msr, whence, retcode))
+      return 0;
 
-  if (verbose)
-    fprintf (stderr, "Writing SAC for %.8s.%.8s.%.8s.%.8s\n",
-             sacnetwork, sacstation, saclocation, sacchannel);
-
-  /* Set misc. header variables */
-  sh.nvhdr = 6;      /* Header version = 6 */
-  sh.leven = 1;      /* Evenly spaced data */
-  sh.iftype = ITIME; /* Data is time-series */
-
-  /* Set sampling interval (seconds), sample count */
-  sh.delta = 1 / mst->samprate;
-  sh.npts = mst->numsamples;
-
-  /* Insert metadata */
-  if (metadata)
-  {
-    rv = insertmetadata (&sh, mst->starttime);
-
-    if (rv == -1)
-      fprintf (stderr, "Error inserting metadata for %.8s.%.8s.%.8s.%.8s\n",
-               sacnetwork, sacstation, saclocation, sacchannel);
-    else if (rv == 1)
-      fprintf (stderr, "No metadata found for %.8s.%.8s.%.8s.%.8s\n",
-               sacnetwork, sacstation, saclocation, sacchannel);
-  }
-
-  /* Set station coordinates specified on command line */
-  if (latitude != DUNDEF)
-    sh.stla = latitude;
-  if (longitude != DUNDEF)
-    sh.stlo = longitude;
-
-  /* Set event parameters */
-  if (eventtime)
-    sh.o = (float)MS_HPTIME2EPOCH ((eventtime - mst->starttime));
-  if (eventlat != DUNDEF)
-    sh.evla = (float)eventlat;
-  if (eventlon != DUNDEF)
-    sh.evlo = (float)eventlon;
-  if (eventdepth != DUNDEF)
-    sh.evdp = (float)eventdepth;
-  if (eventname)
-    ms_strncpopen (sh.kevnm, eventname, 16);
-
-  /* Calculate delta, distance and azimuths if both event and station coordiantes are known */
-  if (sh.evla != FUNDEF && sh.evlo != FUNDEF &&
-      sh.stla != FUNDEF && sh.stlo != FUNDEF)
-  {
-    double delta, dist, azimuth, backazimuth;
-
-    if (!delaz (sh.evla, sh.evlo, sh.stla, sh.stlo, &delta, &dist, &azimuth, &backazimuth))
-    {
-      sh.az = (float)azimuth;
-      sh.baz = (float)backazimuth;
-      sh.gcarc = (float)delta;
-      sh.dist = (float)dist;
+    return mst;
+  }
 
-      if (verbose)
-        fprintf (stderr, "Inserting variables: AZ: %g, BAZ: %g, GCARC: %g, DIST: %g\n",
-                 sh.az, sh.baz, sh.gcarc, sh.dist);
+  if (tk->count >= tk->size)
+  {
+    if ((traces = (MSTrace **)realloc (tk->traces, sizeof (MSTrace *) * (tk->size + 4))) == NULL)
+    {
+      ms_log (2, "addmsrtogroup(): Cannot allocate memory\n");
+      return 0;
     }
+
+    tk->traces = traces;
+    tk->size += 4;
   }
 
-  /* Set reference time */
-  ms_hptime2btime (mst->starttime, &btime);
-  sh.nzyear = btime.year;
-  sh.nzjday = btime.day;
-  sh.nzhour = btime.hour;
-  sh.nzmin = btime.min;
-  sh.nzsec = btime.sec;
-  sh.nzmsec = btime.fract / 10;
+  mst = mst_init (NULL);
 
-  /* Determine any sub-millisecond portion of the start time in HP time */
-  submsec = (mst->starttime -
-             ms_time2hptime (sh.nzyear, sh.nzjday, sh.nzhour,
-                             sh.nzmin, sh.nzsec, sh.nzmsec * 1000));
+  mst->dataquality = msr->dataquality;
 
-  /* Set begin and end offsets from reference time for first and last sample,
-   * any sub-millisecond start time is stored in these offsets. */
-  sh.b = ((float)submsec / HPTMODULUS);
-  sh.e = (mst->numsamples - 1) * (1 / mst->samprate) + ((float)submsec / HPTMODULUS);
+  strncpy (mst->network, msr->network, sizeof (mst->network));
+  strncpy (mst->station, msr->station, sizeof (mst->station));
+  strncpy (mst->location, msr->location, sizeof (mst->location));
+  strncpy (mst->channel, msr->channel, sizeof (mst->channel));
 
-  /* Convert data buffer to floats */
-  if (mst->sampletype == 'f')
+  mst->starttime = msr->starttime;
+  mst->samprate = msr->samprate;
+  mst->sampletype = msr->sampletype;
+
+  if (addsamples (mst, msr, 1, retcode))
   {
-    fdata = (float *)mst->datasamples;
+    mst_free (&mst);
+    return 0;
   }
-  else if (mst->sampletype == 'i')
-  {
-    idata = (int32_t *)mst->datasamples;
-
-    fdata = (float *)malloc (mst->numsamples * sizeof (float));
-
-    if (fdata == NULL)
-    {
-      fprintf (stderr, "Error allocating memory\n");
-      return -1;
-    }
 
-    for (idx = 0; idx < mst->numsamples; idx++)
-      fdata[idx] = (float)idata[idx];
-  }
-  else if (mst->sampletype == 'd')
+  /* Link new MSTrace into the end of the chain */
+  if (!mstg->traces)
   {
-    ddata = (double *)mst->datasamples;
-
-    fdata = (float *)malloc (mst->numsamples * sizeof (float));
-
-    if (fdata == NULL)
-    {
-      fprintf (stderr, "Error allocating memory\n");
-      return -1;
-    }
-
-    for (idx = 0; idx < mst->numsamples; idx++)
-      fdata[idx] = (float)ddata[idx];
+    mstg->traces = mst;
   }
   else
   {
-    fprintf (stderr, "Error, unrecognized sample type: '%c'\n", mst->sampletype);
-    return -1;
-  }
+    if (!tracetail)
+      for (tracetail = mstg->traces; tracetail->next; tracetail = tracetail->next)
+        ;
 
-  /* Create base output file name: Net.Sta.Loc.Chan.Qual.Year.Day.HourMinSec */
-  snprintf (baseoutfile, sizeof (baseoutfile), "%s.%s.%s.%s.%c.%04d.%03d.%02d%02d%02d",
-            sacnetwork, sacstation, saclocation, sacchannel,
-            mst->dataquality, btime.year, btime.day, btime.hour,
-            btime.min, btime.sec);
+    tracetail->next = mst;
+  }
 
-/* Find unused file name */
-#define MAXDUPBASE 1000
-  for (idx = 0; idx <= MAXDUPBASE; idx++)
-  {
-    if (idx == MAXDUPBASE)
-    {
-      fprintf (stderr, "Error, over %d files with a base of %s ????, giving up...\n",
-               MAXDUPBASE, baseoutfile);
-      return -1;
-    }
+  tracetail = mst;
+  mstg->numtraces++;
 
-    if (idx == 0)
-      snprintf (outfile, sizeof (outfile), "%s.SAC%s", baseoutfile, (sacformat == 1) ? "A" : "");
-    else
-      snprintf (outfile, sizeof (outfile), "%s-%" PRId64 ".SAC%s", baseoutfile, idx, (sacformat == 1) ? "A" : "");
+  tk->traces[tk->count++] = mst;
 
-    if (zipfile) /* Trap door for ZIP output, first file name always used */
-      break;
+  return mst;
+} /* End of addmsrtogroup() */
 
-    if (access (outfile, F_OK))
+/***************************************************************************
+ * addsamples:
+ *
+ * Add the time coverage and data samples of a MSRecord to a MSTrace
+ * with mst_addmsr() and account for the memory used by the samples.
+ *
+ * When decoding directly to floats the records are read without data
+ * samples.  Samples added to the end of a trace are decoded straight
+ * into the trace buffer and converted to floats in place, otherwise
+ * they are decoded into the record, converted and copied.  Ranges of
+ * trimmed records arrive with samples already decoded into the record
+ * and are converted and copied, as are 64-bit float samples, which
+ * are larger than the floats they become.  Traces of such records
+ * hold floats (or text) and the sample type of the source data is
+ * kept in a tracestate at MSTrace.prvtptr, so that records of
+ * different sample types are still not combined.
+ *
+ * The retcode is set to a libmseed error code if the data samples of
+ * the record cannot be decoded.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+addsamples (MSTrace *mst, MSRecord *msr, flag whence, int *retcode)
+{
+  struct tracestate *ts;
+  int64_t numsamples = mst->numsamples;
+  size_t offset = 0;
+  size_t outputsize = 0;
+  char *output = NULL;
+  char outputtype;
+  int nsamples;
+  int direct = 0;
+
+  if (fusedecode && msr->samplecnt > 0)
+  {
+    if ((ts = (struct tracestate *)mst->prvtptr) == NULL)
     {
-      if (errno == ENOENT)
-        break;
-      else
+      if ((ts = (struct tracestate *)calloc (1, sizeof (struct tracestate))) == NULL)
       {
-        fprintf (stderr, "Error, Cannot write output file %s: %s\n", outfile, strerror (errno));
+        ms_log (2, "addsamples(): Cannot allocate memory\n");
         return -1;
       }
+
+      mst->prvtptr = ts;
     }
-    else if (overwrite)
+
+    if (msr->datasamples)
     {
-      break;
+      nsamples = msr->numsamples;
+      output = msr->datasamples;
     }
-  }
-
-  if (sacformat >= 2 && sacformat <= 4)
-  {
-    /* Byte swap the data header and data if needed */
-    if ((sacformat == 3 && ms_bigendianhost ()) ||
-        (sacformat == 4 && !ms_bigendianhost ()))
+    else
     {
-      if (verbose)
-        fprintf (stderr, "Byte swapping SAC header and data\n");
+      /* Text samples remain text, all others become floats */
+      if (ts->srctype)
+        outputtype = mst->sampletype;
+      else
+        outputtype = (msr->encoding == DE_ASCII) ? 'a' : 'f';
+
+      /* Decoded samples are the size of the output samples except for
+       * 64-bit floats, and for text in a float trace or vice versa */
+      if (whence == 1 && msr->encoding != DE_FLOAT64 &&
+          (msr->encoding == DE_ASCII) == (outputtype == 'a'))
+      {
+        offset = (size_t)mst->numsamples * ms_samplesize (outputtype);
+        outputsize = (size_t)msr->samplecnt * ms_samplesize (outputtype);
+
+        if (mst_growdata (mst, offset + outputsize))
+        {
+          ms_log (2, "addsamples(): Cannot allocate memory\n");
+          return -1;
+        }
 
-      swapsacheader (&sh);
+        output = (char *)mst->datasamples + offset;
+        direct = 1;
+      }
 
-      for (idx = 0; idx < mst->numsamples; idx++)
+      if ((nsamples = msr_unpack_samples_into (msr, output, outputsize, verbose - 1)) < 0)
       {
-        ms_gswap4 (fdata + idx);
+        *retcode = nsamples;
+        return -1;
       }
-    }
 
-    if (verbose > 1)
-      fprintf (stderr, "Writing binary SAC file: %s\n", outfile);
+      if (!output)
+        output = msr->datasamples;
+    }
 
-    if (writebinarysac (&sh, fdata, mst->numsamples, outfile))
+    if (!ts->srctype)
+    {
+      ts->srctype = msr->sampletype;
+      mst->sampletype = (msr->sampletype == 'a') ? 'a' : 'f';
+    }
+    else if (msr->sampletype != ts->srctype)
+    {
+      ms_log (2, "mst_addmsr(): Mismatched sample type, '%c' and '%c'\n",
+              msr->sampletype, ts->srctype);
       return -1;
-  }
-  else if (sacformat == 1)
-  {
-    if (verbose > 1)
-      fprintf (stderr, "Writing alphanumeric SAC file: %s\n", outfile);
+    }
 
-    if (writealphasac (&sh, fdata, mst->numsamples, outfile))
-      return -1;
-  }
-  else
-  {
-    fprintf (stderr, "Error, unrecognized format: '%d'\n", sacformat);
+    if (msr->sampletype == 'i')
+      sc_int32tofloat ((float *)output, (int32_t *)output, nsamples, 0);
+    else if (msr->sampletype == 'd')
+      sc_doubletofloat ((float *)output, (double *)output, nsamples, 0);
+
+    /* Samples in the trace buffer only need the coverage added */
+    if (direct)
+      mst->numsamples += nsamples;
+    else
+      msr->sampletype = mst->sampletype;
   }
 
-  if (fdata && mst->sampletype != 'f')
-    free (fdata);
+  if (mst_addmsr (mst, msr, whence))
+    return -1;
 
-  fprintf (stderr, "Wrote %lld samples to %s\n", (long long int)mst->numsamples, outfile);
+  streambytes += (mst->numsamples - numsamples) * ms_samplesize (mst->sampletype);
 
-  return mst->numsamples;
+  return 0;
+} /* End of addsamples() */
+
+/***************************************************************************
+ * trimrecord:
+ *
+ * Determine the ranges of samples of a record that are inside the
+ * trim window (-ts and -te) and, when trimming to selections, inside
+ * a time window of the selection matching the record.  A sample is
+ * inside a window when its time is within the window start and end
+ * times, inclusive.  The ranges are placed in trimranges sorted by
+ * first sample with overlapping and adjacent ranges merged.  Records
+ * without samples or a sample rate are kept whole when they overlap
+ * a window.
+ *
+ * The whole flag is set when the only range covers the entire record.
+ *
+ * Return the number of ranges, 0 when no samples are inside the
+ * windows, or -1 on error.
+ ***************************************************************************/
+static int
+trimrecord (MSRecord *msr, Selections *selection, int *whole)
+{
+  struct trimrange *ranges;
+  struct trimrange range;
+  SelectTime anytime;
+  SelectTime *window;
+  hptime_t endtime;
+  hptime_t wstart;
+  hptime_t wend;
+  double hpdelta;
+  int64_t last;
+  int count = 0;
+  int idx;
+
+  *whole = 0;
+
+  anytime.starttime = HPTERROR;
+  anytime.endtime = HPTERROR;
+  anytime.next = NULL;
+
+  window = (trimselect && selection) ? selection->timewindows : &anytime;
+  endtime = msr_endtime (msr);
+
+  for (; window; window = window->next)
+  {
+    /* Limit the window to the trim window */
+    wstart = window->starttime;
+    wend = window->endtime;
+
+    if (trimstart != HPTERROR && (wstart == HPTERROR || wstart < trimstart))
+      wstart = trimstart;
+    if (trimend != HPTERROR && (wend == HPTERROR || wend > trimend))
+      wend = trimend;
+
+    if ((wstart != HPTERROR && endtime < wstart) ||
+        (wend != HPTERROR && msr->starttime > wend))
+      continue;
+
+    if (msr->samplecnt <= 0 || msr->samprate <= 0.0)
+    {
+      range.first = 0;
+      range.count = (msr->samplecnt > 0) ? msr->samplecnt : 0;
+    }
+    else
+    {
+      /* Sample times are within half a tick of the window times they equal */
+      hpdelta = HPTMODULUS / msr->samprate;
+
+      range.first = (wstart == HPTERROR) ? 0 : (int64_t)ceil ((wstart - msr->starttime - 0.5) / hpdelta);
+      last = (wend == HPTERROR) ? msr->samplecnt - 1 : (int64_t)floor ((wend - msr->starttime + 0.5) / hpdelta);
+
+      if (range.first < 0)
+        range.first = 0;
+      if (last > msr->samplecnt - 1)
+        last = msr->samplecnt - 1;
+
+      if (range.first > last)
+        continue;
+
+      range.count = last - range.first + 1;
+    }
+
+    if (count >= trimrangesize)
+    {
+      if ((ranges = (struct trimrange *)realloc (trimranges, sizeof (struct trimrange) * (trimrangesize + 8))) == NULL)
+      {
+        fprintf (stderr, "trimrecord(): Cannot allocate memory\n");
+        return -1;
+      }
+
+      trimranges = ranges;
+      trimrangesize += 8;
+    }
+
+    /* Insert range in order of first sample */
+    for (idx = count; idx > 0 && trimranges[idx - 1].first > range.first; idx--)
+      trimranges[idx] = trimranges[idx - 1];
+
+    trimranges[idx] = range;
+    count++;
+  }
+
+  /* Merge overlapping and adjacent ranges */
+  for (idx = 1; idx < count;)
+  {
+    last = trimranges[idx - 1].first + trimranges[idx - 1].count;
+
+    if (trimranges[idx].first <= last)
+    {
+      if (trimranges[idx].first + trimranges[idx].count > last)
+        trimranges[idx - 1].count = trimranges[idx].first + trimranges[idx].count - trimranges[idx - 1].first;
+
+      memmove (&trimranges[idx], &trimranges[idx + 1], sizeof (struct trimrange) * (count - idx - 1));
+      count--;
+    }
+    else
+    {
+      idx++;
+    }
+  }
+
+  if (count == 1 && trimranges[0].first == 0 &&
+      trimranges[0].count == ((msr->samplecnt > 0) ? msr->samplecnt : 0))
+    *whole = 1;
+
+  return count;
+} /* End of trimrecord() */
+
+/***************************************************************************
+ * addtrimmed:
+ *
+ * Add the ranges of samples of a record determined by trimrecord() to
+ * a MSTraceGroup.  The samples of the record are decoded if needed and
+ * each range is added as a copy of the record header with the start
+ * time, sample count and samples of the range, so only the samples
+ * inside the windows are stored in the traces.
+ *
+ * The retcode is set to a libmseed error code if the data samples of
+ * the record cannot be decoded, otherwise it is left unchanged.
+ *
+ * Return 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+addtrimmed (MSTraceGroup *mstg, MSRecord *msr, int count, int *retcode)
+{
+  MSRecord range;
+  double hpdelta;
+  int samplesize;
+  int rv;
+  int idx;
+
+  if (!msr->datasamples && (rv = msr_unpack_samples (msr, verbose - 1)) != MS_NOERROR)
+  {
+    *retcode = rv;
+    return -1;
+  }
+
+  hpdelta = HPTMODULUS / msr->samprate;
+  samplesize = ms_samplesize (msr->sampletype);
+
+  for (idx = 0; idx < count; idx++)
+  {
+    range = *msr;
+    range.starttime = msr->starttime + (hptime_t) (trimranges[idx].first * hpdelta + 0.5);
+    range.samplecnt = trimranges[idx].count;
+    range.numsamples = trimranges[idx].count;
+    range.datasamples = (char *)msr->datasamples + trimranges[idx].first * samplesize;
+
+    if (!addmsrtogroup (mstg, &range, retcode))
+      return -1;
+  }
+
+  return 0;
+} /* End of addtrimmed() */
+
+/***************************************************************************
+ * findtracekey:
+ *
+ * Find the entry for a key in the trace index, adding a new entry
+ * if not found.
+ *
+ * Return a pointer to the entry or NULL on error.
+ ***************************************************************************/
+static struct tracekey *
+findtracekey (char *key)
+{
+  struct tracekey *tk;
+
+  if ((tk = (struct tracekey *)kt_find (&tracekeys, key, TRACEKEYLEN)))
+    return tk;
+
+  if ((tk = (struct tracekey *)calloc (1, sizeof (struct tracekey))) == NULL)
+  {
+    ms_log (2, "findtracekey(): Cannot allocate memory\n");
+    return NULL;
+  }
+
+  memcpy (tk->key, key, TRACEKEYLEN);
+
+  if (kt_add (&tracekeys, (uintptr_t)tk))
+  {
+    free (tk);
+    return NULL;
+  }
+
+  return tk;
+} /* End of findtracekey() */
+
+/***************************************************************************
+ * tracekeyof:
+ *
+ * Return the key of an entry of the trace index for the KeyTable.
+ ***************************************************************************/
+static const char *
+tracekeyof (void *data, uintptr_t value, size_t *length)
+{
+  (void)data;
+
+  *length = TRACEKEYLEN;
+
+  return ((struct tracekey *)value)->key;
+} /* End of tracekeyof() */
+
+/***************************************************************************
+ * inshard:
+ *
+ * Determine if a source is in the shard processed by this run.  The
+ * shard is selected by the hash of the Net_Sta_Loc_Chan part of the
+ * source name, excluding the quality, so all data of a channel, which
+ * is written to the same output file names, is processed by one shard
+ * and every run assigns sources to the same shards.
+ *
+ * Returns 1 if the source is in the shard, otherwise 0.
+ ***************************************************************************/
+static int
+inshard (char *srcname)
+{
+  char *quality;
+  int length;
+
+  if (!shardcount)
+    return 1;
+
+  quality = strrchr (srcname, '_');
+  length = (quality) ? (int)(quality - srcname) : (int)strlen (srcname);
+
+  return (ms_fnv1a (srcname, length) % (uint32_t)shardcount) == (uint32_t)shardindex;
+} /* End of inshard() */
+
+/***************************************************************************
+ * findnamekey:
+ *
+ * Find the entry for an output file base name in the name registry,
+ * adding a new entry if not found.
+ *
+ * Return a pointer to the entry or NULL on error.
+ ***************************************************************************/
+static struct namekey *
+findnamekey (char *base)
+{
+  struct namekey *nk;
+
+  if ((nk = (struct namekey *)kt_find (&namekeys, base, strlen (base))))
+    return nk;
+
+  if ((nk = (struct namekey *)calloc (1, sizeof (struct namekey))) == NULL ||
+      (nk->base = strdup (base)) == NULL)
+  {
+    fprintf (stderr, "findnamekey(): Cannot allocate memory\n");
+    free (nk);
+    return NULL;
+  }
+
+  if (kt_add (&namekeys, (uintptr_t)nk))
+  {
+    free (nk->base);
+    free (nk);
+    return NULL;
+  }
+
+  return nk;
+} /* End of findnamekey() */
+
+/***************************************************************************
+ * namekeyof:
+ *
+ * Return the key of an entry of the name registry for the KeyTable.
+ ***************************************************************************/
+static const char *
+namekeyof (void *data, uintptr_t value, size_t *length)
+{
+  struct namekey *nk = (struct namekey *)value;
+
+  (void)data;
+
+  *length = strlen (nk->base);
+
+  return nk->base;
+} /* End of namekeyof() */
+
+/***************************************************************************
+ * freenamekeys:
+ *
+ * Free all entries of the output base name registry.
+ ***************************************************************************/
+static void
+freenamekeys (void)
+{
+  struct namekey *nk;
+  uint32_t position = 0;
+
+  while ((nk = (struct namekey *)kt_next (&namekeys, &position)))
+  {
+    free (nk->base);
+    free (nk);
+  }
+
+  kt_free (&namekeys);
+} /* End of freenamekeys() */
+
+/***************************************************************************
+ * cleartracekeys:
+ *
+ * Remove all entries from the trace index, must be called whenever
+ * the traces of the MSTraceGroup are written and the group reset.
+ ***************************************************************************/
+static void
+cleartracekeys (void)
+{
+  struct tracekey *tk;
+  uint32_t position = 0;
+
+  while ((tk = (struct tracekey *)kt_next (&tracekeys, &position)))
+  {
+    if (tk->traces)
+      free (tk->traces);
+    free (tk);
+  }
+
+  kt_clear (&tracekeys);
+  tracetail = 0;
+} /* End of cleartracekeys() */
+
+/***************************************************************************
+ * maketracekey:
+ *
+ * Generate a trace index key from fixed width, NULL padded identifiers
+ * and the quality indicator.  The key buffer must be TRACEKEYLEN bytes.
+ ***************************************************************************/
+static void
+maketracekey (char *key, char *network, char *station, char *location,
+              char *channel, char dataquality)
+{
+  memset (key, 0, TRACEKEYLEN);
+  copykeyfield (key, network, 10);
+  copykeyfield (key + 11, station, 10);
+  copykeyfield (key + 22, location, 10);
+  copykeyfield (key + 33, channel, 10);
+  key[44] = dataquality;
+} /* End of maketracekey() */
+
+/***************************************************************************
+ * copykeyfield:
+ *
+ * Copy an identifier into a field of an index key, up to length
+ * characters.  The field is not terminated, index keys are cleared
+ * before the fields are copied.
+ ***************************************************************************/
+static void
+copykeyfield (char *field, const char *value, size_t length)
+{
+  size_t idx;
+
+  for (idx = 0; idx < length && value[idx]; idx++)
+    ;
+
+  memcpy (field, value, idx);
+} /* End of copykeyfield() */
+
+/***************************************************************************
+ * streamtraces:
+ *
+ * Write traces before the end of input when streaming, called after
+ * each record is added to the MSTraceGroup.
+ *
+ * Traces that end before the latest record start time minus the
+ * lookahead window are considered complete and written.  This
+ * assumes the input is ordered by time within the window, a record
+ * arriving later that is adjacent to a written trace begins a new
+ * trace.
+ *
+ * If the memory used for data samples exceeds the limit the largest
+ * traces are written until usage is below three quarters of the limit.
+ ***************************************************************************/
+static void
+streamtraces (MSTraceGroup *mstg, MSRecord *msr)
+{
+  MSTrace *mst;
+  MSTrace *prev;
+  MSTrace *next;
+  MSTrace *largest;
+  MSTrace *largestprev;
+  hptime_t window;
+  hptime_t cutoff;
+
+  if (msr->starttime > streamhorizon)
+    streamhorizon = msr->starttime;
+
+  /* Write traces ending before the lookahead window, checking each
+   * time the latest start time advances by a quarter of the window */
+  if (streamwindow > 0.0 && streamhorizon >= streamsweep)
+  {
+    window = (hptime_t) (streamwindow * HPTMODULUS);
+    cutoff = streamhorizon - window;
+    streamsweep = streamhorizon + window / 4;
+
+    prev = 0;
+    mst = mstg->traces;
+    while (mst)
+    {
+      next = mst->next;
+
+      if (mst->endtime < cutoff)
+        flushtrace (mstg, prev, mst);
+      else
+        prev = mst;
+
+      mst = next;
+    }
+  }
+
+  /* Write largest traces while over the memory limit */
+  if (streammaxbytes > 0 && streambytes > streammaxbytes)
+  {
+    while (mstg->traces && streambytes > (streammaxbytes / 4 * 3))
+    {
+      largest = mstg->traces;
+      largestprev = 0;
+
+      for (prev = mstg->traces, mst = prev->next; mst; prev = mst, mst = mst->next)
+      {
+        if (mst->numsamples > largest->numsamples)
+        {
+          largest = mst;
+          largestprev = prev;
+        }
+      }
+
+      if (verbose)
+        fprintf (stderr, "Memory limit reached, writing %s_%s_%s_%s early\n",
+                 largest->network, largest->station, largest->location, largest->channel);
+
+      flushtrace (mstg, largestprev, largest);
+    }
+  }
+} /* End of streamtraces() */
+
+/***************************************************************************
+ * flushtrace:
+ *
+ * Remove a MSTrace from the MSTraceGroup and the trace index, write it
+ * and free it.  The prev argument is the MSTrace before it in the chain
+ * or NULL if it is the first.
+ ***************************************************************************/
+static void
+flushtrace (MSTraceGroup *mstg, MSTrace *prev, MSTrace *mst)
+{
+  struct tracekey *tk;
+  char key[TRACEKEYLEN];
+  int idx;
+
+  /* Unlink from MSTrace chain */
+  if (prev)
+    prev->next = mst->next;
+  else
+    mstg->traces = mst->next;
+
+  if (tracetail == mst)
+    tracetail = prev;
+
+  mst->next = 0;
+  mstg->numtraces--;
+
+  /* Remove from trace index */
+  maketracekey (key, mst->network, mst->station, mst->location,
+                mst->channel, mst->dataquality);
+
+  if ((tk = findtracekey (key)))
+  {
+    for (idx = 0; idx < tk->count; idx++)
+    {
+      if (tk->traces[idx] == mst)
+      {
+        memmove (&tk->traces[idx], &tk->traces[idx + 1],
+                 sizeof (MSTrace *) * (tk->count - idx - 1));
+        tk->count--;
+        break;
+      }
+    }
+  }
+
+  streambytes -= mst->numsamples * ms_samplesize (mst->sampletype);
+  if (streambytes < 0)
+    streambytes = 0;
+
+#ifndef NOPTHREADS
+  if (writers)
+  {
+    submitsac (mst);
+    return;
+  }
+#endif
+
+  writesac (mst);
+  mst_free (&mst);
+} /* End of flushtrace() */
+
+/***************************************************************************
+ * writesac:
+ *
+ * Write data buffer to output file as binary SAC.
+ *
+ * Returns the number of samples written or -1 on error.
+ ***************************************************************************/
+static int
+writesac (MSTrace *mst)
+{
+  struct sacjob job;
+  int rv;
+
+  memset (&job, 0, sizeof (struct sacjob));
+
+  if ((rv = preparesac (mst, &job)))
+    return (rv > 0) ? 0 : -1;
+
+  job.mst = mst;
+
+  return outputsac (&job);
 } /* End of writesac() */
 
 /***************************************************************************
- * writebinarysac:
- * Write binary SAC file.
+ * preparesac:
+ *
+ * Populate a SAC header for a trace, determine the output file name
+ * and open the output file (unless writing to a ZIP archive).
+ *
+ * This routine is always called in trace order from the main thread,
+ * making the selection of unique output file names deterministic.
+ *
+ * Returns 0 on success, 1 when there is nothing to write and -1 on error.
+ ***************************************************************************/
+static int
+preparesac (MSTrace *mst, struct sacjob *job)
+{
+  char baseoutfile[1024];
+  char *outfile = job->outfile;
+  struct namekey *nk = 0;
+
+  int64_t idx;
+  int exclusive;
+  int fd;
+  int rv;
+
+  job->fd = -1;
+
+  if (!mst)
+    return -1;
+
+  /* Populate the SAC header and determine the base output file name */
+  if ((rv = m2s_header (&sacctx, mst, &job->sh, baseoutfile, sizeof (baseoutfile))))
+    return rv;
+
+  /* Output files are created exclusively unless overwriting or writing a ZIP archive or bundle */
+  exclusive = (!zipfile && !bundlefile && !overwrite && sacformat >= 1 && sacformat <= 4);
+
+  /* Names already used for this base in this run are not tried again,
+   * files in a bundle are named uniquely using only these names */
+  if ((exclusive || bundlefile) && (nk = findnamekey (baseoutfile)) == NULL)
+    return -1;
+
+/* Find unused file name */
+#define MAXDUPBASE 1000
+  for (idx = (nk) ? nk->nextidx : 0; idx <= MAXDUPBASE; idx++)
+  {
+    if (idx == MAXDUPBASE)
+    {
+      fprintf (stderr, "Error, over %d files with a base of %s ????, giving up...\n",
+               MAXDUPBASE, baseoutfile);
+      return -1;
+    }
+
+    if (idx == 0)
+      snprintf (outfile, sizeof (job->outfile), "%s.SAC%s", baseoutfile, (sacformat == 1) ? "A" : "");
+    else
+      snprintf (outfile, sizeof (job->outfile), "%s-%" PRId64 ".SAC%s", baseoutfile, idx, (sacformat == 1) ? "A" : "");
+
+    if (zipfile) /* Trap door for ZIP output, first file name always used */
+      break;
+
+    if (bundlefile)
+    {
+      nk->nextidx = idx + 1;
+      break;
+    }
+
+    if (overwrite)
+    {
+#ifndef NOPTHREADS
+      /* Let any writer still working on this file finish before replacing it */
+      if (writers && pendingoutput (outfile))
+        drainwriters ();
+#endif
+      break;
+    }
+
+    if (!exclusive)
+      break;
+
+    /* Create the output file only if it does not exist, reserving the name */
+    if ((fd = open (outfile, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0666)) >= 0)
+    {
+      /* Small binary files are written with asynchronous output if enabled */
+      if (asyncthreads > 0 && sacformat >= 2 && sacformat <= 4 &&
+          sizeof (struct SACHeader) + mst->numsamples * sizeof (float) <= AO_MAXFILE)
+      {
+        job->fd = fd;
+      }
+      else if ((job->ofp = fdopen (fd, "wb")) == NULL)
+      {
+        fprintf (stderr, "Cannot open output file: %s (%s)\n",
+                 outfile, strerror (errno));
+        close (fd);
+        return -1;
+      }
+
+      nk->nextidx = idx + 1;
+      break;
+    }
+    else if (errno != EEXIST)
+    {
+      fprintf (stderr, "Error, Cannot write output file %s: %s\n", outfile, strerror (errno));
+      return -1;
+    }
+  }
+
+  /* Open output file when overwriting, reserving the name for this trace */
+  if (!exclusive && !zipfile && !bundlefile && sacformat >= 1 && sacformat <= 4)
+  {
+    if ((job->ofp = fopen (outfile, "wb")) == NULL)
+    {
+      fprintf (stderr, "Cannot open output file: %s (%s)\n",
+               outfile, strerror (errno));
+      return -1;
+    }
+  }
+
+  return 0;
+} /* End of preparesac() */
+
+/***************************************************************************
+ * outputsac:
+ *
+ * Write the SAC file or ZIP entry for a prepared trace.  Samples are
+ * converted to floats in blocks as they are written.  When run by
+ * writer threads the ZIP entries are written in the order the jobs
+ * were prepared.
+ *
+ * Returns the number of samples written or -1 on error.
+ ***************************************************************************/
+static int
+outputsac (struct sacjob *job)
+{
+  MSTrace *mst = job->mst;
+  struct SACHeader *sh = &job->sh;
+  char *outfile = job->outfile;
+
+  M2SSink sink;
+  char srcname[50];
+  double start = st_now ();
+  int rv = 0;
+
+  memset (&sink, 0, sizeof (M2SSink));
+  sink.write = outputwrite;
+  sink.handle = job;
+
+  if (verbose && sacformat >= 2 && sacformat <= 4 && m2s_swapneeded (&sacctx))
+    fprintf (stderr, "Byte swapping SAC header and data\n");
+
+  if (verbose > 1)
+    fprintf (stderr, "Writing %s SAC file: %s\n",
+             (sacformat == 1) ? "alphanumeric" : "binary", outfile);
+
+  job->manifest.method = -1;
+
+  if (job->fd >= 0)
+  {
+    if (writeasyncsac (sh, mst, outfile, job->fd))
+      rv = -1;
+    job->fd = -1;
+    job->manifest.size = sizeof (struct SACHeader) + mst->numsamples * sizeof (float);
+  }
+  else
+  {
+    zipturn (job, 1);
+    if (outputbegin (job, outfile, mst) ||
+        m2s_writedata (&sacctx, sh, mst, &sink) ||
+        outputend (job))
+      rv = -1;
+    zipturn (job, 0);
+  }
+
+  if (job->ofp)
+  {
+    if (rv == 0 && syncoutput &&
+        (fflush (job->ofp) || ao_syncfd (fileno (job->ofp))))
+    {
+      fprintf (stderr, "Error syncing output file %s: %s\n", outfile, strerror (errno));
+      rv = -1;
+    }
+
+    if (fclose (job->ofp) && rv == 0)
+    {
+      fprintf (stderr, "Error closing output file %s: %s\n", outfile, strerror (errno));
+      rv = -1;
+    }
+
+    job->ofp = NULL;
+  }
+
+  if (job->fd >= 0)
+  {
+    close (job->fd);
+    job->fd = -1;
+  }
+
+  if (rv)
+    return -1;
+
+  mst_srcname (mst, srcname, 1);
+
+  if (manifestfile)
+  {
+    snprintf (job->manifest.name, sizeof (job->manifest.name), "%s", outfile);
+    snprintf (job->manifest.srcname, sizeof (job->manifest.srcname), "%s", srcname);
+    job->manifest.starttime = mst->starttime;
+    job->manifest.endtime = mst->endtime;
+    job->manifest.samples = mst->numsamples;
+
+    if (mf_add (&job->manifest))
+      return -1;
+  }
+
+  st_channel (srcname, start, mst->numsamples);
+  st_add (ST_WRITE, start, 0);
+
+  fprintf (stderr, "Wrote %lld samples to %s\n", (long long int)mst->numsamples, outfile);
+
+  return mst->numsamples;
+} /* End of outputsac() */
+
+/***************************************************************************
+ * outputbegin:
+ *
+ * Begin the output of a SAC file for a job, starting a bundle or ZIP
+ * entry when writing to one.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+outputbegin (void *handle, const char *name, const MSTrace *mst)
+{
+#ifndef NOFDZIP
+  struct sacjob *job = (struct sacjob *)handle;
+  ssize_t writestatus = 0;
+#endif /* NOFDZIP */
+
+  if (bundle)
+  {
+    if (sb_entrybegin (bundle))
+    {
+      fprintf (stderr, "Error writing SAC header for %s to bundle: %s\n",
+               name, strerror (errno));
+      return -1;
+    }
+  }
+#ifndef NOFDZIP
+  else if (zipfile)
+  {
+    if (!(job->zentry = zs_entrybegin (zstream, (char *)name, time (NULL),
+                                       zipmethod, &writestatus)))
+    {
+      fprintf (stderr, "Cannot begin ZIP entry, write status: %lld\n",
+               (long long int)writestatus);
+      return -1;
+    }
+  }
+#endif /* NOFDZIP */
+
+  return 0;
+} /* End of outputbegin() */
+
+/***************************************************************************
+ * outputwrite:
+ *
+ * Write SAC file contents for a job to the output file, ZIP entry or
+ * bundle, used as the write callback of the SAC conversion sink.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+outputwrite (void *handle, const void *data, size_t length)
+{
+  struct sacjob *job = (struct sacjob *)handle;
+#ifndef NOFDZIP
+  ssize_t writestatus = 0;
+  double start;
+#endif /* NOFDZIP */
+
+  st_addbytes (ST_WRITE, length);
+  job->manifest.size += length;
+
+  if (bundle)
+  {
+    if (sb_entrydata (bundle, data, length))
+    {
+      fprintf (stderr, "Error writing SAC data for %s to bundle: %s\n",
+               job->outfile, strerror (errno));
+      return -1;
+    }
+  }
+#ifndef NOFDZIP
+  else if (zipfile)
+  {
+    start = st_now ();
+    job->zentry = zs_entrydata (zstream, (ZIPentry *)job->zentry, (uint8_t *)data,
+                                length, &writestatus);
+    st_add (ST_ZIPDATA, start, length);
+
+    if (!job->zentry)
+    {
+      fprintf (stderr, "Error adding entry data for %s to output ZIP, write status: %lld\n",
+               job->outfile, (long long int)writestatus);
+      return -1;
+    }
+  }
+#endif /* NOFDZIP */
+  else if (fwrite (data, length, 1, job->ofp) != 1)
+  {
+    fprintf (stderr, "Error writing SAC data to output file %s: %s\n",
+             job->outfile, strerror (errno));
+    return -1;
+  }
+
+  return 0;
+} /* End of outputwrite() */
+
+/***************************************************************************
+ * outputend:
+ *
+ * End the output of a SAC file for a job, adding it to the bundle
+ * index or ending the ZIP entry when writing to one.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+outputend (void *handle)
+{
+  struct sacjob *job = (struct sacjob *)handle;
+  char srcname[100];
+#ifndef NOFDZIP
+  ssize_t writestatus = 0;
+#endif /* NOFDZIP */
+
+  if (bundle)
+  {
+    if (sb_entryend (bundle, job->outfile, mst_srcname (job->mst, srcname, 1),
+                     job->mst->starttime, job->mst->endtime))
+    {
+      fprintf (stderr, "Error adding %s to bundle index\n", job->outfile);
+      return -1;
+    }
+
+    job->manifest.offset = bundle->entries[bundle->count - 1].offset;
+    job->manifest.length = bundle->entries[bundle->count - 1].length;
+  }
+#ifndef NOFDZIP
+  else if (zipfile)
+  {
+    if (!zs_entryend (zstream, (ZIPentry *)job->zentry, &writestatus))
+    {
+      fprintf (stderr, "Error ending ZIP entry for %s, write status: %lld\n",
+               job->outfile, (long long int)writestatus);
+      return -1;
+    }
+
+    job->manifest.offset = ((ZIPentry *)job->zentry)->LocalHeaderOffset;
+    job->manifest.length = ((ZIPentry *)job->zentry)->CompressedSize;
+    job->manifest.crc32 = ((ZIPentry *)job->zentry)->CRC32;
+    job->manifest.method = ((ZIPentry *)job->zentry)->CompressionMethod;
+    job->zentry = 0;
+  }
+#endif /* NOFDZIP */
+
+  return 0;
+} /* End of outputend() */
+
+/***************************************************************************
+ * writetraces:
+ *
+ * Write all traces in a MSTraceGroup.  When writer threads are running
+ * the traces are removed from the group and handed to the writers,
+ * which free each trace when it has been written.
+ ***************************************************************************/
+static void
+writetraces (MSTraceGroup *mstg)
+{
+  MSTrace *mst;
+  MSTrace *next;
+
+  if (!mstg)
+    return;
+
+#ifndef NOPTHREADS
+  if (writers)
+  {
+    mst = mstg->traces;
+    mstg->traces = 0;
+    mstg->numtraces = 0;
+
+    while (mst)
+    {
+      next = mst->next;
+      mst->next = 0;
+
+      submitsac (mst);
+
+      mst = next;
+    }
+
+    return;
+  }
+#endif
+
+  mst = mstg->traces;
+  while (mst)
+  {
+    next = mst->next;
+    writesac (mst);
+    mst = next;
+  }
+} /* End of writetraces() */
+
+#ifndef NOPTHREADS
+/***************************************************************************
+ * submitsac:
+ *
+ * Prepare a trace for writing and add it to the queue for the writer
+ * threads.  The writers take ownership of the trace, which is freed
+ * either here, if there is nothing to write, or when it is written.
+ *
+ * The queue is limited to twice the number of writer threads, this
+ * routine will block until there is room in the queue.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+submitsac (MSTrace *mst)
+{
+  struct sacjob *job;
+  int rv;
+
+  if ((job = (struct sacjob *)calloc (1, sizeof (struct sacjob))) == NULL)
+  {
+    fprintf (stderr, "Error allocating memory\n");
+    mst_free (&mst);
+    return -1;
+  }
+
+  if ((rv = preparesac (mst, job)))
+  {
+    mst_free (&mst);
+    free (job);
+    return (rv > 0) ? 0 : -1;
+  }
+
+  job->mst = mst;
+
+  pthread_mutex_lock (&writelock);
+
+  while (jobcount >= (writethreads * 2))
+    pthread_cond_wait (&writecond, &writelock);
+
+  job->seq = jobseq++;
+
+  if (jobtail)
+    jobtail->next = job;
+  else
+    jobhead = job;
+  jobtail = job;
+  jobcount++;
+
+  pthread_cond_broadcast (&writecond);
+  pthread_mutex_unlock (&writelock);
+
+  return 0;
+} /* End of submitsac() */
+
+/***************************************************************************
+ * writerthread:
+ *
+ * Writer thread, output the first unclaimed job in the queue until
+ * stopwriters() is called and the queue is empty.
+ ***************************************************************************/
+static void *
+writerthread (void *arg)
+{
+  struct sacjob *job;
+  struct sacjob *prev;
+
+  pthread_mutex_lock (&writelock);
+
+  for (;;)
+  {
+    for (job = jobhead; job && job->running; job = job->next)
+      ;
+
+    if (!job)
+    {
+      if (writersexit)
+        break;
+
+      pthread_cond_wait (&writecond, &writelock);
+      continue;
+    }
+
+    job->running = 1;
+    pthread_mutex_unlock (&writelock);
+
+    outputsac (job);
+
+    pthread_mutex_lock (&writelock);
+
+    /* Pass the ZIP turn if the job failed before taking it */
+    if (zipfile || bundlefile)
+    {
+      while (zipnext < job->seq)
+        pthread_cond_wait (&writecond, &writelock);
+
+      if (zipnext == job->seq)
+        zipnext++;
+    }
+
+    /* Remove job from queue */
+    if (jobhead == job)
+    {
+      jobhead = job->next;
+      prev = 0;
+    }
+    else
+    {
+      for (prev = jobhead; prev->next != job; prev = prev->next)
+        ;
+      prev->next = job->next;
+    }
+    if (jobtail == job)
+      jobtail = prev;
+    jobcount--;
+
+    pthread_cond_broadcast (&writecond);
+    pthread_mutex_unlock (&writelock);
+
+    mst_free (&job->mst);
+    free (job);
+
+    pthread_mutex_lock (&writelock);
+  }
+
+  pthread_mutex_unlock (&writelock);
+
+  return NULL;
+} /* End of writerthread() */
+
+/***************************************************************************
+ * startwriters:
+ *
+ * Start the pool of writer threads.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+startwriters (void)
+{
+  int idx;
+  int rv;
+
+  if ((writers = (pthread_t *)calloc (writethreads, sizeof (pthread_t))) == NULL)
+  {
+    fprintf (stderr, "Error allocating memory\n");
+    return -1;
+  }
+
+  for (idx = 0; idx < writethreads; idx++)
+  {
+    if ((rv = pthread_create (&writers[idx], NULL, writerthread, NULL)))
+    {
+      fprintf (stderr, "Cannot create writer thread: %s\n", strerror (rv));
+      writethreads = idx;
+      stopwriters ();
+      return -1;
+    }
+  }
+
+  if (verbose)
+    fprintf (stderr, "Started %d writer threads\n", writethreads);
+
+  return 0;
+} /* End of startwriters() */
+
+/***************************************************************************
+ * stopwriters:
+ *
+ * Wait for all queued jobs to be written and stop the writer threads.
+ ***************************************************************************/
+static void
+stopwriters (void)
+{
+  int idx;
+
+  if (!writers)
+    return;
+
+  pthread_mutex_lock (&writelock);
+  writersexit = 1;
+  pthread_cond_broadcast (&writecond);
+  pthread_mutex_unlock (&writelock);
+
+  for (idx = 0; idx < writethreads; idx++)
+    pthread_join (writers[idx], NULL);
+
+  free (writers);
+  writers = 0;
+} /* End of stopwriters() */
+
+/***************************************************************************
+ * drainwriters:
+ *
+ * Wait until all queued jobs have been written.
+ ***************************************************************************/
+static void
+drainwriters (void)
+{
+  pthread_mutex_lock (&writelock);
+
+  while (jobcount > 0)
+    pthread_cond_wait (&writecond, &writelock);
+
+  pthread_mutex_unlock (&writelock);
+} /* End of drainwriters() */
+
+/***************************************************************************
+ * pendingoutput:
+ *
+ * Check if an output file is the target of a queued job.
+ *
+ * Returns 1 if the file is pending output, otherwise 0.
+ ***************************************************************************/
+static int
+pendingoutput (char *outfile)
+{
+  struct sacjob *job;
+  int pending = 0;
+
+  pthread_mutex_lock (&writelock);
+
+  for (job = jobhead; job; job = job->next)
+  {
+    if (!strcmp (job->outfile, outfile))
+    {
+      pending = 1;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock (&writelock);
+
+  return pending;
+} /* End of pendingoutput() */
+#endif /* NOPTHREADS */
+
+/***************************************************************************
+ * zipturn:
+ *
+ * When writer threads are adding entries to a ZIP archive or bundle,
+ * wait for the turn of the specified job (take is true) or pass the
+ * turn to the next job (take is false).  Otherwise nothing is done.
+ ***************************************************************************/
+static void
+zipturn (struct sacjob *job, int take)
+{
+#ifndef NOPTHREADS
+  if ((!zipfile && !bundlefile) || !writers)
+    return;
+
+  pthread_mutex_lock (&writelock);
+
+  if (take)
+  {
+    while (zipnext != job->seq)
+      pthread_cond_wait (&writecond, &writelock);
+  }
+  else
+  {
+    zipnext++;
+    pthread_cond_broadcast (&writecond);
+  }
+
+  pthread_mutex_unlock (&writelock);
+#endif
+} /* End of zipturn() */
+
+/***************************************************************************
+ * readrecord:
+ *
+ * Return the next record from an input file.  When reader threads are
+ * running the record is taken from the queue for the file, otherwise
+ * the record is read with ms_readmsr_r().
+ *
+ * Records must be requested for one file at a time and in file order,
+ * a NULL filename signals that processing of a file is complete and
+ * any record is freed.  A file may be completed before all of its
+ * records are returned, the reader thread then stops reading it.
+ *
+ * Returns a libmseed return code, MS_NOERROR when a record is returned.
+ ***************************************************************************/
+static int
+readrecord (MSRecord **ppmsr, int fileidx, char *filename)
+{
+#ifndef NOPTHREADS
+  struct readfile *rf;
+  int retcode;
+
+  if (readers)
+  {
+    msr_free (ppmsr);
+
+    pthread_mutex_lock (&readlock);
+
+    if (!filename)
+    {
+      abandonfile (&readfiles[fileidx]);
+      readcurrent = fileidx + 1;
+      pthread_cond_broadcast (&readcond);
+      pthread_mutex_unlock (&readlock);
+      return MS_NOERROR;
+    }
+
+    rf = &readfiles[fileidx];
+
+    while (rf->qcount == 0 && !rf->done)
+      pthread_cond_wait (&readcond, &readlock);
+
+    if (rf->qcount > 0)
+    {
+      *ppmsr = rf->queue[rf->qhead];
+      rf->qhead = (rf->qhead + 1) % READQUEUE;
+      rf->qcount--;
+      retcode = MS_NOERROR;
+
+      pthread_cond_broadcast (&readcond);
+    }
+    else
+    {
+      retcode = rf->retcode;
+    }
+
+    pthread_mutex_unlock (&readlock);
+
+    return retcode;
+  }
+#endif
+
+  return readfilerecord (&readmain, ppmsr, filename, selectindex);
+} /* End of readrecord() */
+
+/***************************************************************************
+ * readfilerecord:
+ *
+ * Read the next record from an input file with ms_readmsr_r(), a NULL
+ * filename signals that processing of a file is complete and all
+ * reading state is cleaned up.
+ *
+ * When record index files are used the index for the file is loaded
+ * if present and current.  With an index and selections only records
+ * matching the selections are read, seeking directly to each of them.
+ * Otherwise the file is read in order and, if no index was loaded, an
+ * index is built and written once the file has been read completely.
+ *
+ * Returns a libmseed return code, MS_NOERROR when a record is returned.
+ ***************************************************************************/
+static int
+readfilerecord (struct readstate *rs, MSRecord **ppmsr, char *filename,
+                SelectIndex *index)
+{
+  MSIndexEntry *entry;
+  off_t fpos;
+  off_t *pfpos = NULL;
+  char *srcname;
+
+  if (!filename)
+  {
+    /* Write a newly built index if the file was read completely, packed
+     * files are not indexed as seeking would skip their pack headers */
+    if (rs->building && rs->retcode == MS_ENDOFFILE &&
+        rs->msfp && rs->msfp->packtype == 0)
+      msi_write (rs->index, rs->filename, verbose);
+
+    rs->retcode = ms_readmsr_r (&rs->msfp, ppmsr, NULL, 0, NULL, NULL, 0, 0, 0);
+
+    msi_free (rs->index);
+    rs->index = NULL;
+    rs->entry = 0;
+    rs->building = 0;
+
+    return rs->retcode;
+  }
+
+  /* Set the read-ahead buffer and load or start an index before the first read of a file */
+  if (!rs->msfp)
+  {
+    if (readbuffer > 0 && ms_readmsr_setbuffer (&rs->msfp, readbuffer, 1))
+      return MS_GENERROR;
+
+    if (useindex && !rs->index && strcmp (filename, "-"))
+    {
+      rs->filename = filename;
+      rs->entry = 0;
+
+      if ((rs->index = msi_read (filename, reclen, verbose)) == NULL)
+      {
+        if ((rs->index = msi_init (reclen)) == NULL)
+          return MS_GENERROR;
+
+        rs->building = 1;
+      }
+    }
+  }
+
+  /* Read only the records in the shard and matching the selections using the index */
+  if (rs->index && !rs->building && (selections || shardcount))
+  {
+    for (; rs->entry < rs->index->count; rs->entry++)
+    {
+      entry = &rs->index->entries[rs->entry];
+      srcname = rs->index->srcnames[entry->srcname];
+
+      if (!inshard (srcname))
+        continue;
+
+      if (!selections)
+        break;
+
+      if (index)
+      {
+        if (ms_matchselect_index (index, srcname, entry->starttime, entry->endtime, NULL))
+          break;
+      }
+      else if (ms_matchselect (selections, srcname, entry->starttime, entry->endtime, NULL))
+      {
+        break;
+      }
+    }
+
+    if (rs->entry >= rs->index->count)
+    {
+      msr_free (ppmsr);
+      return (rs->retcode = MS_ENDOFFILE);
+    }
+
+    /* Seek unless the record follows the previous one */
+    entry = &rs->index->entries[rs->entry++];
+
+    if ((rs->msfp && entry->offset != rs->msfp->filepos) ||
+        (!rs->msfp && entry->offset != 0))
+    {
+      fpos = (off_t)entry->offset * -1;
+      pfpos = &fpos;
+    }
+
+    return (rs->retcode = ms_readmsr_r (&rs->msfp, ppmsr, filename, reclen, pfpos, NULL,
+                                        1, (fusedecode) ? 0 : 1, verbose - 1));
+  }
+
+  /* Only unpack headers when selecting, trimming or sharding, samples are
+   * unpacked for matches, or when samples are decoded directly into traces */
+  fpos = 0;
+  rs->retcode = ms_readmsr_r (&rs->msfp, ppmsr, filename, reclen,
+                              (rs->building) ? &fpos : NULL, NULL, 1,
+                              (selections || trimming || shardcount || fusedecode) ? 0 : 1, verbose - 1);
+
+  if (rs->retcode == MS_NOERROR && rs->building &&
+      msi_add (rs->index, *ppmsr, (int64_t)fpos))
+    return (rs->retcode = MS_GENERROR);
+
+  if (rs->retcode == MS_NOERROR && !fusedecode)
+    rs->retcode = unpackselected (*ppmsr, index);
+
+  return rs->retcode;
+} /* End of readfilerecord() */
+
+/***************************************************************************
+ * unpackselected:
+ *
+ * Unpack the data samples of a record read without samples if it is
+ * in the shard, matched by the selections and overlaps the trim window.
+ * Records that are not matched are left without samples, they are
+ * skipped when processed.  When there are no selections, no trimming
+ * and no sharding the records are read with samples and nothing is done.
+ *
+ * The compiled selection index caches matches and is specific to the
+ * calling thread, without an index the selection list is searched.
+ *
+ * Returns a libmseed return code, MS_NOERROR on success.
+ ***************************************************************************/
+static int
+unpackselected (MSRecord *msr, SelectIndex *index)
+{
+  char srcname[50];
+
+  if (!selections && !trimming && !shardcount)
+    return MS_NOERROR;
+
+  if ((trimstart != HPTERROR && msr_endtime (msr) < trimstart) ||
+      (trimend != HPTERROR && msr->starttime > trimend))
+    return MS_NOERROR;
+
+  if (selections || shardcount)
+    msr_srcname (msr, srcname, 1);
+
+  if (shardcount && !inshard (srcname))
+    return MS_NOERROR;
+
+  if (selections)
+  {
+    if (index)
+    {
+      if (!ms_matchselect_index (index, srcname, msr->starttime, msr_endtime (msr), NULL))
+        return MS_NOERROR;
+    }
+    else if (!ms_matchselect (selections, srcname, msr->starttime, msr_endtime (msr), NULL))
+    {
+      return MS_NOERROR;
+    }
+  }
+
+  return msr_unpack_samples (msr, verbose - 1);
+} /* End of unpackselected() */
+
+#ifndef NOPTHREADS
+/***************************************************************************
+ * readerthread:
+ *
+ * Reader thread, read and decode the next unclaimed input file with
+ * ms_readmsr_r() and add the records to the queue for the file.
+ *
+ * Files are claimed in order and no more than twice the number of
+ * reader threads ahead of the file being processed by the main
+ * thread, limiting the number of records held in memory.  Reading of
+ * a file stops when it is abandoned by the main thread.
+ ***************************************************************************/
+static void *
+readerthread (void *arg)
+{
+  struct readstate rs;
+  MSRecord *msr = NULL;
+  SelectIndex *index = NULL;
+  struct readfile *rf;
+  int retcode;
+
+  memset (&rs, 0, sizeof (rs));
+
+  /* Each reader uses its own selection index, the match cache is not shared */
+  if (selections)
+    index = ms_compileselections (selections);
+
+  pthread_mutex_lock (&readlock);
+
+  for (;;)
+  {
+    while (readnext < readfilecount &&
+           readnext >= (readcurrent + readthreads * 2))
+      pthread_cond_wait (&readcond, &readlock);
+
+    if (readnext >= readfilecount)
+      break;
+
+    rf = &readfiles[readnext++];
+
+    pthread_mutex_unlock (&readlock);
+
+    while ((retcode = readfilerecord (&rs, &msr, rf->filename, index)) == MS_NOERROR)
+    {
+      pthread_mutex_lock (&readlock);
+
+      while (rf->qcount >= READQUEUE && !rf->abandoned)
+        pthread_cond_wait (&readcond, &readlock);
+
+      if (rf->abandoned)
+      {
+        pthread_mutex_unlock (&readlock);
+        break;
+      }
+
+      rf->queue[(rf->qhead + rf->qcount) % READQUEUE] = msr;
+      rf->qcount++;
+
+      pthread_cond_broadcast (&readcond);
+      pthread_mutex_unlock (&readlock);
+
+      /* Record now owned by the queue, a new one is allocated for the next */
+      msr = NULL;
+    }
+
+    /* Make sure everything is cleaned up */
+    readfilerecord (&rs, &msr, NULL, index);
+
+    pthread_mutex_lock (&readlock);
+
+    rf->retcode = retcode;
+    rf->done = 1;
+
+    /* Free records left in the queue of an abandoned file */
+    if (rf->abandoned)
+      abandonfile (rf);
+
+    pthread_cond_broadcast (&readcond);
+  }
+
+  pthread_mutex_unlock (&readlock);
+
+  ms_freeselectindex (index);
+
+  return NULL;
+} /* End of readerthread() */
+
+/***************************************************************************
+ * startreaders:
+ *
+ * Create the list of input files to read and start the pool of reader
+ * threads.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+startreaders (void)
+{
+  struct listnode *flp;
+  int idx;
+  int rv;
+
+  for (flp = filelist; flp; flp = flp->next)
+    readfilecount++;
+
+  if ((readfiles = (struct readfile *)calloc (readfilecount, sizeof (struct readfile))) == NULL ||
+      (readers = (pthread_t *)calloc (readthreads, sizeof (pthread_t))) == NULL)
+  {
+    fprintf (stderr, "Error allocating memory\n");
+    free (readfiles);
+    readfiles = 0;
+    return -1;
+  }
+
+  for (flp = filelist, idx = 0; flp; flp = flp->next, idx++)
+    readfiles[idx].filename = flp->data;
+
+  for (idx = 0; idx < readthreads; idx++)
+  {
+    if ((rv = pthread_create (&readers[idx], NULL, readerthread, NULL)))
+    {
+      fprintf (stderr, "Cannot create reader thread: %s\n", strerror (rv));
+
+      /* Stop the threads already started */
+      readthreads = idx;
+      stopreaders ();
+      return -1;
+    }
+  }
+
+  if (verbose)
+    fprintf (stderr, "Started %d reader threads\n", readthreads);
+
+  return 0;
+} /* End of startreaders() */
+
+/***************************************************************************
+ * abandonfile:
+ *
+ * Mark an input file as abandoned by the main thread, the reader
+ * thread stops reading it.  Records left in the queue are freed once
+ * the reader is done with the file.  The caller must hold readlock.
+ ***************************************************************************/
+static void
+abandonfile (struct readfile *rf)
+{
+  rf->abandoned = 1;
+
+  if (!rf->done)
+    return;
+
+  while (rf->qcount > 0)
+  {
+    msr_free (&rf->queue[rf->qhead]);
+    rf->qhead = (rf->qhead + 1) % READQUEUE;
+    rf->qcount--;
+  }
+} /* End of abandonfile() */
+
+/***************************************************************************
+ * stopreaders:
+ *
+ * Stop the reader threads and free the list of input files.  Files
+ * not yet processed are abandoned, the readers stop reading them.
+ ***************************************************************************/
+static void
+stopreaders (void)
+{
+  int idx;
+
+  if (!readers)
+    return;
+
+  pthread_mutex_lock (&readlock);
+
+  for (idx = 0; idx < readfilecount; idx++)
+    abandonfile (&readfiles[idx]);
+
+  readnext = readfilecount;
+  pthread_cond_broadcast (&readcond);
+  pthread_mutex_unlock (&readlock);
+
+  for (idx = 0; idx < readthreads; idx++)
+    pthread_join (readers[idx], NULL);
+
+  free (readers);
+  readers = 0;
+
+  free (readfiles);
+  readfiles = 0;
+} /* End of stopreaders() */
+#endif /* NOPTHREADS */
+
+/***************************************************************************
+ * writeasyncsac:
+ * Write binary SAC file using asynchronous output, the header and
+ * converted samples are placed in a single buffer that is queued with
+ * the open output file, which is closed when written.
  *
  * Returns 0 on success, and -1 on failure.
  ***************************************************************************/
 static int
-writebinarysac (struct SACHeader *sh, float *fdata, int64_t npts, char *outfile)
+writeasyncsac (struct SACHeader *sh, MSTrace *mst, char *outfile, int fd)
 {
-  FILE *ofp;
+  size_t length = sizeof (struct SACHeader) + mst->numsamples * sizeof (float);
+  M2SBuffer buffer;
+  M2SSink sink;
 
-#ifndef NOFDZIP
-  ZIPentry *zentry = 0;
-  ssize_t writestatus = 0;
-#endif /* NOFDZIP */
+  st_addbytes (ST_WRITE, length);
 
-  if (!zipfile)
-  {
-    /* Open output file */
-    if ((ofp = fopen (outfile, "wb")) == NULL)
-    {
-      fprintf (stderr, "Cannot open output file: %s (%s)\n",
-               outfile, strerror (errno));
-      return -1;
-    }
+  /* Write the complete file to a buffer of its exact size */
+  memset (&buffer, 0, sizeof (M2SBuffer));
 
-    /* Write SAC header to output file */
-    if (fwrite (sh, sizeof (struct SACHeader), 1, ofp) != 1)
-    {
-      fprintf (stderr, "Error writing SAC header to output file\n");
-      return -1;
-    }
+  if ((buffer.data = (char *)malloc (length)) == NULL)
+  {
+    fprintf (stderr, "Error allocating memory\n");
+    close (fd);
+    return -1;
+  }
 
-    /* Write float data to output file */
-    if (fwrite (fdata, sizeof (float), npts, ofp) != npts)
-    {
-      fprintf (stderr, "Error writing SAC data to output file\n");
-      return -1;
-    }
+  buffer.size = length;
+  m2s_buffersink (&sink, &buffer);
 
-    fclose (ofp);
+  if (m2s_writedata (&sacctx, sh, mst, &sink))
+  {
+    m2s_freebuffer (&buffer);
+    close (fd);
+    return -1;
   }
+
+  return ao_submit (outfile, fd, buffer.data, buffer.length);
+} /* End of writeasyncsac() */
+
+/***************************************************************************
+ * insertmetadata:
+ *
+ * Search the metadata list for the first matching source and insert
+ * the metadata into the SAC header if found.  The source names (net,
+ * sta, loc, chan) are used to find a match.  If metadata list entries
+ * include a '*' they will match everything, for example if the
+ * channel field is '*' all channels for the specified network,
+ * station and location will match the list entry.
+ *
+ * Entries without wildcards are found using the metadata index, see
+ * indexmetadata(), entries with wildcards are searched in list order
+ * up to the first exact match.
+ *
+ * The metadata list should be populated with an array of pointers to:
+ *  0:  Network (knetwk)
+ *  1:  Station (kstnm)
+ *  2:  Location (khole)
+ *  3:  Channel (kcmpnm)
+ *  4:  Latitude (stla)
+ *  5:  Longitude (stlo)
+ *  6:  Elevation (stel) [not currently used by SAC]
+ *  7:  Depth (stdp) [not currently used by SAC]
+ *  8:  Component Azimuth (cmpaz), degrees clockwise from north
+ *  9:  Component Incident Angle (cmpinc), degrees from vertical
+ *  10: Instrument Name (kinst)
+ *  11: Scale Factor (scale)
+ *  12: Scale Frequency, unused
+ *  13: Scale Units, unused
+ *  14: Sampling rate, unused
+ *  15: Start time, used for matching
+ *  16: End time, used for matching
+ *
+ * Used as the metadata callback of the SAC conversion, handle is unused.
+ *
+ * Returns 0 on sucess, 1 when no matching metadata found and -1 on failure.
+ ***************************************************************************/
+static int
+insertmetadata (void *handle, struct SACHeader *sh, hptime_t sacstarttime)
+{
+  struct metanode *mn = NULL;
+  struct metakey *mk;
+  hptime_t sacendtime;
+  char sacnetwork[9];
+  char sacstation[9];
+  char saclocation[9];
+  char sacchannel[9];
+  char key[METAKEYLEN];
+  int idx;
+
+  if (!metadata || !sh)
+    return -1;
+
+  /* Determine source name parameters for comparison */
+  if (strncmp (sh->knetwk, SUNDEF, 8))
+    ms_strncpclean (sacnetwork, sh->knetwk, 8);
+  else
+    sacnetwork[0] = '\0';
+  if (strncmp (sh->kstnm, SUNDEF, 8))
+    ms_strncpclean (sacstation, sh->kstnm, 8);
   else
+    sacstation[0] = '\0';
+  if (strncmp (sh->khole, SUNDEF, 8))
+    ms_strncpclean (saclocation, sh->khole, 8);
+  else
+    saclocation[0] = '\0';
+  if (strncmp (sh->kcmpnm, SUNDEF, 8))
+    ms_strncpclean (sacchannel, sh->kcmpnm, 8);
+  else
+    sacchannel[0] = '\0';
+
+  /* Calculate end time of SAC data */
+  sacendtime = sacstarttime + (((sh->npts - 1) * sh->delta) * HPTMODULUS);
+
+  /* Find first matching entry for the exact source name */
+  makemetakey (key, sacnetwork, sacstation, saclocation, sacchannel);
+
+  if ((mk = findmetakey (key, 0)))
+    mn = matchmetakey (mk, sacstarttime, sacendtime);
+
+  /* Search entries with wildcards that are earlier in the list */
+  for (idx = 0; idx < metawildcount; idx++)
   {
-#ifndef NOFDZIP
-    /* Begin ZIP entry */
-    if (!(zentry = zs_entrybegin (zstream, outfile, time (NULL),
-                                  zipmethod, &writestatus)))
-    {
-      fprintf (stderr, "Cannot begin ZIP entry, write status: %lld\n",
-               (long long int)writestatus);
-      return -1;
-    }
+    if (mn && metawild[idx]->position > mn->position)
+      break;
 
-    /* Write SAC header to ZIP */
-    if (!zs_entrydata (zstream, zentry, (uint8_t *)sh,
-                       sizeof (struct SACHeader), &writestatus))
+    /* Sanity check that source name fields are present */
+    if (!metawild[idx]->metafields[0] || !metawild[idx]->metafields[1] ||
+        !metawild[idx]->metafields[2] || !metawild[idx]->metafields[3])
     {
-      fprintf (stderr, "Error adding entry data for %s to output ZIP, write status: %lld\n",
-               outfile, (long long int)writestatus);
-      return -1;
+      fprintf (stderr, "insertmetadata(): error, source name fields not all present\n");
     }
-
-    /* Write float data to ZIP */
-    if (!zs_entrydata (zstream, zentry, (uint8_t *)fdata,
-                       npts * sizeof (float), &writestatus))
+    /* Test if network, station, location and channel; also handle simple wildcards */
+    else if ((!strncmp (sacnetwork, metawild[idx]->metafields[0], 8) || (*(metawild[idx]->metafields[0]) == '*')) &&
+             (!strncmp (sacstation, metawild[idx]->metafields[1], 8) || (*(metawild[idx]->metafields[1]) == '*')) &&
+             (!strncmp (saclocation, metawild[idx]->metafields[2], 8) || (*(metawild[idx]->metafields[2]) == '*')) &&
+             (!strncmp (sacchannel, metawild[idx]->metafields[3], 8) || (*(metawild[idx]->metafields[3]) == '*')) &&
+             metatimematch (metawild[idx], sacstarttime, sacendtime))
     {
-      fprintf (stderr, "Error adding entry data for %s to output ZIP, write status: %lld\n",
-               outfile, (long long int)writestatus);
-      return -1;
+      mn = metawild[idx];
+      break;
     }
+  }
 
-    /* End ZIP entry */
-    if (!zs_entryend (zstream, zentry, &writestatus))
-    {
-      fprintf (stderr, "Error ending ZIP entry for %s, write status: %lld\n",
-               outfile, (long long int)writestatus);
-      return 1;
-    }
-#endif /* NOFDZIP */
+  if (!mn)
+    return 1;
+
+  if (verbose)
+    fprintf (stderr, "Inserting metadata for N: '%s', S: '%s', L: '%s', C: '%s' (%s - %s)\n",
+             sacnetwork, sacstation, saclocation, sacchannel,
+             (mn->metafields[15]) ? mn->metafields[15] : "NONE",
+             (mn->metafields[16]) ? mn->metafields[16] : "NONE");
+
+  /* Insert metadata into SAC header */
+  if (mn->metafields[4])
+    sh->stla = mn->stla;
+  if (mn->metafields[5])
+    sh->stlo = mn->stlo;
+  if (mn->metafields[6])
+    sh->stel = mn->stel;
+  if (mn->metafields[7])
+    sh->stdp = mn->stdp;
+  if (mn->metafields[8])
+    sh->cmpaz = mn->cmpaz;
+  if (mn->metafields[9])
+  {
+    sh->cmpinc = mn->cmpinc;
+    if (seedinc)
+      sh->cmpinc += 90;
   }
+  if (mn->metafields[10])
+    ms_strncpopen (sh->kinst, mn->metafields[10], 8);
+  if (mn->metafields[11])
+    sh->scale = mn->scale;
 
   return 0;
-} /* End of writebinarysac() */
+} /* End of insertmetadata() */
 
 /***************************************************************************
- * writealphasac:
- * Write alphanumeric SAC file.
+ * metatimematch:
  *
- * Returns 0 on success, and -1 on failure.
+ * Test if a metadata entry time window overlaps the SAC data, unset
+ * start or end times of the entry match any time.
+ *
+ * Returns 1 on match and 0 otherwise.
  ***************************************************************************/
 static int
-writealphasac (struct SACHeader *sh, float *fdata, int64_t npts, char *outfile)
+metatimematch (struct metanode *mn, hptime_t sacstarttime, hptime_t sacendtime)
 {
-  FILE *ofp;
-  char buffer[2000];
-  char *bp;
-  int64_t idx, fidx;
+  if (mn->starttime != HPTERROR && sacendtime < mn->starttime)
+    return 0;
 
-  /* Declare and set up pointers to header variable type sections */
-  float *fhp = (float *)sh;
-  int32_t *ihp = (int32_t *)sh + (NUMFLOATHDR);
-  char *shp = (char *)sh + (NUMFLOATHDR * 4 + NUMINTHDR * 4);
+  if (mn->endtime != HPTERROR && sacstarttime > mn->endtime)
+    return 0;
 
-#ifndef NOFDZIP
-  ZIPentry *zentry = 0;
-  ssize_t writestatus = 0;
-#endif /* NOFDZIP */
+  return 1;
+} /* End of metatimematch() */
 
-  /* Generate header in buffer */
-  bp = buffer;
+/***************************************************************************
+ * matchmetakey:
+ *
+ * Find the first entry, in metadata list order, of a metadata index
+ * key with a time window overlapping the SAC data.
+ *
+ * The entries are sorted by start time, those starting after the end
+ * of the data are excluded by a binary search and the remainder are
+ * searched backwards until no earlier entry ends late enough.
+ *
+ * Returns a pointer to the matching metanode or NULL for no match.
+ ***************************************************************************/
+static struct metanode *
+matchmetakey (struct metakey *mk, hptime_t sacstarttime, hptime_t sacendtime)
+{
+  struct metanode *mn = NULL;
+  int low = 0;
+  int high = mk->count;
+  int mid;
+  int idx;
 
-  /* Write SAC header float variables to output file, 5 variables per line */
-  for (idx = 0; idx < NUMFLOATHDR; idx += 5)
+  while (low < high)
   {
-    for (fidx = idx; fidx < (idx + 5) && fidx < NUMFLOATHDR; fidx++)
-    {
-      sprintf (bp, "%#15.7g", *(fhp + fidx));
-      bp += 15;
-    }
+    mid = (low + high) / 2;
 
-    sprintf (bp, "\n");
-    bp += 1;
+    if (mk->nodes[mid]->starttime == HPTERROR || mk->nodes[mid]->starttime <= sacendtime)
+      low = mid + 1;
+    else
+      high = mid;
   }
 
-  /* Write SAC header integer variables to output file, 5 variables per line */
-  for (idx = 0; idx < NUMINTHDR; idx += 5)
+  for (idx = low - 1; idx >= 0; idx--)
   {
-    for (fidx = idx; fidx < (idx + 5) && fidx < NUMINTHDR; fidx++)
-    {
-      sprintf (bp, "%10d", *(ihp + fidx));
-      bp += 10;
-    }
+    if (mk->maxend[idx] != HPTERROR && mk->maxend[idx] < sacstarttime)
+      break;
+
+    if ((mk->nodes[idx]->endtime == HPTERROR || mk->nodes[idx]->endtime >= sacstarttime) &&
+        (!mn || mk->nodes[idx]->position < mn->position))
+      mn = mk->nodes[idx];
+  }
+
+  return mn;
+} /* End of matchmetakey() */
+
+/***************************************************************************
+ * findmetakey:
+ *
+ * Find the entry for a key in the metadata index, optionally adding
+ * a new entry if not found.
+ *
+ * Return a pointer to the entry or NULL when not found or on error.
+ ***************************************************************************/
+static struct metakey *
+findmetakey (char *key, int add)
+{
+  struct metakey *mk;
 
-    sprintf (bp, "\n");
-    bp += 1;
+  if ((mk = (struct metakey *)kt_find (&metakeys, key, METAKEYLEN)) || !add)
+    return mk;
+
+  if ((mk = (struct metakey *)calloc (1, sizeof (struct metakey))) == NULL)
+  {
+    fprintf (stderr, "findmetakey(): Cannot allocate memory\n");
+    return NULL;
   }
 
-  /* Write SAC header string variables to output file, 3 variables per line */
-  for (idx = 0; idx < (NUMSTRHDR + 1); idx += 3)
+  memcpy (mk->key, key, METAKEYLEN);
+
+  if (kt_add (&metakeys, (uintptr_t)mk))
   {
-    if (idx == 0)
+    free (mk);
+    return NULL;
+  }
+
+  return mk;
+} /* End of findmetakey() */
+
+/***************************************************************************
+ * metakeyof:
+ *
+ * Return the key of an entry of the metadata index for the KeyTable.
+ ***************************************************************************/
+static const char *
+metakeyof (void *data, uintptr_t value, size_t *length)
+{
+  (void)data;
+
+  *length = METAKEYLEN;
+
+  return ((struct metakey *)value)->key;
+} /* End of metakeyof() */
+
+/***************************************************************************
+ * makemetakey:
+ *
+ * Create a metadata index key from source name fields, each field is
+ * limited to 8 characters as when compared with SAC header values.
+ ***************************************************************************/
+static void
+makemetakey (char *key, char *network, char *station, char *location,
+             char *channel)
+{
+  memset (key, 0, METAKEYLEN);
+  copykeyfield (key, network, 8);
+  copykeyfield (key + 9, station, 8);
+  copykeyfield (key + 18, location, 8);
+  copykeyfield (key + 27, channel, 8);
+} /* End of makemetakey() */
+
+/***************************************************************************
+ * comparemetanode:
+ *
+ * Compare metadata entries by start time, unset start times first,
+ * and then by list order.
+ ***************************************************************************/
+static int
+comparemetanode (const void *a, const void *b)
+{
+  struct metanode *mna = *(struct metanode **)a;
+  struct metanode *mnb = *(struct metanode **)b;
+
+  if (mna->starttime != mnb->starttime)
+  {
+    if (mna->starttime == HPTERROR)
+      return -1;
+    if (mnb->starttime == HPTERROR)
+      return 1;
+
+    return (mna->starttime < mnb->starttime) ? -1 : 1;
+  }
+
+  return mna->position - mnb->position;
+} /* End of comparemetanode() */
+
+/***************************************************************************
+ * indexmetadata:
+ *
+ * Build the metadata index from the metadata list.  Entries without
+ * wildcards are added to a hash table keyed on network, station,
+ * location and channel with the entries for each key sorted by start
+ * time.  Entries with a wildcard in any source name field are kept in
+ * list order for a linear search.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+indexmetadata (void)
+{
+  struct listnode *mlp;
+  struct metanode *mn;
+  struct metakey *mk;
+  void *newnodes;
+  char key[METAKEYLEN];
+  int position = 0;
+  uint32_t slot = 0;
+
+  for (mlp = metadata; mlp; mlp = mlp->next, position++)
+  {
+    mn = (struct metanode *)mlp->data;
+    mn->position = position;
+
+    /* Entries with wildcards or missing fields are searched linearly */
+    if (!mn->metafields[0] || !mn->metafields[1] ||
+        !mn->metafields[2] || !mn->metafields[3] ||
+        *(mn->metafields[0]) == '*' || *(mn->metafields[1]) == '*' ||
+        *(mn->metafields[2]) == '*' || *(mn->metafields[3]) == '*')
     {
-      sprintf (bp, "%-8.8s%-16.16s", shp, shp + 8);
-      bp += 24;
+      if ((newnodes = realloc (metawild, (metawildcount + 1) * sizeof (struct metanode *))) == NULL)
+      {
+        fprintf (stderr, "indexmetadata(): Cannot allocate memory\n");
+        return -1;
+      }
+
+      metawild = (struct metanode **)newnodes;
+      metawild[metawildcount++] = mn;
+      continue;
     }
-    else
+
+    makemetakey (key, mn->metafields[0], mn->metafields[1],
+                 mn->metafields[2], mn->metafields[3]);
+
+    if ((mk = findmetakey (key, 1)) == NULL)
+      return -1;
+
+    if (mk->count >= mk->size)
     {
-      for (fidx = idx; fidx < (idx + 3) && fidx < (NUMSTRHDR + 1); fidx++)
+      mk->size = (mk->size) ? mk->size * 2 : 4;
+
+      if ((newnodes = realloc (mk->nodes, mk->size * sizeof (struct metanode *))) == NULL)
       {
-        sprintf (bp, "%-8.8s", shp + (fidx * 8));
-        bp += 8;
+        fprintf (stderr, "indexmetadata(): Cannot allocate memory\n");
+        return -1;
       }
+
+      mk->nodes = (struct metanode **)newnodes;
     }
 
-    sprintf (bp, "\n");
-    bp += 1;
+    mk->nodes[mk->count++] = mn;
   }
 
-  if (!zipfile)
+  /* Sort the entries of each key and track the latest end time */
+  while ((mk = (struct metakey *)kt_next (&metakeys, &slot)))
   {
-    /* Open output file */
-    if ((ofp = fopen (outfile, "wb")) == NULL)
+    if ((mk->maxend = (hptime_t *)malloc (mk->count * sizeof (hptime_t))) == NULL)
     {
-      fprintf (stderr, "Cannot open output file: %s (%s)\n",
-               outfile, strerror (errno));
+      fprintf (stderr, "indexmetadata(): Cannot allocate memory\n");
       return -1;
     }
 
-    /* Write SAC header to output file */
-    if (fwrite (buffer, (bp - buffer), 1, ofp) != 1)
+    qsort (mk->nodes, mk->count, sizeof (struct metanode *), comparemetanode);
+
+    for (position = 0; position < mk->count; position++)
     {
-      fprintf (stderr, "Error writing SAC header to output file\n");
-      return -1;
+      if (mk->nodes[position]->endtime == HPTERROR ||
+          (position > 0 && mk->maxend[position - 1] == HPTERROR))
+        mk->maxend[position] = HPTERROR;
+      else if (position > 0 && mk->maxend[position - 1] > mk->nodes[position]->endtime)
+        mk->maxend[position] = mk->maxend[position - 1];
+      else
+        mk->maxend[position] = mk->nodes[position]->endtime;
     }
+  }
 
-    /* Write float data to output file, 5 values per line */
-    for (idx = 0; idx < npts; idx += 5)
-    {
-      for (fidx = idx; fidx < (idx + 5) && fidx < npts && fidx >= 0; fidx++)
-        fprintf (ofp, "%#15.7g", *(fdata + fidx));
+  return 0;
+} /* End of indexmetadata() */
 
-      fprintf (ofp, "\n");
-    }
+#ifndef NODAEMON
+/***************************************************************************
+ * rundaemon:
+ *
+ * Accept conversion jobs on a Unix socket until the daemon is stopped
+ * with SIGINT or SIGTERM.  The metadata and selections are read once
+ * when the daemon is started and are shared by all jobs.
+ *
+ * Each job is processed by a new process forked from the daemon, up to
+ * daemonjobs at a time.  The job process reads the job request from
+ * the connection, processes the job options and continues with the
+ * conversion, writing the output to the connection as stdout.  Input
+ * from stdin ("-") is read from the connection after the request.
+ *
+ * Returns 0 in a job process, 1 in the daemon when it is stopped and
+ * -1 on error.
+ ***************************************************************************/
+static int
+rundaemon (void)
+{
+  struct sockaddr_un addr;
+  struct sigaction sa;
+  struct stat st;
+  char **jobargv = 0;
+  int jobargc = 0;
+  int listenfd;
+  int connfd;
+  int running = 0;
+  int status;
+  int64_t jobs = 0;
+  mode_t mask;
+  pid_t pid;
+
+  if (strlen (daemonsocket) >= sizeof (addr.sun_path))
+  {
+    fprintf (stderr, "Socket path is too long: %s\n", daemonsocket);
+    return -1;
+  }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, daemonsocket);
+
+  /* Remove a socket left by a previous daemon */
+  if (!stat (daemonsocket, &st) && S_ISSOCK (st.st_mode))
+    unlink (daemonsocket);
+
+  /* Create the socket accessible only by the owner of the daemon */
+  mask = umask (0077);
 
-    fclose (ofp);
+  if ((listenfd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      bind (listenfd, (struct sockaddr *)&addr, sizeof (addr)) ||
+      chmod (daemonsocket, S_IRUSR | S_IWUSR) ||
+      listen (listenfd, SOMAXCONN))
+  {
+    fprintf (stderr, "Cannot listen on socket %s: %s\n", daemonsocket, strerror (errno));
+    umask (mask);
+    if (listenfd >= 0)
+      close (listenfd);
+    return -1;
   }
-  else
+
+  umask (mask);
+
+  /* Stop on SIGINT and SIGTERM, interrupting accept() and waitpid() */
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = daemonsignal;
+  sigemptyset (&sa.sa_mask);
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+
+  /* Report write errors on closed connections instead of terminating */
+  signal (SIGPIPE, SIG_IGN);
+
+  if (verbose)
+    fprintf (stderr, "Accepting jobs on %s, processing up to %d at a time\n",
+             daemonsocket, daemonjobs);
+
+  while (!daemonstop)
   {
-#ifndef NOFDZIP
-    /* Begin ZIP entry */
-    if (!(zentry = zs_entrybegin (zstream, outfile, time (NULL),
-                                  zipmethod, &writestatus)))
+    /* Collect finished jobs, waiting for one if all are running */
+    while (running > 0)
     {
-      fprintf (stderr, "Cannot begin ZIP entry, write status: %lld\n",
-               (long long int)writestatus);
-      return -1;
+      if ((pid = waitpid (-1, &status, (running >= daemonjobs) ? 0 : WNOHANG)) == 0)
+        break;
+
+      if (pid < 0)
+      {
+        if (errno == EINTR && !daemonstop)
+          continue;
+
+        break;
+      }
+
+      running--;
+
+      if (!WIFEXITED (status) || WEXITSTATUS (status))
+        fprintf (stderr, "Job process %d failed\n", (int)pid);
+      else if (verbose)
+        fprintf (stderr, "Job process %d finished\n", (int)pid);
     }
 
-    /* Write SAC header to ZIP */
-    if (!zs_entrydata (zstream, zentry, (uint8_t *)buffer,
-                       (bp - buffer), &writestatus))
+    if (daemonstop)
+      break;
+
+    if ((connfd = accept (listenfd, NULL, NULL)) < 0)
     {
-      fprintf (stderr, "Error adding entry data for %s to output ZIP, write status: %lld\n",
-               outfile, (long long int)writestatus);
-      return -1;
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+
+      fprintf (stderr, "Error accepting job connection: %s\n", strerror (errno));
+      break;
     }
 
-    /* Write float data to buffer and then to ZIP */
-    bp = buffer;
-    for (idx = 0; idx < npts; idx += 5)
+    if ((pid = fork ()) == 0)
     {
-      for (fidx = idx; fidx < (idx + 5) && fidx < npts && fidx >= 0; fidx++)
-      {
-        sprintf (bp, "%#15.7g", *(fdata + fidx));
-        bp += 15;
-      }
+      close (listenfd);
+
+      sa.sa_handler = SIG_DFL;
+      sigaction (SIGINT, &sa, NULL);
+      sigaction (SIGTERM, &sa, NULL);
 
-      sprintf (bp, "\n");
-      bp += 1;
+      if (readjob (connfd, &jobargc, &jobargv))
+        exit (1);
 
-      /* Write float data to ZIP */
-      if (!zs_entrydata (zstream, zentry, (uint8_t *)buffer,
-                         (bp - buffer), &writestatus))
+      /* The connection is the input and output of the job */
+      if (dup2 (connfd, fileno (stdin)) < 0 || dup2 (connfd, fileno (stdout)) < 0)
       {
-        fprintf (stderr, "Error adding entry data for %s to output ZIP, write status: %lld\n",
-                 outfile, (long long int)writestatus);
-        return -1;
+        fprintf (stderr, "Cannot redirect job input and output: %s\n", strerror (errno));
+        exit (1);
       }
 
-      bp = buffer;
+      close (connfd);
+
+      jobprocess = 1;
+
+      if (parameter_proc (jobargc, jobargv) < 0)
+        exit (1);
+
+      return 0;
     }
 
-    /* End ZIP entry */
-    if (!zs_entryend (zstream, zentry, &writestatus))
+    close (connfd);
+
+    if (pid < 0)
     {
-      fprintf (stderr, "Error ending ZIP entry for %s, write status: %lld\n",
-               outfile, (long long int)writestatus);
-      return 1;
+      fprintf (stderr, "Cannot create job process: %s\n", strerror (errno));
+      continue;
     }
-#endif /* NOFDZIP */
-  }
 
-  return 0;
-} /* End of writealphasac() */
+    running++;
+    jobs++;
 
-/***************************************************************************
- * swapsacheader:
- *
- * Byte swap all multi-byte quantities (floats and ints) in SAC header
- * struct.
- *
- * Returns 0 on sucess and -1 on failure.
- ***************************************************************************/
-static int
-swapsacheader (struct SACHeader *sh)
-{
-  int32_t *ip;
-  int idx;
+    if (verbose)
+      fprintf (stderr, "Started job %lld in process %d\n", (long long int)jobs, (int)pid);
+  }
 
-  if (!sh)
-    return -1;
+  close (listenfd);
+  unlink (daemonsocket);
+
+  if (verbose)
+    fprintf (stderr, "Stopping, waiting for %d running jobs\n", running);
 
-  for (idx = 0; idx < (NUMFLOATHDR + NUMINTHDR); idx++)
+  /* Wait for running jobs to finish */
+  while (running > 0 && (pid = waitpid (-1, &status, 0)) != 0)
   {
-    ip = (int32_t *)sh + idx;
-    ms_gswap4 (ip);
+    if (pid < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    running--;
   }
 
-  return 0;
-} /* End of swapsacheader() */
+  if (verbose)
+    fprintf (stderr, "Processed %lld jobs\n", (long long int)jobs);
+
+  return 1;
+} /* End of rundaemon() */
 
 /***************************************************************************
- * insertmetadata:
- *
- * Search the metadata list for the first matching source and insert
- * the metadata into the SAC header if found.  The source names (net,
- * sta, loc, chan) are used to find a match.  If metadata list entries
- * include a '*' they will match everything, for example if the
- * channel field is '*' all channels for the specified network,
- * station and location will match the list entry.
+ * readjob:
  *
- * The metadata list should be populated with an array of pointers to:
- *  0:  Network (knetwk)
- *  1:  Station (kstnm)
- *  2:  Location (khole)
- *  3:  Channel (kcmpnm)
- *  4:  Latitude (stla)
- *  5:  Longitude (stlo)
- *  6:  Elevation (stel) [not currently used by SAC]
- *  7:  Depth (stdp) [not currently used by SAC]
- *  8:  Component Azimuth (cmpaz), degrees clockwise from north
- *  9:  Component Incident Angle (cmpinc), degrees from vertical
- *  10: Instrument Name (kinst)
- *  11: Scale Factor (scale)
- *  12: Scale Frequency, unused
- *  13: Scale Units, unused
- *  14: Sampling rate, unused
- *  15: Start time, used for matching
- *  16: End time, used for matching
+ * Read a job request from a connection.  A request contains the
+ * options and input files of a job as they would be given on the
+ * command line, one argument per line, and ends with an empty line or
+ * the end of input.  The request is read a byte at a time so that any
+ * input data following it is left unread.  The connection is dropped
+ * if the request is not received within daemontimeout seconds, idle
+ * clients would otherwise hold a job slot indefinitely.
  *
- * Returns 0 on sucess, 1 when no matching metadata found and -1 on failure.
+ * Returns 0 on success and -1 on error.
  ***************************************************************************/
 static int
-insertmetadata (struct SACHeader *sh, hptime_t sacstarttime)
+readjob (int fd, int *jobargc, char ***jobargv)
 {
-  struct listnode *mlp = metadata;
-  struct metanode *mn = NULL;
-  hptime_t sacendtime;
-  char *endptr;
-  char sacnetwork[9];
-  char sacstation[9];
-  char saclocation[9];
-  char sacchannel[9];
-  int retval = 1;
+  struct pollfd pfd;
+  struct timespec now;
+  struct timespec deadline;
+  char *request;
+  char **argv;
+  char *line;
+  char *ptr;
+  size_t length = 0;
+  ssize_t count;
+  int remaining;
+  int argc;
+  int rv;
 
-  if (!mlp || !sh)
+  if ((request = (char *)malloc (JOBMAXREQUEST + 1)) == NULL)
+  {
+    fprintf (stderr, "readjob(): Cannot allocate memory\n");
     return -1;
+  }
 
-  /* Determine source name parameters for comparison */
-  if (strncmp (sh->knetwk, SUNDEF, 8))
-    ms_strncpclean (sacnetwork, sh->knetwk, 8);
-  else
-    sacnetwork[0] = '\0';
-  if (strncmp (sh->kstnm, SUNDEF, 8))
-    ms_strncpclean (sacstation, sh->kstnm, 8);
-  else
-    sacstation[0] = '\0';
-  if (strncmp (sh->khole, SUNDEF, 8))
-    ms_strncpclean (saclocation, sh->khole, 8);
-  else
-    saclocation[0] = '\0';
-  if (strncmp (sh->kcmpnm, SUNDEF, 8))
-    ms_strncpclean (sacchannel, sh->kcmpnm, 8);
-  else
-    sacchannel[0] = '\0';
+  clock_gettime (CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += daemontimeout;
 
-  /* Calculate end time of SAC data */
-  sacendtime = sacstarttime + (((sh->npts - 1) * sh->delta) * HPTMODULUS);
+  pfd.fd = fd;
+  pfd.events = POLLIN;
 
-  while (mlp)
+  while (length < JOBMAXREQUEST)
   {
-    mn = (struct metanode *)mlp->data;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    remaining = (int)((deadline.tv_sec - now.tv_sec) * 1000 +
+                      (deadline.tv_nsec - now.tv_nsec) / 1000000);
 
-    /* Sanity check that source name fields are present */
-    if (!mn->metafields[0] || !mn->metafields[1] ||
-        !mn->metafields[2] || !mn->metafields[3])
+    if (remaining <= 0 || (rv = poll (&pfd, 1, remaining)) == 0)
     {
-      fprintf (stderr, "insertmetadata(): error, source name fields not all present\n");
+      fprintf (stderr, "Timeout reading job request\n");
+      free (request);
+      return -1;
     }
-    /* Test if network, station, location and channel; also handle simple wildcards */
-    else if ((!strncmp (sacnetwork, mn->metafields[0], 8) || (*(mn->metafields[0]) == '*')) &&
-             (!strncmp (sacstation, mn->metafields[1], 8) || (*(mn->metafields[1]) == '*')) &&
-             (!strncmp (saclocation, mn->metafields[2], 8) || (*(mn->metafields[2]) == '*')) &&
-             (!strncmp (sacchannel, mn->metafields[3], 8) || (*(mn->metafields[3]) == '*')))
+
+    if (rv < 0)
     {
-      /* Check time window match */
-      if (mn->starttime != HPTERROR || mn->endtime != HPTERROR)
-      {
-        /* Check for overlap with metadata window */
-        if (mn->starttime != HPTERROR && mn->endtime != HPTERROR)
-        {
-          if (!(sacendtime >= mn->starttime && sacstarttime <= mn->endtime))
-          {
-            mlp = mlp->next;
-            continue;
-          }
-        }
-        /* Check if data after start time */
-        else if (mn->starttime != HPTERROR)
-        {
-          if (sacendtime < mn->starttime)
-          {
-            mlp = mlp->next;
-            continue;
-          }
-        }
-        /* Check if data before end time */
-        else if (mn->endtime != HPTERROR)
-        {
-          if (sacstarttime > mn->endtime)
-          {
-            mlp = mlp->next;
-            continue;
-          }
-        }
-      }
+      if (errno == EINTR)
+        continue;
 
-      if (verbose)
-        fprintf (stderr, "Inserting metadata for N: '%s', S: '%s', L: '%s', C: '%s' (%s - %s)\n",
-                 sacnetwork, sacstation, saclocation, sacchannel,
-                 (mn->metafields[15]) ? mn->metafields[15] : "NONE",
-                 (mn->metafields[16]) ? mn->metafields[16] : "NONE");
-
-      /* Insert metadata into SAC header */
-      if (mn->metafields[4])
-        sh->stla = (float)strtod (mn->metafields[4], &endptr);
-      if (mn->metafields[5])
-        sh->stlo = (float)strtod (mn->metafields[5], &endptr);
-      if (mn->metafields[6])
-        sh->stel = (float)strtod (mn->metafields[6], &endptr);
-      if (mn->metafields[7])
-        sh->stdp = (float)strtod (mn->metafields[7], &endptr);
-      if (mn->metafields[8])
-        sh->cmpaz = (float)strtod (mn->metafields[8], &endptr);
-      if (mn->metafields[9])
-      {
-        sh->cmpinc = (float)strtod (mn->metafields[9], &endptr);
-        if (seedinc)
-          sh->cmpinc += 90;
-      }
-      if (mn->metafields[10])
-        ms_strncpopen (sh->kinst, mn->metafields[10], 8);
-      if (mn->metafields[11])
-        sh->scale = (float)strtod (mn->metafields[11], &endptr);
+      fprintf (stderr, "Error waiting for job request: %s\n", strerror (errno));
+      free (request);
+      return -1;
+    }
 
-      retval = 0;
-      break;
+    if ((count = read (fd, request + length, 1)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      fprintf (stderr, "Error reading job request: %s\n", strerror (errno));
+      free (request);
+      return -1;
     }
 
-    mlp = mlp->next;
+    if (count == 0)
+      break;
+
+    length++;
+
+    /* An empty line ends the request */
+    if (request[length - 1] == '\n' && (length == 1 || request[length - 2] == '\n'))
+      break;
   }
 
-  return retval;
-} /* End of insertmetadata() */
+  if (length >= JOBMAXREQUEST)
+  {
+    fprintf (stderr, "Job request is larger than %d bytes\n", JOBMAXREQUEST);
+    free (request);
+    return -1;
+  }
 
-/***************************************************************************
- * delaz:
- *
- * Calculate the angular distance (and approximately equivalent
- * kilometers), azimuth and back azimuth for specified coordinates.
- * Latitudes are converted to geocentric latitudes using the WGS84
- * spheriod to correct for ellipticity.
- *
- * delta       : angular distance (degrees)
- * dist        : distance (kilometers, 111.19 km/deg)
- * azimuth     : azimuth from 1 to 2 (degrees)
- * backazimuth : azimuth from 2 to 1 (degrees)
- *
- * Returns 0 on sucess and -1 on failure.
- ***************************************************************************/
-static int
-delaz (double lat1, double lon1, double lat2, double lon2,
-       double *delta, double *dist, double *azimuth, double *backazimuth)
-{
-  /* Major and minor axies for WGS84 spheriod */
-  const double semimajor = 6378137.0;
-  const double semiminor = 6356752.3142;
+  request[length] = '\0';
 
-  double ratio2, pirad, halfpi, nlat1, nlat2, gamma, a, b, sita, bsita;
+  /* Each line is an argument, the first argument is the program name */
+  argc = 1;
+  for (ptr = request; *ptr; ptr++)
+    if (*ptr == '\n')
+      argc++;
+
+  if ((argv = (char **)calloc (argc + 2, sizeof (char *))) == NULL)
+  {
+    fprintf (stderr, "readjob(): Cannot allocate memory\n");
+    free (request);
+    return -1;
+  }
 
-  ratio2 = ((semiminor * semiminor) / (semimajor * semimajor));
+  argv[0] = PACKAGE;
+  argc = 1;
 
-  pirad = acos (-1.0) / 180.0;
-  halfpi = acos (-1.0) / 2.0;
+  for (line = request; *line; line = ptr)
+  {
+    if ((ptr = strchr (line, '\n')))
+      *ptr++ = '\0';
+    else
+      ptr = line + strlen (line);
 
-  /* Convert latitude to geocentric coordinates */
-  nlat1 = atan (ratio2 * tan (lat1 * pirad));
-  nlat2 = atan (ratio2 * tan (lat2 * pirad));
+    if (*line)
+      argv[argc++] = line;
+  }
 
-  /* Great circle calculation for delta and azimuth */
-  gamma = (lon2 - lon1) * pirad;
-  a = (halfpi - nlat2);
-  b = (halfpi - nlat1);
+  *jobargc = argc;
+  *jobargv = argv;
 
-  if (a == 0.0)
-    sita = 1.0;
-  else if (nlat2 == 0.0)
-    sita = 0.0;
-  else
-    sita = sin (b) / tan (a);
+  return 0;
+} /* End of readjob() */
 
-  if (b == 0.0)
-    bsita = 1.0;
-  else if (nlat1 == 0.0)
-    bsita = 0.0;
-  else
-    bsita = sin (a) / tan (b);
+/***************************************************************************
+ * daemonsignal:
+ *
+ * Signal handler to stop the daemon.
+ ***************************************************************************/
+static void
+daemonsignal (int sig)
+{
+  daemonstop = 1;
+} /* End of daemonsignal() */
 
-  *delta = acos (cos (a) * cos (b) + sin (a) * sin (b) * cos (gamma)) / pirad;
-  if (FLTEQUAL (*delta, 0.0))
-    *delta = 0.0;
 
-  /* 111.19 km/deg */
-  *dist = *delta * 111.19;
-  if (FLTEQUAL (*dist, 0.0))
-    *dist = 0.0;
+/***************************************************************************
+ * jobcanuse:
+ *
+ * Check if an option is accepted in a job request, see joboptions.
+ *
+ * Returns 1 if the option is accepted and 0 otherwise.
+ ***************************************************************************/
+static int
+jobcanuse (const char *option)
+{
+  int idx;
 
-  *azimuth = atan2 (sin (gamma), sita - cos (gamma) * cos (b)) / pirad;
-  if (FLTEQUAL (*azimuth, 0.0))
-    *azimuth = 0.0;
-  else if (*azimuth < 0.0)
-    *azimuth += 360;
+  /* Verbosity only affects diagnostics of the job process */
+  if (!strncmp (option, "-v", 2) && strspn (option + 1, "v") == strlen (option + 1))
+    return 1;
 
-  *backazimuth = atan2 (-sin (gamma), bsita - cos (gamma) * cos (a)) / pirad;
-  if (FLTEQUAL (*backazimuth, 0.0))
-    *backazimuth = 0.0;
-  else if (*backazimuth < 0.0)
-    *backazimuth += 360;
+  for (idx = 0; joboptions[idx]; idx++)
+  {
+    if (!strcmp (option, joboptions[idx]))
+      return 1;
+  }
 
   return 0;
-} /* End of delaz() */
+} /* End of jobcanuse() */
+#endif /* NODAEMON */
 
 /***************************************************************************
  * parameter_proc:
@@ -1122,11 +3481,21 @@ parameter_proc (int argcount, char **argvec)
   char *metaline = 0;
   char *eventstr = 0;
   char *selectfile = 0;
+  char *shardstr = 0;
+  char shardend;
   int optind;
 
   /* Process all command line arguments */
   for (optind = 1; optind < argcount; optind++)
   {
+    /* Only input, selection and output format options are used in a job */
+    if (jobprocess && argvec[optind][0] == '-' && argvec[optind][1] &&
+        !jobcanuse (argvec[optind]))
+    {
+      fprintf (stderr, "Option %s cannot be used in a job\n", argvec[optind]);
+      exit (1);
+    }
+
     if (strcmp (argvec[optind], "-V") == 0)
     {
       fprintf (stderr, "%s version: %s\n", PACKAGE, VERSION);
@@ -1150,70 +3519,216 @@ parameter_proc (int argcount, char **argvec)
     {
       overwrite = 1;
     }
-    else if (strcmp (argvec[optind], "-k") == 0)
+    else if (strcmp (argvec[optind], "-k") == 0)
+    {
+      coorstr = getoptval (argcount, argvec, optind++, 1);
+    }
+    else if (strcmp (argvec[optind], "-m") == 0)
+    {
+      metafile = getoptval (argcount, argvec, optind++, 0);
+    }
+    else if (strcmp (argvec[optind], "-M") == 0)
+    {
+      metaline = getoptval (argcount, argvec, optind++, 0);
+      if ( addmetadata(metaline) < 0 )
+      {
+        fprintf (stderr, "Error adding metadata fields for line:\n%s\n", metaline);
+      }
+    }
+    else if (strcmp (argvec[optind], "-msi") == 0)
+    {
+      seedinc = 1;
+    }
+    else if (strcmp (argvec[optind], "-E") == 0)
+    {
+      eventstr = getoptval (argcount, argvec, optind++, 0);
+    }
+    else if (strcmp (argvec[optind], "-l") == 0)
+    {
+      selectfile = getoptval (argcount, argvec, optind++, 0);
+    }
+    else if (strcmp (argvec[optind], "-f") == 0)
+    {
+      sacformat = strtoul (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+    }
+    else if (strcmp (argvec[optind], "-N") == 0)
+    {
+      network = getoptval (argcount, argvec, optind++, 0);
+    }
+    else if (strcmp (argvec[optind], "-S") == 0)
+    {
+      station = getoptval (argcount, argvec, optind++, 0);
+    }
+    else if (strcmp (argvec[optind], "-L") == 0)
+    {
+      location = getoptval (argcount, argvec, optind++, 0);
+    }
+    else if (strcmp (argvec[optind], "-C") == 0)
+    {
+      channel = getoptval (argcount, argvec, optind++, 0);
+    }
+    else if (strcmp (argvec[optind], "-r") == 0)
+    {
+      reclen = strtoul (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+    }
+    else if (strcmp (argvec[optind], "-dr") == 0)
+    {
+      deriverate = 1;
+    }
+    else if (strcmp (argvec[optind], "-i") == 0)
+    {
+      indifile = 1;
+    }
+    else if (strcmp (argvec[optind], "-ic") == 0)
+    {
+      indichannel = 1;
+    }
+    else if (strcmp (argvec[optind], "-rb") == 0)
+    {
+      readbuffer = (int)strtoul (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (readbuffer < 1 || readbuffer > 1024)
+      {
+        fprintf (stderr, "Read buffer size must be between 1 and 1024 megabytes\n");
+        exit (1);
+      }
+
+      readbuffer *= 1048576;
+    }
+    else if (strcmp (argvec[optind], "-ri") == 0)
+    {
+      useindex = 1;
+    }
+    else if (strcmp (argvec[optind], "-mc") == 0)
+    {
+      usecache = 1;
+    }
+    else if (strcmp (argvec[optind], "-sw") == 0)
+    {
+      streamwindow = strtod (getoptval (argcount, argvec, optind++, 0), NULL);
+
+      if (!(streamwindow > 0.0 && streamwindow <= STREAMMAXWINDOW))
+      {
+        fprintf (stderr, "Streaming window must be greater than 0 and at most %.0f seconds\n",
+                 STREAMMAXWINDOW);
+        exit (1);
+      }
+    }
+    else if (strcmp (argvec[optind], "-sm") == 0)
+    {
+      streammaxbytes = strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (streammaxbytes < 1 || streammaxbytes > STREAMMAXMEGABYTES)
+      {
+        fprintf (stderr, "Streaming memory limit must be between 1 and %d megabytes\n",
+                 STREAMMAXMEGABYTES);
+        exit (1);
+      }
+
+      streammaxbytes *= 1048576;
+    }
+    else if (strcmp (argvec[optind], "-stats") == 0)
     {
-      coorstr = getoptval (argcount, argvec, optind++, 1);
+      stats = 1;
     }
-    else if (strcmp (argvec[optind], "-m") == 0)
+    else if (strcmp (argvec[optind], "-statsjson") == 0)
     {
-      metafile = getoptval (argcount, argvec, optind++, 0);
+      statsfile = getoptval (argcount, argvec, optind++, 1);
     }
-    else if (strcmp (argvec[optind], "-M") == 0)
+#ifndef NOPTHREADS
+    else if (strcmp (argvec[optind], "-j") == 0)
     {
-      metaline = getoptval (argcount, argvec, optind++, 0);
-      if ( addmetadata(metaline) < 0 )
+      writethreads = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (writethreads < 1 || writethreads > MAXTHREADS)
       {
-        fprintf (stderr, "Error adding metadata fields for line:\n%s\n", metaline);
+        fprintf (stderr, "Number of writer threads must be between 1 and %d\n", MAXTHREADS);
+        exit (1);
       }
     }
-    else if (strcmp (argvec[optind], "-msi") == 0)
+    else if (strcmp (argvec[optind], "-rt") == 0)
     {
-      seedinc = 1;
+      readthreads = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (readthreads < 1 || readthreads > MAXTHREADS)
+      {
+        fprintf (stderr, "Number of reader threads must be between 1 and %d\n", MAXTHREADS);
+        exit (1);
+      }
     }
-    else if (strcmp (argvec[optind], "-E") == 0)
+    else if (strcmp (argvec[optind], "-ao") == 0)
     {
-      eventstr = getoptval (argcount, argvec, optind++, 0);
+      asyncthreads = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (asyncthreads < 1 || asyncthreads > MAXTHREADS)
+      {
+        fprintf (stderr, "Number of output threads must be between 1 and %d\n", MAXTHREADS);
+        exit (1);
+      }
     }
-    else if (strcmp (argvec[optind], "-l") == 0)
+#endif
+    else if (strcmp (argvec[optind], "-fsync") == 0)
     {
-      selectfile = getoptval (argcount, argvec, optind++, 0);
+      syncoutput = 1;
     }
-    else if (strcmp (argvec[optind], "-f") == 0)
+    else if (strcmp (argvec[optind], "-b") == 0)
     {
-      sacformat = strtoul (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+      bundlefile = getoptval (argcount, argvec, optind++, 1);
     }
-    else if (strcmp (argvec[optind], "-N") == 0)
+    else if (strcmp (argvec[optind], "-ts") == 0)
     {
-      network = getoptval (argcount, argvec, optind++, 0);
+      if ((trimstart = ms_timestr2hptime (getoptval (argcount, argvec, optind++, 0))) == HPTERROR)
+      {
+        fprintf (stderr, "Error parsing trim start time: '%s'\n", argvec[optind]);
+        exit (1);
+      }
     }
-    else if (strcmp (argvec[optind], "-S") == 0)
+    else if (strcmp (argvec[optind], "-te") == 0)
     {
-      station = getoptval (argcount, argvec, optind++, 0);
+      if ((trimend = ms_timestr2hptime (getoptval (argcount, argvec, optind++, 0))) == HPTERROR)
+      {
+        fprintf (stderr, "Error parsing trim end time: '%s'\n", argvec[optind]);
+        exit (1);
+      }
     }
-    else if (strcmp (argvec[optind], "-L") == 0)
+    else if (strcmp (argvec[optind], "-tl") == 0)
     {
-      location = getoptval (argcount, argvec, optind++, 0);
+      trimselect = 1;
     }
-    else if (strcmp (argvec[optind], "-C") == 0)
+    else if (strcmp (argvec[optind], "-shard") == 0)
     {
-      channel = getoptval (argcount, argvec, optind++, 0);
+      shardstr = getoptval (argcount, argvec, optind++, 0);
     }
-    else if (strcmp (argvec[optind], "-r") == 0)
+    else if (strcmp (argvec[optind], "-manifest") == 0)
     {
-      reclen = strtoul (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+      manifestfile = getoptval (argcount, argvec, optind++, 1);
     }
-    else if (strcmp (argvec[optind], "-dr") == 0)
+#ifndef NODAEMON
+    else if (strcmp (argvec[optind], "-daemon") == 0)
     {
-      deriverate = 1;
+      daemonsocket = getoptval (argcount, argvec, optind++, 0);
     }
-    else if (strcmp (argvec[optind], "-i") == 0)
+    else if (strcmp (argvec[optind], "-dj") == 0)
     {
-      indifile = 1;
+      daemonjobs = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (daemonjobs < 1 || daemonjobs > JOBMAXCONCURRENT)
+      {
+        fprintf (stderr, "Number of concurrent daemon jobs must be between 1 and %d\n", JOBMAXCONCURRENT);
+        exit (1);
+      }
     }
-    else if (strcmp (argvec[optind], "-ic") == 0)
+    else if (strcmp (argvec[optind], "-dt") == 0)
     {
-      indichannel = 1;
+      daemontimeout = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (daemontimeout < 1 || daemontimeout > 3600)
+      {
+        fprintf (stderr, "Job request timeout must be between 1 and 3600 seconds\n");
+        exit (1);
+      }
     }
+#endif
 #ifndef NOFDZIP
     else if (strcmp (argvec[optind], "-z") == 0)
     {
@@ -1225,6 +3740,52 @@ parameter_proc (int argcount, char **argvec)
       zipfile = getoptval (argcount, argvec, optind++, 1);
       zipmethod = ZS_STORE;
     }
+#ifdef FDZIP_LIBDEFLATE
+    else if (strcmp (argvec[optind], "-zl") == 0)
+    {
+      zipfile = getoptval (argcount, argvec, optind++, 1);
+      zipmethod = ZS_LIBDEFLATE;
+    }
+#endif
+#ifdef FDZIP_ZSTD
+    else if (strcmp (argvec[optind], "-zs") == 0)
+    {
+      zipfile = getoptval (argcount, argvec, optind++, 1);
+      zipmethod = ZS_ZSTD;
+    }
+#endif
+#ifndef NOPTHREADS
+    else if (strcmp (argvec[optind], "-zt") == 0)
+    {
+      zipthreads = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (zipthreads < 1 || zipthreads > MAXTHREADS)
+      {
+        fprintf (stderr, "Number of ZIP compression threads must be between 1 and %d\n", MAXTHREADS);
+        exit (1);
+      }
+    }
+    else if (strcmp (argvec[optind], "-zw") == 0)
+    {
+      zipbuffers = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (zipbuffers < 2 || zipbuffers > ZIPMAXBUFFERS)
+      {
+        fprintf (stderr, "Number of ZIP output buffers must be between 2 and %d\n", ZIPMAXBUFFERS);
+        exit (1);
+      }
+    }
+    else if (strcmp (argvec[optind], "-zws") == 0)
+    {
+      zipbufsize = (int)strtol (getoptval (argcount, argvec, optind++, 0), NULL, 10);
+
+      if (zipbufsize < 1 || zipbufsize > ZIPMAXBUFSIZE)
+      {
+        fprintf (stderr, "Size of ZIP output buffers must be between 1 and %d kilobytes\n", ZIPMAXBUFSIZE);
+        exit (1);
+      }
+    }
+#endif
 #endif
     else if (strncmp (argvec[optind], "-", 1) == 0 &&
              strlen (argvec[optind]) > 1)
@@ -1235,15 +3796,22 @@ parameter_proc (int argcount, char **argvec)
     else
     {
       /* Add the file name to the intput file list */
-      if (!addnode (&filelist, NULL, 0, argvec[optind], strlen (argvec[optind]) + 1))
+      if (!addnode (&filelist, &filelisttail, NULL, 0, argvec[optind], strlen (argvec[optind]) + 1))
       {
         fprintf (stderr, "Error adding file name to list\n");
       }
     }
   }
 
+  /* Input files are specified by each job when running as a daemon */
+  if (daemonsocket && !jobprocess && filelist)
+  {
+    fprintf (stderr, "Error, input files are specified by jobs when running as a daemon\n");
+    exit (1);
+  }
+
   /* Make sure an input files were specified */
-  if (filelist == 0)
+  if (filelist == 0 && (!daemonsocket || jobprocess))
   {
     fprintf (stderr, "No input files were specified\n\n");
     fprintf (stderr, "%s version %s\n\n", PACKAGE, VERSION);
@@ -1251,21 +3819,65 @@ parameter_proc (int argcount, char **argvec)
     exit (1);
   }
 
+  /* A bundle contains binary SAC files and is not written with a ZIP archive */
+  if (bundlefile && (zipfile || sacformat < 2 || sacformat > 4))
+  {
+    fprintf (stderr, "Error, a SAC bundle (-b) requires a binary SAC format and no ZIP archive\n");
+    exit (1);
+  }
+
+  /* Job output is written to the connection as a single stream */
+  if (jobprocess &&
+      !((zipfile && !strcmp (zipfile, "-")) || (bundlefile && !strcmp (bundlefile, "-"))))
+  {
+    fprintf (stderr, "Error, job output must be a ZIP archive (-z -) or SAC bundle (-b -)\n");
+    exit (1);
+  }
+
+  /* Trimming to selection windows requires selections */
+  if (trimselect && !selectfile && !selections)
+  {
+    fprintf (stderr, "Error, trimming to selection windows (-tl) requires a selection file (-l)\n");
+    exit (1);
+  }
+
+  trimming = (trimstart != HPTERROR || trimend != HPTERROR || trimselect);
+
+  /* Parse shard as k/N, shards are numbered from 0 to N-1 */
+  if (shardstr)
+  {
+    if (sscanf (shardstr, "%d/%d%c", &shardindex, &shardcount, &shardend) != 2 ||
+        shardcount < 1 || shardindex < 0 || shardindex >= shardcount)
+    {
+      fprintf (stderr, "Error parsing shard, expected k/N with 0 <= k < N: %s\n", shardstr);
+      exit (1);
+    }
+  }
+
+  /* The manifest is not written to stdout when the output is */
+  if (manifestfile && !strcmp (manifestfile, "-") &&
+      ((zipfile && !strcmp (zipfile, "-")) || (bundlefile && !strcmp (bundlefile, "-"))))
+  {
+    fprintf (stderr, "Error, the manifest cannot be written to stdout with the output\n");
+    exit (1);
+  }
+
   /* Report the program version */
-  if (verbose)
+  if (verbose && !jobprocess)
     fprintf (stderr, "%s version: %s\n", PACKAGE, VERSION);
 
   /* Check the input files for any list files, if any are found
    * remove them from the list and add the contained list */
   if (filelist)
   {
-    struct listnode *prevln, *ln;
+    struct listnode *prevln, *ln, *nextln;
     char *lfname;
 
     prevln = ln = filelist;
     while (ln != 0)
     {
       lfname = ln->data;
+      nextln = ln->next;
 
       if (*lfname == '@')
       {
@@ -1275,6 +3887,9 @@ parameter_proc (int argcount, char **argvec)
         else
           prevln->next = ln->next;
 
+        if (ln == filelisttail)
+          filelisttail = (filelist == ln->next) ? 0 : prevln;
+
         /* Skip the '@' first character */
         if (*lfname == '@')
           lfname++;
@@ -1293,7 +3908,7 @@ parameter_proc (int argcount, char **argvec)
         prevln = ln;
       }
 
-      ln = ln->next;
+      ln = nextln;
     }
   }
 
@@ -1399,17 +4014,35 @@ parameter_proc (int argcount, char **argvec)
         eventname = ename;
   }
 
-  /* Read data selection file */
+  /* Read data selection file, replacing the selections of the daemon for a job */
   if (selectfile)
   {
-    if (ms_readselectionsfile (&selections, selectfile) < 0)
+    if (jobprocess)
     {
-      fprintf (stderr, "Cannot read data selection file\n");
-      return -1;
+      selections = 0;
+      selectindex = 0;
+    }
+
+    if (!usecache || !strcmp (selectfile, "-") || readselectcache (selectfile))
+    {
+      if (ms_readselectionsfile (&selections, selectfile) < 0)
+      {
+        fprintf (stderr, "Cannot read data selection file\n");
+        return -1;
+      }
+
+      if (usecache && strcmp (selectfile, "-"))
+        writeselectcache (selectfile);
     }
 
     if (verbose > 1)
       ms_printselections (selections);
+
+    if (!(selectindex = ms_compileselections (selections)))
+    {
+      fprintf (stderr, "Cannot compile data selections\n");
+      return -1;
+    }
   }
 
   /* Read metadata file if specified */
@@ -1422,6 +4055,13 @@ parameter_proc (int argcount, char **argvec)
     }
   }
 
+  /* Index metadata from file and command line, a job uses the index of the daemon */
+  if (metadata && !jobprocess && indexmetadata ())
+  {
+    fprintf (stderr, "Error indexing metadata\n");
+    return -1;
+  }
+
   return 0;
 } /* End of parameter_proc() */
 
@@ -1550,7 +4190,7 @@ readlistfile (char *listfile)
         fprintf (stderr, "Adding '%s' to input file list\n", filename);
 
       /* Add file name to the intput file list */
-      if (!addnode (&filelist, NULL, 0, filename, strlen (filename) + 1))
+      if (!addnode (&filelist, &filelisttail, NULL, 0, filename, strlen (filename) + 1))
       {
         fprintf (stderr, "Error adding file name to list\n");
       }
@@ -1610,6 +4250,7 @@ addmetadata (char *metaline)
 {
   struct metanode mn;
   char *lineptr;
+  char *endptr;
   char *fp;
   char delim;
   int fields = 0;
@@ -1658,6 +4299,7 @@ addmetadata (char *metaline)
   /* Create a copy of the line */
   lineptr = strdup (metaline);
 
+  memset (&mn, 0, sizeof (struct metanode));
   mn.metafields[0] = fp = lineptr;
   mn.starttime = HPTERROR;
   mn.endtime = HPTERROR;
@@ -1694,6 +4336,22 @@ addmetadata (char *metaline)
     mn.metafields[2] = "";
   }
 
+  /* Parse numeric fields */
+  if (mn.metafields[4])
+    mn.stla = (float)strtod (mn.metafields[4], &endptr);
+  if (mn.metafields[5])
+    mn.stlo = (float)strtod (mn.metafields[5], &endptr);
+  if (mn.metafields[6])
+    mn.stel = (float)strtod (mn.metafields[6], &endptr);
+  if (mn.metafields[7])
+    mn.stdp = (float)strtod (mn.metafields[7], &endptr);
+  if (mn.metafields[8])
+    mn.cmpaz = (float)strtod (mn.metafields[8], &endptr);
+  if (mn.metafields[9])
+    mn.cmpinc = (float)strtod (mn.metafields[9], &endptr);
+  if (mn.metafields[11])
+    mn.scale = (float)strtod (mn.metafields[11], &endptr);
+
   /* Parse and convert start time */
   if (mn.metafields[15])
   {
@@ -1715,7 +4373,7 @@ addmetadata (char *metaline)
   }
 
   /* Add the metanode to the metadata list */
-  if (!addnode (&metadata, NULL, 0, &mn, sizeof (struct metanode)))
+  if (!addnode (&metadata, &metadatatail, NULL, 0, &mn, sizeof (struct metanode)))
   {
     fprintf (stderr, "Error adding metadata fields to list\n");
   }
@@ -1733,6 +4391,9 @@ addmetadata (char *metaline)
  *
  * Any lines beginning with '#' are skipped, think comments.
  *
+ * When caches are used the entries are loaded from a current cache of
+ * the file if available, otherwise the cache is written after parsing.
+ *
  * Returns 0 on sucess and -1 on failure.
  ***************************************************************************/
 static int
@@ -1741,11 +4402,22 @@ readmetadata (char *metafile)
   FILE *mfp;
   char line[1024];
   char *fp;
+  struct listnode *lastmeta;
   int linecount = 0;
+  int saveseedinc;
+  int fileseedinc;
 
   if (!metafile)
     return -1;
 
+  if (usecache && !readmetacache (metafile))
+    return 0;
+
+  /* Track entries and inclination convention of this file for the cache */
+  lastmeta = (metadata) ? metadatatail : 0;
+  saveseedinc = seedinc;
+  seedinc = 0;
+
   if ((mfp = fopen (metafile, "rb")) == NULL)
   {
     fprintf (stderr, "Cannot open metadata output file: %s (%s)\n",
@@ -1780,19 +4452,285 @@ readmetadata (char *metafile)
 
   fclose (mfp);
 
+  fileseedinc = seedinc;
+  seedinc |= saveseedinc;
+
+  if (usecache)
+    writemetacache (metafile, (lastmeta) ? lastmeta->next : metadata, fileseedinc);
+
   return 0;
 } /* End of readmetadata() */
 
+/***************************************************************************
+ * readmetacache:
+ *
+ * Add the metadata entries from the cache of a metadata file to the
+ * metadata list.  The fields of the entries reference the strings of
+ * the cache, which is kept for the life of the program.
+ *
+ * Returns 0 on success and -1 when no usable cache exists or on error.
+ ***************************************************************************/
+static int
+readmetacache (char *metafile)
+{
+  struct metanode mn;
+  MCMetaEntry *entry;
+  MCache *cache;
+  int64_t idx;
+  int field;
+  int valid;
+
+  if ((cache = mc_read (metafile, MC_METADATA, sizeof (MCMetaEntry), verbose)) == NULL)
+    return -1;
+
+  /* Check all string references before adding any entries */
+  for (idx = 0; idx < cache->count; idx++)
+  {
+    entry = (MCMetaEntry *)(cache->entries + idx * cache->entrysize);
+
+    for (field = 0; field < MAXMETAFIELDS; field++)
+    {
+      if (!mc_string (cache, entry->fields[field], &valid) && (!valid || field <= 3))
+      {
+        fprintf (stderr, "Corrupt cache file for %s\n", metafile);
+        mc_free (cache);
+        return -1;
+      }
+    }
+  }
+
+  if (verbose)
+    fprintf (stderr, "Reading station/channel metadata from cache of %s\n", metafile);
+
+  for (idx = 0; idx < cache->count; idx++)
+  {
+    entry = (MCMetaEntry *)(cache->entries + idx * cache->entrysize);
+
+    memset (&mn, 0, sizeof (struct metanode));
+
+    for (field = 0; field < MAXMETAFIELDS; field++)
+      mn.metafields[field] = (char *)mc_string (cache, entry->fields[field], &valid);
+
+    mn.stla = entry->stla;
+    mn.stlo = entry->stlo;
+    mn.stel = entry->stel;
+    mn.stdp = entry->stdp;
+    mn.cmpaz = entry->cmpaz;
+    mn.cmpinc = entry->cmpinc;
+    mn.scale = entry->scale;
+    mn.starttime = entry->starttime;
+    mn.endtime = entry->endtime;
+
+    if (!addnode (&metadata, &metadatatail, NULL, 0, &mn, sizeof (struct metanode)))
+    {
+      fprintf (stderr, "Error adding metadata fields to list\n");
+    }
+  }
+
+  if (cache->flags & MC_SEEDINC)
+    seedinc = 1;
+
+  metacache = cache;
+
+  return 0;
+} /* End of readmetacache() */
+
+/***************************************************************************
+ * writemetacache:
+ *
+ * Write the cache of a metadata file containing the entries of the
+ * metadata list from first to the end, fileseedinc indicates that the
+ * file contains SEED dip inclinations.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+writemetacache (char *metafile, struct listnode *first, int fileseedinc)
+{
+  struct listnode *mlp;
+  struct metanode *mn;
+  MCMetaEntry *entry;
+  MCache *cache;
+  int field;
+  int rv = -1;
+
+  if ((cache = mc_init (MC_METADATA, sizeof (MCMetaEntry))) == NULL)
+    return -1;
+
+  if (fileseedinc)
+    cache->flags |= MC_SEEDINC;
+
+  for (mlp = first; mlp; mlp = mlp->next)
+  {
+    mn = (struct metanode *)mlp->data;
+
+    if ((entry = (MCMetaEntry *)mc_addentry (cache)) == NULL)
+      goto cleanup;
+
+    for (field = 0; field < MAXMETAFIELDS; field++)
+      if (mc_addstring (cache, mn->metafields[field], &entry->fields[field]))
+        goto cleanup;
+
+    entry->stla = mn->stla;
+    entry->stlo = mn->stlo;
+    entry->stel = mn->stel;
+    entry->stdp = mn->stdp;
+    entry->cmpaz = mn->cmpaz;
+    entry->cmpinc = mn->cmpinc;
+    entry->scale = mn->scale;
+    entry->starttime = mn->starttime;
+    entry->endtime = mn->endtime;
+  }
+
+  rv = mc_write (cache, metafile, verbose);
+
+cleanup:
+  mc_free (cache);
+
+  return rv;
+} /* End of writemetacache() */
+
+/***************************************************************************
+ * readselectcache:
+ *
+ * Build the data selection list from the cache of a selection file,
+ * in the same order as read by ms_readselectionsfile().
+ *
+ * Returns 0 on success and -1 when no usable cache exists or on error.
+ ***************************************************************************/
+static int
+readselectcache (char *selectfile)
+{
+  MCSelectEntry *entry;
+  MCache *cache;
+  Selections *select = 0;
+  Selections *lastselect = 0;
+  SelectTime *selecttime;
+  SelectTime *lasttime = 0;
+  const char *srcname;
+  uint32_t lastsrcname = 0;
+  int64_t idx;
+  int valid;
+
+  if ((cache = mc_read (selectfile, MC_SELECTIONS, sizeof (MCSelectEntry), verbose)) == NULL)
+    return -1;
+
+  for (idx = 0; idx < cache->count; idx++)
+  {
+    entry = (MCSelectEntry *)(cache->entries + idx * cache->entrysize);
+
+    if (!(srcname = mc_string (cache, entry->srcname, &valid)))
+    {
+      fprintf (stderr, "Corrupt cache file for %s\n", selectfile);
+      goto failure;
+    }
+
+    /* Consecutive entries with the same source name are one selection */
+    if (!select || entry->srcname != lastsrcname)
+    {
+      if (!(select = (Selections *)calloc (1, sizeof (Selections))))
+      {
+        fprintf (stderr, "readselectcache(): Cannot allocate memory\n");
+        goto failure;
+      }
+
+      strncpy (select->srcname, srcname, sizeof (select->srcname) - 1);
+
+      if (lastselect)
+        lastselect->next = select;
+      else
+        selections = select;
+
+      lastselect = select;
+      lasttime = 0;
+      lastsrcname = entry->srcname;
+    }
+
+    if (!(selecttime = (SelectTime *)calloc (1, sizeof (SelectTime))))
+    {
+      fprintf (stderr, "readselectcache(): Cannot allocate memory\n");
+      goto failure;
+    }
+
+    selecttime->starttime = entry->starttime;
+    selecttime->endtime = entry->endtime;
+
+    if (lasttime)
+      lasttime->next = selecttime;
+    else
+      select->timewindows = selecttime;
+
+    lasttime = selecttime;
+  }
+
+  mc_free (cache);
+
+  return 0;
+
+failure:
+  mc_free (cache);
+  ms_freeselections (selections);
+  selections = 0;
+
+  return -1;
+} /* End of readselectcache() */
+
+/***************************************************************************
+ * writeselectcache:
+ *
+ * Write the cache of a selection file containing the data selection
+ * list.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+writeselectcache (char *selectfile)
+{
+  MCSelectEntry *entry;
+  MCache *cache;
+  Selections *select;
+  SelectTime *selecttime;
+  uint32_t srcname;
+  int rv = -1;
+
+  if ((cache = mc_init (MC_SELECTIONS, sizeof (MCSelectEntry))) == NULL)
+    return -1;
+
+  for (select = selections; select; select = select->next)
+  {
+    if (mc_addstring (cache, select->srcname, &srcname))
+      goto cleanup;
+
+    for (selecttime = select->timewindows; selecttime; selecttime = selecttime->next)
+    {
+      if ((entry = (MCSelectEntry *)mc_addentry (cache)) == NULL)
+        goto cleanup;
+
+      entry->srcname = srcname;
+      entry->starttime = selecttime->starttime;
+      entry->endtime = selecttime->endtime;
+    }
+  }
+
+  rv = mc_write (cache, selectfile, verbose);
+
+cleanup:
+  mc_free (cache);
+
+  return rv;
+} /* End of writeselectcache() */
+
 /***************************************************************************
  * addnode:
  *
- * Add node to the specified list.  Copies of the key and data are created.
+ * Add node to the end of the specified list, listtail tracks the last
+ * node of the list.  Copies of the key and data are created.
  *
  * Return a pointer to the added node on success and NULL on error.
  ***************************************************************************/
 static struct listnode *
-addnode (struct listnode **listroot, void *key, int keylen,
-         void *data, int datalen)
+addnode (struct listnode **listroot, struct listnode **listtail,
+         void *key, int keylen, void *data, int datalen)
 {
   struct listnode *lastlp, *newlp;
 
@@ -1802,14 +4740,7 @@ addnode (struct listnode **listroot, void *key, int keylen,
     return NULL;
   }
 
-  lastlp = *listroot;
-  while (lastlp != 0)
-  {
-    if (lastlp->next == 0)
-      break;
-
-    lastlp = lastlp->next;
-  }
+  lastlp = (*listroot) ? *listtail : 0;
 
   /* Create new listnode */
   newlp = (struct listnode *)malloc (sizeof (struct listnode));
@@ -1834,6 +4765,8 @@ addnode (struct listnode **listroot, void *key, int keylen,
   else
     lastlp->next = newlp;
 
+  *listtail = newlp;
+
   return newlp;
 } /* End of addnode() */
 
@@ -1862,6 +4795,9 @@ usage (int level)
            " -E event       Specify event parameters as 'Time[/Lat][/Lon][/Depth][/Name]'\n"
            "                  e.g. '2006,123,15:27:08.7/-20.33/-174.03/65.5/Tonga'\n"
            " -l selectfile  Read a list of selections from file, used for subsetting\n"
+           " -ts time       Trim samples before this time, YYYY-MM-DD[THH:MM:SS.FFFFFF]\n"
+           " -te time       Trim samples after this time, YYYY-MM-DD[THH:MM:SS.FFFFFF]\n"
+           " -tl            Trim samples outside of the time windows of the selections\n"
            "\n"
            " -f format      Specify SAC file format (default is 2:binary):\n"
            "                  1=alpha, 2=binary (host byte order),\n"
@@ -1881,11 +4817,64 @@ usage (int level)
              " -i             Process each input file individually instead of merged\n"
              " -ic            Process each channel individually, data should be well ordered\n"
              " -dr            Use the sampling rate derived from the time stamps instead\n"
-             "                  of the sample rate denoted in the input data\n");
+             "                  of the sample rate denoted in the input data\n"
+             " -rb megabytes  Read input with a read-ahead buffer of this size instead\n"
+             "                  of memory mapping, for network file systems\n"
+             " -ri            Read selected records using record index files, which are\n"
+             "                  created next to the input files when missing or outdated\n"
+             " -mc            Load the metadata and selection files from compiled caches,\n"
+             "                  created next to the files when missing or outdated\n"
+             " -sw seconds    Stream output, write traces that end more than this many\n"
+             "                  seconds before the latest record, input ordered by time,\n"
+             "                  greater than 0 and at most 1000000000\n"
+             " -sm megabytes  Stream output, write largest traces early to keep sample\n"
+             "                  memory below this limit, 1 to 1048576\n"
+             " -stats         Report phase timing, throughput and the slowest channels\n"
+             " -statsjson file\n"
+             "                  Write the statistics as JSON to file, use '-' for stdout\n"
+             " -shard k/N     Process only the sources in shard k of N, from 0 to N-1\n"
+             " -manifest file Write a manifest of the SAC files written as JSON to file\n");
+#ifndef NOPTHREADS
+    fprintf (stderr,
+             " -j threads     Number of threads used to write output files, default\n"
+             "                  is to write files from the main thread\n"
+             " -rt threads    Number of threads used to read and decode input files,\n"
+             "                  default is to read files from the main thread\n"
+             " -ao threads    Number of threads used to write small binary SAC files\n"
+             "                  asynchronously in batches\n");
+#endif
+    fprintf (stderr,
+             " -fsync         Sync each output file to storage before closing it\n"
+             " -b bundlefile  Write all binary SAC files to a single indexed bundle,\n"
+             "                  use '-' for stdout\n");
 #ifndef NOFDZIP
     fprintf (stderr,
              " -z zipfile     Write all SAC files to a ZIP archive, use '-' for stdout\n"
              " -z0 zipfile    Same as -z but do not compress archive entries\n");
+#ifdef FDZIP_LIBDEFLATE
+    fprintf (stderr,
+             " -zl zipfile    Same as -z but compress entries using libdeflate\n");
+#endif
+#ifdef FDZIP_ZSTD
+    fprintf (stderr,
+             " -zs zipfile    Same as -z but compress entries using zstd (method 93)\n");
+#endif
+#ifndef NOPTHREADS
+    fprintf (stderr,
+             " -zt threads    Number of threads used to compress ZIP archive entries\n"
+             " -zw buffers    Write ZIP archive with a separate thread from this many\n"
+             "                  buffers, 2 to 256, overlapping compression and output\n"
+             " -zws kilobytes Size of each ZIP output buffer for -zw, 1 to 65536, default 1024\n");
+#endif
+#endif
+#ifndef NODAEMON
+    fprintf (stderr,
+             " -daemon socket Accept conversion jobs on a Unix socket, keeping the metadata\n"
+             "                  and selections loaded, output is written to the connection\n"
+             " -dj jobs       Number of jobs processed concurrently by the daemon, 1 to 256,\n"
+             "                  default 1\n"
+             " -dt seconds    Time allowed for a client to send a job request, 1 to 3600,\n"
+             "                  default 10\n");
 #endif
 
     fprintf (stderr, "\n");
@@ -0,0 +1,370 @@
+/***************************************************************************
+ * msindex.c
+ *
+ * Record index files for miniSEED input.
+ *
+ * An index file is a sidecar of a data file, see sidecar.c, with
+ * MSI_SUFFIX added to the name.  It contains the source name, start
+ * and end times, length and offset of every record in the data file.
+ * Source names are stored once in a table and referenced by the
+ * records.  The header identifies the record length option used to
+ * read the data, an index built with another record length is ignored
+ * as the records found may differ.
+ *
+ * Index file layout:
+ *   char     magic[8]     "MSIDX01\n"
+ *   uint32_t byteorder    0x01020304
+ *   uint32_t entrysize    sizeof(MSIndexEntry)
+ *   int32_t  reclen
+ *   uint32_t srccount
+ *   int64_t  filesize
+ *   int64_t  filetime
+ *   int64_t  count
+ *   srccount x (uint16_t length, char srcname[length])
+ *   count x MSIndexEntry
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msindex.h"
+#include "sidecar.h"
+
+#define MSI_MAGIC "MSIDX01\n"
+
+static int addsrcname (MSIndex *index, const char *srcname, uint32_t *srcidx);
+static const char *srcnameof (void *data, uintptr_t value, size_t *length);
+
+/***************************************************************************
+ * msi_init:
+ *
+ * Allocate and initialize an empty index for building, the reclen is
+ * the record length used to read the data file.
+ *
+ * Returns a pointer to a new MSIndex on success and NULL on error.
+ ***************************************************************************/
+MSIndex *
+msi_init (int32_t reclen)
+{
+  MSIndex *index;
+
+  if ((index = (MSIndex *)calloc (1, sizeof (MSIndex))) == NULL)
+  {
+    fprintf (stderr, "msi_init(): Cannot allocate memory\n");
+    return NULL;
+  }
+
+  index->reclen = reclen;
+  kt_init (&index->srctable, srcnameof, index);
+
+  return index;
+} /* End of msi_init() */
+
+/***************************************************************************
+ * msi_add:
+ *
+ * Add an entry for a record read from the specified offset of the
+ * data file, records must be added in file order.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+msi_add (MSIndex *index, MSRecord *msr, int64_t offset)
+{
+  MSIndexEntry *entry;
+  void *newentries;
+  char srcname[50];
+  uint32_t srcidx;
+
+  if (!index || !msr)
+    return -1;
+
+  if (index->count >= index->size)
+  {
+    index->size = (index->size) ? index->size * 2 : 1024;
+
+    if ((newentries = realloc (index->entries, index->size * sizeof (MSIndexEntry))) == NULL)
+    {
+      fprintf (stderr, "msi_add(): Cannot allocate memory\n");
+      return -1;
+    }
+
+    index->entries = (MSIndexEntry *)newentries;
+  }
+
+  msr_srcname (msr, srcname, 1);
+
+  if (addsrcname (index, srcname, &srcidx))
+    return -1;
+
+  entry = &index->entries[index->count++];
+  entry->offset = offset;
+  entry->starttime = msr->starttime;
+  entry->endtime = msr_endtime (msr);
+  entry->srcname = srcidx;
+  entry->reclen = msr->reclen;
+
+  return 0;
+} /* End of msi_add() */
+
+/***************************************************************************
+ * msi_read:
+ *
+ * Read the index file for a data file.  The index is only returned if
+ * it was built with the same record length and the data file has not
+ * changed size or modification time since.
+ *
+ * Returns a pointer to a MSIndex on success and NULL when no usable
+ * index exists or on error.
+ ***************************************************************************/
+MSIndex *
+msi_read (const char *datafile, int32_t reclen, int verbose)
+{
+  MSIndex *index = NULL;
+  FILE *ifp;
+  char indexfile[1024];
+  char header[SC_HEADERSIZE];
+  uint32_t entrysize;
+  uint32_t srccount;
+  uint32_t idx;
+  uint16_t length;
+  int64_t filesize;
+  int64_t filetime;
+
+  if (sc_path (indexfile, sizeof (indexfile), datafile, MSI_SUFFIX))
+    return NULL;
+
+  if ((ifp = fopen (indexfile, "rb")) == NULL)
+    return NULL;
+
+  if ((index = msi_init (reclen)) == NULL)
+  {
+    fclose (ifp);
+    return NULL;
+  }
+
+  if (fread (header, sizeof (header), 1, ifp) != 1 ||
+      fread (&entrysize, sizeof (entrysize), 1, ifp) != 1 ||
+      fread (&index->reclen, sizeof (index->reclen), 1, ifp) != 1 ||
+      fread (&srccount, sizeof (srccount), 1, ifp) != 1 ||
+      fread (&index->filesize, sizeof (index->filesize), 1, ifp) != 1 ||
+      fread (&index->filetime, sizeof (index->filetime), 1, ifp) != 1 ||
+      fread (&index->count, sizeof (index->count), 1, ifp) != 1 ||
+      sc_checkheader (header, MSI_MAGIC) || entrysize != sizeof (MSIndexEntry) ||
+      index->count < 0)
+  {
+    if (verbose)
+      fprintf (stderr, "Ignoring unrecognized index file %s\n", indexfile);
+
+    goto failure;
+  }
+
+  /* Check that the index matches the data file and reading options */
+  if (sc_filestat (datafile, &filesize, &filetime) ||
+      filesize != index->filesize || filetime != index->filetime ||
+      reclen != index->reclen)
+  {
+    if (verbose)
+      fprintf (stderr, "Ignoring out of date index file %s\n", indexfile);
+
+    goto failure;
+  }
+
+  if ((srccount && (index->srcnames = (char **)calloc (srccount, sizeof (char *))) == NULL) ||
+      (index->count && (index->entries = (MSIndexEntry *)malloc (index->count * sizeof (MSIndexEntry))) == NULL))
+  {
+    fprintf (stderr, "msi_read(): Cannot allocate memory\n");
+    goto failure;
+  }
+
+  for (idx = 0; idx < srccount; idx++)
+  {
+    if (fread (&length, sizeof (length), 1, ifp) != 1 ||
+        (index->srcnames[idx] = (char *)malloc (length + 1)) == NULL ||
+        (length && fread (index->srcnames[idx], length, 1, ifp) != 1))
+    {
+      fprintf (stderr, "Error reading index file %s\n", indexfile);
+      goto failure;
+    }
+
+    index->srcnames[idx][length] = '\0';
+    index->srccount = idx + 1;
+  }
+
+  if (index->count && fread (index->entries, sizeof (MSIndexEntry), index->count, ifp) != (size_t)index->count)
+  {
+    fprintf (stderr, "Error reading index file %s\n", indexfile);
+    goto failure;
+  }
+
+  index->size = index->count;
+
+  /* Validate source name references */
+  for (filesize = 0; filesize < index->count; filesize++)
+  {
+    if (index->entries[filesize].srcname >= index->srccount)
+    {
+      fprintf (stderr, "Corrupt index file %s\n", indexfile);
+      goto failure;
+    }
+  }
+
+  fclose (ifp);
+
+  if (verbose)
+    fprintf (stderr, "Read index of %lld records from %s\n", (long long int)index->count, indexfile);
+
+  return index;
+
+failure:
+  fclose (ifp);
+  msi_free (index);
+
+  return NULL;
+} /* End of msi_read() */
+
+/***************************************************************************
+ * msi_write:
+ *
+ * Write an index file for a data file, replacing any existing index.
+ * The size and modification time of the data file are recorded for
+ * detection of changes.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+msi_write (MSIndex *index, const char *datafile, int verbose)
+{
+  SCWriter sw;
+  FILE *ifp;
+  uint32_t entrysize = sizeof (MSIndexEntry);
+  uint32_t idx;
+  uint16_t length;
+
+  if (!index || !datafile)
+    return -1;
+
+  if (sc_filestat (datafile, &index->filesize, &index->filetime))
+    return -1;
+
+  if (sc_open (&sw, datafile, MSI_SUFFIX, "index", MSI_MAGIC))
+    return -1;
+
+  ifp = sw.fp;
+
+  if (fwrite (&entrysize, sizeof (entrysize), 1, ifp) != 1 ||
+      fwrite (&index->reclen, sizeof (index->reclen), 1, ifp) != 1 ||
+      fwrite (&index->srccount, sizeof (index->srccount), 1, ifp) != 1 ||
+      fwrite (&index->filesize, sizeof (index->filesize), 1, ifp) != 1 ||
+      fwrite (&index->filetime, sizeof (index->filetime), 1, ifp) != 1 ||
+      fwrite (&index->count, sizeof (index->count), 1, ifp) != 1)
+    goto failure;
+
+  for (idx = 0; idx < index->srccount; idx++)
+  {
+    length = (uint16_t)strlen (index->srcnames[idx]);
+
+    if (fwrite (&length, sizeof (length), 1, ifp) != 1 ||
+        (length && fwrite (index->srcnames[idx], length, 1, ifp) != 1))
+      goto failure;
+  }
+
+  if (index->count && fwrite (index->entries, sizeof (MSIndexEntry), index->count, ifp) != (size_t)index->count)
+    goto failure;
+
+  if (sc_close (&sw))
+    return -1;
+
+  if (verbose)
+    fprintf (stderr, "Wrote index of %lld records to %s\n", (long long int)index->count, sw.path);
+
+  return 0;
+
+failure:
+  sc_abort (&sw);
+
+  return -1;
+} /* End of msi_write() */
+
+/***************************************************************************
+ * msi_free:
+ *
+ * Free all memory associated with an index.
+ ***************************************************************************/
+void
+msi_free (MSIndex *index)
+{
+  uint32_t idx;
+
+  if (!index)
+    return;
+
+  for (idx = 0; idx < index->srccount; idx++)
+    free (index->srcnames[idx]);
+
+  free (index->srcnames);
+  kt_free (&index->srctable);
+  free (index->entries);
+  free (index);
+} /* End of msi_free() */
+
+/***************************************************************************
+ * addsrcname:
+ *
+ * Find a source name in the index, adding it if not present.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+addsrcname (MSIndex *index, const char *srcname, uint32_t *srcidx)
+{
+  uintptr_t value;
+  void *newnames;
+
+  if ((value = kt_find (&index->srctable, srcname, strlen (srcname))))
+  {
+    *srcidx = (uint32_t)(value - 1);
+    return 0;
+  }
+
+  if ((newnames = realloc (index->srcnames, (index->srccount + 1) * sizeof (char *))) == NULL)
+  {
+    fprintf (stderr, "addsrcname(): Cannot allocate memory\n");
+    return -1;
+  }
+
+  index->srcnames = (char **)newnames;
+
+  if ((index->srcnames[index->srccount] = strdup (srcname)) == NULL)
+  {
+    fprintf (stderr, "addsrcname(): Cannot allocate memory\n");
+    return -1;
+  }
+
+  if (kt_add (&index->srctable, (uintptr_t)index->srccount + 1))
+  {
+    free (index->srcnames[index->srccount]);
+    return -1;
+  }
+
+  *srcidx = index->srccount++;
+
+  return 0;
+} /* End of addsrcname() */
+
+/***************************************************************************
+ * srcnameof:
+ *
+ * Return the source name of a value of the source name table, the
+ * index of the name + 1.
+ ***************************************************************************/
+static const char *
+srcnameof (void *data, uintptr_t value, size_t *length)
+{
+  const char *srcname = ((MSIndex *)data)->srcnames[value - 1];
+
+  *length = strlen (srcname);
+
+  return srcname;
+} /* End of srcnameof() */
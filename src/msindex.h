@@ -0,0 +1,58 @@
+/***************************************************************************
+ * msindex.h
+ *
+ * Record index files for miniSEED input, a sidecar file listing the
+ * source name, time range, length and file offset of every record in
+ * a data file.  With an index the records matching a data selection
+ * can be read directly without scanning the whole file.
+ ***************************************************************************/
+
+#ifndef MSINDEX_H
+#define MSINDEX_H
+
+#include <stdint.h>
+
+#include <libmseed.h>
+
+#include "keytable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Suffix added to a data file name for its index file */
+#define MSI_SUFFIX ".msidx"
+
+typedef struct MSIndexEntry_s
+{
+  int64_t offset;     /* Offset of record in data file */
+  hptime_t starttime; /* Time of first sample */
+  hptime_t endtime;   /* Time of last sample */
+  uint32_t srcname;   /* Source name, index into srcnames */
+  int32_t reclen;     /* Record length */
+} MSIndexEntry;
+
+typedef struct MSIndex_s
+{
+  char **srcnames; /* Source names, Net_Sta_Loc_Chan_Qual */
+  uint32_t srccount;
+  KeyTable srctable; /* Source names, values are index + 1, built while adding */
+  MSIndexEntry *entries; /* Records in file order */
+  int64_t count;
+  int64_t size;
+  int64_t filesize; /* Size of data file when indexed */
+  int64_t filetime; /* Modification time of data file when indexed */
+  int32_t reclen;   /* Record length used to read data file, -1 to detect */
+} MSIndex;
+
+extern MSIndex *msi_init (int32_t reclen);
+extern int msi_add (MSIndex *index, MSRecord *msr, int64_t offset);
+extern MSIndex *msi_read (const char *datafile, int32_t reclen, int verbose);
+extern int msi_write (MSIndex *index, const char *datafile, int verbose);
+extern void msi_free (MSIndex *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSINDEX_H */
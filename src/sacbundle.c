@@ -0,0 +1,254 @@
+/***************************************************************************
+ * sacbundle.c
+ *
+ * SAC bundle output.
+ *
+ * A bundle holds many SAC files in a single file that is only ever
+ * appended to, so it may be written to a pipe.  Each SAC file is
+ * stored complete and unmodified, starting at an offset aligned to
+ * SB_ALIGN bytes, and the index of all files is written when the
+ * bundle is closed.  A reader can map the bundle, find the index from
+ * the trailer at the end and use the offset and length of a file to
+ * access it directly.  Bundles are written in host byte order, the
+ * header identifies the byte order and index entry size.
+ *
+ * Bundle layout:
+ *   char     magic[8]     "SACBNDL1"
+ *   uint32_t byteorder    0x01020304
+ *   uint32_t entrysize    sizeof(SBIndexEntry)
+ *   SAC files, each zero padded to SB_ALIGN bytes
+ *   count x SBIndexEntry
+ *   int64_t  indexoffset  Offset of first index entry
+ *   int64_t  count        Number of index entries
+ *   char     magic[8]     "SBINDEX1"
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sacbundle.h"
+
+#define SB_MAGIC "SACBNDL1"
+#define SB_INDEXMAGIC "SBINDEX1"
+#define SB_BYTEORDER 0x01020304
+
+static int writebundle (SACBundle *bundle, const void *data, size_t length);
+static int padbundle (SACBundle *bundle);
+
+/***************************************************************************
+ * sb_open:
+ *
+ * Create a bundle file and write the header, a bundle file of "-" is
+ * written to stdout.
+ *
+ * Returns a pointer to a new SACBundle on success and NULL on error.
+ ***************************************************************************/
+SACBundle *
+sb_open (const char *bundlefile)
+{
+  SACBundle *bundle;
+  uint32_t byteorder = SB_BYTEORDER;
+  uint32_t entrysize = sizeof (SBIndexEntry);
+
+  if ((bundle = (SACBundle *)calloc (1, sizeof (SACBundle))) == NULL)
+  {
+    fprintf (stderr, "sb_open(): Cannot allocate memory\n");
+    return NULL;
+  }
+
+  bundle->entrystart = -1;
+
+  if (!strcmp (bundlefile, "-"))
+  {
+    bundle->fp = stdout;
+  }
+  else if ((bundle->fp = fopen (bundlefile, "wb")) == NULL)
+  {
+    fprintf (stderr, "Cannot open output file: %s (%s)\n", bundlefile, strerror (errno));
+    free (bundle);
+    return NULL;
+  }
+
+  if (writebundle (bundle, SB_MAGIC, 8) ||
+      writebundle (bundle, &byteorder, sizeof (byteorder)) ||
+      writebundle (bundle, &entrysize, sizeof (entrysize)))
+  {
+    fprintf (stderr, "Error writing bundle header to %s: %s\n", bundlefile, strerror (errno));
+
+    if (bundle->fp != stdout)
+      fclose (bundle->fp);
+    free (bundle);
+    return NULL;
+  }
+
+  return bundle;
+} /* End of sb_open() */
+
+/***************************************************************************
+ * sb_entrybegin:
+ *
+ * Begin adding a SAC file to a bundle, the contents are added with
+ * sb_entrydata() and the file is finished with sb_entryend().
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sb_entrybegin (SACBundle *bundle)
+{
+  if (!bundle || bundle->entrystart >= 0)
+    return -1;
+
+  if (padbundle (bundle))
+    return -1;
+
+  bundle->entrystart = bundle->offset;
+
+  return 0;
+} /* End of sb_entrybegin() */
+
+/***************************************************************************
+ * sb_entrydata:
+ *
+ * Add data to the SAC file being added to a bundle.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sb_entrydata (SACBundle *bundle, const void *data, size_t length)
+{
+  if (!bundle || bundle->entrystart < 0)
+    return -1;
+
+  return writebundle (bundle, data, length);
+} /* End of sb_entrydata() */
+
+/***************************************************************************
+ * sb_entryend:
+ *
+ * Finish adding a SAC file to a bundle and add it to the index with
+ * the specified name, source name and times.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sb_entryend (SACBundle *bundle, const char *name, const char *srcname,
+             hptime_t starttime, hptime_t endtime)
+{
+  SBIndexEntry *entry;
+  void *newentries;
+  int64_t newsize;
+
+  if (!bundle || bundle->entrystart < 0)
+    return -1;
+
+  if (bundle->count >= bundle->size)
+  {
+    newsize = (bundle->size) ? bundle->size * 2 : 256;
+
+    if ((newentries = realloc (bundle->entries, newsize * sizeof (SBIndexEntry))) == NULL)
+    {
+      fprintf (stderr, "sb_entryend(): Cannot allocate memory\n");
+      return -1;
+    }
+
+    bundle->entries = (SBIndexEntry *)newentries;
+    bundle->size = newsize;
+  }
+
+  entry = &bundle->entries[bundle->count++];
+  memset (entry, 0, sizeof (SBIndexEntry));
+
+  entry->offset = bundle->entrystart;
+  entry->length = bundle->offset - bundle->entrystart;
+  entry->starttime = starttime;
+  entry->endtime = endtime;
+  strncpy (entry->srcname, srcname, sizeof (entry->srcname) - 1);
+  strncpy (entry->name, name, sizeof (entry->name) - 1);
+
+  bundle->entrystart = -1;
+
+  return 0;
+} /* End of sb_entryend() */
+
+/***************************************************************************
+ * sb_close:
+ *
+ * Write the index and trailer of a bundle, close the bundle file and
+ * free all memory associated with the bundle.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sb_close (SACBundle *bundle, int verbose)
+{
+  int64_t indexoffset;
+  int rv = 0;
+
+  if (!bundle)
+    return -1;
+
+  if (padbundle (bundle))
+    rv = -1;
+
+  indexoffset = bundle->offset;
+
+  if (rv == 0 &&
+      ((bundle->count && writebundle (bundle, bundle->entries, bundle->count * sizeof (SBIndexEntry))) ||
+       writebundle (bundle, &indexoffset, sizeof (indexoffset)) ||
+       writebundle (bundle, &bundle->count, sizeof (bundle->count)) ||
+       writebundle (bundle, SB_INDEXMAGIC, 8)))
+    rv = -1;
+
+  if (fflush (bundle->fp))
+    rv = -1;
+
+  if (bundle->fp != stdout && fclose (bundle->fp))
+    rv = -1;
+
+  if (rv)
+    fprintf (stderr, "Error writing bundle: %s\n", strerror (errno));
+  else if (verbose)
+    fprintf (stderr, "Wrote bundle of %lld SAC files, %lld bytes\n",
+             (long long int)bundle->count, (long long int)(bundle->offset));
+
+  free (bundle->entries);
+  free (bundle);
+
+  return rv;
+} /* End of sb_close() */
+
+/***************************************************************************
+ * writebundle:
+ *
+ * Write data to the end of a bundle.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+writebundle (SACBundle *bundle, const void *data, size_t length)
+{
+  if (length && fwrite (data, length, 1, bundle->fp) != 1)
+    return -1;
+
+  bundle->offset += length;
+
+  return 0;
+} /* End of writebundle() */
+
+/***************************************************************************
+ * padbundle:
+ *
+ * Pad the end of a bundle with zeros to a multiple of SB_ALIGN bytes.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+padbundle (SACBundle *bundle)
+{
+  static const char zeros[SB_ALIGN] = {0};
+  size_t padding = (SB_ALIGN - bundle->offset % SB_ALIGN) % SB_ALIGN;
+
+  return writebundle (bundle, zeros, padding);
+} /* End of padbundle() */
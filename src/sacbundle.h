@@ -0,0 +1,55 @@
+/***************************************************************************
+ * sacbundle.h
+ *
+ * SAC bundle output, a single append-only file containing complete
+ * binary SAC files followed by an index of their source names, times,
+ * offsets and lengths.
+ ***************************************************************************/
+
+#ifndef SACBUNDLE_H
+#define SACBUNDLE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <libmseed.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Alignment of SAC files and the index in a bundle */
+#define SB_ALIGN 8
+
+typedef struct SBIndexEntry_s
+{
+  int64_t offset;     /* Offset of SAC file in bundle */
+  int64_t length;     /* Length of SAC file */
+  hptime_t starttime; /* Time of first sample */
+  hptime_t endtime;   /* Time of last sample */
+  char srcname[64];   /* Source name, Net_Sta_Loc_Chan_Qual */
+  char name[128];     /* SAC file name */
+} SBIndexEntry;
+
+typedef struct SACBundle_s
+{
+  FILE *fp;
+  int64_t offset;        /* Current end of bundle */
+  int64_t entrystart;    /* Offset of SAC file being added, -1 if none */
+  SBIndexEntry *entries; /* SAC files in bundle order */
+  int64_t count;
+  int64_t size;
+} SACBundle;
+
+extern SACBundle *sb_open (const char *bundlefile);
+extern int sb_entrybegin (SACBundle *bundle);
+extern int sb_entrydata (SACBundle *bundle, const void *data, size_t length);
+extern int sb_entryend (SACBundle *bundle, const char *name, const char *srcname,
+                        hptime_t starttime, hptime_t endtime);
+extern int sb_close (SACBundle *bundle, int verbose);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SACBUNDLE_H */
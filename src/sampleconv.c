@@ -0,0 +1,504 @@
+/***************************************************************************
+ * sampleconv.c
+ *
+ * Conversion of data samples to 32-bit floats for SAC output, with
+ * optional byte swapping of the converted samples.
+ *
+ * Conversion and swapping are done in a single pass.  SSE2 and AVX2
+ * (x86) or NEON (ARM64) implementations are selected at run time by
+ * sc_init(), with a portable scalar implementation as a fallback.  The
+ * vector conversions use the same rounding as the scalar casts, so
+ * all implementations produce identical output.
+ *
+ * Formatting of floats for alphanumeric SAC is done by sc_formatalpha(),
+ * producing output identical to printf("%#15.7g").
+ ***************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sampleconv.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SC_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SC_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Byte swap a 32-bit value */
+#define SC_SWAP32(X) (((X) >> 24) | (((X) >> 8) & 0x0000ff00) | \
+                      (((X) << 8) & 0x00ff0000) | ((X) << 24))
+
+static void int32tofloat_scalar (float *fdata, const int32_t *idata, int64_t count, int swap);
+static void doubletofloat_scalar (float *fdata, const double *ddata, int64_t count, int swap);
+static void swapfloat_scalar (float *fdata, int64_t count);
+
+/* Selected implementations */
+static void (*int32tofloat) (float *, const int32_t *, int64_t, int) = int32tofloat_scalar;
+static void (*doubletofloat) (float *, const double *, int64_t, int) = doubletofloat_scalar;
+static void (*swapfloat) (float *, int64_t) = swapfloat_scalar;
+static const char *kernelname = 0;
+
+/***************************************************************************
+ * Scalar implementations
+ *
+ * Swapped values are stored with memcpy() to avoid any floating point
+ * handling of the byte swapped bit patterns.
+ ***************************************************************************/
+static void
+int32tofloat_scalar (float *fdata, const int32_t *idata, int64_t count, int swap)
+{
+  uint32_t word;
+  float value;
+  int64_t idx;
+
+  if (!swap)
+  {
+    for (idx = 0; idx < count; idx++)
+      fdata[idx] = (float)idata[idx];
+
+    return;
+  }
+
+  for (idx = 0; idx < count; idx++)
+  {
+    value = (float)idata[idx];
+    memcpy (&word, &value, sizeof (word));
+    word = SC_SWAP32 (word);
+    memcpy (&fdata[idx], &word, sizeof (word));
+  }
+}
+
+static void
+doubletofloat_scalar (float *fdata, const double *ddata, int64_t count, int swap)
+{
+  uint32_t word;
+  float value;
+  int64_t idx;
+
+  if (!swap)
+  {
+    for (idx = 0; idx < count; idx++)
+      fdata[idx] = (float)ddata[idx];
+
+    return;
+  }
+
+  for (idx = 0; idx < count; idx++)
+  {
+    value = (float)ddata[idx];
+    memcpy (&word, &value, sizeof (word));
+    word = SC_SWAP32 (word);
+    memcpy (&fdata[idx], &word, sizeof (word));
+  }
+}
+
+static void
+swapfloat_scalar (float *fdata, int64_t count)
+{
+  uint32_t word;
+  int64_t idx;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    memcpy (&word, &fdata[idx], sizeof (word));
+    word = SC_SWAP32 (word);
+    memcpy (&fdata[idx], &word, sizeof (word));
+  }
+}
+
+#if defined(SC_X86)
+/***************************************************************************
+ * SSE2 implementations
+ ***************************************************************************/
+__attribute__ ((target ("sse2"))) static inline __m128i
+swap32_sse2 (__m128i value)
+{
+  /* Swap bytes within 16-bit words, then swap the 16-bit words */
+  value = _mm_or_si128 (_mm_slli_epi16 (value, 8), _mm_srli_epi16 (value, 8));
+  value = _mm_shufflelo_epi16 (value, _MM_SHUFFLE (2, 3, 0, 1));
+  return _mm_shufflehi_epi16 (value, _MM_SHUFFLE (2, 3, 0, 1));
+}
+
+__attribute__ ((target ("sse2"))) static void
+int32tofloat_sse2 (float *fdata, const int32_t *idata, int64_t count, int swap)
+{
+  __m128 value;
+  int64_t idx;
+
+  for (idx = 0; (idx + 4) <= count; idx += 4)
+  {
+    value = _mm_cvtepi32_ps (_mm_loadu_si128 ((const __m128i *)(idata + idx)));
+
+    if (swap)
+      _mm_storeu_si128 ((__m128i *)(fdata + idx), swap32_sse2 (_mm_castps_si128 (value)));
+    else
+      _mm_storeu_ps (fdata + idx, value);
+  }
+
+  int32tofloat_scalar (fdata + idx, idata + idx, count - idx, swap);
+}
+
+__attribute__ ((target ("sse2"))) static void
+doubletofloat_sse2 (float *fdata, const double *ddata, int64_t count, int swap)
+{
+  __m128 value;
+  int64_t idx;
+
+  for (idx = 0; (idx + 4) <= count; idx += 4)
+  {
+    value = _mm_movelh_ps (_mm_cvtpd_ps (_mm_loadu_pd (ddata + idx)),
+                           _mm_cvtpd_ps (_mm_loadu_pd (ddata + idx + 2)));
+
+    if (swap)
+      _mm_storeu_si128 ((__m128i *)(fdata + idx), swap32_sse2 (_mm_castps_si128 (value)));
+    else
+      _mm_storeu_ps (fdata + idx, value);
+  }
+
+  doubletofloat_scalar (fdata + idx, ddata + idx, count - idx, swap);
+}
+
+__attribute__ ((target ("sse2"))) static void
+swapfloat_sse2 (float *fdata, int64_t count)
+{
+  int64_t idx;
+
+  for (idx = 0; (idx + 4) <= count; idx += 4)
+    _mm_storeu_si128 ((__m128i *)(fdata + idx),
+                      swap32_sse2 (_mm_loadu_si128 ((const __m128i *)(fdata + idx))));
+
+  swapfloat_scalar (fdata + idx, count - idx);
+}
+
+/***************************************************************************
+ * AVX2 implementations
+ ***************************************************************************/
+__attribute__ ((target ("avx2"))) static inline __m256i
+swap32_avx2 (__m256i value)
+{
+  const __m256i mask = _mm256_set_epi8 (12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+  return _mm256_shuffle_epi8 (value, mask);
+}
+
+__attribute__ ((target ("avx2"))) static void
+int32tofloat_avx2 (float *fdata, const int32_t *idata, int64_t count, int swap)
+{
+  __m256 value;
+  int64_t idx;
+
+  for (idx = 0; (idx + 8) <= count; idx += 8)
+  {
+    value = _mm256_cvtepi32_ps (_mm256_loadu_si256 ((const __m256i *)(idata + idx)));
+
+    if (swap)
+      _mm256_storeu_si256 ((__m256i *)(fdata + idx), swap32_avx2 (_mm256_castps_si256 (value)));
+    else
+      _mm256_storeu_ps (fdata + idx, value);
+  }
+
+  int32tofloat_scalar (fdata + idx, idata + idx, count - idx, swap);
+}
+
+__attribute__ ((target ("avx2"))) static void
+doubletofloat_avx2 (float *fdata, const double *ddata, int64_t count, int swap)
+{
+  __m256 value;
+  int64_t idx;
+
+  for (idx = 0; (idx + 8) <= count; idx += 8)
+  {
+    value = _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm256_cvtpd_ps (_mm256_loadu_pd (ddata + idx))),
+                                  _mm256_cvtpd_ps (_mm256_loadu_pd (ddata + idx + 4)), 1);
+
+    if (swap)
+      _mm256_storeu_si256 ((__m256i *)(fdata + idx), swap32_avx2 (_mm256_castps_si256 (value)));
+    else
+      _mm256_storeu_ps (fdata + idx, value);
+  }
+
+  doubletofloat_scalar (fdata + idx, ddata + idx, count - idx, swap);
+}
+
+__attribute__ ((target ("avx2"))) static void
+swapfloat_avx2 (float *fdata, int64_t count)
+{
+  int64_t idx;
+
+  for (idx = 0; (idx + 8) <= count; idx += 8)
+    _mm256_storeu_si256 ((__m256i *)(fdata + idx),
+                         swap32_avx2 (_mm256_loadu_si256 ((const __m256i *)(fdata + idx))));
+
+  swapfloat_scalar (fdata + idx, count - idx);
+}
+#endif /* SC_X86 */
+
+#if defined(SC_NEON)
+/***************************************************************************
+ * NEON implementations
+ ***************************************************************************/
+static void
+int32tofloat_neon (float *fdata, const int32_t *idata, int64_t count, int swap)
+{
+  float32x4_t value;
+  int64_t idx;
+
+  for (idx = 0; (idx + 4) <= count; idx += 4)
+  {
+    value = vcvtq_f32_s32 (vld1q_s32 (idata + idx));
+
+    if (swap)
+      vst1q_u8 ((uint8_t *)(fdata + idx), vrev32q_u8 (vreinterpretq_u8_f32 (value)));
+    else
+      vst1q_f32 (fdata + idx, value);
+  }
+
+  int32tofloat_scalar (fdata + idx, idata + idx, count - idx, swap);
+}
+
+static void
+doubletofloat_neon (float *fdata, const double *ddata, int64_t count, int swap)
+{
+  float32x4_t value;
+  int64_t idx;
+
+  for (idx = 0; (idx + 4) <= count; idx += 4)
+  {
+    value = vcombine_f32 (vcvt_f32_f64 (vld1q_f64 (ddata + idx)),
+                          vcvt_f32_f64 (vld1q_f64 (ddata + idx + 2)));
+
+    if (swap)
+      vst1q_u8 ((uint8_t *)(fdata + idx), vrev32q_u8 (vreinterpretq_u8_f32 (value)));
+    else
+      vst1q_f32 (fdata + idx, value);
+  }
+
+  doubletofloat_scalar (fdata + idx, ddata + idx, count - idx, swap);
+}
+
+static void
+swapfloat_neon (float *fdata, int64_t count)
+{
+  int64_t idx;
+
+  for (idx = 0; (idx + 4) <= count; idx += 4)
+    vst1q_u8 ((uint8_t *)(fdata + idx), vrev32q_u8 (vld1q_u8 ((const uint8_t *)(fdata + idx))));
+
+  swapfloat_scalar (fdata + idx, count - idx);
+}
+#endif /* SC_NEON */
+
+/***************************************************************************
+ * sc_init:
+ *
+ * Select the conversion implementations for the running CPU.  This
+ * should be called before any threads use the conversion routines,
+ * otherwise it is called on first use.
+ *
+ * Returns the name of the selected implementation.
+ ***************************************************************************/
+const char *
+sc_init (void)
+{
+  if (kernelname)
+    return kernelname;
+
+#if defined(SC_X86)
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2"))
+  {
+    int32tofloat = int32tofloat_avx2;
+    doubletofloat = doubletofloat_avx2;
+    swapfloat = swapfloat_avx2;
+    kernelname = "AVX2";
+  }
+  else if (__builtin_cpu_supports ("sse2"))
+  {
+    int32tofloat = int32tofloat_sse2;
+    doubletofloat = doubletofloat_sse2;
+    swapfloat = swapfloat_sse2;
+    kernelname = "SSE2";
+  }
+#elif defined(SC_NEON)
+  int32tofloat = int32tofloat_neon;
+  doubletofloat = doubletofloat_neon;
+  swapfloat = swapfloat_neon;
+  kernelname = "NEON";
+#endif
+
+  if (!kernelname)
+    kernelname = "scalar";
+
+  return kernelname;
+} /* End of sc_init() */
+
+/***************************************************************************
+ * sc_int32tofloat:
+ *
+ * Convert 32-bit integers to floats, byte swapping the floats if swap
+ * is true.  The samples may be converted in place, with fdata at the
+ * start of the input samples.
+ ***************************************************************************/
+void
+sc_int32tofloat (float *fdata, const int32_t *idata, int64_t count, int swap)
+{
+  if (!kernelname)
+    sc_init ();
+
+  int32tofloat (fdata, idata, count, swap);
+} /* End of sc_int32tofloat() */
+
+/***************************************************************************
+ * sc_doubletofloat:
+ *
+ * Convert 64-bit doubles to floats, byte swapping the floats if swap
+ * is true.  The samples may be converted in place, with fdata at the
+ * start of the input samples.
+ ***************************************************************************/
+void
+sc_doubletofloat (float *fdata, const double *ddata, int64_t count, int swap)
+{
+  if (!kernelname)
+    sc_init ();
+
+  doubletofloat (fdata, ddata, count, swap);
+} /* End of sc_doubletofloat() */
+
+/***************************************************************************
+ * sc_swapfloat:
+ *
+ * Byte swap floats in place.
+ ***************************************************************************/
+void
+sc_swapfloat (float *fdata, int64_t count)
+{
+  if (!kernelname)
+    sc_init ();
+
+  swapfloat (fdata, count);
+} /* End of sc_swapfloat() */
+
+/***************************************************************************
+ * sc_formatalpha:
+ *
+ * Format a float exactly as printf("%#15.7g") would, writing 15
+ * characters to buffer without a terminating NULL.
+ *
+ * Values printed in fixed point notation, with magnitudes from 1e-4 up
+ * to 1e7 and the bulk of typical sample values, are formatted directly
+ * using exact integer arithmetic with round-half-even rounding of the
+ * binary value, matching the C library.  All other values, including
+ * zero, exponential notation, subnormals, infinities and NaNs, are
+ * formatted with snprintf().
+ ***************************************************************************/
+void
+sc_formatalpha (char *buffer, float value)
+{
+  static const uint64_t pow10[] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL,
+                                   100000ULL, 1000000ULL, 10000000ULL,
+                                   100000000ULL, 1000000000ULL, 10000000000ULL};
+  char fallback[32];
+  char digits[7];
+  char *cp;
+  uint32_t word;
+  uint64_t mantissa;
+  uint64_t scaled;
+  uint64_t digitval;
+  uint64_t remainder;
+  uint64_t half;
+  int biased;
+  int shift;
+  int exponent;
+  int precision;
+  int length;
+  int tries;
+  int idx;
+
+  memcpy (&word, &value, sizeof (word));
+  biased = (word >> 23) & 0xff;
+
+  /* The value is (mantissa / 2^shift), fixed point output requires a
+   * value of at least ~1e-4 (2^-14) and under 1e7 (< 2^24) */
+  shift = 150 - biased;
+
+  if (biased != 0 && shift >= 0 && shift <= 38)
+  {
+    mantissa = (word & 0x7fffff) | 0x800000;
+
+    /* Estimate decimal exponent from binary exponent, then correct it
+     * using the rounded 7 significant digits of the value */
+    exponent = ((biased - 127) * 1233) >> 12;
+
+    for (tries = 0; tries < 4; tries++)
+    {
+      precision = 6 - exponent;
+
+      if (precision < 0 || precision > 10)
+        break;
+
+      scaled = mantissa * pow10[precision];
+      digitval = scaled >> shift;
+
+      if (shift > 0)
+      {
+        remainder = scaled & ((1ULL << shift) - 1);
+        half = 1ULL << (shift - 1);
+
+        if (remainder > half || (remainder == half && (digitval & 1)))
+          digitval++;
+      }
+
+      if (digitval >= 10000000ULL)
+        exponent++;
+      else if (digitval < 1000000ULL)
+        exponent--;
+      else
+        break;
+    }
+
+    if (tries < 4 && precision >= 0 && precision <= 10)
+    {
+      for (idx = 6; idx >= 0; idx--)
+      {
+        digits[idx] = '0' + (char)(digitval % 10);
+        digitval /= 10;
+      }
+
+      /* Length: sign, leading "0." and zeros or the decimal point */
+      length = ((word >> 31) ? 1 : 0) + 8 + ((exponent < 0) ? -exponent : 0);
+
+      memset (buffer, ' ', 15 - length);
+      cp = buffer + 15 - length;
+
+      if (word >> 31)
+        *cp++ = '-';
+
+      if (exponent >= 0)
+      {
+        memcpy (cp, digits, exponent + 1);
+        cp += exponent + 1;
+        *cp++ = '.';
+        memcpy (cp, digits + exponent + 1, 6 - exponent);
+      }
+      else
+      {
+        *cp++ = '0';
+        *cp++ = '.';
+        for (idx = 1; idx < -exponent; idx++)
+          *cp++ = '0';
+        memcpy (cp, digits, 7);
+      }
+
+      return;
+    }
+  }
+
+  snprintf (fallback, sizeof (fallback), "%#15.7g", value);
+  memcpy (buffer, fallback, 15);
+} /* End of sc_formatalpha() */
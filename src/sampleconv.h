@@ -0,0 +1,31 @@
+/***************************************************************************
+ * sampleconv.h
+ *
+ * Conversion of data samples to 32-bit floats for SAC output, with
+ * optional byte swapping, and formatting of floats for alphanumeric SAC.
+ *
+ * Vectorized implementations are selected at run time based on the
+ * capabilities of the CPU, a portable scalar implementation is used
+ * otherwise.  All implementations produce identical results.
+ ***************************************************************************/
+
+#ifndef SAMPLECONV_H
+#define SAMPLECONV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const char *sc_init (void);
+extern void sc_int32tofloat (float *fdata, const int32_t *idata, int64_t count, int swap);
+extern void sc_doubletofloat (float *fdata, const double *ddata, int64_t count, int swap);
+extern void sc_swapfloat (float *fdata, int64_t count);
+extern void sc_formatalpha (char *buffer, float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLECONV_H */
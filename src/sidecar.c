@@ -0,0 +1,181 @@
+/***************************************************************************
+ * sidecar.c
+ *
+ * Common routines of sidecar files.
+ *
+ * A sidecar file is written next to an input file, with a suffix added
+ * to the name, in host byte order.  Every sidecar starts with an 8
+ * byte magic identifying its format followed by SC_BYTEORDER, a file
+ * written on a host of the other byte order does not match and is
+ * ignored.  The size and modification time of the input file are
+ * recorded by the formats so that a sidecar is rebuilt when the file
+ * changes.  A sidecar is written to a temporary file that is renamed
+ * when complete, readers never see a partial file.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "sidecar.h"
+
+/***************************************************************************
+ * sc_path:
+ *
+ * Build the name of the sidecar of an input file in a buffer of size
+ * bytes.
+ *
+ * Returns 0 on success and -1 if the name does not fit.
+ ***************************************************************************/
+int
+sc_path (char *path, size_t size, const char *srcfile, const char *suffix)
+{
+  int length;
+
+  length = snprintf (path, size, "%s%s", srcfile, suffix);
+
+  if (length < 0 || (size_t)length >= size)
+  {
+    fprintf (stderr, "Sidecar file name for %s is too long\n", srcfile);
+    return -1;
+  }
+
+  return 0;
+} /* End of sc_path() */
+
+/***************************************************************************
+ * sc_filestat:
+ *
+ * Determine the size and modification time of an input file.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sc_filestat (const char *file, int64_t *filesize, int64_t *filetime)
+{
+  struct stat sbuf;
+
+  if (stat (file, &sbuf))
+  {
+    fprintf (stderr, "Cannot stat %s: %s\n", file, strerror (errno));
+    return -1;
+  }
+
+  *filesize = (int64_t)sbuf.st_size;
+  *filetime = (int64_t)sbuf.st_mtime;
+
+  return 0;
+} /* End of sc_filestat() */
+
+/***************************************************************************
+ * sc_checkheader:
+ *
+ * Check the common header of SC_HEADERSIZE bytes read from a sidecar,
+ * the magic and the byte order value must match.
+ *
+ * Returns 0 when the header matches and -1 otherwise.
+ ***************************************************************************/
+int
+sc_checkheader (const char *header, const char *magic)
+{
+  uint32_t byteorder;
+
+  memcpy (&byteorder, header + 8, sizeof (byteorder));
+
+  if (memcmp (header, magic, 8) || byteorder != SC_BYTEORDER)
+    return -1;
+
+  return 0;
+} /* End of sc_checkheader() */
+
+/***************************************************************************
+ * sc_open:
+ *
+ * Start writing the sidecar of an input file, the temporary file is
+ * created and the common header written.  The remainder of the file
+ * is written to sw->fp by the caller, followed by sc_close() or, on
+ * error, sc_abort().
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sc_open (SCWriter *sw, const char *srcfile, const char *suffix,
+         const char *kind, const char *magic)
+{
+  uint32_t byteorder = SC_BYTEORDER;
+
+  sw->fp = NULL;
+  sw->kind = kind;
+
+  if (sc_path (sw->path, sizeof (sw->path), srcfile, suffix))
+    return -1;
+
+  snprintf (sw->tempfile, sizeof (sw->tempfile), "%s.tmp", sw->path);
+
+  if ((sw->fp = fopen (sw->tempfile, "wb")) == NULL)
+  {
+    fprintf (stderr, "Cannot create %s file %s: %s\n", kind, sw->tempfile, strerror (errno));
+    return -1;
+  }
+
+  if (fwrite (magic, 8, 1, sw->fp) != 1 ||
+      fwrite (&byteorder, sizeof (byteorder), 1, sw->fp) != 1)
+  {
+    sc_abort (sw);
+    return -1;
+  }
+
+  return 0;
+} /* End of sc_open() */
+
+/***************************************************************************
+ * sc_close:
+ *
+ * Complete writing a sidecar, the temporary file is closed and
+ * renamed, replacing any existing sidecar.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+sc_close (SCWriter *sw)
+{
+  if (fclose (sw->fp))
+  {
+    sw->fp = NULL;
+    sc_abort (sw);
+    return -1;
+  }
+
+  sw->fp = NULL;
+
+  /* Replace any existing sidecar, removing it first where rename does not */
+  if (rename (sw->tempfile, sw->path) && (remove (sw->path) || rename (sw->tempfile, sw->path)))
+  {
+    fprintf (stderr, "Cannot rename %s file %s: %s\n", sw->kind, sw->tempfile, strerror (errno));
+    remove (sw->tempfile);
+    return -1;
+  }
+
+  return 0;
+} /* End of sc_close() */
+
+/***************************************************************************
+ * sc_abort:
+ *
+ * Report an error writing a sidecar, close and remove the temporary
+ * file.
+ ***************************************************************************/
+void
+sc_abort (SCWriter *sw)
+{
+  fprintf (stderr, "Error writing %s file %s: %s\n", sw->kind, sw->tempfile, strerror (errno));
+
+  if (sw->fp)
+    fclose (sw->fp);
+
+  sw->fp = NULL;
+  remove (sw->tempfile);
+} /* End of sc_abort() */
@@ -0,0 +1,46 @@
+/***************************************************************************
+ * sidecar.h
+ *
+ * Common routines of sidecar files, binary files written next to an
+ * input file that hold data derived from it, such as record indexes
+ * and compiled caches.
+ ***************************************************************************/
+
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Size of the common header, magic and byte order value */
+#define SC_HEADERSIZE 12
+
+/* Byte order value written in host byte order */
+#define SC_BYTEORDER 0x01020304
+
+/* A sidecar file being written */
+typedef struct SCWriter_s
+{
+  FILE *fp;           /* Temporary file being written */
+  char path[1024];    /* Sidecar file */
+  char tempfile[1040];
+  const char *kind;   /* Kind of sidecar for messages, e.g. "index" */
+} SCWriter;
+
+extern int sc_path (char *path, size_t size, const char *srcfile, const char *suffix);
+extern int sc_filestat (const char *file, int64_t *filesize, int64_t *filetime);
+extern int sc_checkheader (const char *header, const char *magic);
+extern int sc_open (SCWriter *sw, const char *srcfile, const char *suffix,
+                    const char *kind, const char *magic);
+extern int sc_close (SCWriter *sw);
+extern void sc_abort (SCWriter *sw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIDECAR_H */
@@ -0,0 +1,288 @@
+/***************************************************************************
+ * stats.c
+ *
+ * Timing and throughput statistics for the phases of a conversion.
+ *
+ * Phases are timed by taking a start time with st_now() and adding the
+ * elapsed time to the phase with st_add().  Nothing is measured until
+ * st_enable() is called, st_now() returns 0 and the other routines
+ * return immediately, so the calls can be left in the processing
+ * paths.  Statistics may be added from multiple threads.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jsonout.h"
+#include "m2splatform.h"
+#include "stats.h"
+
+#if defined(WIN32) || defined(WIN64)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct stphase
+{
+  double seconds;
+  int64_t calls;
+  int64_t bytes;
+};
+
+struct stchannel
+{
+  char name[64];
+  double seconds;
+  int64_t samples;
+};
+
+static const char *phasenames[ST_PHASES] = {
+    "read", "selection", "assembly", "write", "zip_entrydata", "zip_finish"};
+
+static int enabled = 0;
+static double starttime = 0.0;
+static struct stphase phases[ST_PHASES];
+static struct stchannel slowest[ST_SLOWEST]; /* Sorted, slowest first */
+static int slowestcount = 0;
+
+#ifndef NOPTHREADS
+static pthread_mutex_t statslock = PTHREAD_MUTEX_INITIALIZER;
+#define ST_LOCK() pthread_mutex_lock (&statslock)
+#define ST_UNLOCK() pthread_mutex_unlock (&statslock)
+#else
+#define ST_LOCK()
+#define ST_UNLOCK()
+#endif
+
+static long peakrss (void);
+
+/***************************************************************************
+ * st_enable:
+ *
+ * Enable collection of statistics, the run time is measured from this
+ * call.
+ ***************************************************************************/
+void
+st_enable (void)
+{
+  enabled = 1;
+  starttime = st_now ();
+} /* End of st_enable() */
+
+/***************************************************************************
+ * st_now:
+ *
+ * Returns a monotonic time in seconds, or 0 when statistics are not
+ * enabled.
+ ***************************************************************************/
+double
+st_now (void)
+{
+#if defined(WIN32) || defined(WIN64)
+  LARGE_INTEGER count;
+  LARGE_INTEGER frequency;
+
+  if (!enabled)
+    return 0.0;
+
+  QueryPerformanceCounter (&count);
+  QueryPerformanceFrequency (&frequency);
+
+  return (double)count.QuadPart / frequency.QuadPart;
+#else
+  struct timespec ts;
+
+  if (!enabled)
+    return 0.0;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+} /* End of st_now() */
+
+/***************************************************************************
+ * st_add:
+ *
+ * Add the time elapsed since start, one call and bytes processed to
+ * a phase.
+ ***************************************************************************/
+void
+st_add (int phase, double start, int64_t bytes)
+{
+  double seconds;
+
+  if (!enabled || phase < 0 || phase >= ST_PHASES)
+    return;
+
+  seconds = st_now () - start;
+
+  ST_LOCK ();
+  phases[phase].seconds += seconds;
+  phases[phase].calls++;
+  phases[phase].bytes += bytes;
+  ST_UNLOCK ();
+} /* End of st_add() */
+
+/***************************************************************************
+ * st_addbytes:
+ *
+ * Add bytes processed to a phase without a call or time.
+ ***************************************************************************/
+void
+st_addbytes (int phase, int64_t bytes)
+{
+  if (!enabled || phase < 0 || phase >= ST_PHASES)
+    return;
+
+  ST_LOCK ();
+  phases[phase].bytes += bytes;
+  ST_UNLOCK ();
+} /* End of st_addbytes() */
+
+/***************************************************************************
+ * st_channel:
+ *
+ * Add the time elapsed since start writing a channel to the list of
+ * slowest channels if it is one of the ST_SLOWEST slowest.
+ ***************************************************************************/
+void
+st_channel (const char *name, double start, int64_t samples)
+{
+  double seconds;
+  int idx;
+
+  if (!enabled)
+    return;
+
+  seconds = st_now () - start;
+
+  ST_LOCK ();
+
+  if (slowestcount < ST_SLOWEST || seconds > slowest[slowestcount - 1].seconds)
+  {
+    if (slowestcount < ST_SLOWEST)
+      slowestcount++;
+
+    /* Shift faster entries down, dropping the last */
+    for (idx = slowestcount - 1; idx > 0 && slowest[idx - 1].seconds < seconds; idx--)
+      slowest[idx] = slowest[idx - 1];
+
+    strncpy (slowest[idx].name, name, sizeof (slowest[idx].name) - 1);
+    slowest[idx].name[sizeof (slowest[idx].name) - 1] = '\0';
+    slowest[idx].seconds = seconds;
+    slowest[idx].samples = samples;
+  }
+
+  ST_UNLOCK ();
+} /* End of st_channel() */
+
+/***************************************************************************
+ * st_report:
+ *
+ * Print the statistics, as JSON if json is true, otherwise as text.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+int
+st_report (FILE *fp, int json, int files, int64_t records, int64_t samples)
+{
+  double runtime;
+  double rate;
+  long rss;
+  int idx;
+
+  if (!enabled)
+    return 0;
+
+  runtime = st_now () - starttime;
+  rate = (runtime > 0.0) ? records / runtime : 0.0;
+  rss = peakrss ();
+
+  ST_LOCK ();
+
+  if (json)
+  {
+    fprintf (fp, "{\n");
+    fprintf (fp, "  \"runtime\": %.6f,\n", runtime);
+    fprintf (fp, "  \"files\": %d,\n", files);
+    fprintf (fp, "  \"records\": %lld,\n", (long long int)records);
+    fprintf (fp, "  \"samples\": %lld,\n", (long long int)samples);
+    fprintf (fp, "  \"records_per_second\": %.1f,\n", rate);
+    fprintf (fp, "  \"bytes_read\": %lld,\n", (long long int)phases[ST_READ].bytes);
+    fprintf (fp, "  \"bytes_written\": %lld,\n", (long long int)phases[ST_WRITE].bytes);
+    fprintf (fp, "  \"peak_rss_kb\": %ld,\n", rss);
+    fprintf (fp, "  \"phases\": {\n");
+
+    for (idx = 0; idx < ST_PHASES; idx++)
+      fprintf (fp, "    \"%s\": {\"seconds\": %.6f, \"calls\": %lld, \"bytes\": %lld}%s\n",
+               phasenames[idx], phases[idx].seconds, (long long int)phases[idx].calls,
+               (long long int)phases[idx].bytes, (idx < ST_PHASES - 1) ? "," : "");
+
+    fprintf (fp, "  },\n");
+    fprintf (fp, "  \"slowest_channels\": [\n");
+
+    for (idx = 0; idx < slowestcount; idx++)
+    {
+      fprintf (fp, "    {\"name\": \"");
+      json_printstring (fp, slowest[idx].name);
+      fprintf (fp, "\", \"seconds\": %.6f, \"samples\": %lld}%s\n",
+               slowest[idx].seconds, (long long int)slowest[idx].samples,
+               (idx < slowestcount - 1) ? "," : "");
+    }
+
+    fprintf (fp, "  ]\n");
+    fprintf (fp, "}\n");
+  }
+  else
+  {
+    fprintf (fp, "Run time: %.3f seconds, %d files, %lld records (%.1f/s), %lld samples\n",
+             runtime, files, (long long int)records, rate, (long long int)samples);
+    fprintf (fp, "Bytes read: %lld, bytes written: %lld, peak RSS: %ld KB\n",
+             (long long int)phases[ST_READ].bytes, (long long int)phases[ST_WRITE].bytes, rss);
+
+    for (idx = 0; idx < ST_PHASES; idx++)
+      fprintf (fp, "  %-14s %10.3f s %10lld calls %14lld bytes\n",
+               phasenames[idx], phases[idx].seconds, (long long int)phases[idx].calls,
+               (long long int)phases[idx].bytes);
+
+    if (slowestcount > 0)
+      fprintf (fp, "Slowest channels written:\n");
+
+    for (idx = 0; idx < slowestcount; idx++)
+      fprintf (fp, "  %-30s %10.3f s %12lld samples\n", slowest[idx].name,
+               slowest[idx].seconds, (long long int)slowest[idx].samples);
+  }
+
+  ST_UNLOCK ();
+
+  return (ferror (fp)) ? -1 : 0;
+} /* End of st_report() */
+
+/***************************************************************************
+ * peakrss:
+ *
+ * Returns the peak resident set size of the process in kilobytes, or
+ * -1 if not available.
+ ***************************************************************************/
+static long
+peakrss (void)
+{
+#if defined(WIN32) || defined(WIN64)
+  return -1;
+#else
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage))
+    return -1;
+
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+} /* End of peakrss() */
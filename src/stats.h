@@ -0,0 +1,41 @@
+/***************************************************************************
+ * stats.h
+ *
+ * Timing and throughput statistics for the phases of a conversion,
+ * reported at the end of a run as text or JSON.
+ ***************************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Timed phases */
+#define ST_READ 0       /* Reading records */
+#define ST_SELECT 1     /* Testing records against selections */
+#define ST_ASSEMBLY 2   /* Adding records to traces */
+#define ST_WRITE 3      /* Writing SAC files or ZIP entries */
+#define ST_ZIPDATA 4    /* Adding data to ZIP entries with zs_entrydata() */
+#define ST_ZIPFINISH 5  /* Finishing ZIP archive with zs_finish() */
+#define ST_PHASES 6
+
+/* Number of slowest channels reported */
+#define ST_SLOWEST 10
+
+extern void st_enable (void);
+extern double st_now (void);
+extern void st_add (int phase, double start, int64_t bytes);
+extern void st_addbytes (int phase, int64_t bytes);
+extern void st_channel (const char *name, double start, int64_t samples);
+extern int st_report (FILE *fp, int json, int files, int64_t records, int64_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATS_H */
@@ -0,0 +1,229 @@
+/***************************************************************************
+ * m2stestbundle.c
+ *
+ * A program for mseed2sac SAC bundle tests, checking the structure of
+ * a bundle, listing its index and optionally extracting the SAC files.
+ *
+ * modified 2026.287
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#include "sacbundle.h"
+
+#define PACKAGE "m2stestbundle"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+static char *bundlefile = 0;
+static char *extractdir = 0;
+
+static int parameter_proc (int argcount, char **argvec);
+static void usage (void);
+
+int
+main (int argc, char **argv)
+{
+  SBIndexEntry *entries = NULL;
+  char *bundle = NULL;
+  char starttime[30];
+  char endtime[30];
+  char path[1024];
+  uint32_t byteorder;
+  uint32_t entrysize;
+  int64_t indexoffset;
+  int64_t count;
+  int64_t expect;
+  long size;
+  FILE *fp;
+  int64_t idx;
+  int errors = 0;
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  if ((fp = fopen (bundlefile, "rb")) == NULL)
+  {
+    fprintf (stderr, "Cannot open %s: %s\n", bundlefile, strerror (errno));
+    return 1;
+  }
+
+  if (fseek (fp, 0, SEEK_END) || (size = ftell (fp)) < 0 || fseek (fp, 0, SEEK_SET) ||
+      (bundle = (char *)malloc (size + 1)) == NULL ||
+      (size > 0 && fread (bundle, size, 1, fp) != 1))
+  {
+    fprintf (stderr, "Cannot read %s\n", bundlefile);
+    fclose (fp);
+    free (bundle);
+    return 1;
+  }
+
+  fclose (fp);
+
+  /* Header: magic, byte order value and index entry size */
+  if (size < 40 || memcmp (bundle, "SACBNDL1", 8))
+  {
+    fprintf (stderr, "%s: No bundle header\n", bundlefile);
+    free (bundle);
+    return 1;
+  }
+
+  memcpy (&byteorder, bundle + 8, sizeof (byteorder));
+  memcpy (&entrysize, bundle + 12, sizeof (entrysize));
+
+  if (byteorder != 0x01020304 || entrysize != sizeof (SBIndexEntry))
+  {
+    fprintf (stderr, "%s: Unexpected byte order value 0x%08x or entry size %u\n",
+             bundlefile, byteorder, entrysize);
+    free (bundle);
+    return 1;
+  }
+
+  /* Trailer: offset of index, number of entries and magic */
+  memcpy (&indexoffset, bundle + size - 24, sizeof (indexoffset));
+  memcpy (&count, bundle + size - 16, sizeof (count));
+
+  if (memcmp (bundle + size - 8, "SBINDEX1", 8) || indexoffset % SB_ALIGN ||
+      count < 0 || indexoffset + count * (int64_t)entrysize != size - 24)
+  {
+    fprintf (stderr, "%s: Invalid bundle trailer\n", bundlefile);
+    free (bundle);
+    return 1;
+  }
+
+  entries = (SBIndexEntry *)(bundle + indexoffset);
+
+  printf ("%s: %" PRId64 " SAC files, index at %" PRId64 "\n", bundlefile, count, indexoffset);
+
+  /* SAC files follow the header in index order at aligned offsets */
+  expect = 16;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    SBIndexEntry entry;
+
+    memcpy (&entry, &entries[idx], sizeof (entry));
+
+    ms_hptime2isotimestr (entry.starttime, starttime, 1);
+    ms_hptime2isotimestr (entry.endtime, endtime, 1);
+
+    printf ("%" PRId64 " %" PRId64 " %s %s %s %s\n", entry.offset, entry.length,
+            entry.srcname, starttime, endtime, entry.name);
+
+    if (entry.offset != expect || entry.offset % SB_ALIGN || entry.length <= 0 ||
+        entry.offset + entry.length > indexoffset)
+    {
+      printf ("ERROR %s: Offset %" PRId64 " or length %" PRId64 " out of place\n",
+              entry.name, entry.offset, entry.length);
+      errors++;
+      continue;
+    }
+
+    expect = (entry.offset + entry.length + SB_ALIGN - 1) / SB_ALIGN * SB_ALIGN;
+
+    if (extractdir)
+    {
+      snprintf (path, sizeof (path), "%s/%s", extractdir, entry.name);
+
+      if ((fp = fopen (path, "wb")) == NULL ||
+          fwrite (bundle + entry.offset, entry.length, 1, fp) != 1 ||
+          fclose (fp))
+      {
+        fprintf (stderr, "Cannot write %s: %s\n", path, strerror (errno));
+        errors++;
+      }
+    }
+  }
+
+  if (expect != indexoffset)
+  {
+    printf ("ERROR Index at %" PRId64 ", expected %" PRId64 "\n", indexoffset, expect);
+    errors++;
+  }
+
+  free (bundle);
+
+  return (errors) ? 1 : 0;
+} /* End of main() */
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      fprintf (stderr, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-x") == 0 && optind + 1 < argcount)
+    {
+      extractdir = argvec[++optind];
+    }
+    else if (strncmp (argvec[optind], "-", 1) == 0)
+    {
+      fprintf (stderr, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+    else if (bundlefile == 0)
+    {
+      bundlefile = argvec[optind];
+    }
+    else
+    {
+      fprintf (stderr, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+  }
+
+  /* Make sure a bundle file was specified */
+  if (!bundlefile)
+  {
+    fprintf (stderr, "No bundle file was specified\n\n");
+    fprintf (stderr, "Try %s -h for usage\n", PACKAGE);
+    exit (1);
+  }
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s [options] bundlefile\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -x dir         Extract the SAC files into dir\n"
+           "\n"
+           " bundlefile     SAC bundle written with mseed2sac -b\n"
+           "\n"
+           "This program checks the header, SAC file offsets, index and\n"
+           "trailer of a SAC bundle and lists its index.\n"
+           "\n");
+} /* End of usage() */
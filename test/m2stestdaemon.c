@@ -0,0 +1,199 @@
+/***************************************************************************
+ * m2stestdaemon.c
+ *
+ * A program for mseed2sac daemon tests, a client sending a job request
+ * to a daemon socket and copying the output of the job to stdout.
+ *
+ * modified 2026.287
+ ***************************************************************************/
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <libmseed.h>
+
+#define PACKAGE "m2stestdaemon"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+/* Connection attempts while the daemon is starting, 0.1 seconds apart */
+#define CONNECTTRIES 100
+
+static int sendall (int fd, const char *data, size_t length);
+static void usage (void);
+
+int
+main (int argc, char **argv)
+{
+  struct sockaddr_un addr;
+  char buffer[65536];
+  char *datafile = NULL;
+  ssize_t count;
+  size_t length;
+  FILE *fp;
+  int idle = 0;
+  int argidx = 2;
+  int tries;
+  int fd = -1;
+
+  if (argc < 2 || strcmp (argv[1], "-h") == 0)
+  {
+    usage ();
+    return (argc < 2) ? 1 : 0;
+  }
+
+  /* Report a connection closed by the daemon as an error */
+  signal (SIGPIPE, SIG_IGN);
+
+  for (; argidx + 1 < argc; argidx += 2)
+  {
+    if (strcmp (argv[argidx], "-d") == 0)
+      datafile = argv[argidx + 1];
+    else if (strcmp (argv[argidx], "-i") == 0)
+      idle = atoi (argv[argidx + 1]);
+    else
+      break;
+  }
+
+  if (strlen (argv[1]) >= sizeof (addr.sun_path))
+  {
+    fprintf (stderr, "Socket path is too long: %s\n", argv[1]);
+    return 1;
+  }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, argv[1]);
+
+  for (tries = 0; tries < CONNECTTRIES; tries++)
+  {
+    if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+      fprintf (stderr, "Cannot create socket: %s\n", strerror (errno));
+      return 1;
+    }
+
+    if (connect (fd, (struct sockaddr *)&addr, sizeof (addr)) == 0)
+      break;
+
+    close (fd);
+    fd = -1;
+    usleep (100000);
+  }
+
+  if (fd < 0)
+  {
+    fprintf (stderr, "Cannot connect to %s: %s\n", argv[1], strerror (errno));
+    return 1;
+  }
+
+  /* An idle client before the request */
+  if (idle > 0)
+    sleep (idle);
+
+  /* One argument per line followed by an empty line */
+  for (; argidx < argc; argidx++)
+  {
+    if (sendall (fd, argv[argidx], strlen (argv[argidx])) || sendall (fd, "\n", 1))
+      return 1;
+  }
+
+  if (sendall (fd, "\n", 1))
+    return 1;
+
+  /* Input read by the job from the connection */
+  if (datafile)
+  {
+    if ((fp = fopen (datafile, "rb")) == NULL)
+    {
+      fprintf (stderr, "Cannot open %s: %s\n", datafile, strerror (errno));
+      return 1;
+    }
+
+    while ((length = fread (buffer, 1, sizeof (buffer), fp)) > 0)
+    {
+      if (sendall (fd, buffer, length))
+        return 1;
+    }
+
+    fclose (fp);
+  }
+
+  shutdown (fd, SHUT_WR);
+
+  while ((count = read (fd, buffer, sizeof (buffer))) != 0)
+  {
+    if (count < 0 && errno == EINTR)
+      continue;
+
+    if (count < 0)
+    {
+      fprintf (stderr, "Cannot read job output: %s\n", strerror (errno));
+      return 1;
+    }
+
+    if (fwrite (buffer, count, 1, stdout) != 1)
+    {
+      fprintf (stderr, "Cannot write job output: %s\n", strerror (errno));
+      return 1;
+    }
+  }
+
+  close (fd);
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * sendall():
+ * Send all of a buffer on a connection.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+sendall (int fd, const char *data, size_t length)
+{
+  ssize_t count;
+
+  while (length > 0)
+  {
+    if ((count = write (fd, data, length)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      fprintf (stderr, "Cannot send job request: %s\n", strerror (errno));
+      return -1;
+    }
+
+    data += count;
+    length -= count;
+  }
+
+  return 0;
+} /* End of sendall() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s socket [-d datafile] [-i seconds] [job arguments]\n\n", PACKAGE);
+  fprintf (stderr,
+           " socket         Unix socket of a mseed2sac daemon\n"
+           " -d datafile    Send datafile as the input \"-\" of the job\n"
+           " -i seconds     Stay idle for seconds after connecting\n"
+           " job arguments  Options and input files of the job\n"
+           "\n"
+           "This program sends a job request to a mseed2sac daemon and copies\n"
+           "the output of the job to stdout.\n"
+           "\n");
+} /* End of usage() */
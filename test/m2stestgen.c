@@ -0,0 +1,202 @@
+/***************************************************************************
+ * m2stestgen.c
+ *
+ * A program for mseed2sac tests, generating a miniSEED file of a
+ * single continuous channel with a number of samples.
+ *
+ * The samples are a random walk with small steps from a fixed seed,
+ * packed into 512-byte Steim2 records, so the file is compact and the
+ * same for every run while the SAC file converted from it does not
+ * compress much.
+ *
+ * modified 2026.287
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#define PACKAGE "m2stestgen"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+static int64_t samplecount = 0;
+static char *outputfile = 0;
+
+static void record_handler (char *record, int reclen, void *handlerdata);
+static int parameter_proc (int argcount, char **argvec);
+static void usage (void);
+
+int
+main (int argc, char **argv)
+{
+  MSRecord *msr = NULL;
+  int64_t packedsamples = 0;
+  int32_t *samples;
+  int32_t value = 0;
+  uint32_t lcg = 12345;
+  int64_t idx;
+  FILE *fp;
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  if ((samples = (int32_t *)malloc (samplecount * sizeof (int32_t))) == NULL)
+  {
+    fprintf (stderr, "Cannot allocate memory\n");
+    return 1;
+  }
+
+  for (idx = 0; idx < samplecount; idx++)
+  {
+    lcg = lcg * 1103515245u + 12345u;
+    value += (int32_t)((lcg >> 16) % 101) - 50;
+    samples[idx] = value;
+  }
+
+  if ((fp = fopen (outputfile, "wb")) == NULL)
+  {
+    fprintf (stderr, "Cannot open %s: %s\n", outputfile, strerror (errno));
+    free (samples);
+    return 1;
+  }
+
+  if (!(msr = msr_init (NULL)))
+  {
+    fprintf (stderr, "Cannot allocate memory\n");
+    fclose (fp);
+    free (samples);
+    return 1;
+  }
+
+  strcpy (msr->network, "XX");
+  strcpy (msr->station, "LONG");
+  strcpy (msr->channel, "BHZ");
+  msr->dataquality = 'D';
+  msr->starttime   = ms_timestr2hptime ("2020-03-01T00:00:00");
+  msr->samprate    = 40.0;
+  msr->reclen      = 512;
+  msr->encoding    = DE_STEIM2;
+  msr->byteorder   = 1;
+  msr->datasamples = samples;
+  msr->numsamples  = samplecount;
+  msr->samplecnt   = samplecount;
+  msr->sampletype  = 'i';
+
+  if (msr_pack (msr, record_handler, fp, &packedsamples, 1, 0) < 0 ||
+      packedsamples != samplecount)
+  {
+    fprintf (stderr, "Cannot pack %" PRId64 " samples\n", samplecount);
+    msr->datasamples = NULL;
+    msr_free (&msr);
+    fclose (fp);
+    free (samples);
+    return 1;
+  }
+
+  msr->datasamples = NULL;
+  msr_free (&msr);
+  free (samples);
+
+  if (fclose (fp))
+  {
+    fprintf (stderr, "Cannot write %s: %s\n", outputfile, strerror (errno));
+    return 1;
+  }
+
+  return 0;
+} /* End of main() */
+
+/***************************************************************************
+ * record_handler():
+ * Write a packed record to the output file.
+ ***************************************************************************/
+static void
+record_handler (char *record, int reclen, void *handlerdata)
+{
+  if (fwrite (record, reclen, 1, (FILE *)handlerdata) != 1)
+  {
+    fprintf (stderr, "Cannot write %s: %s\n", outputfile, strerror (errno));
+    exit (1);
+  }
+} /* End of record_handler() */
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      fprintf (stderr, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-n") == 0 && optind + 1 < argcount)
+    {
+      samplecount = strtoll (argvec[++optind], NULL, 10);
+    }
+    else if (strncmp (argvec[optind], "-", 1) == 0)
+    {
+      fprintf (stderr, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+    else if (outputfile == 0)
+    {
+      outputfile = argvec[optind];
+    }
+    else
+    {
+      fprintf (stderr, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+  }
+
+  /* Make sure a sample count and output file were specified */
+  if (samplecount < 1 || samplecount > 100000000 || !outputfile)
+  {
+    fprintf (stderr, "No sample count between 1 and 100000000 or output file was specified\n\n");
+    fprintf (stderr, "Try %s -h for usage\n", PACKAGE);
+    exit (1);
+  }
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s -n samples outputfile\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -n samples     Number of samples to generate\n"
+           "\n"
+           " outputfile     miniSEED file to write\n"
+           "\n"
+           "This program writes a miniSEED file of one continuous channel\n"
+           "of generated samples.\n"
+           "\n");
+} /* End of usage() */
@@ -0,0 +1,439 @@
+/***************************************************************************
+ * m2stestsink.c
+ *
+ * A program for libmseed2sac tests, converting the traces of a file
+ * to SAC through the output sinks of the library.
+ *
+ * The traces are written to files with a callback sink, to a memory
+ * buffer sink, which must contain the same SAC files, and concurrently
+ * by threads with their own contexts and buffer sinks, which must all
+ * produce the same buffer.  The traces are also written from a trace
+ * list.
+ *
+ * modified 2026.287
+ ***************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+#include "libmseed2sac.h"
+
+#define PACKAGE "m2stestsink"
+#define VERSION "[libmseed " LIBMSEED_VERSION " " PACKAGE " ]"
+
+/* Largest number of conversion threads */
+#define MAXTHREADS 16
+
+static flag verbose     = 0;
+static int sacformat    = M2S_BINARY;
+static int threads      = 0;
+static char *inputfile  = 0;
+static char *outputdir  = 0;
+
+/* Handle of the callback sink writing files */
+struct filesink
+{
+  FILE *fp;
+  char path[1024];
+  M2SBuffer written; /* Contents of all files written */
+};
+
+/* Conversion by a thread */
+struct conversion
+{
+  MSTraceGroup *mstg;
+  M2SBuffer buffer;
+  int rv;
+};
+
+static int writegroup (const M2SContext *ctx, MSTraceGroup *mstg, M2SSink *sink);
+static void *convertthread (void *arg);
+static int filebegin (void *handle, const char *name, const MSTrace *mst);
+static int filewrite (void *handle, const void *data, size_t length);
+static int fileend (void *handle);
+static int parameter_proc (int argcount, char **argvec);
+static void print_stderr (char *message);
+static void usage (void);
+
+int
+main (int argc, char **argv)
+{
+  MSRecord *msr           = NULL;
+  MSTraceGroup *mstg      = NULL;
+  MSTraceList *mstl       = NULL;
+  struct conversion conversions[MAXTHREADS];
+  pthread_t tids[MAXTHREADS];
+  struct filesink files;
+  M2SContext ctx;
+  M2SSink sink;
+  M2SBuffer buffer;
+  M2SBuffer listbuffer;
+  M2SSink buffersink;
+  int retcode;
+  int count;
+  int idx;
+  int rv = 0;
+
+  /* Redirect libmseed logging facility to stderr for consistency */
+  ms_loginit (print_stderr, NULL, print_stderr, NULL);
+
+  /* Process given parameters (command line and parameter file) */
+  if (parameter_proc (argc, argv) < 0)
+    return -1;
+
+  mstg = mst_initgroup (NULL);
+  mstl = mstl_init (NULL);
+
+  /* Assemble traces as mseed2sac, separated by quality */
+  while ((retcode = ms_readmsr (&msr, inputfile, 0, NULL, NULL, 1, 1, verbose)) == MS_NOERROR)
+  {
+    mst_addmsrtogroup (mstg, msr, 1, -1.0, -1.0);
+    mstl_addmsr (mstl, msr, 1, 1, -1.0, -1.0);
+  }
+
+  if (retcode != MS_ENDOFFILE)
+    ms_log (2, "Cannot read %s: %s\n", inputfile, ms_errorstr (retcode));
+
+  /* Cleanup memory and close file */
+  ms_readmsr (&msr, NULL, 0, NULL, NULL, 0, 0, 0);
+
+  m2s_initcontext (&ctx);
+  ctx.format  = sacformat;
+  ctx.verbose = verbose;
+
+  /* Write the SAC files with the callback sink */
+  memset (&files, 0, sizeof (files));
+  memset (&sink, 0, sizeof (sink));
+  sink.begin  = filebegin;
+  sink.write  = filewrite;
+  sink.end    = fileend;
+  sink.handle = &files;
+
+  if ((count = writegroup (&ctx, mstg, &sink)) < 0)
+  {
+    ms_log (2, "Cannot write SAC files to sink\n");
+    return 1;
+  }
+
+  ms_log (0, "Callback sink: %d SAC files, %zu bytes\n", count, files.written.length);
+
+  /* Write the SAC files to a memory buffer */
+  memset (&buffer, 0, sizeof (buffer));
+  m2s_buffersink (&buffersink, &buffer);
+
+  if ((count = writegroup (&ctx, mstg, &buffersink)) < 0)
+  {
+    ms_log (2, "Cannot write SAC files to buffer\n");
+    return 1;
+  }
+
+  if (buffer.length == files.written.length &&
+      !memcmp (buffer.data, files.written.data, buffer.length))
+    ms_log (0, "Buffer sink: %d SAC files, %zu bytes, matches files\n", count, buffer.length);
+  else
+    ms_log (0, "ERROR Buffer sink: %d SAC files, %zu bytes, differs from files\n",
+            count, buffer.length);
+
+  /* Concurrent conversions with separate contexts and sinks */
+  for (idx = 0; idx < threads; idx++)
+  {
+    memset (&conversions[idx], 0, sizeof (struct conversion));
+    conversions[idx].mstg = mstg;
+
+    if ((retcode = pthread_create (&tids[idx], NULL, convertthread, &conversions[idx])))
+    {
+      ms_log (2, "Cannot create conversion thread: %s\n", strerror (retcode));
+      return 1;
+    }
+  }
+
+  for (idx = 0; idx < threads; idx++)
+  {
+    pthread_join (tids[idx], NULL);
+
+    if (conversions[idx].rv < 0 || conversions[idx].buffer.length != buffer.length ||
+        memcmp (conversions[idx].buffer.data, buffer.data, buffer.length))
+    {
+      ms_log (0, "ERROR Thread %d: %zu bytes, differs from buffer sink\n",
+              idx, conversions[idx].buffer.length);
+      rv = 1;
+    }
+
+    m2s_freebuffer (&conversions[idx].buffer);
+  }
+
+  if (threads)
+    ms_log (0, "Threads: %d concurrent conversions, %s\n", threads,
+            (rv) ? "differ" : "match buffer sink");
+
+  /* Write the SAC files of a trace list */
+  memset (&listbuffer, 0, sizeof (listbuffer));
+  m2s_buffersink (&buffersink, &listbuffer);
+
+  if ((count = m2s_writetracelist (&ctx, mstl, &buffersink)) < 0)
+  {
+    ms_log (2, "Cannot write SAC files of trace list\n");
+    return 1;
+  }
+
+  ms_log (0, "Trace list: %d SAC files, %zu bytes\n", count, listbuffer.length);
+
+  m2s_freebuffer (&listbuffer);
+  m2s_freebuffer (&buffer);
+  m2s_freebuffer (&files.written);
+  mst_freegroup (&mstg);
+  mstl_free (&mstl, 1);
+
+  return rv;
+} /* End of main() */
+
+/***************************************************************************
+ * writegroup():
+ * Write each trace of a MSTraceGroup as a SAC file to a sink.
+ *
+ * Returns the number of SAC files written or -1 on error.
+ ***************************************************************************/
+static int
+writegroup (const M2SContext *ctx, MSTraceGroup *mstg, M2SSink *sink)
+{
+  MSTrace *mst;
+  int count = 0;
+  int rv;
+
+  for (mst = mstg->traces; mst; mst = mst->next)
+  {
+    if ((rv = m2s_writetrace (ctx, mst, sink)) < 0)
+      return -1;
+
+    if (rv > 0)
+      count++;
+  }
+
+  return count;
+} /* End of writegroup() */
+
+/***************************************************************************
+ * convertthread():
+ * Convert the traces of a MSTraceGroup to a buffer sink, with a
+ * context of the thread.
+ ***************************************************************************/
+static void *
+convertthread (void *arg)
+{
+  struct conversion *conversion = (struct conversion *)arg;
+  M2SContext ctx;
+  M2SSink sink;
+
+  m2s_initcontext (&ctx);
+  ctx.format = sacformat;
+
+  m2s_buffersink (&sink, &conversion->buffer);
+
+  conversion->rv = writegroup (&ctx, conversion->mstg, &sink);
+
+  return NULL;
+} /* End of convertthread() */
+
+/***************************************************************************
+ * filebegin():
+ * Sink callback opening a SAC file in the output directory.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+filebegin (void *handle, const char *name, const MSTrace *mst)
+{
+  struct filesink *files = (struct filesink *)handle;
+
+  snprintf (files->path, sizeof (files->path), "%s/%s",
+            (outputdir) ? outputdir : ".", name);
+
+  if ((files->fp = fopen (files->path, "wb")) == NULL)
+  {
+    ms_log (2, "Cannot open %s: %s\n", files->path, strerror (errno));
+    return -1;
+  }
+
+  ms_log (0, "Writing %" PRId64 " samples to %s\n", mst->numsamples, name);
+
+  return 0;
+} /* End of filebegin() */
+
+/***************************************************************************
+ * filewrite():
+ * Sink callback writing SAC file contents, also kept in a buffer.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+filewrite (void *handle, const void *data, size_t length)
+{
+  struct filesink *files = (struct filesink *)handle;
+  M2SBuffer *written     = &files->written;
+
+  if (fwrite (data, length, 1, files->fp) != 1)
+  {
+    ms_log (2, "Cannot write %s: %s\n", files->path, strerror (errno));
+    return -1;
+  }
+
+  if (written->length + length > written->size)
+  {
+    written->size = (written->length + length) * 2;
+
+    if ((written->data = (char *)realloc (written->data, written->size)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return -1;
+    }
+  }
+
+  memcpy (written->data + written->length, data, length);
+  written->length += length;
+
+  return 0;
+} /* End of filewrite() */
+
+/***************************************************************************
+ * fileend():
+ * Sink callback closing a SAC file.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+fileend (void *handle)
+{
+  struct filesink *files = (struct filesink *)handle;
+
+  if (fclose (files->fp))
+  {
+    ms_log (2, "Cannot close %s: %s\n", files->path, strerror (errno));
+    files->fp = NULL;
+    return -1;
+  }
+
+  files->fp = NULL;
+
+  return 0;
+} /* End of fileend() */
+
+/***************************************************************************
+ * parameter_proc():
+ * Process the command line parameters.
+ *
+ * Returns 0 on success, and -1 on failure
+ ***************************************************************************/
+static int
+parameter_proc (int argcount, char **argvec)
+{
+  int optind;
+
+  /* Process all command line arguments */
+  for (optind = 1; optind < argcount; optind++)
+  {
+    if (strcmp (argvec[optind], "-V") == 0)
+    {
+      ms_log (1, "%s version: %s\n", PACKAGE, VERSION);
+      exit (0);
+    }
+    else if (strcmp (argvec[optind], "-h") == 0)
+    {
+      usage ();
+      exit (0);
+    }
+    else if (strncmp (argvec[optind], "-v", 2) == 0)
+    {
+      verbose += strspn (&argvec[optind][1], "v");
+    }
+    else if (strcmp (argvec[optind], "-f") == 0 && optind + 1 < argcount)
+    {
+      sacformat = (int)strtol (argvec[++optind], NULL, 10);
+
+      if (sacformat < M2S_ALPHA || sacformat > M2S_BINARYBE)
+      {
+        ms_log (2, "Unsupported SAC format: %d\n", sacformat);
+        exit (1);
+      }
+    }
+    else if (strcmp (argvec[optind], "-t") == 0 && optind + 1 < argcount)
+    {
+      threads = (int)strtol (argvec[++optind], NULL, 10);
+
+      if (threads < 0 || threads > MAXTHREADS)
+      {
+        ms_log (2, "Number of threads must be between 0 and %d\n", MAXTHREADS);
+        exit (1);
+      }
+    }
+    else if (strcmp (argvec[optind], "-o") == 0 && optind + 1 < argcount)
+    {
+      outputdir = argvec[++optind];
+    }
+    else if (strncmp (argvec[optind], "-", 1) == 0 &&
+             strlen (argvec[optind]) > 1)
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+    else if (inputfile == 0)
+    {
+      inputfile = argvec[optind];
+    }
+    else
+    {
+      ms_log (2, "Unknown option: %s\n", argvec[optind]);
+      exit (1);
+    }
+  }
+
+  /* Make sure an input file was specified */
+  if (!inputfile)
+  {
+    ms_log (2, "No input file was specified\n\n");
+    ms_log (1, "%s version %s\n\n", PACKAGE, VERSION);
+    ms_log (1, "Try %s -h for usage\n", PACKAGE);
+    exit (1);
+  }
+
+  return 0;
+} /* End of parameter_proc() */
+
+/***************************************************************************
+ * print_stderr():
+ * Print messsage to stderr.
+ ***************************************************************************/
+static void
+print_stderr (char *message)
+{
+  fprintf (stderr, "%s", message);
+} /* End of print_stderr() */
+
+/***************************************************************************
+ * usage():
+ * Print the usage message.
+ ***************************************************************************/
+static void
+usage (void)
+{
+  fprintf (stderr, "%s version: %s\n\n", PACKAGE, VERSION);
+  fprintf (stderr, "Usage: %s [options] file\n\n", PACKAGE);
+  fprintf (stderr,
+           " ## Options ##\n"
+           " -V             Report program version\n"
+           " -h             Show this usage message\n"
+           " -v             Be more verbose, multiple flags can be used\n"
+           " -f format      SAC format, 1 to 4 as for mseed2sac -f\n"
+           " -t threads     Also convert concurrently with threads\n"
+           " -o dir         Write SAC files into dir, default is the current\n"
+           "\n"
+           " file           File of miniSEED records\n"
+           "\n"
+           "This program converts the traces of a file to SAC with callback and\n"
+           "memory buffer sinks of libmseed2sac.\n"
+           "\n");
+} /* End of usage() */